@@ -0,0 +1,126 @@
+#include "Mesh.h"
+#include "OpenDriveMap.h"
+#include "RoadNetworkMesh.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* a synthetic network: num_roads winding roads with 3 lanes on each side and broken roadmarks */
+static void write_synthetic_xodr(const std::string& filename, int num_roads)
+{
+    std::ofstream out(filename);
+    out << "<?xml version=\"1.0\" standalone=\"yes\"?>\n<OpenDRIVE>\n"
+        << "    <header revMajor=\"1\" revMinor=\"4\" name=\"synthetic\"/>\n";
+    for (int r = 0; r < num_roads; r++)
+    {
+        const double y = r * 50.0;
+        out << "    <road name=\"\" length=\"600\" id=\"" << r << "\" junction=\"-1\">\n"
+            << "        <planView>\n"
+            << "            <geometry s=\"0\" x=\"0\" y=\"" << y << "\" hdg=\"0\" length=\"200\"><line/></geometry>\n"
+            << "            <geometry s=\"200\" x=\"200\" y=\"" << y << "\" hdg=\"0\" length=\"200\"><arc curvature=\"0.005\"/></geometry>\n"
+            << "            <geometry s=\"400\" x=\"368.29\" y=\"" << y + 91.94 << "\" hdg=\"1\" length=\"200\">"
+            << "<paramPoly3 aU=\"0\" bU=\"200\" cU=\"0\" dU=\"0\" aV=\"0\" bV=\"0\" cV=\"10\" dV=\"-5\" pRange=\"normalized\"/></geometry>\n"
+            << "        </planView>\n"
+            << "        <elevationProfile><elevation s=\"0\" a=\"0\" b=\"0.01\" c=\"0\" d=\"0\"/></elevationProfile>\n"
+            << "        <lanes>\n";
+        for (double s0 : {0.0, 300.0})
+        {
+            out << "            <laneSection s=\"" << s0 << "\">\n";
+            for (const char* side : {"left", "right"})
+            {
+                const int sign = (side[0] == 'l') ? 1 : -1;
+                out << "                <" << side << ">\n";
+                for (int i = 3; i >= 1; i--)
+                {
+                    out << "                    <lane id=\"" << sign * i << "\" type=\"driving\" level=\"false\">\n"
+                        << "                        <width sOffset=\"0\" a=\"3.5\" b=\"0\" c=\"0\" d=\"0\"/>\n"
+                        << "                        <roadMark sOffset=\"0\" type=\"broken\" weight=\"standard\" color=\"standard\" width=\"0.15\"/>\n"
+                        << "                    </lane>\n";
+                }
+                out << "                </" << side << ">\n";
+            }
+            out << "                <center><lane id=\"0\" type=\"none\" level=\"false\">"
+                << "<roadMark sOffset=\"0\" type=\"solid solid\" weight=\"standard\" color=\"yellow\" width=\"0.15\"/></lane></center>\n"
+                << "            </laneSection>\n";
+        }
+        out << "        </lanes>\n"
+            << "    </road>\n";
+    }
+    out << "</OpenDRIVE>\n";
+}
+
+template<typename T>
+static bool same_vector(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || std::equal(a.begin(), a.end(), b.begin()));
+}
+
+static bool same_mesh(const odr::Mesh3D& a, const odr::Mesh3D& b)
+{
+    return same_vector(a.vertices, b.vertices) && same_vector(a.indices, b.indices) && same_vector(a.normals, b.normals) &&
+           same_vector(a.st_coordinates, b.st_coordinates);
+}
+
+/* byte-identical: the same vertices, indices and start-index maps */
+static bool same_road_network_mesh(const odr::RoadNetworkMesh& a, const odr::RoadNetworkMesh& b)
+{
+    return same_mesh(a.lanes_mesh, b.lanes_mesh) && same_mesh(a.roadmarks_mesh, b.roadmarks_mesh) &&
+           same_mesh(a.road_objects_mesh, b.road_objects_mesh) && same_mesh(a.road_signals_mesh, b.road_signals_mesh) &&
+           a.lanes_mesh.road_start_indices == b.lanes_mesh.road_start_indices &&
+           a.lanes_mesh.lanesec_start_indices == b.lanes_mesh.lanesec_start_indices &&
+           a.lanes_mesh.lane_start_indices == b.lanes_mesh.lane_start_indices &&
+           a.roadmarks_mesh.road_start_indices == b.roadmarks_mesh.road_start_indices &&
+           a.roadmarks_mesh.lanesec_start_indices == b.roadmarks_mesh.lanesec_start_indices &&
+           a.roadmarks_mesh.lane_start_indices == b.roadmarks_mesh.lane_start_indices &&
+           a.roadmarks_mesh.roadmark_type_start_indices == b.roadmarks_mesh.roadmark_type_start_indices &&
+           a.road_objects_mesh.road_start_indices == b.road_objects_mesh.road_start_indices &&
+           a.road_objects_mesh.road_object_start_indices == b.road_objects_mesh.road_object_start_indices &&
+           a.road_signals_mesh.road_signal_start_indices == b.road_signals_mesh.road_signal_start_indices;
+}
+
+int main(int argc, char** argv)
+{
+    /* bench-mesh [file.xodr | num_roads] [eps] */
+    std::string xodr_file = (argc > 1) ? argv[1] : "200";
+    const double eps = (argc > 2) ? atof(argv[2]) : 0.1;
+    if (xodr_file.find_first_not_of("0123456789") == std::string::npos)
+    {
+        const int num_roads = atoi(xodr_file.c_str());
+        xodr_file = "/tmp/bench-mesh-synthetic.xodr";
+        write_synthetic_xodr(xodr_file, num_roads);
+    }
+
+    odr::OpenDriveMap odr_map(xodr_file);
+    printf("%s: %lu roads, eps %.2f, %u hardware threads\n",
+           xodr_file.c_str(),
+           odr_map.get_roads().size(),
+           eps,
+           std::thread::hardware_concurrency());
+
+    auto                       t0 = std::chrono::steady_clock::now();
+    const odr::RoadNetworkMesh serial = odr_map.get_road_network_mesh(eps);
+    auto                       t1 = std::chrono::steady_clock::now();
+    const double               serial_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    printf("threads  1: %9.1f ms (%lu lane vertices, %lu roadmark vertices)\n",
+           serial_ms,
+           serial.lanes_mesh.vertices.size(),
+           serial.roadmarks_mesh.vertices.size());
+
+    int failed = 0;
+    for (unsigned int num_threads : {2u, 4u, 8u, 16u})
+    {
+        t0 = std::chrono::steady_clock::now();
+        const odr::RoadNetworkMesh parallel = odr_map.get_road_network_mesh(eps, num_threads);
+        t1 = std::chrono::steady_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        const bool   same = same_road_network_mesh(serial, parallel);
+        printf("threads %2u: %9.1f ms, speedup %5.2fx, %s\n", num_threads, ms, serial_ms / ms, same ? "identical" : "MISMATCH");
+        failed += same ? 0 : 1;
+    }
+    return failed ? 1 : 0;
+}
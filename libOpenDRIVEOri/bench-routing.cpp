@@ -0,0 +1,244 @@
+#include "Lane.h"
+#include "Math.hpp"
+#include "OpenDriveMap.h"
+#include "RoutingGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* a grid city: size x size junctions block_len apart, every street segment is a road with one lane per
+   direction and every junction connects each incoming lane to the outgoing lanes of the other three arms */
+static odr::RoutingGraph make_grid_city(int size, double block_len, std::unordered_map<odr::LaneKey, odr::Vec3D>& lane_positions)
+{
+    odr::RoutingGraph routing_graph;
+    const double      turn_len = 15.0;
+
+    /* the lane entering junction (x, y) from direction dir (0: east, 1: north, 2: west, 3: south) */
+    auto segment_lane = [&](int x, int y, int dir, bool incoming) -> odr::LaneKey
+    {
+        const int dx[] = {1, 0, -1, 0}, dy[] = {0, 1, 0, -1};
+        const int nx = x + dx[dir], ny = y + dy[dir];
+        const int ax = std::min(x, nx), ay = std::min(y, ny);
+        const std::string road_id = ((dir % 2) ? "v_" : "h_") + std::to_string(ax) + "_" + std::to_string(ay);
+        /* lane -1 runs towards +x/+y, lane 1 towards -x/-y */
+        const bool towards_positive = (dir < 2) != incoming;
+        return odr::LaneKey(road_id, 0, towards_positive ? -1 : 1);
+    };
+
+    for (int x = 0; x < size; x++)
+    {
+        for (int y = 0; y < size; y++)
+        {
+            const odr::Vec3D junction_pos{x * block_len, y * block_len, 0};
+            for (int in_dir = 0; in_dir < 4; in_dir++)
+            {
+                const int dx[] = {1, 0, -1, 0}, dy[] = {0, 1, 0, -1};
+                if (x + dx[in_dir] < 0 || x + dx[in_dir] >= size || y + dy[in_dir] < 0 || y + dy[in_dir] >= size)
+                    continue;
+                const odr::LaneKey in_lane = segment_lane(x, y, in_dir, true);
+                lane_positions[in_lane] = {junction_pos[0] + dx[in_dir] * block_len, junction_pos[1] + dy[in_dir] * block_len, 0};
+
+                for (int out_dir = 0; out_dir < 4; out_dir++)
+                {
+                    if (out_dir == in_dir || x + dx[out_dir] < 0 || x + dx[out_dir] >= size || y + dy[out_dir] < 0 ||
+                        y + dy[out_dir] >= size)
+                        continue;
+                    const odr::LaneKey out_lane = segment_lane(x, y, out_dir, false);
+                    const odr::LaneKey turn_lane("j_" + std::to_string(x) + "_" + std::to_string(y) + "_" + std::to_string(in_dir * 4 + out_dir),
+                                                 0,
+                                                 -1);
+                    lane_positions[turn_lane] = junction_pos;
+                    lane_positions[out_lane] = junction_pos;
+                    routing_graph.add_edge(odr::RoutingGraphEdge(in_lane, turn_lane, block_len));
+                    routing_graph.add_edge(odr::RoutingGraphEdge(turn_lane, out_lane, turn_len));
+                }
+            }
+        }
+    }
+    return routing_graph;
+}
+
+/* the previous implementation of RoutingGraph::shortest_path() */
+static std::vector<odr::LaneKey> legacy_shortest_path(const odr::RoutingGraph& graph, const odr::LaneKey& from, const odr::LaneKey& to)
+{
+    std::vector<odr::LaneKey> path;
+    if (graph.lane_key_to_successors.count(from) == 0)
+        return path;
+
+    std::unordered_set<odr::LaneKey> vertices;
+    for (const auto& lane_key_successors : graph.lane_key_to_successors)
+    {
+        vertices.insert(lane_key_successors.first);
+        vertices.insert(lane_key_successors.second.begin(), lane_key_successors.second.end());
+    }
+    if (vertices.count(to) == 0)
+        return path;
+
+    std::vector<odr::LaneKey>                      nodes;
+    std::unordered_map<odr::LaneKey, double>       weights;
+    std::unordered_map<odr::LaneKey, odr::LaneKey> previous;
+
+    auto comparator = [&](const odr::LaneKey& lhs, const odr::LaneKey& rhs) { return weights[lhs] > weights[rhs]; };
+    for (const auto& lane_key : vertices)
+    {
+        weights[lane_key] = std::equal_to<odr::LaneKey>{}(lane_key, from) ? 0 : std::numeric_limits<double>::max();
+        nodes.push_back(lane_key);
+        std::push_heap(nodes.begin(), nodes.end(), comparator);
+    }
+
+    while (nodes.empty() == false)
+    {
+        std::pop_heap(nodes.begin(), nodes.end(), comparator);
+        odr::LaneKey smallest = nodes.back();
+        nodes.pop_back();
+        if (std::equal_to<odr::LaneKey>{}(smallest, to))
+        {
+            while (previous.find(smallest) != previous.end())
+            {
+                path.push_back(smallest);
+                smallest = previous.at(smallest);
+            }
+            break;
+        }
+        if (weights.at(smallest) == std::numeric_limits<double>::max())
+            break;
+        auto smallest_succ_iter = graph.lane_key_to_successors.find(smallest);
+        if (smallest_succ_iter == graph.lane_key_to_successors.end())
+            continue;
+        for (const auto& successor : smallest_succ_iter->second)
+        {
+            const double alt = weights.at(smallest) + successor.weight;
+            if (alt < weights.at(successor))
+            {
+                weights[successor] = alt;
+                previous.insert({successor, smallest});
+                std::make_heap(nodes.begin(), nodes.end(), comparator);
+            }
+        }
+    }
+    path.push_back(from);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+static double path_cost(const odr::CompiledRoutingGraph& graph, const std::vector<odr::LaneKey>& path)
+{
+    double cost = 0;
+    for (std::size_t i = 0; i + 1 < path.size(); i++)
+    {
+        const uint32_t from = graph.get_lane_idx(path[i]), to = graph.get_lane_idx(path[i + 1]);
+        double         weight = -1;
+        for (uint32_t pos = graph.successor_offsets[from]; pos < graph.successor_offsets[from + 1]; pos++)
+        {
+            if (graph.successors[pos] == to)
+                weight = graph.successor_weights[pos];
+        }
+        if (weight < 0)
+            return -1; // not a path of the graph
+        cost += weight;
+    }
+    return cost;
+}
+
+template<typename F>
+static double time_queries(const std::vector<std::pair<odr::LaneKey, odr::LaneKey>>& queries,
+                           std::size_t                                            count,
+                           std::vector<double>&                                   costs,
+                           const odr::CompiledRoutingGraph&                       graph,
+                           F                                                      route)
+{
+    count = std::min(count, queries.size());
+    costs.clear();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++)
+        costs.push_back(path_cost(graph, route(queries[i].first, queries[i].second)));
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(t1 - t0).count() / count;
+}
+
+int main(int argc, char** argv)
+{
+    /* bench-routing [grid size] [queries] [file.xodr] */
+    const int size = (argc > 1) ? atoi(argv[1]) : 20;
+    const int num_queries = (argc > 2) ? atoi(argv[2]) : 1000;
+
+    std::unordered_map<odr::LaneKey, odr::Vec3D> lane_positions;
+    odr::RoutingGraph                             routing_graph = make_grid_city(size, 100.0, lane_positions);
+    if (argc > 3)
+    {
+        odr::OpenDriveMap odr_map(argv[3]);
+        routing_graph = odr_map.get_routing_graph();
+        const odr::CompiledRoutingGraph map_graph = odr_map.get_compiled_routing_graph();
+        for (std::size_t idx = 0; idx < map_graph.lane_positions.size(); idx++)
+            lane_positions[map_graph.lane_keys[idx]] = map_graph.lane_positions[idx];
+    }
+
+    auto                            t0 = std::chrono::steady_clock::now();
+    const odr::CompiledRoutingGraph graph(routing_graph, lane_positions);
+    auto                            t1 = std::chrono::steady_clock::now();
+    printf("%lu lanes, %lu edges, compiled in %.1f ms, heuristic scale %.3f\n",
+           graph.get_num_lanes(),
+           graph.successors.size(),
+           std::chrono::duration<double, std::milli>(t1 - t0).count(),
+           graph.heuristic_scale);
+
+    std::mt19937                               gen(5);
+    std::uniform_int_distribution<std::size_t> lane(0, graph.get_num_lanes() - 1);
+    std::vector<std::pair<odr::LaneKey, odr::LaneKey>> queries;
+    for (int i = 0; i < num_queries; i++)
+        queries.push_back({graph.lane_keys[lane(gen)], graph.lane_keys[lane(gen)]});
+
+    std::vector<double> legacy_costs, graph_costs, dijkstra_costs, astar_costs;
+    const double        legacy_us = time_queries(queries, 10, legacy_costs, graph, [&](const odr::LaneKey& from, const odr::LaneKey& to) {
+        return legacy_shortest_path(routing_graph, from, to);
+    });
+    const double        graph_us = time_queries(queries, queries.size(), graph_costs, graph, [&](const odr::LaneKey& from, const odr::LaneKey& to) {
+        return routing_graph.shortest_path(from, to);
+    });
+    const double        dijkstra_us = time_queries(queries, queries.size(), dijkstra_costs, graph, [&](const odr::LaneKey& from, const odr::LaneKey& to) {
+        return graph.shortest_path(from, to, false);
+    });
+    const double        astar_us = time_queries(queries, queries.size(), astar_costs, graph, [&](const odr::LaneKey& from, const odr::LaneKey& to) {
+        return graph.shortest_path(from, to, true);
+    });
+
+    /* the legacy search keeps the first predecessor found for a lane and may return a longer path */
+    int legacy_longer = 0, mismatches = 0;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        if (i < legacy_costs.size() && legacy_costs[i] > dijkstra_costs[i] + 1e-6)
+            legacy_longer++;
+        if (i < graph_costs.size() && std::abs(graph_costs[i] - dijkstra_costs[i]) > 1e-6)
+            mismatches++;
+        if (std::abs(astar_costs[i] - dijkstra_costs[i]) > 1e-6)
+            mismatches++;
+    }
+
+    printf("legacy make_heap Dijkstra     : %10.1f us/query (%lu queries, %d longer paths)\n", legacy_us, legacy_costs.size(), legacy_longer);
+    printf("RoutingGraph::shortest_path   : %10.1f us/query (%lu queries, compiled once)\n", graph_us, graph_costs.size());
+    printf("CompiledRoutingGraph Dijkstra : %10.1f us/query (%lu queries)\n", dijkstra_us, dijkstra_costs.size());
+    printf("CompiledRoutingGraph A*       : %10.1f us/query (%lu queries)\n", astar_us, astar_costs.size());
+    printf("speedup vs legacy             : %10.1fx (Dijkstra), %.1fx (A*)\n", legacy_us / dijkstra_us, legacy_us / astar_us);
+
+    /* a new edge drops the cached compiled graph: a shortcut has to be taken by the next query */
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        const std::vector<odr::LaneKey> path = routing_graph.shortest_path(queries[i].first, queries[i].second);
+        if (path.size() < 3)
+            continue;
+        routing_graph.add_edge(odr::RoutingGraphEdge(queries[i].first, queries[i].second, 1e-3));
+        if (routing_graph.shortest_path(queries[i].first, queries[i].second).size() != 2)
+            mismatches++;
+        break;
+    }
+    printf("path cost mismatches          : %d\n", mismatches);
+    return mismatches ? 1 : 0;
+}
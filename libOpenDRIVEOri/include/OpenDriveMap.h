@@ -28,8 +28,11 @@ public:
     std::vector<Road>     get_roads() const;
     std::vector<Junction> get_junctions() const;
 
-    RoadNetworkMesh get_road_network_mesh(const double eps) const;
+    /* num_threads > 1 tessellates the roads in parallel, the result is identical to the serial one */
+    RoadNetworkMesh get_road_network_mesh(const double eps, const unsigned int num_threads = 1) const;
     RoutingGraph    get_routing_graph() const;
+    /* the routing graph with lane positions for A* queries */
+    CompiledRoutingGraph get_compiled_routing_graph() const;
 
     std::string        proj4 = "";
     double             x_offs = 0;
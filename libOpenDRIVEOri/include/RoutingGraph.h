@@ -1,7 +1,9 @@
 #pragma once
 #include "Lane.h"
+#include "Math.hpp"
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -70,6 +72,8 @@ struct equal_to<odr::WeightedLaneKey>
 namespace odr
 {
 
+class CompiledRoutingGraph;
+
 class RoutingGraph
 {
 public:
@@ -80,9 +84,46 @@ public:
     std::vector<LaneKey> get_lane_predecessors(const LaneKey& lane_key) const;
     std::vector<LaneKey> shortest_path(const LaneKey& from, const LaneKey& to) const;
 
+    /* compiled on first use and kept until the next add_edge(), changes made to the members directly have to be
+     * followed by invalidate_compiled_graph() */
+    std::shared_ptr<const CompiledRoutingGraph> get_compiled_graph() const;
+    void                                        invalidate_compiled_graph();
+
     std::unordered_set<RoutingGraphEdge>                             edges;
     std::unordered_map<LaneKey, std::unordered_set<WeightedLaneKey>> lane_key_to_successors;
     std::unordered_map<LaneKey, std::unordered_set<WeightedLaneKey>> lane_key_to_predecessors;
+
+private:
+    /* accessed with the atomic shared_ptr functions, concurrent queries may compile it more than once */
+    mutable std::shared_ptr<const CompiledRoutingGraph> compiled_graph;
+};
+
+/* RoutingGraph compiled for queries: lanes are mapped to dense ids and the successors are kept in CSR
+ * arrays, the successors of lane i are successors[successor_offsets[i]:successor_offsets[i + 1]] */
+class CompiledRoutingGraph
+{
+public:
+    CompiledRoutingGraph() = default;
+    /* lane_positions enables the A* search, it has to contain every lane of the graph */
+    CompiledRoutingGraph(const RoutingGraph& routing_graph, const std::unordered_map<LaneKey, Vec3D>& lane_positions = {});
+
+    /* returns -1 if the lane is not part of the graph */
+    int                   get_lane_idx(const LaneKey& lane_key) const;
+    std::size_t           get_num_lanes() const;
+    std::vector<uint32_t> shortest_path(const uint32_t from, const uint32_t to, const bool use_astar = true) const;
+    std::vector<LaneKey>  shortest_path(const LaneKey& from, const LaneKey& to, const bool use_astar = true) const;
+
+    std::vector<LaneKey>                  lane_keys;
+    std::unordered_map<LaneKey, uint32_t> lane_key_to_idx;
+
+    std::vector<uint32_t> successor_offsets;
+    std::vector<uint32_t> successors;
+    std::vector<double>   successor_weights;
+
+    /* h(lane) = heuristic_scale * |lane_positions[lane] - lane_positions[to]|, the scale is chosen
+     * so that h never drops by more than the weight of an edge, which keeps it consistent */
+    std::vector<Vec3D> lane_positions;
+    double             heuristic_scale = 0;
 };
 
 } // namespace odr
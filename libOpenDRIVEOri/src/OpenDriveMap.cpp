@@ -18,15 +18,19 @@
 #include "Utils.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <climits>
 #include <cmath>
+#include <exception>
 #include <iterator>
 #include <memory>
 #include <set>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -681,60 +685,209 @@ std::vector<Road> OpenDriveMap::get_roads() const { return get_map_values(this->
 
 std::vector<Junction> OpenDriveMap::get_junctions() const { return get_map_values(this->id_to_junction); }
 
-RoadNetworkMesh OpenDriveMap::get_road_network_mesh(const double eps) const
+/* append the lane, roadmark, object and signal meshes of one road */
+static void add_road_mesh(RoadNetworkMesh& out_mesh, const Road& road, const double eps)
 {
-    RoadNetworkMesh  out_mesh;
     LanesMesh&       lanes_mesh = out_mesh.lanes_mesh;
     RoadmarksMesh&   roadmarks_mesh = out_mesh.roadmarks_mesh;
     RoadObjectsMesh& road_objects_mesh = out_mesh.road_objects_mesh;
     RoadSignalsMesh& road_signals_mesh = out_mesh.road_signals_mesh;
 
-    for (const auto& id_road : this->id_to_road)
-    {
-        const Road& road = id_road.second;
-        lanes_mesh.road_start_indices[lanes_mesh.vertices.size()] = road.id;
-        roadmarks_mesh.road_start_indices[roadmarks_mesh.vertices.size()] = road.id;
-        road_objects_mesh.road_start_indices[road_objects_mesh.vertices.size()] = road.id;
+    lanes_mesh.road_start_indices[lanes_mesh.vertices.size()] = road.id;
+    roadmarks_mesh.road_start_indices[roadmarks_mesh.vertices.size()] = road.id;
+    road_objects_mesh.road_start_indices[road_objects_mesh.vertices.size()] = road.id;
 
-        for (const auto& s_lanesec : road.s_to_lanesection)
+    for (const auto& s_lanesec : road.s_to_lanesection)
+    {
+        const LaneSection& lanesec = s_lanesec.second;
+        lanes_mesh.lanesec_start_indices[lanes_mesh.vertices.size()] = lanesec.s0;
+        roadmarks_mesh.lanesec_start_indices[roadmarks_mesh.vertices.size()] = lanesec.s0;
+        for (const auto& id_lane : lanesec.id_to_lane)
         {
-            const LaneSection& lanesec = s_lanesec.second;
-            lanes_mesh.lanesec_start_indices[lanes_mesh.vertices.size()] = lanesec.s0;
-            roadmarks_mesh.lanesec_start_indices[roadmarks_mesh.vertices.size()] = lanesec.s0;
-            for (const auto& id_lane : lanesec.id_to_lane)
+            const Lane&       lane = id_lane.second;
+            const std::size_t lanes_idx_offset = lanes_mesh.vertices.size();
+            lanes_mesh.lane_start_indices[lanes_idx_offset] = lane.id;
+            lanes_mesh.add_mesh(road.get_lane_mesh(lane, eps));
+
+            std::size_t roadmarks_idx_offset = roadmarks_mesh.vertices.size();
+            roadmarks_mesh.lane_start_indices[roadmarks_idx_offset] = lane.id;
+            const std::vector<RoadMark> roadmarks = lane.get_roadmarks(lanesec.s0, road.get_lanesection_end(lanesec));
+            for (const RoadMark& roadmark : roadmarks)
             {
-                const Lane&       lane = id_lane.second;
-                const std::size_t lanes_idx_offset = lanes_mesh.vertices.size();
-                lanes_mesh.lane_start_indices[lanes_idx_offset] = lane.id;
-                lanes_mesh.add_mesh(road.get_lane_mesh(lane, eps));
-
-                std::size_t roadmarks_idx_offset = roadmarks_mesh.vertices.size();
-                roadmarks_mesh.lane_start_indices[roadmarks_idx_offset] = lane.id;
-                const std::vector<RoadMark> roadmarks = lane.get_roadmarks(lanesec.s0, road.get_lanesection_end(lanesec));
-                for (const RoadMark& roadmark : roadmarks)
-                {
-                    roadmarks_idx_offset = roadmarks_mesh.vertices.size();
-                    roadmarks_mesh.roadmark_type_start_indices[roadmarks_idx_offset] = roadmark.type;
-                    roadmarks_mesh.add_mesh(road.get_roadmark_mesh(lane, roadmark, eps));
-                }
+                roadmarks_idx_offset = roadmarks_mesh.vertices.size();
+                roadmarks_mesh.roadmark_type_start_indices[roadmarks_idx_offset] = roadmark.type;
+                roadmarks_mesh.add_mesh(road.get_roadmark_mesh(lane, roadmark, eps));
             }
         }
+    }
 
-        for (const auto& id_road_object : road.id_to_object)
-        {
-            const RoadObject& road_object = id_road_object.second;
-            const std::size_t road_objs_idx_offset = road_objects_mesh.vertices.size();
-            road_objects_mesh.road_object_start_indices[road_objs_idx_offset] = road_object.id;
-            road_objects_mesh.add_mesh(road.get_road_object_mesh(road_object, eps));
-        }
+    for (const auto& id_road_object : road.id_to_object)
+    {
+        const RoadObject& road_object = id_road_object.second;
+        const std::size_t road_objs_idx_offset = road_objects_mesh.vertices.size();
+        road_objects_mesh.road_object_start_indices[road_objs_idx_offset] = road_object.id;
+        road_objects_mesh.add_mesh(road.get_road_object_mesh(road_object, eps));
+    }
 
-        for (const auto& id_signal : road.id_to_signal)
+    for (const auto& id_signal : road.id_to_signal)
+    {
+        const RoadSignal& road_signal = id_signal.second;
+        const std::size_t signals_idx_offset = road_signals_mesh.vertices.size();
+        road_signals_mesh.road_signal_start_indices[signals_idx_offset] = road_signal.id;
+        road_signals_mesh.add_mesh(road.get_road_signal_mesh(road_signal));
+    }
+}
+
+/* run fn(idx) for idx in [0, count) on num_threads threads, exceptions are rethrown in index order */
+template<typename F>
+static void parallel_for(const std::size_t count, const unsigned int num_threads, F fn)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::atomic<std::size_t>        next_idx(0);
+    auto                            worker = [&]() {
+        for (std::size_t idx = next_idx++; idx < count; idx = next_idx++)
         {
-            const RoadSignal& road_signal = id_signal.second;
-            const std::size_t signals_idx_offset = road_signals_mesh.vertices.size();
-            road_signals_mesh.road_signal_start_indices[signals_idx_offset] = road_signal.id;
-            road_signals_mesh.add_mesh(road.get_road_signal_mesh(road_signal));
+            try
+            {
+                fn(idx);
+            }
+            catch (...)
+            {
+                errors[idx] = std::current_exception();
+            }
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+template<typename K, typename V>
+static void merge_start_indices(std::map<K, V>& out, const std::map<K, V>& part, const std::size_t offset)
+{
+    for (const auto& idx_val : part)
+        out[idx_val.first + offset] = idx_val.second;
+}
+
+/* the per-mesh prefix offsets of all parts, used to place them in the merged mesh */
+struct MeshOffsets
+{
+    std::vector<std::size_t> vertices, indices, normals, st_coordinates;
+};
+
+static MeshOffsets get_mesh_offsets(const std::vector<const Mesh3D*>& parts)
+{
+    MeshOffsets offsets;
+    for (std::vector<std::size_t>* v : {&offsets.vertices, &offsets.indices, &offsets.normals, &offsets.st_coordinates})
+        v->assign(parts.size() + 1, 0);
+    for (std::size_t idx = 0; idx < parts.size(); idx++)
+    {
+        offsets.vertices[idx + 1] = offsets.vertices[idx] + parts[idx]->vertices.size();
+        offsets.indices[idx + 1] = offsets.indices[idx] + parts[idx]->indices.size();
+        offsets.normals[idx + 1] = offsets.normals[idx] + parts[idx]->normals.size();
+        offsets.st_coordinates[idx + 1] = offsets.st_coordinates[idx] + parts[idx]->st_coordinates.size();
+    }
+    return offsets;
+}
+
+static void copy_mesh_part(Mesh3D& out, const Mesh3D& part, const MeshOffsets& offsets, const std::size_t idx)
+{
+    std::copy(part.vertices.begin(), part.vertices.end(), out.vertices.begin() + offsets.vertices[idx]);
+    std::copy(part.normals.begin(), part.normals.end(), out.normals.begin() + offsets.normals[idx]);
+    std::copy(part.st_coordinates.begin(), part.st_coordinates.end(), out.st_coordinates.begin() + offsets.st_coordinates[idx]);
+
+    /* same arithmetic as Mesh3D::add_mesh() */
+    const std::size_t idx_offset = offsets.vertices[idx];
+    auto              out_iter = out.indices.begin() + offsets.indices[idx];
+    for (const uint32_t& vert_idx : part.indices)
+        *out_iter++ = vert_idx + idx_offset;
+}
+
+static void resize_mesh(Mesh3D& out, const MeshOffsets& offsets)
+{
+    out.vertices.resize(offsets.vertices.back());
+    out.indices.resize(offsets.indices.back());
+    out.normals.resize(offsets.normals.back());
+    out.st_coordinates.resize(offsets.st_coordinates.back());
+}
+
+RoadNetworkMesh OpenDriveMap::get_road_network_mesh(const double eps, const unsigned int num_threads) const
+{
+    RoadNetworkMesh out_mesh;
+    if (num_threads <= 1 || this->id_to_road.size() < 2)
+    {
+        for (const auto& id_road : this->id_to_road)
+            add_road_mesh(out_mesh, id_road.second, eps);
+        return out_mesh;
+    }
+
+    /* tessellate every road into its own mesh */
+    std::vector<const Road*> roads;
+    for (const auto& id_road : this->id_to_road)
+        roads.push_back(&id_road.second);
+    std::vector<RoadNetworkMesh> road_meshes(roads.size());
+    parallel_for(roads.size(), num_threads, [&](std::size_t idx) { add_road_mesh(road_meshes[idx], *roads[idx], eps); });
+
+    /* merge in road order, the result is identical to the serial path */
+    std::vector<const Mesh3D*> lanes, roadmarks, road_objects, road_signals;
+    for (const RoadNetworkMesh& road_mesh : road_meshes)
+    {
+        lanes.push_back(&road_mesh.lanes_mesh);
+        roadmarks.push_back(&road_mesh.roadmarks_mesh);
+        road_objects.push_back(&road_mesh.road_objects_mesh);
+        road_signals.push_back(&road_mesh.road_signals_mesh);
+    }
+    const MeshOffsets lanes_offs = get_mesh_offsets(lanes);
+    const MeshOffsets roadmarks_offs = get_mesh_offsets(roadmarks);
+    const MeshOffsets road_objects_offs = get_mesh_offsets(road_objects);
+    const MeshOffsets road_signals_offs = get_mesh_offsets(road_signals);
+    resize_mesh(out_mesh.lanes_mesh, lanes_offs);
+    resize_mesh(out_mesh.roadmarks_mesh, roadmarks_offs);
+    resize_mesh(out_mesh.road_objects_mesh, road_objects_offs);
+    resize_mesh(out_mesh.road_signals_mesh, road_signals_offs);
+
+    parallel_for(road_meshes.size(),
+                 num_threads,
+                 [&](std::size_t idx)
+                 {
+                     copy_mesh_part(out_mesh.lanes_mesh, road_meshes[idx].lanes_mesh, lanes_offs, idx);
+                     copy_mesh_part(out_mesh.roadmarks_mesh, road_meshes[idx].roadmarks_mesh, roadmarks_offs, idx);
+                     copy_mesh_part(out_mesh.road_objects_mesh, road_meshes[idx].road_objects_mesh, road_objects_offs, idx);
+                     copy_mesh_part(out_mesh.road_signals_mesh, road_meshes[idx].road_signals_mesh, road_signals_offs, idx);
+                 });
+
+    for (std::size_t idx = 0; idx < road_meshes.size(); idx++)
+    {
+        const RoadNetworkMesh& part = road_meshes[idx];
+        merge_start_indices(out_mesh.lanes_mesh.road_start_indices, part.lanes_mesh.road_start_indices, lanes_offs.vertices[idx]);
+        merge_start_indices(out_mesh.lanes_mesh.lanesec_start_indices, part.lanes_mesh.lanesec_start_indices, lanes_offs.vertices[idx]);
+        merge_start_indices(out_mesh.lanes_mesh.lane_start_indices, part.lanes_mesh.lane_start_indices, lanes_offs.vertices[idx]);
+
+        const std::size_t roadmarks_offset = roadmarks_offs.vertices[idx];
+        merge_start_indices(out_mesh.roadmarks_mesh.road_start_indices, part.roadmarks_mesh.road_start_indices, roadmarks_offset);
+        merge_start_indices(out_mesh.roadmarks_mesh.lanesec_start_indices, part.roadmarks_mesh.lanesec_start_indices, roadmarks_offset);
+        merge_start_indices(out_mesh.roadmarks_mesh.lane_start_indices, part.roadmarks_mesh.lane_start_indices, roadmarks_offset);
+        merge_start_indices(
+            out_mesh.roadmarks_mesh.roadmark_type_start_indices, part.roadmarks_mesh.roadmark_type_start_indices, roadmarks_offset);
+
+        const std::size_t road_objects_offset = road_objects_offs.vertices[idx];
+        merge_start_indices(out_mesh.road_objects_mesh.road_start_indices, part.road_objects_mesh.road_start_indices, road_objects_offset);
+        merge_start_indices(
+            out_mesh.road_objects_mesh.road_object_start_indices, part.road_objects_mesh.road_object_start_indices, road_objects_offset);
+
+        merge_start_indices(out_mesh.road_signals_mesh.road_signal_start_indices,
+                            part.road_signals_mesh.road_signal_start_indices,
+                            road_signals_offs.vertices[idx]);
     }
 
     return out_mesh;
@@ -859,4 +1012,39 @@ RoutingGraph OpenDriveMap::get_routing_graph() const
     return routing_graph;
 }
 
+CompiledRoutingGraph OpenDriveMap::get_compiled_routing_graph() const
+{
+    const RoutingGraph routing_graph = this->get_routing_graph();
+
+    /* the center of each lane at the start of its lanesection */
+    std::unordered_map<LaneKey, Vec3D> lane_positions;
+    auto                               add_lane_position = [&](const LaneKey& lane_key)
+    {
+        if (lane_positions.count(lane_key))
+            return;
+        auto road_iter = this->id_to_road.find(lane_key.road_id);
+        if (road_iter == this->id_to_road.end())
+            return;
+        const Road& road = road_iter->second;
+        auto        lanesec_iter = road.s_to_lanesection.find(lane_key.lanesection_s0);
+        if (lanesec_iter == road.s_to_lanesection.end())
+            return;
+        auto lane_iter = lanesec_iter->second.id_to_lane.find(lane_key.lane_id);
+        if (lane_iter == lanesec_iter->second.id_to_lane.end())
+            return;
+        const Lane&  lane = lane_iter->second;
+        const double s = lane_key.lanesection_s0;
+        const double t = 0.5 * (lane.inner_border.get(s) + lane.outer_border.get(s));
+        lane_positions[lane_key] = road.get_xyz(s, t, 0);
+    };
+    for (const auto& lane_key_successors : routing_graph.lane_key_to_successors)
+    {
+        add_lane_position(lane_key_successors.first);
+        for (const WeightedLaneKey& successor : lane_key_successors.second)
+            add_lane_position(successor);
+    }
+
+    return CompiledRoutingGraph(routing_graph, lane_positions);
+}
+
 } // namespace odr
@@ -1,6 +1,7 @@
 #include "RoutingGraph.h"
 
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <utility>
 
@@ -21,8 +22,22 @@ void RoutingGraph::add_edge(const RoutingGraphEdge& edge)
     this->edges.insert(edge);
     this->lane_key_to_successors[edge.from].insert(WeightedLaneKey(edge.to, edge.weight));
     this->lane_key_to_predecessors[edge.to].insert(WeightedLaneKey(edge.from, edge.weight));
+    this->invalidate_compiled_graph();
 }
 
+std::shared_ptr<const CompiledRoutingGraph> RoutingGraph::get_compiled_graph() const
+{
+    std::shared_ptr<const CompiledRoutingGraph> graph = std::atomic_load(&this->compiled_graph);
+    if (!graph)
+    {
+        graph = std::make_shared<const CompiledRoutingGraph>(*this);
+        std::atomic_store(&this->compiled_graph, graph);
+    }
+    return graph;
+}
+
+void RoutingGraph::invalidate_compiled_graph() { std::atomic_store(&this->compiled_graph, std::shared_ptr<const CompiledRoutingGraph>()); }
+
 std::vector<LaneKey> RoutingGraph::get_lane_successors(const LaneKey& lane_key) const
 {
     std::unordered_set<WeightedLaneKey> res = try_get_val(this->lane_key_to_successors, lane_key, std::unordered_set<WeightedLaneKey>{});
@@ -43,69 +58,203 @@ std::vector<LaneKey> RoutingGraph::shortest_path(const LaneKey& from, const Lane
     if (this->lane_key_to_successors.count(from) == 0)
         return path;
 
-    std::unordered_set<LaneKey> vertices;
-    for (const auto& lane_key_successors : this->lane_key_to_successors)
+    const std::shared_ptr<const CompiledRoutingGraph> compiled_graph = this->get_compiled_graph();
+    const int                                         to_idx = compiled_graph->get_lane_idx(to);
+    if (to_idx < 0)
+        return path;
+
+    const std::vector<uint32_t> path_idxs = compiled_graph->shortest_path(compiled_graph->get_lane_idx(from), to_idx, false);
+    if (path_idxs.empty())
+        path.push_back(from);
+    for (const uint32_t lane_idx : path_idxs)
+        path.push_back(compiled_graph->lane_keys.at(lane_idx));
+    return path;
+}
+
+static bool lane_key_less(const LaneKey& lhs, const LaneKey& rhs)
+{
+    if (lhs.road_id != rhs.road_id)
+        return lhs.road_id < rhs.road_id;
+    if (lhs.lanesection_s0 != rhs.lanesection_s0)
+        return lhs.lanesection_s0 < rhs.lanesection_s0;
+    return lhs.lane_id < rhs.lane_id;
+}
+
+CompiledRoutingGraph::CompiledRoutingGraph(const RoutingGraph& routing_graph, const std::unordered_map<LaneKey, Vec3D>& lane_positions)
+{
+    /* dense ids in lane key order, independent of the hash order */
+    for (const auto& lane_key_successors : routing_graph.lane_key_to_successors)
     {
-        vertices.insert(lane_key_successors.first);
-        vertices.insert(lane_key_successors.second.begin(), lane_key_successors.second.end());
+        this->lane_key_to_idx.insert({lane_key_successors.first, 0});
+        for (const WeightedLaneKey& successor : lane_key_successors.second)
+            this->lane_key_to_idx.insert({successor, 0});
     }
+    for (const auto& lane_key_idx : this->lane_key_to_idx)
+        this->lane_keys.push_back(lane_key_idx.first);
+    std::sort(this->lane_keys.begin(), this->lane_keys.end(), lane_key_less);
+    for (std::size_t idx = 0; idx < this->lane_keys.size(); idx++)
+        this->lane_key_to_idx[this->lane_keys[idx]] = idx;
 
-    if (vertices.count(to) == 0)
-        return path;
-
-    std::vector<LaneKey>                 nodes;
-    std::unordered_map<LaneKey, double>  weights;
-    std::unordered_map<LaneKey, LaneKey> previous;
+    this->successor_offsets.push_back(0);
+    std::vector<std::pair<uint32_t, double>> lane_successors;
+    for (const LaneKey& lane_key : this->lane_keys)
+    {
+        lane_successors.clear();
+        auto successors_iter = routing_graph.lane_key_to_successors.find(lane_key);
+        if (successors_iter != routing_graph.lane_key_to_successors.end())
+        {
+            for (const WeightedLaneKey& successor : successors_iter->second)
+                lane_successors.push_back({this->lane_key_to_idx.at(successor), successor.weight});
+        }
+        std::sort(lane_successors.begin(), lane_successors.end());
+        for (const auto& idx_weight : lane_successors)
+        {
+            this->successors.push_back(idx_weight.first);
+            this->successor_weights.push_back(idx_weight.second);
+        }
+        this->successor_offsets.push_back(this->successors.size());
+    }
 
-    auto comparator = [&](const LaneKey& lhs, const LaneKey& rhs) { return weights[lhs] > weights[rhs]; };
-    for (const auto& lane_key : vertices)
+    for (const LaneKey& lane_key : this->lane_keys)
     {
-        if (std::equal_to<odr::LaneKey>{}(lane_key, from))
-            weights[lane_key] = 0;
-        else
-            weights[lane_key] = std::numeric_limits<double>::max();
-        nodes.push_back(lane_key);
-        std::push_heap(nodes.begin(), nodes.end(), comparator);
+        auto position_iter = lane_positions.find(lane_key);
+        if (position_iter == lane_positions.end())
+        {
+            this->lane_positions.clear();
+            return;
+        }
+        this->lane_positions.push_back(position_iter->second);
     }
 
-    while (nodes.empty() == false)
+    /* the largest scale not exceeding 1 for which no edge is shorter than the drop of the heuristic */
+    this->heuristic_scale = 1.0;
+    for (std::size_t idx = 0; idx < this->lane_keys.size(); idx++)
     {
-        std::pop_heap(nodes.begin(), nodes.end(), comparator);
-        LaneKey smallest = nodes.back();
-        nodes.pop_back();
+        for (uint32_t succ_pos = this->successor_offsets[idx]; succ_pos < this->successor_offsets[idx + 1]; succ_pos++)
+        {
+            const double dist = euclDistance(this->lane_positions[idx], this->lane_positions[this->successors[succ_pos]]);
+            if (dist > 0)
+                this->heuristic_scale = std::min(this->heuristic_scale, std::max(this->successor_weights[succ_pos], 0.0) / dist);
+        }
+    }
+}
+
+int CompiledRoutingGraph::get_lane_idx(const LaneKey& lane_key) const
+{
+    auto idx_iter = this->lane_key_to_idx.find(lane_key);
+    return (idx_iter == this->lane_key_to_idx.end()) ? -1 : static_cast<int>(idx_iter->second);
+}
 
-        if (std::equal_to<LaneKey>{}(smallest, to))
+std::size_t CompiledRoutingGraph::get_num_lanes() const { return this->lane_keys.size(); }
+
+namespace
+{
+struct SearchNode
+{
+    double   f;
+    double   g;
+    uint32_t lane_idx;
+
+    bool operator>(const SearchNode& other) const { return f > other.f; }
+};
+
+/* per-thread search buffers reused by all queries, an entry is valid if its stamp is the current one */
+struct SearchBuffers
+{
+    std::vector<double>     dist;
+    std::vector<uint32_t>   prev;
+    std::vector<uint32_t>   stamp;
+    std::vector<SearchNode> heap;
+    uint32_t                cur_stamp = 0;
+
+    void reset(const std::size_t num_lanes)
+    {
+        if (this->stamp.size() < num_lanes)
         {
-            while (previous.find(smallest) != previous.end())
-            {
-                path.push_back(smallest);
-                smallest = previous.at(smallest);
-            }
-            break;
+            this->dist.resize(num_lanes);
+            this->prev.resize(num_lanes);
+            this->stamp.resize(num_lanes, 0);
+        }
+        if (++this->cur_stamp == 0)
+        {
+            std::fill(this->stamp.begin(), this->stamp.end(), 0);
+            this->cur_stamp = 1;
         }
+        this->heap.clear();
+    }
 
-        if (weights.at(smallest) == std::numeric_limits<double>::max())
-            break;
+    bool visited(const uint32_t lane_idx) const { return this->stamp[lane_idx] == this->cur_stamp; }
+};
+} // namespace
+
+std::vector<uint32_t> CompiledRoutingGraph::shortest_path(const uint32_t from, const uint32_t to, const bool use_astar) const
+{
+    std::vector<uint32_t> path;
+    if (from >= this->lane_keys.size() || to >= this->lane_keys.size())
+        return path;
 
-        auto smallest_succ_iter = this->lane_key_to_successors.find(smallest);
-        if (smallest_succ_iter == this->lane_key_to_successors.end())
-            continue;
+    const bool   with_heuristic = use_astar && !this->lane_positions.empty() && this->heuristic_scale > 0;
+    const Vec3D  to_pos = with_heuristic ? this->lane_positions[to] : Vec3D{0, 0, 0};
+    auto         heuristic = [&](const uint32_t lane_idx)
+    { return with_heuristic ? this->heuristic_scale * euclDistance(this->lane_positions[lane_idx], to_pos) : 0.0; };
 
-        for (const auto& successor : smallest_succ_iter->second)
+    static thread_local SearchBuffers buffers;
+    buffers.reset(this->lane_keys.size());
+    const std::greater<SearchNode> heap_cmp;
+
+    buffers.stamp[from] = buffers.cur_stamp;
+    buffers.dist[from] = 0;
+    buffers.prev[from] = from;
+    buffers.heap.push_back({heuristic(from), 0, from});
+
+    bool found = false;
+    while (!buffers.heap.empty())
+    {
+        std::pop_heap(buffers.heap.begin(), buffers.heap.end(), heap_cmp);
+        const SearchNode node = buffers.heap.back();
+        buffers.heap.pop_back();
+        if (node.g > buffers.dist[node.lane_idx])
+            continue; // stale entry, the lane was reached on a shorter path meanwhile
+
+        if (node.lane_idx == to)
+        {
+            found = true;
+            break;
+        }
+
+        for (uint32_t succ_pos = this->successor_offsets[node.lane_idx]; succ_pos < this->successor_offsets[node.lane_idx + 1]; succ_pos++)
         {
-            const double alt = weights.at(smallest) + successor.weight;
-            if (alt < weights.at(successor))
-            {
-                weights[successor] = alt;
-                previous.insert({successor, smallest});
-                std::make_heap(nodes.begin(), nodes.end(), comparator);
-            }
+            const uint32_t succ_idx = this->successors[succ_pos];
+            const double   alt = node.g + this->successor_weights[succ_pos];
+            if (buffers.visited(succ_idx) && alt >= buffers.dist[succ_idx])
+                continue;
+            buffers.stamp[succ_idx] = buffers.cur_stamp;
+            buffers.dist[succ_idx] = alt;
+            buffers.prev[succ_idx] = node.lane_idx;
+            buffers.heap.push_back({alt + heuristic(succ_idx), alt, succ_idx});
+            std::push_heap(buffers.heap.begin(), buffers.heap.end(), heap_cmp);
         }
     }
 
+    if (!found)
+        return path;
+    for (uint32_t lane_idx = to; lane_idx != from; lane_idx = buffers.prev[lane_idx])
+        path.push_back(lane_idx);
     path.push_back(from);
     std::reverse(path.begin(), path.end());
     return path;
 }
 
-} // namespace odr
\ No newline at end of file
+std::vector<LaneKey> CompiledRoutingGraph::shortest_path(const LaneKey& from, const LaneKey& to, const bool use_astar) const
+{
+    std::vector<LaneKey> path;
+    const int            from_idx = this->get_lane_idx(from);
+    const int            to_idx = this->get_lane_idx(to);
+    if (from_idx < 0 || to_idx < 0)
+        return path;
+    for (const uint32_t lane_idx : this->shortest_path(from_idx, to_idx, use_astar))
+        path.push_back(this->lane_keys[lane_idx]);
+    return path;
+}
+
+} // namespace odr
@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Compares the dense association (score every pair as
+// Fusion::ComputeAssociateMatrix does, then KMkernal on the full matrix)
+// with GatedAssociation on a busy junction. Both use the score of
+// Fusion::CheckDisScore.
+//
+// assoc_bench [tracks] [detections] [rounds] [area_m]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "modules/fusion/gated_association.h"
+#include "modules/fusion/km.h"
+
+namespace {
+
+const double kMaxMatchDistance = 2.5;
+
+double DisScore(double dis) {
+  return 2.5 * std::max(0.0, kMaxMatchDistance - dis);
+}
+
+// tracks spread over the junction, the detections are the tracks seen with
+// noise, some tracks are missed and some detections are new objects
+void MakeScene(int num_tracks, int num_detections, double area,
+               std::mt19937 *gen, std::vector<Eigen::Vector2d> *tracks,
+               std::vector<Eigen::Vector2d> *detections) {
+  std::uniform_real_distribution<double> pos(-area / 2, area / 2);
+  std::normal_distribution<double> noise(0., 0.7);
+  std::uniform_real_distribution<double> chance(0., 1.);
+  tracks->clear();
+  detections->clear();
+  for (int i = 0; i < num_tracks; ++i) {
+    tracks->push_back(Eigen::Vector2d(pos(*gen), pos(*gen)));
+  }
+  while (static_cast<int>(detections->size()) < num_detections) {
+    if (chance(*gen) < 0.1) {
+      detections->push_back(Eigen::Vector2d(pos(*gen), pos(*gen)));
+    } else {
+      const auto &t = (*tracks)[detections->size() % num_tracks];
+      detections->push_back(t + Eigen::Vector2d(noise(*gen), noise(*gen)));
+    }
+  }
+}
+
+double MatchedSum(const std::vector<Eigen::Vector2d> &tracks,
+                  const std::vector<Eigen::Vector2d> &detections,
+                  const std::vector<std::pair<int, int>> &match_cps) {
+  double sum = 0;
+  for (const auto &cp : match_cps) {
+    if (cp.first == -1 || cp.second == -1) continue;
+    sum += DisScore((tracks[cp.first] - detections[cp.second]).norm());
+  }
+  return sum;
+}
+
+double ElapsedUs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int num_tracks = argc > 1 ? atoi(argv[1]) : 500;
+  const int num_detections = argc > 2 ? atoi(argv[2]) : 500;
+  const int rounds = argc > 3 ? atoi(argv[3]) : 10;
+  const double area = argc > 4 ? atof(argv[4]) : 300.;
+
+  std::mt19937 gen(1);
+  std::vector<Eigen::Vector2d> tracks, detections;
+  std::vector<std::pair<int, int>> dense_cps, gated_cps;
+  coop::v2x::KMkernal km;
+  coop::v2x::GatedAssociation gated;
+  double dense_us = 0, gated_us = 0;
+  size_t pairs = 0, components = 0;
+  int mismatches = 0;
+
+  for (int r = 0; r < rounds; ++r) {
+    MakeScene(num_tracks, num_detections, area, &gen, &tracks, &detections);
+
+    auto t0 = std::chrono::steady_clock::now();
+    Eigen::MatrixXf association_mat(num_tracks, num_detections);
+    for (int i = 0; i < num_tracks; ++i) {
+      for (int j = 0; j < num_detections; ++j) {
+        association_mat(i, j) = DisScore((tracks[i] - detections[j]).norm());
+      }
+    }
+    km.GetKMResult(association_mat, &dense_cps);
+    dense_us += ElapsedUs(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    gated.Associate(tracks, detections, kMaxMatchDistance,
+                    [](int, int, double dis) { return DisScore(dis); },
+                    &gated_cps);
+    gated_us += ElapsedUs(t0);
+    pairs += gated.num_pairs();
+    components += gated.num_components();
+
+    const double dense_sum = MatchedSum(tracks, detections, dense_cps);
+    const double gated_sum = MatchedSum(tracks, detections, gated_cps);
+    if (std::abs(dense_sum - gated_sum) > 1e-3 * (1 + dense_sum)) {
+      mismatches++;
+    }
+  }
+
+  printf("%d tracks x %d detections in %.0f x %.0f m, %d rounds\n", num_tracks,
+         num_detections, area, area, rounds);
+  printf("dense : %10.1f us/frame (%d pairs scored)\n", dense_us / rounds,
+         num_tracks * num_detections);
+  printf("gated : %10.1f us/frame (%lu pairs scored, %lu components)\n",
+         gated_us / rounds, pairs / rounds, components / rounds);
+  printf("speedup %.1fx, score mismatches: %d\n", dense_us / gated_us,
+         mismatches);
+  return mismatches ? 1 : 0;
+}
@@ -18,6 +18,8 @@
 #include <future>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "modules/common/earth.h"
 #include "modules/dataType/vehicle_state.h"
@@ -52,8 +54,8 @@ class Fuser {
    * @param target Observation to be added into vehicle states
    * @return
    */
-  bool AddVehicleState(std::map<int, spVehicleState> &vehicles,
-                       sp_cRaysunFrame frame, const VehicleObs &target);
+  bool AddVehicleState(VehicleStateTable &vehicles, sp_cRaysunFrame frame,
+                       const VehicleObs &target);
 
   /**
    * @brief Fuse the frames from different radar equipment in the same time
@@ -69,12 +71,11 @@ class Fuser {
    * @param dev_id Id of observation camera
    * @param target_obs Observed vehicle to be associated
    * @param vehicle_state_id output, Id of vehicle state that is associated with
-   * observed vehicle
+   * observed vehicle, the lowest id if several can be associated
    * @return If the given vehicle can be associated
    */
   bool isAssociated(const OCLong dev_id, const VehicleObs &target_obs,
-                    std::map<int, coop::v2x::spVehicleState> &vehicle_states,
-                    int *vehicle_state_id);
+                    VehicleStateTable &vehicle_states, int *vehicle_state_id);
 
   /**
    * @brief Decide if the observed vehicle id can be tracked with a vehicle
@@ -87,8 +88,7 @@ class Fuser {
    * @return if the given vehicle can be tracked
    */
   bool isTracked(const OCLong dev_id, const OCInt target_id,
-                 std::map<int, coop::v2x::spVehicleState> &vehicle_states,
-                 int *vehicle_state_id);
+                 VehicleStateTable &vehicle_states, int *vehicle_state_id);
 
   /**
    * @brief propagate the vehicle states to current time with previous time and
@@ -96,7 +96,7 @@ class Fuser {
    * @param vehicle_states
    * @param current_time the given time until when the system is propagated
    */
-  void PropagateVehicles(std::map<int, spVehicleState> &vehicle_states,
+  void PropagateVehicles(VehicleStateTable &vehicle_states,
                          OCLong current_time);
   /**
    * @brief Read in offline data .record
@@ -122,8 +122,14 @@ class Fuser {
    * @param vehicles vehicle states
    * @param syncFrames synced latest observation frames from various cameras
    */
-  void UpdateVehicleStates(std::map<int, spVehicleState> &vehicles,
-                           const std::vector<spRaysunFrame> syncFrames);
+  void UpdateVehicleStates(VehicleStateTable &vehicles,
+                           const std::vector<spRaysunFrame> &syncFrames);
+
+  /**
+   * @brief refresh the position of a vehicle state in vehicle_grid_
+   * @param slot slot of the vehicle in vehicle_states_
+   */
+  void IndexVehicle(uint32_t slot);
 
   /**
    * @brief given frame t from camera k, get frames from other frames and sync
@@ -140,9 +146,11 @@ class Fuser {
    * @param syncFrames frame whose time will be used to sync other frames
    * @return
    */
-  void PlotVehicleStatesAndFrames(std::map<int, spVehicleState> vehicles,
-                                  std::vector<spRaysunFrame> syncFrames,std::map<int, spVehicleObs> vehicle_obsers,
-                                  OCLong current_time, OCLong last_time);
+  void PlotVehicleStatesAndFrames(
+      const VehicleStateTable &vehicles,
+      const std::vector<spRaysunFrame> &syncFrames,
+      const std::map<int, spVehicleObs> &vehicle_obsers, OCLong current_time,
+      OCLong last_time);
   int FuseVehicleData(spRaysunFrame frame, const KITTI_RAW &vehicle);
 
   /**
@@ -155,7 +163,8 @@ class Fuser {
   void viz_process();
 
  private:
-  int set_fusion(std::map<int, spVehicleState>, jos::fusion_package &outpkg);
+  int set_fusion(const VehicleStateTable &vehicles,
+                 jos::fusion_package &outpkg);
   int set_fusion_target(spVehicleState &status, jos::target &tgt);
 
  private:
@@ -168,8 +177,21 @@ class Fuser {
 
   OCLong last_time_ = 0;
   OCLong current_time_ = 0;
-  std::map<int, spVehicleState> vehicle_states_;
+  struct TargetKeyHash {
+    size_t operator()(const std::pair<OCLong, OCInt> &key) const {
+      return std::hash<OCLong>()(key.first) * 31 + key.second;
+    }
+  };
+  VehicleStateTable vehicle_states_;
   std::map<int, spVehicleState> removed_vehicle_states_;
+  // (devid, target id) -> id of the vehicle state tracking it, the
+  // obs_dev_target_id of every vehicle state
+  std::unordered_map<std::pair<OCLong, OCInt>, int, TargetKeyHash>
+      tracked_targets_;
+  // slots of vehicle_states_ by position, the cell is larger than the
+  // association box of isAssociated
+  TrackGrid vehicle_grid_{6.0};
+  std::vector<Eigen::Vector3d> vehicle_enu_;
   std::map<int, spVehicleObs> vehicle_obsers_;
   std::vector<sp_cRaysunFrame> data_buffer_;
   std::shared_ptr<Cacher> g_cacher_;
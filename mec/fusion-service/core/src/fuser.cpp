@@ -17,6 +17,7 @@
 #include <sys/time.h>
 #include <eigen3/Eigen/Dense>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "common/file.h"
@@ -34,11 +35,19 @@ using namespace jos;
 
 std::unique_ptr<FuserConfig> g_fuserConfig =
     common::util::make_unique<FuserConfig>();
+static std::once_flag g_fuser_init_flag;
 
 Fuser::Fuser() {
-  Earth::SetOrigin(
-      Eigen::Vector3d(g_ori_pos_deg[0], g_ori_pos_deg[1], g_ori_pos_deg[2]),
-      true);
+  // The origin and g_fuserConfig are shared by all fusers. Set them only once
+  // so that a fuser can be created while others are fusing on other threads.
+  std::call_once(g_fuser_init_flag, [] {
+    Earth::SetOrigin(
+        Eigen::Vector3d(g_ori_pos_deg[0], g_ori_pos_deg[1], g_ori_pos_deg[2]),
+        true);
+    std::string cfg_pth = std::string(PROJECT_ROOT_PATH) +
+                          "/middle_ware/cyber/conf/config.pb.txt";
+    apollo::cyber::common::GetProtoFromFile(cfg_pth, g_fuserConfig.get());
+  });
   sp_fusion_ = std::make_shared<Fusion>();
   sp_img_processor_ = std::make_shared<IMGPROCESSOR>();
   // sp_viz_processor_ = std::make_shared<VizProcessor>();
@@ -52,9 +61,6 @@ Fuser::Fuser() {
   apollo::cyber::common::GetProtoFromFile(raysun_system_cfg_pth,
                                           raysunSystem_config_.get());
   std::cout << raysunSystem_config_->max_match_distance() << std::endl;
-  std::string cfg_pth =
-      std::string(PROJECT_ROOT_PATH) + "/middle_ware/cyber/conf/config.pb.txt";
-  apollo::cyber::common::GetProtoFromFile(cfg_pth, g_fuserConfig.get());
 
   g_cacher_ = std::make_shared<Cacher>();
   sp_fusion_->set_max_distance_match(
@@ -122,11 +128,29 @@ void Fuser::ProcessOneFrame(sp_cRaysunFrame frame, bool plot) {
   }
 }
 
-void Fuser::PropagateVehicles(std::map<int, spVehicleState> &vehicle_states,
+void Fuser::PropagateVehicles(VehicleStateTable &vehicle_states,
                               OCLong current_time) {
   removed_vehicle_states_.clear();
   sp_predictor_->PropagateVehicles(vehicle_states, removed_vehicle_states_,current_time);
+  // the targets of the removed vehicles are free again
+  for (const auto &removed : removed_vehicle_states_) {
+    for (const auto &dev_target : removed.second->obs_dev_target_id) {
+      auto it = tracked_targets_.find(dev_target);
+      if (it != tracked_targets_.end() && it->second == removed.first) {
+        tracked_targets_.erase(it);
+      }
+    }
+  }
+}
+
+void Fuser::IndexVehicle(uint32_t slot) {
+  if (vehicle_enu_.size() <= slot) {
+    vehicle_enu_.resize(slot + 1);
+  }
+  vehicle_enu_[slot] = vehicle_states_.at_slot(slot).second->pos_enu();
+  vehicle_grid_.Update(slot, vehicle_enu_[slot](0), vehicle_enu_[slot](1));
 }
+
 void Fuser::UpdateVehicleObsTraj(
     const std::shared_ptr<std::vector<spRaysunFrame>> syncFrames) {
   std::map<int, spVehicleObs> current_vehicle_obs;
@@ -166,28 +190,41 @@ void Fuser::UpdateVehicleObsTraj(
   }
 }
 
-void Fuser::UpdateVehicleStates(std::map<int, spVehicleState> &vehicles,
-                                const std::vector<spRaysunFrame> syncFrames) {
+void Fuser::UpdateVehicleStates(VehicleStateTable &vehicles,
+                                const std::vector<spRaysunFrame> &syncFrames) {
+  // the vehicles moved in PropagateVehicles
+  for (uint32_t slot = 0; slot < vehicles.slots(); ++slot) {
+    if (vehicles.live(slot)) {
+      IndexVehicle(slot);
+    } else {
+      vehicle_grid_.Remove(slot);
+    }
+  }
   for (const auto &frame : syncFrames) {
+    const OCLong devid = frame->head().devid;
     for (const auto &obs : frame->targets()) {
       int vehicle_state_id;  // id of vehicle tracked of associated
       // if the observation is already tracked by one vehicle state
       // update the state with observation
-      if (isTracked(frame->head().devid, obs.id(), vehicles,
-                    &vehicle_state_id)) {
-        vehicles[vehicle_state_id]->set_timestamp(frame->head().timestamp);
-        vehicles[vehicle_state_id]->Update2(obs);
-
+      if (isTracked(devid, obs.id(), vehicles, &vehicle_state_id)) {
+        const uint32_t slot = vehicles.slot(vehicle_state_id);
+        auto &vehicle = vehicles.at_slot(slot).second;
+        vehicle->set_timestamp(frame->head().timestamp);
+        vehicle->Update2(obs);
+        IndexVehicle(slot);
         continue;
       }
 
       // if the observation is not tracked but can be associated with a close
       // vehicle
-      if (isAssociated(frame->head().devid, obs, vehicles, &vehicle_state_id)) {
-        vehicles[vehicle_state_id]->obs_dev_target_id[frame->head().devid] =
-            obs.id();
-        vehicles[vehicle_state_id]->set_timestamp(frame->head().timestamp);
-        vehicles[vehicle_state_id]->Update2(obs);
+      if (isAssociated(devid, obs, vehicles, &vehicle_state_id)) {
+        const uint32_t slot = vehicles.slot(vehicle_state_id);
+        auto &vehicle = vehicles.at_slot(slot).second;
+        vehicle->obs_dev_target_id[devid] = obs.id();
+        tracked_targets_[std::make_pair(devid, obs.id())] = vehicle_state_id;
+        vehicle->set_timestamp(frame->head().timestamp);
+        vehicle->Update2(obs);
+        IndexVehicle(slot);
         continue;
       }
       // Add a new vehicle state if it is not in current states
@@ -197,36 +234,48 @@ void Fuser::UpdateVehicleStates(std::map<int, spVehicleState> &vehicles,
   }
 }
 
-bool Fuser::AddVehicleState(std::map<int, spVehicleState> &vehicles,
-                            sp_cRaysunFrame frame, const VehicleObs &target) {
+bool Fuser::AddVehicleState(VehicleStateTable &vehicles, sp_cRaysunFrame frame,
+                            const VehicleObs &target) {
   int new_vehicle_id = VehicleID::getInstance()->get_new_id();
-  vehicles[new_vehicle_id] = std::make_shared<VehicleState>();
-  auto new_vehicle = vehicles[new_vehicle_id];
+  const uint32_t slot =
+      vehicles.Insert(new_vehicle_id, std::make_shared<VehicleState>());
+  auto new_vehicle = vehicles.at_slot(slot).second;
   new_vehicle->Init(target);
   new_vehicle->set_id(new_vehicle_id);
   new_vehicle->set_timestamp(frame->head().timestamp);
   new_vehicle->obs_dev_target_id[frame->head().devid] = target.id();
+  tracked_targets_[std::make_pair(frame->head().devid, target.id())] =
+      new_vehicle_id;
+  IndexVehicle(slot);
+  return true;
 }
 
-bool Fuser::isAssociated(
-    const OCLong dev_id, const VehicleObs &target_obs,
-    std::map<int, coop::v2x::spVehicleState> &vehicle_states,
-    int *vehicle_state_id) {
-  for (const auto &vehicle : vehicle_states) {
+bool Fuser::isAssociated(const OCLong dev_id, const VehicleObs &target_obs,
+                         VehicleStateTable &vehicle_states,
+                         int *vehicle_state_id) {
+  // only the vehicles around the observation can be in the association box,
+  // the lowest id wins as in a scan of the vehicles by id
+  const Eigen::Vector3d target_enu = target_obs.pos_enu();
+  int associated_id = -1;
+  vehicle_grid_.ForEachNear(target_enu(0), target_enu(1), [&](uint32_t slot) {
+    const auto &vehicle = vehicle_states.at_slot(slot);
+    if (associated_id != -1 && vehicle.first > associated_id) {
+      return;
+    }
     if (target_obs.obj_class() == RAYSUN_TARGET_TYPE_PEDESTRIAN &&
         vehicle.second->obj_class() != RAYSUN_TARGET_TYPE_PEDESTRIAN) {
-      continue;
+      return;
     }
     if (target_obs.obj_class() != RAYSUN_TARGET_TYPE_PEDESTRIAN &&
         vehicle.second->obj_class() == RAYSUN_TARGET_TYPE_PEDESTRIAN) {
-      continue;
+      return;
     }
 
     if (vehicle.second->obs_dev_target_id.count(dev_id)) {
-      continue;
+      return;
     }
     // if the observed vehicle is close to a vehicle state, we associate them
-    Eigen::Vector3d dis_3d = target_obs.pos_enu() - vehicle.second->pos_enu();
+    Eigen::Vector3d dis_3d = target_enu - vehicle_enu_[slot];
     Eigen::Vector2d dis_2d_ENU{dis_3d(0),
                                dis_3d(1)};  // difference in ENU coordinate
     double heading_enu = vehicle.second->HeadingENU();
@@ -237,58 +286,57 @@ bool Fuser::isAssociated(
         rotation.transpose() * dis_2d_ENU;  // difference in vehicle coordinate
 
     if (abs(dis_2d_vehicle(0)) < 4 && abs(dis_2d_vehicle(1)) < 2.5) {
-      *vehicle_state_id = vehicle.second->id();
-      return true;
+      associated_id = vehicle.first;
     }
+  });
+  if (associated_id == -1) {
+    return false;
   }
-  return false;
+  *vehicle_state_id = associated_id;
+  return true;
 }
 bool Fuser::isTracked(const OCLong devid, const OCInt target_id,
-                      std::map<int, coop::v2x::spVehicleState> &vehicle_states,
+                      VehicleStateTable &vehicle_states,
                       int *vehicle_state_id) {
-  for (auto &&vehicle : vehicle_states) {
-    // if the vehicle state is already tracked by a specific dev by target id
-    // return true and give back the target id
-    if (vehicle.second->obs_dev_target_id.count(devid)) {
-      if (target_id == vehicle.second->obs_dev_target_id[devid]) {
-        *vehicle_state_id = vehicle.second->id();
-        return true;
-      }
-    }
+  // the vehicle state already tracked by a specific dev by target id
+  auto it = tracked_targets_.find(std::make_pair(devid, target_id));
+  if (it == tracked_targets_.end()) {
+    return false;
   }
-  return false;
+  *vehicle_state_id = it->second;
+  return true;
 }
 
 void Fuser::PlotVehicleStatesAndFrames(
-    std::map<int, spVehicleState> vehicles,
-    std::vector<spRaysunFrame> syncFrames,
-    std::map<int, spVehicleObs> vehicle_obsers, OCLong current_time,
+    const VehicleStateTable &vehicles,
+    const std::vector<spRaysunFrame> &syncFrames,
+    const std::map<int, spVehicleObs> &vehicle_obsers, OCLong current_time,
     OCLong last_time) {
   cv::Mat combine;
-  sp_img_processor_->PlotVehicleStatesAndFrames(
-      &combine, vehicles, syncFrames, vehicle_obsers, current_time, last_time);
+  // the image processor plots the vehicles by id
+  const std::map<int, spVehicleState> vehicles_by_id(vehicles.begin(),
+                                                     vehicles.end());
+  sp_img_processor_->PlotVehicleStatesAndFrames(&combine, vehicles_by_id,
+                                                syncFrames, vehicle_obsers,
+                                                current_time, last_time);
   sp_img_processor_->SaveImage(&combine, current_time);
 }
 
 void Fuser::GetSyncFrames(
     sp_cRaysunFrame frame,
     std::shared_ptr<std::vector<spRaysunFrame>> syncFrames) {
-  for (auto &&cam_deque : g_cacher_->named_buff()) {
-    sp_cRaysunFrame sp_cMatchedFrame =
-        g_cacher_->GetNearestFrame(frame->head().timestamp, cam_deque.first);
-    if (!sp_cMatchedFrame) {
-      continue;
-    }
-    OCLong dt_ms =
-        frame->head().timestamp - sp_cMatchedFrame->head().timestamp;  // ms
-    if (dt_ms < 1000) {
-      // if the matched frame in name_buff is too old, do not merge
-      // interpolate the frame to sync
-      spRaysunFrame syncSubFrame =
-          sp_predictor_->PropagateFrame(sp_cMatchedFrame, dt_ms);
-      syncFrames->push_back(syncSubFrame);
-    }
-  }
+  const OCLong timestamp = frame->head().timestamp;
+  g_cacher_->ForEachNearestFrame(
+      timestamp, [&](OCLong devid, const sp_cRaysunFrame &sp_cMatchedFrame) {
+        OCLong dt_ms = timestamp - sp_cMatchedFrame->head().timestamp;  // ms
+        if (dt_ms < 1000) {
+          // if the matched frame in name_buff is too old, do not merge
+          // interpolate the frame to sync
+          spRaysunFrame syncSubFrame =
+              sp_predictor_->PropagateFrame(sp_cMatchedFrame, dt_ms);
+          syncFrames->push_back(syncSubFrame);
+        }
+      });
 }
 
 spVehicleState Fuser::AssociateADVehicle(
@@ -316,7 +364,7 @@ spRaysunFrame Fuser::FuseRaysunData(
   return spFusedResult;
 }
 
-int Fuser::set_fusion(std::map<int, spVehicleState> vehicles,
+int Fuser::set_fusion(const VehicleStateTable &vehicles,
                       fusion_package &outpkg) {
   // std::cout << "fusion result number " << vehicles.size() <<std::endl;
   timeval tv;
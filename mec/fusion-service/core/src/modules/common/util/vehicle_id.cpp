@@ -17,21 +17,16 @@
 
 namespace coop {
 namespace v2x {
-VehicleID* VehicleID::vehicle_id_ = nullptr;
 VehicleID* VehicleID::getInstance() {
-  if (vehicle_id_ == nullptr) {
-    vehicle_id_ = new VehicleID();
-  }
-  return vehicle_id_;
+  // fusers on different threads share the ids
+  static VehicleID vehicle_id;
+  return &vehicle_id;
 }
 
-VehicleID::VehicleID(/* args */) { id_value_ = -1; }
+VehicleID::VehicleID(/* args */) : id_value_(-1) {}
 
 VehicleID::~VehicleID() {}
 
-int VehicleID::get_new_id() {
-  id_value_ = id_value_ + 1;
-  return id_value_;
-}
+int VehicleID::get_new_id() { return ++id_value_; }
 }  // namespace v2x
 }  // namespace coop
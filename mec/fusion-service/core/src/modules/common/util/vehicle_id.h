@@ -14,6 +14,8 @@
  * limitations under the License.
  *****************************************************************************/
 #pragma once
+#include <atomic>
+
 namespace coop {
 namespace v2x {
 
@@ -23,8 +25,7 @@ class VehicleID {
   /* data */
   VehicleID(/* args */);
   ~VehicleID();
-  int id_value_;
-  static VehicleID* vehicle_id_;
+  std::atomic<int> id_value_;
 
  public:
   static VehicleID* getInstance();
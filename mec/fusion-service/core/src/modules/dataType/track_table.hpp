@@ -0,0 +1,257 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coop {
+namespace v2x {
+
+/**
+ * @brief tracks stored by id in a dense array of slots
+ *
+ * A track keeps its slot until it is erased, the slots of erased tracks are
+ * reused through a free list. The id -> slot index is a hash map, so find,
+ * insert and erase are O(1). Iteration walks the slot array and yields
+ * std::pair<int, T> like a std::map<int, T>, in slot order.
+ */
+template <typename T>
+class TrackTable {
+ public:
+  typedef std::pair<int, T> value_type;
+  static const uint32_t npos = UINT32_MAX;
+
+  template <bool Const>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<int, T> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<Const, const value_type *,
+                                      value_type *>::type pointer;
+    typedef typename std::conditional<Const, const value_type &,
+                                      value_type &>::type reference;
+    typedef typename std::conditional<Const, const TrackTable *,
+                                      TrackTable *>::type TablePtr;
+
+    Iterator(TablePtr table, uint32_t slot) : table_(table), slot_(slot) {
+      Skip();
+    }
+    // iterator to const_iterator
+    operator Iterator<true>() const { return Iterator<true>(table_, slot_); }
+
+    reference operator*() const { return table_->slots_[slot_]; }
+    pointer operator->() const { return &table_->slots_[slot_]; }
+    Iterator &operator++() {
+      slot_++;
+      Skip();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+    bool operator==(const Iterator &other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const Iterator &other) const {
+      return slot_ != other.slot_;
+    }
+    uint32_t slot() const { return slot_; }
+
+   private:
+    void Skip() {
+      while (slot_ < table_->slots_.size() && !table_->live_[slot_]) slot_++;
+    }
+    TablePtr table_;
+    uint32_t slot_;
+  };
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  size_t size() const { return index_.size(); }
+  bool empty() const { return index_.empty(); }
+  // number of slots, live or free
+  size_t slots() const { return slots_.size(); }
+  void reserve(size_t n) {
+    slots_.reserve(n);
+    live_.reserve(n);
+    index_.reserve(n);
+  }
+  void clear() {
+    slots_.clear();
+    live_.clear();
+    free_.clear();
+    index_.clear();
+  }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, slots_.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, slots_.size()); }
+
+  // slot of the track, npos if there is none
+  uint32_t slot(int id) const {
+    auto it = index_.find(id);
+    return it == index_.end() ? npos : it->second;
+  }
+  value_type &at_slot(uint32_t slot) { return slots_[slot]; }
+  const value_type &at_slot(uint32_t slot) const { return slots_[slot]; }
+
+  iterator find(int id) {
+    const uint32_t s = slot(id);
+    return s == npos ? end() : iterator(this, s);
+  }
+  const_iterator find(int id) const {
+    const uint32_t s = slot(id);
+    return s == npos ? end() : const_iterator(this, s);
+  }
+  size_t count(int id) const { return index_.count(id); }
+  bool live(uint32_t slot) const { return slot < live_.size() && live_[slot]; }
+
+  // inserts or replaces the track, returns its slot
+  uint32_t Insert(int id, const T &value) {
+    auto it = index_.find(id);
+    if (it != index_.end()) {
+      slots_[it->second].second = value;
+      return it->second;
+    }
+    uint32_t s;
+    if (!free_.empty()) {
+      s = free_.back();
+      free_.pop_back();
+      slots_[s] = value_type(id, value);
+      live_[s] = 1;
+    } else {
+      s = slots_.size();
+      slots_.push_back(value_type(id, value));
+      live_.push_back(1);
+    }
+    index_.emplace(id, s);
+    return s;
+  }
+
+  T &operator[](int id) {
+    const uint32_t s = slot(id);
+    return slots_[s == npos ? Insert(id, T()) : s].second;
+  }
+
+  // returns the iterator to the next track
+  iterator erase(iterator it) {
+    const uint32_t s = it.slot();
+    index_.erase(slots_[s].first);
+    slots_[s].second = T();
+    live_[s] = 0;
+    free_.push_back(s);
+    return ++it;
+  }
+  size_t erase(int id) {
+    const uint32_t s = slot(id);
+    if (s == npos) return 0;
+    erase(iterator(this, s));
+    return 1;
+  }
+
+ private:
+  std::vector<value_type> slots_;
+  std::vector<char> live_;
+  std::vector<uint32_t> free_;
+  std::unordered_map<int, uint32_t> index_;
+};
+
+template <typename T>
+const uint32_t TrackTable<T>::npos;
+
+/**
+ * @brief slots of a TrackTable bucketed by their 2d position
+ *
+ * ForEachNear() visits the slots in the 3x3 cells around a point, which is
+ * every slot closer than the cell size. A slot is moved when its track
+ * moves to another cell, empty cells are dropped.
+ */
+class TrackGrid {
+ public:
+  explicit TrackGrid(double cell_size = 5.0) : cell_size_(cell_size) {}
+
+  double cell_size() const { return cell_size_; }
+
+  void Clear() {
+    cells_.clear();
+    std::fill(cell_of_.begin(), cell_of_.end(), NoCell());
+  }
+
+  // inserts the slot or moves it to the cell of (x, y)
+  void Update(uint32_t slot, double x, double y) {
+    const int64_t key = Key(Cell(x), Cell(y));
+    if (slot >= cell_of_.size()) cell_of_.resize(slot + 1, NoCell());
+    if (cell_of_[slot] == key) return;
+    Remove(slot);
+    cells_[key].push_back(slot);
+    cell_of_[slot] = key;
+  }
+
+  void Remove(uint32_t slot) {
+    if (slot >= cell_of_.size() || cell_of_[slot] == NoCell()) return;
+    auto it = cells_.find(cell_of_[slot]);
+    auto &cell = it->second;
+    for (size_t i = 0; i < cell.size(); ++i) {
+      if (cell[i] == slot) {
+        cell[i] = cell.back();
+        cell.pop_back();
+        break;
+      }
+    }
+    if (cell.empty()) cells_.erase(it);
+    cell_of_[slot] = NoCell();
+  }
+
+  template <typename Fn>
+  void ForEachNear(double x, double y, Fn fn) const {
+    const int64_t cx = Cell(x), cy = Cell(y);
+    for (int64_t dx = -1; dx <= 1; ++dx) {
+      for (int64_t dy = -1; dy <= 1; ++dy) {
+        auto it = cells_.find(Key(cx + dx, cy + dy));
+        if (it == cells_.end()) continue;
+        for (uint32_t slot : it->second) fn(slot);
+      }
+    }
+  }
+
+ private:
+  static int64_t NoCell() { return INT64_MIN; }
+
+  int64_t Cell(double v) const {
+    return static_cast<int64_t>(std::floor(v / cell_size_));
+  }
+  static int64_t Key(int64_t cx, int64_t cy) {
+    return static_cast<int64_t>((static_cast<uint64_t>(cx) << 32) ^
+                                static_cast<uint32_t>(cy));
+  }
+
+  double cell_size_;
+  std::unordered_map<int64_t, std::vector<uint32_t>> cells_;
+  std::vector<int64_t> cell_of_;
+};
+
+}  // namespace v2x
+}  // namespace coop
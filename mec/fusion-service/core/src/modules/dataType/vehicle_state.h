@@ -20,6 +20,7 @@
 #include <vector>
 #include "modules/common/util/inner_types.hpp"
 #include "modules/dataType/vehicle_base.hpp"
+#include "modules/dataType/track_table.hpp"
 #include "modules/dataType/vehicle_obs.hpp"
 #include "modules/filter/kalman_filter.h"
 namespace coop {
@@ -53,6 +54,7 @@ class VehicleState : public VehicleBase {
   // Eigen::Matrix<double, 15, 15> cov;
 };
 DEFINE_EXTEND_TYPE(VehicleState);
+typedef TrackTable<spVehicleState> VehicleStateTable;
 
 }  // namespace v2x
 }  // namespace coop
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#pragma once
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <cmath>
+#include "modules/common/util/util.h"
+
+namespace coop {
+namespace v2x {
+
+/**
+ * @brief extended Kalman filter with compile time dimensions, the state,
+ * the covariance and all temporaries are fixed size Eigen matrices, so
+ * Predict() and Correct() never allocate.
+ *
+ * The Model provides kStateDim, kMeasureDim, kIdentityMeasure and
+ *   // x = f(x), P = F P F' with F the jacobian of f
+ *   static void Predict(double dt, State *x, Covariance *variance);
+ *   static void Residual(Measure *diff);  // e.g. wrap angles
+ * With kIdentityMeasure the measure is the state (H = I) and Correct() skips
+ * the products with measure_matrix_.
+ */
+template <typename Model>
+class FixedSizeEKF {
+ public:
+  enum { kStateDim = Model::kStateDim, kMeasureDim = Model::kMeasureDim };
+  typedef Eigen::Matrix<double, kStateDim, 1> State;
+  typedef Eigen::Matrix<double, kStateDim, kStateDim> Covariance;
+  typedef Eigen::Matrix<double, kMeasureDim, 1> Measure;
+  typedef Eigen::Matrix<double, kMeasureDim, kMeasureDim> MeasureCovariance;
+  typedef Eigen::Matrix<double, kMeasureDim, kStateDim> MeasureMatrix;
+  typedef Eigen::Matrix<double, kStateDim, kMeasureDim> Gain;
+
+  FixedSizeEKF() : inited_(false) {
+    state_.setZero();
+    variance_.setIdentity();
+    process_noise_.setIdentity();
+    measure_noise_.setIdentity();
+    measure_matrix_.setIdentity();
+  }
+
+  void Init(const State &x) {
+    state_ = x;
+    inited_ = true;
+  }
+
+  void Predict(double delta_t) {
+    if (!inited_) return;
+    Model::Predict(delta_t, &state_, &variance_);
+    variance_ += process_noise_;
+  }
+
+  // the first measurement initializes the state
+  void Correct(const Measure &z) {
+    if (!inited_) {
+      state_ = measure_matrix_.transpose() * z;
+      inited_ = true;
+      return;
+    }
+    if (Model::kIdentityMeasure) {
+      const Covariance cov = variance_ + measure_noise_;
+      const Covariance kalman_gain = variance_ * cov.inverse();
+      variance_ -= kalman_gain * variance_;
+      Measure diff = z - state_;
+      Model::Residual(&diff);
+      state_ += kalman_gain * diff;
+      return;
+    }
+    const MeasureCovariance cov =
+        measure_matrix_ * variance_ * measure_matrix_.transpose() +
+        measure_noise_;
+    const Gain kalman_gain =
+        variance_ * measure_matrix_.transpose() * cov.inverse();
+    variance_ = variance_ - kalman_gain * measure_matrix_ * variance_;
+    Measure diff = z - measure_matrix_ * state_;
+    Model::Residual(&diff);
+    state_ = state_ + kalman_gain * diff;
+  }
+
+  bool inited() const { return inited_; }
+  const State &state() const { return state_; }
+  void set_state(const State &x) { state_ = x; }
+
+  Covariance variance_;
+  Covariance process_noise_;
+  MeasureCovariance measure_noise_;
+  MeasureMatrix measure_matrix_;
+
+ protected:
+  State state_;
+  bool inited_;
+};
+
+/**
+ * @brief F * P * F' of the track motion, F = I + [a b; e d] in rows 0-1 and
+ * columns 2-3. Only the upper triangle of P is read and written, rows 2 and 3
+ * do not change.
+ */
+inline void PropagateTrackCovariance(double a, double b, double e, double d,
+                                     double *p00, double *p01, double *p02,
+                                     double *p03, double *p11, double *p12,
+                                     double *p13, double p22, double p23,
+                                     double p33) {
+  // rows 0 and 1 of F * P
+  const double fp00 = *p00 + a * *p02 + b * *p03;
+  const double fp01 = *p01 + a * *p12 + b * *p13;
+  const double fp02 = *p02 + a * p22 + b * p23;
+  const double fp03 = *p03 + a * p23 + b * p33;
+  const double fp11 = *p11 + e * *p12 + d * *p13;
+  const double fp12 = *p12 + e * p22 + d * p23;
+  const double fp13 = *p13 + e * p23 + d * p33;
+  // (F * P) * F'
+  *p00 = fp00 + a * fp02 + b * fp03;
+  *p01 = fp01 + e * fp02 + d * fp03;
+  *p02 = fp02;
+  *p03 = fp03;
+  *p11 = fp11 + e * fp12 + d * fp13;
+  *p12 = fp12;
+  *p13 = fp13;
+}
+
+/**
+ * @brief motion of the fusion tracks, X = (x, y, v, theta)'
+ * x = x + v cos(theta) dt
+ * y = y + v sin(theta) dt
+ * v and theta only change by noise, z = X
+ */
+struct TrackMotionModel {
+  enum { kStateDim = 4, kMeasureDim = 4, kIdentityMeasure = 1 };
+
+  static void Predict(double dt, Eigen::Matrix<double, 4, 1> *x,
+                      Eigen::Matrix<double, 4, 4> *variance) {
+    const double v = (*x)(2);
+    const double sin_theta = std::sin((*x)(3));
+    const double cos_theta = std::cos((*x)(3));
+    (*x)(0) += v * cos_theta * dt;
+    (*x)(1) += v * sin_theta * dt;
+    auto &p = *variance;
+    PropagateTrackCovariance(dt * cos_theta, -dt * v * sin_theta,
+                             dt * sin_theta, dt * v * cos_theta, &p(0, 0),
+                             &p(0, 1), &p(0, 2), &p(0, 3), &p(1, 1), &p(1, 2),
+                             &p(1, 3), p(2, 2), p(2, 3), p(3, 3));
+    p(1, 0) = p(0, 1);
+    p(2, 0) = p(0, 2);
+    p(3, 0) = p(0, 3);
+    p(2, 1) = p(1, 2);
+    p(3, 1) = p(1, 3);
+  }
+
+  static void Residual(Eigen::Matrix<double, 4, 1> *diff) {
+    (*diff)(3) = normalizeRad((*diff)(3));
+  }
+};
+
+}  // namespace v2x
+}  // namespace coop
@@ -63,25 +63,11 @@ bool Fusion::CombineNewResource(const std::vector<VehicleObs> &new_objects,
     }
     return true;
   }
-  int u_num = fused_objects->size();
-  int v_num = new_objects.size();
-  Eigen::MatrixXf association_mat(u_num, v_num);
-  ComputeAssociateMatrix(*fused_objects, new_objects, &association_mat);
-  // size of association_mat is u*v
-  // if i in original fused object matches j in new objects
-  // mat(i,j) will be non-zero
-  std::cout << "association mat" << std::endl;
-  std::cout << association_mat << std::endl;
-  // size of match_cps is v+u
   // for a pair(i,j), j represents the index of object in new objects
   // i represents the index of object in original fused objects
   // -1 means no matching
   std::vector<std::pair<int, int>> match_cps;
-  if (u_num > v_num) {
-    km_matcher_.GetKMResult(association_mat.transpose(), &match_cps, true);
-  } else {
-    km_matcher_.GetKMResult(association_mat, &match_cps, false);
-  }
+  AssociateGated(*fused_objects, new_objects, &match_cps);
 
   std::vector<VehicleObs> matched_objects;
   matched_objects.push_back(fused_objects->back());
@@ -124,6 +110,28 @@ bool Fusion::ComputeAssociateMatrix(const std::vector<VehicleObs> &in1_objects,
   return true;
 }
 
+bool Fusion::AssociateGated(const std::vector<VehicleObs> &in1_objects,
+                            const std::vector<VehicleObs> &in2_objects,
+                            std::vector<std::pair<int, int>> *match_cps) {
+  // the ENU position of an object is computed once, not once per pair
+  in1_pos_.resize(in1_objects.size());
+  for (unsigned int i = 0; i < in1_objects.size(); ++i) {
+    in1_pos_[i] = in1_objects[i].pos_enu().head<2>();
+  }
+  in2_pos_.resize(in2_objects.size());
+  for (unsigned int j = 0; j < in2_objects.size(); ++j) {
+    in2_pos_[j] = in2_objects[j].pos_enu().head<2>();
+  }
+  // DisScore is 0 beyond the max match distance
+  return gated_association_.Associate(
+      in1_pos_, in2_pos_, score_params_.max_match_distance(),
+      [this](int, int, double dis) {
+        double score = DisScore(dis);
+        return (score >= score_params_.min_score()) ? score : 0;
+      },
+      match_cps);
+}
+
 double Fusion::CheckOdistance(const VehicleObs &in1_ptr, const VehicleObs &in2_ptr) {
   double xi = in1_ptr.pos_enu()[0];
   double yi = in1_ptr.pos_enu()[1];
@@ -137,8 +145,12 @@ double Fusion::CheckOdistance(const VehicleObs &in1_ptr, const VehicleObs &in2_p
 bool Fusion::CheckDisScore(const VehicleObs &in1_ptr, const VehicleObs &in2_ptr,
                            double *score) {
   double dis = CheckOdistance(in1_ptr, in2_ptr);
-  *score = 2.5 * std::max(0.0, score_params_.max_match_distance() - dis);
+  *score = DisScore(dis);
   return true;
 }
+
+double Fusion::DisScore(double dis) {
+  return 2.5 * std::max(0.0, score_params_.max_match_distance() - dis);
+}
 }  // namespace v2x
 }  // namespace coop
@@ -17,6 +17,7 @@
 #include <vector>
 #include "modules/dataType/vehicle_obs.hpp"
 #include "modules/dataType/raysunframe.hpp"
+#include "modules/fusion/gated_association.h"
 #include "modules/fusion/km.h"
 
 namespace coop {
@@ -61,15 +62,32 @@ class Fusion {
   bool ComputeAssociateMatrix(const std::vector<VehicleObs> &in1_objects,
                               const std::vector<VehicleObs> &in2_objects,
                               Eigen::MatrixXf *association_mat);
+
+  /**
+   * @brief match two groups of objects, only the pairs closer than the max
+   * match distance are scored
+   *
+   * @param in1_objects
+   * @param in2_objects
+   * @param match_cps (i, j) for matched objects, (i, -1) and (-1, j) for
+   * the unmatched ones
+   */
+  bool AssociateGated(const std::vector<VehicleObs> &in1_objects,
+                      const std::vector<VehicleObs> &in2_objects,
+                      std::vector<std::pair<int, int>> *match_cps);
   void set_max_distance_match(double distance);
 
  private:
   bool CheckDisScore(const VehicleObs &in1_ptr, const VehicleObs &in2_ptr,
                      double *score);
+  double DisScore(double dis);
 
   double CheckOdistance(const VehicleObs &in1_ptr, const VehicleObs &in2_ptr);
   ScoreParams score_params_;
   KMkernal km_matcher_;
+  GatedAssociation gated_association_;
+  std::vector<Eigen::Vector2d> in1_pos_;
+  std::vector<Eigen::Vector2d> in2_pos_;
 };
 
 DEFINE_EXTEND_TYPE(Fusion);
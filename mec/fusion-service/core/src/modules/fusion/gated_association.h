@@ -0,0 +1,281 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#pragma once
+#include <eigen3/Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "modules/fusion/km.h"
+
+namespace coop {
+namespace v2x {
+
+/**
+ * @brief Association of tracks and detections that only scores the pairs
+ * closer than a gate distance.
+ *
+ * The detections are bucketed into a uniform grid with the gate as cell size,
+ * so a track only looks at the 3x3 cells around it. The gated pairs form a
+ * bipartite graph whose connected components are matched independently by
+ * KMkernal. The result is the one of KMkernal on the dense matrix, as long as
+ * the score is <= 0 for every pair farther than the gate.
+ *
+ * The buffers are kept between calls. Not thread safe.
+ */
+class GatedAssociation {
+ public:
+  GatedAssociation() = default;
+  ~GatedAssociation() = default;
+
+  /**
+   * @brief match tracks and detections
+   *
+   * @param tracks, detections positions in a local metric frame (ENU)
+   * @param gate max distance of a pair, in meter
+   * @param score score(i, j, distance) of track i and detection j, <= 0 if
+   * they do not match
+   * @param match_cps every track and every detection exactly once: (i, j) for
+   * a match, (i, -1) and (-1, j) for unmatched ones
+   * @return false if the gate is not positive
+   */
+  template <typename ScoreFn>
+  bool Associate(const std::vector<Eigen::Vector2d> &tracks,
+                 const std::vector<Eigen::Vector2d> &detections, double gate,
+                 ScoreFn score, std::vector<std::pair<int, int>> *match_cps);
+
+  // statistics of the last call
+  size_t num_pairs() const { return edges_.size(); }
+  size_t num_components() const { return num_components_; }
+
+ private:
+  struct Edge {
+    int track;
+    int detection;
+    float score;
+    int component;
+  };
+  // the detections of a cell are cells_[begin, end)
+  struct Cell {
+    int64_t key;
+    int begin;
+    int end;
+  };
+
+  static int64_t CellKey(int64_t cx, int64_t cy) {
+    return static_cast<int64_t>((static_cast<uint64_t>(cx) << 32) ^
+                                static_cast<uint32_t>(cy));
+  }
+  size_t CellSlot(int64_t key) const {
+    return (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> cell_shift_;
+  }
+  void BuildCells();
+  const Cell *FindCell(int64_t key) const;
+  int Find(int node);
+  void Union(int a, int b);
+  void Solve(int begin, int end);
+
+  int num_tracks_ = 0;
+  size_t num_components_ = 0;
+  // (cell key, detection index) sorted by key
+  std::vector<std::pair<int64_t, int>> cells_;
+  // open addressing table of the non empty cells
+  std::vector<Cell> cell_table_;
+  int cell_shift_ = 64;
+  std::vector<Edge> edges_;
+  // union find over tracks [0, n) and detections [n, n + m)
+  std::vector<int> parent_;
+  // component local indices of the tracks and detections
+  std::vector<int> local_;
+  std::vector<int> comp_tracks_;
+  std::vector<int> comp_detections_;
+  std::vector<float> mat_buf_;
+  std::vector<int> track_match_;
+  std::vector<int> detection_match_;
+  std::vector<std::pair<int, int>> comp_cps_;
+  KMkernal km_matcher_;
+};
+
+inline void GatedAssociation::BuildCells() {
+  size_t size = 4;
+  cell_shift_ = 62;
+  while (size < cells_.size() * 2) {
+    size <<= 1;
+    cell_shift_--;
+  }
+  cell_table_.assign(size, Cell{0, -1, -1});
+  for (size_t begin = 0, end; begin < cells_.size(); begin = end) {
+    for (end = begin + 1;
+         end < cells_.size() && cells_[end].first == cells_[begin].first;
+         ++end) {
+    }
+    size_t slot = CellSlot(cells_[begin].first);
+    while (cell_table_[slot].begin >= 0) slot = (slot + 1) & (size - 1);
+    cell_table_[slot] = Cell{cells_[begin].first, static_cast<int>(begin),
+                             static_cast<int>(end)};
+  }
+}
+
+inline const GatedAssociation::Cell *GatedAssociation::FindCell(
+    int64_t key) const {
+  const size_t mask = cell_table_.size() - 1;
+  for (size_t slot = CellSlot(key);; slot = (slot + 1) & mask) {
+    const Cell &cell = cell_table_[slot];
+    if (cell.begin < 0) return nullptr;
+    if (cell.key == key) return &cell;
+  }
+}
+
+inline int GatedAssociation::Find(int node) {
+  while (parent_[node] != node) {
+    parent_[node] = parent_[parent_[node]];
+    node = parent_[node];
+  }
+  return node;
+}
+
+inline void GatedAssociation::Union(int a, int b) {
+  a = Find(a);
+  b = Find(b);
+  if (a != b) parent_[std::max(a, b)] = std::min(a, b);
+}
+
+// edges_[begin, end) is one connected component
+inline void GatedAssociation::Solve(int begin, int end) {
+  if (end - begin == 1) {
+    track_match_[edges_[begin].track] = edges_[begin].detection;
+    detection_match_[edges_[begin].detection] = edges_[begin].track;
+    return;
+  }
+  comp_tracks_.clear();
+  comp_detections_.clear();
+  for (int e = begin; e < end; ++e) {
+    const Edge &edge = edges_[e];
+    const int t = edge.track, d = num_tracks_ + edge.detection;
+    if (local_[t] < 0) {
+      local_[t] = comp_tracks_.size();
+      comp_tracks_.push_back(edge.track);
+    }
+    if (local_[d] < 0) {
+      local_[d] = comp_detections_.size();
+      comp_detections_.push_back(edge.detection);
+    }
+  }
+  const int rows = comp_tracks_.size(), cols = comp_detections_.size();
+  if (mat_buf_.size() < static_cast<size_t>(rows * cols)) {
+    mat_buf_.resize(rows * cols);
+  }
+  Eigen::Map<Eigen::MatrixXf> mat(mat_buf_.data(), rows, cols);
+  mat.setZero();
+  for (int e = begin; e < end; ++e) {
+    const Edge &edge = edges_[e];
+    mat(local_[edge.track], local_[num_tracks_ + edge.detection]) = edge.score;
+  }
+  km_matcher_.GetKMResult(mat, &comp_cps_);
+  for (const auto &cp : comp_cps_) {
+    if (cp.first == -1 || cp.second == -1) continue;
+    const int t = comp_tracks_[cp.first], d = comp_detections_[cp.second];
+    track_match_[t] = d;
+    detection_match_[d] = t;
+  }
+  for (int t : comp_tracks_) local_[t] = -1;
+  for (int d : comp_detections_) local_[num_tracks_ + d] = -1;
+}
+
+template <typename ScoreFn>
+bool GatedAssociation::Associate(const std::vector<Eigen::Vector2d> &tracks,
+                                 const std::vector<Eigen::Vector2d> &detections,
+                                 double gate, ScoreFn score,
+                                 std::vector<std::pair<int, int>> *match_cps) {
+  match_cps->clear();
+  edges_.clear();
+  num_components_ = 0;
+  if (!(gate > 0)) {
+    return false;
+  }
+  num_tracks_ = tracks.size();
+  const int num_detections = detections.size();
+
+  // bucket the detections
+  cells_.resize(num_detections);
+  for (int j = 0; j < num_detections; ++j) {
+    const int64_t cx = std::floor(detections[j](0) / gate);
+    const int64_t cy = std::floor(detections[j](1) / gate);
+    cells_[j] = std::make_pair(CellKey(cx, cy), j);
+  }
+  std::sort(cells_.begin(), cells_.end());
+  BuildCells();
+
+  // score the pairs in the 3x3 cells around every track
+  for (int i = 0; i < num_tracks_; ++i) {
+    const int64_t cx = std::floor(tracks[i](0) / gate);
+    const int64_t cy = std::floor(tracks[i](1) / gate);
+    for (int64_t dx = -1; dx <= 1; ++dx) {
+      for (int64_t dy = -1; dy <= 1; ++dy) {
+        const Cell *cell = FindCell(CellKey(cx + dx, cy + dy));
+        if (!cell) continue;
+        for (int c = cell->begin; c < cell->end; ++c) {
+          const int j = cells_[c].second;
+          const double dist = (tracks[i] - detections[j]).norm();
+          if (dist >= gate) continue;
+          const double s = score(i, j, dist);
+          if (s > 0) edges_.push_back({i, j, static_cast<float>(s), 0});
+        }
+      }
+    }
+  }
+
+  // connected components of the gated pairs
+  const int nodes = num_tracks_ + num_detections;
+  if (parent_.size() < static_cast<size_t>(nodes)) {
+    parent_.resize(nodes);
+    local_.resize(nodes);
+  }
+  for (int n = 0; n < nodes; ++n) parent_[n] = n;
+  std::fill(local_.begin(), local_.begin() + nodes, -1);
+  for (const auto &edge : edges_) {
+    Union(edge.track, num_tracks_ + edge.detection);
+  }
+  for (auto &edge : edges_) {
+    edge.component = Find(edge.track);
+  }
+  std::sort(edges_.begin(), edges_.end(), [](const Edge &a, const Edge &b) {
+    return a.component < b.component;
+  });
+
+  track_match_.assign(num_tracks_, -1);
+  detection_match_.assign(num_detections, -1);
+  for (size_t begin = 0, end; begin < edges_.size(); begin = end) {
+    for (end = begin + 1; end < edges_.size() &&
+                          edges_[end].component == edges_[begin].component;
+         ++end) {
+    }
+    Solve(begin, end);
+    num_components_++;
+  }
+
+  for (int i = 0; i < num_tracks_; ++i) {
+    match_cps->push_back(std::make_pair(i, track_match_[i]));
+  }
+  for (int j = 0; j < num_detections; ++j) {
+    if (detection_match_[j] == -1) match_cps->push_back(std::make_pair(-1, j));
+  }
+  return true;
+}
+}  // namespace v2x
+}  // namespace coop
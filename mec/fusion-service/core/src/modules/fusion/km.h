@@ -21,6 +21,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <string>
 #include <utility>
@@ -28,127 +29,183 @@
 
 namespace coop {
 namespace v2x {
-#define USR_INF 999999999999
 
+/**
+ * @brief Kuhn-Munkres assignment maximizing the sum of the association
+ * scores. Pairs with a score <= 0 are gated out and never matched.
+ *
+ * The solver runs shortest augmenting paths with potentials (Jonker-Volgenant
+ * style) on the rows, every row may also stay unmatched at cost 0, so any
+ * rows x cols shape is accepted. The working buffers are kept between calls
+ * and only grow to the largest problem seen, a matcher does not allocate in
+ * steady state. A matcher must not be shared between threads.
+ */
 class KMkernal {
  public:
   KMkernal() = default;
   ~KMkernal() = default;
+
+  /**
+   * @brief match the rows and the columns of the association matrix
+   *
+   * @param association_mat the score of row i and column j, <= 0 if gated
+   * @param match_cps every row and every column exactly once: (i, j) for a
+   * match, (i, -1) and (-1, j) for unmatched ones. The pairs are (j, i) if
+   * need_reverse is set.
+   * @return true
+   */
   template <typename T>
   bool GetKMResult(const T &association_mat,
                    std::vector<std::pair<int, int>> *match_cps,
                    bool need_reverse = false);
 
  private:
-  int u_size_;
-  int v_size_;
-  double *ex_u_;
-  double *ex_v_;
-  int *v_matched_;
-  double *v_slack_;
-  std::set<int> used_u_;
-  std::set<int> used_v_;
   template <typename T>
-  bool FindCP(const T &mat, int i);
+  void Solve(const T &mat);
+  template <typename T>
+  void Augment(const T &mat, int row);
+  template <typename T>
+  double Cost(const T &mat, int row, int col) const;
+
+  int u_size_ = 0;
+  int v_size_ = 0;
+  // columns of the problem: v_size_ real ones, then one "unmatched"
+  // column per active row
+  int cols_ = 0;
+  // the rows having at least one pair passing the gate
+  std::vector<int> active_;
+  // potentials of the active rows and of the columns
+  std::vector<double> ex_u_;
+  std::vector<double> ex_v_;
+  // active row matched to a column (1-based, 0 for none), column 0
+  // is the root of the current search
+  std::vector<int> col_match_;
+  std::vector<int> way_;
+  std::vector<double> min_slack_;
+  std::vector<char> used_;
+  std::vector<int> row_match_;
 };
+
 template <typename T>
-bool KMkernal::GetKMResult(const T &association_mat,
-                           std::vector<std::pair<int, int>> *match_cps,
-                           bool need_reverse) {
-  match_cps->clear();
-  u_size_ = association_mat.rows();
-  v_size_ = association_mat.cols();
-  if (u_size_ > v_size_) return false;
-  ex_u_ = new double[u_size_];
-  ex_v_ = new double[v_size_];
-  v_matched_ = new int[v_size_];
-  std::fill(v_matched_, v_matched_ + v_size_, -1);
-  memset(ex_v_, 0, v_size_ * sizeof(double));
-  for (int i = 0; i < u_size_; ++i) {
-    ex_u_[i] = association_mat(i, 0);
-    for (int j = 1; j < v_size_; ++j) {
-      ex_u_[i] = std::max(static_cast<float>(ex_u_[i]), association_mat(i, j));
-    }
+double KMkernal::Cost(const T &mat, int row, int col) const {
+  if (col >= v_size_) {
+    return 0.;
   }
-  for (int i = 0; i < u_size_; ++i) {
-    if (ex_u_[i] <= 0) {
-      if (need_reverse)
-        match_cps->push_back(std::make_pair(-1, i));
-      else
-        match_cps->push_back(std::make_pair(i, -1));
-      continue;
-    }
-    v_slack_ = new double[v_size_];
-    std::fill(v_slack_, v_slack_ + v_size_, USR_INF);
-    while (1) {
-      used_u_.clear();
-      used_v_.clear();
-      if (FindCP(association_mat, i)) break;
-      double d = USR_INF;
-      for (int j = 0; j < v_size_; ++j)
-        if (used_v_.find(j) == used_v_.end()) d = std::min(d, v_slack_[j]);
-      for (auto it = used_u_.begin(); it != used_u_.end(); it++) {
-        ex_u_[*it] -= d;
+  const double score = mat(row, col);
+  return score > 0 ? -score : std::numeric_limits<double>::infinity();
+}
+
+template <typename T>
+void KMkernal::Augment(const T &mat, int row) {
+  const double inf = std::numeric_limits<double>::infinity();
+  col_match_[0] = row;
+  std::fill(min_slack_.begin(), min_slack_.begin() + cols_ + 1, inf);
+  std::fill(used_.begin(), used_.begin() + cols_ + 1, 0);
+  int j0 = 0;
+  do {
+    used_[j0] = 1;
+    const int i0 = col_match_[j0];
+    const int mat_row = active_[i0 - 1];
+    double delta = inf;
+    int j1 = 0;
+    for (int j = 1; j <= cols_; ++j) {
+      if (used_[j]) continue;
+      const double cost = Cost(mat, mat_row, j - 1);
+      // gated pairs are never relaxed
+      if (cost != inf) {
+        const double cur = cost - ex_u_[i0] - ex_v_[j];
+        if (cur < min_slack_[j]) {
+          min_slack_[j] = cur;
+          way_[j] = j0;
+        }
       }
-      for (int j = 0; j < v_size_; ++j) {
-        if (used_v_.find(j) != used_v_.end())
-          ex_v_[j] += d;
-        else
-          v_slack_[j] -= d;
+      if (min_slack_[j] < delta) {
+        delta = min_slack_[j];
+        j1 = j;
       }
     }
-    delete[] v_slack_;
-  }
-  if (need_reverse) {
-    for (int j = 0; j < v_size_; ++j) {
-      if (v_matched_[j] == -1) {
-        match_cps->push_back(std::make_pair(j, -1));
-      } else if (association_mat(v_matched_[j], j) > 0) {
-        match_cps->push_back(std::make_pair(j, v_matched_[j]));
+    for (int j = 0; j <= cols_; ++j) {
+      if (used_[j]) {
+        ex_u_[col_match_[j]] += delta;
+        ex_v_[j] -= delta;
       } else {
-        match_cps->push_back(std::make_pair(-1, v_matched_[j]));
-        match_cps->push_back(std::make_pair(j, -1));
+        min_slack_[j] -= delta;
       }
     }
-  } else {
+    j0 = j1;
+  } while (col_match_[j0] != 0);
+
+  // flip the augmenting path
+  do {
+    const int j1 = way_[j0];
+    col_match_[j0] = col_match_[j1];
+    j0 = j1;
+  } while (j0);
+}
+
+template <typename T>
+void KMkernal::Solve(const T &mat) {
+  active_.clear();
+  for (int i = 0; i < u_size_; ++i) {
     for (int j = 0; j < v_size_; ++j) {
-      if (v_matched_[j] == -1) {
-        match_cps->push_back(std::make_pair(-1, j));
-      } else if (association_mat(v_matched_[j], j) > 0) {
-        match_cps->push_back(std::make_pair(v_matched_[j], j));
-      } else {
-        match_cps->push_back(std::make_pair(v_matched_[j], -1));
-        match_cps->push_back(std::make_pair(-1, j));
+      if (mat(i, j) > 0) {
+        active_.push_back(i);
+        break;
       }
     }
   }
-  delete[] ex_u_;
-  delete[] ex_v_;
-  delete[] v_matched_;
-  return true;
+  const int rows = active_.size();
+  cols_ = v_size_ + rows;
+  if (ex_v_.size() < static_cast<size_t>(cols_ + 1)) {
+    ex_u_.resize(cols_ + 1);
+    ex_v_.resize(cols_ + 1);
+    col_match_.resize(cols_ + 1);
+    way_.resize(cols_ + 1);
+    min_slack_.resize(cols_ + 1);
+    used_.resize(cols_ + 1);
+  }
+  std::fill(ex_u_.begin(), ex_u_.begin() + rows + 1, 0.);
+  std::fill(ex_v_.begin(), ex_v_.begin() + cols_ + 1, 0.);
+  std::fill(col_match_.begin(), col_match_.begin() + cols_ + 1, 0);
+
+  for (int i = 1; i <= rows; ++i) {
+    Augment(mat, i);
+  }
+
+  // the active rows left in an "unmatched" column stay -1
+  if (row_match_.size() < static_cast<size_t>(u_size_)) {
+    row_match_.resize(u_size_);
+  }
+  std::fill(row_match_.begin(), row_match_.begin() + u_size_, -1);
+  for (int j = 1; j <= v_size_; ++j) {
+    if (col_match_[j]) {
+      row_match_[active_[col_match_[j] - 1]] = j - 1;
+    }
+  }
 }
 
 template <typename T>
-bool KMkernal::FindCP(const T &mat, int i) {
-  used_u_.insert(i);
-  for (int j = 0; j < v_size_; ++j) {
-    if (used_v_.find(j) != used_v_.end()) {
-      continue;
-    }
-    double gap = ex_u_[i] + ex_v_[j] - mat(i, j);
-    if (gap <= 0) {
-      // res = 0;
-      used_v_.insert(j);
-      bool match_success = v_matched_[j] == -1 || FindCP(mat, v_matched_[j]);
-      if (match_success) {
-        v_matched_[j] = i;
-        return true;
-      }
-    } else {
-      v_slack_[j] = std::min(v_slack_[j], gap);
-    }
+bool KMkernal::GetKMResult(const T &association_mat,
+                           std::vector<std::pair<int, int>> *match_cps,
+                           bool need_reverse) {
+  match_cps->clear();
+  u_size_ = association_mat.rows();
+  v_size_ = association_mat.cols();
+  Solve(association_mat);
+
+  auto add_pair = [&](int i, int j) {
+    if (need_reverse)
+      match_cps->push_back(std::make_pair(j, i));
+    else
+      match_cps->push_back(std::make_pair(i, j));
+  };
+  for (int i = 0; i < u_size_; ++i) {
+    if (row_match_[i] == -1) add_pair(i, -1);
+  }
+  for (int j = 1; j <= v_size_; ++j) {
+    add_pair(col_match_[j] ? active_[col_match_[j] - 1] : -1, j - 1);
   }
-  return false;
+  return true;
 }
 }  // namespace v2x
 }  // namespace coop
@@ -102,9 +102,9 @@ void IMGPROCESSOR::PlotVehicleSnapshot(
 }
 
 void IMGPROCESSOR::PlotVehicleStatesAndFrames(
-    cv::Mat *ptr_img, std::map<int, spVehicleState> vehicles,
-    std::vector<spRaysunFrame> syncFrames,
-    std::map<int, spVehicleObs> vehicle_obsers, OCLong current_time,
+    cv::Mat *ptr_img, const std::map<int, spVehicleState> &vehicles,
+    const std::vector<spRaysunFrame> &syncFrames,
+    const std::map<int, spVehicleObs> &vehicle_obsers, OCLong current_time,
     OCLong last_time) {
   cv::Mat vehicle_fusion_img = cv::Mat(H_, W_, CV_32FC3, cv::Scalar(0, 0, 0));
   PlotFusionVehicles(&vehicle_fusion_img, vehicles);
@@ -64,11 +64,11 @@ class IMGPROCESSOR {
    * @param syncFrames Synced observation observation to plot
    * @return
    */
-  void PlotVehicleStatesAndFrames(cv::Mat* ptr_img,
-                                  std::map<int, spVehicleState> vehicles,
-                                  std::vector<spRaysunFrame> syncFrames,
-                                  std::map<int, spVehicleObs> vehicle_obsers,
-                                  OCLong current_time, OCLong last_time);
+  void PlotVehicleStatesAndFrames(
+      cv::Mat* ptr_img, const std::map<int, spVehicleState>& vehicles,
+      const std::vector<spRaysunFrame>& syncFrames,
+      const std::map<int, spVehicleObs>& vehicle_obsers, OCLong current_time,
+      OCLong last_time);
 
   void PlotVehicleSnapshot(cv::Mat* ptr_img,
                                   std::map<int, spVehicleState> origin,
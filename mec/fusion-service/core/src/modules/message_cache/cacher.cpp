@@ -26,25 +26,21 @@ Cacher::Cacher() {
   auto const& cfg = g_fuserConfig->cacher_cfg();
   duration_s_ = cfg.duration_s();
   max_delay_ms_ = cfg.max_delay_ms();
+  if (cfg.frames_per_device() > 0) {
+    frames_per_device_ = cfg.frames_per_device();
+  }
 }
 
 // Get the last value of the specific device <= time of main device
 sp_cRaysunFrame Cacher::GetNearestFrame(const OCLong timestamp,
                                         const OCLong devid) {
   // std::lock_guard<std::mutex> lock(mtx_named_buff_);
-  auto& dev_map = named_buff_[devid];
-  if (dev_map.size() == 0) {
+  auto it = named_buff_.find(devid);
+  if (it == named_buff_.end()) {
     return nullptr;
   }
-  auto it = dev_map.upper_bound(timestamp);
-
-  if (it != dev_map.begin()) {
-    --it;
-    return it->second;
-  } else {
-    return nullptr;
-  }
-
+  const sp_cRaysunFrame *frame = it->second.Nearest(timestamp);
+  return frame ? *frame : nullptr;
 }
 
 void Cacher::SortCache() {
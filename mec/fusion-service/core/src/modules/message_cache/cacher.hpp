@@ -22,10 +22,13 @@
 #include <queue>
 #include "modules/common/util/inner_types.hpp"
 #include "modules/dataType/raysunframe.hpp"
+#include "modules/message_cache/frame_ring.hpp"
 
 namespace coop {
 namespace v2x {
 
+typedef TimeIndexedRing<sp_cRaysunFrame> FrameRing;
+
 class Cacher {
  public:
   Cacher();
@@ -34,18 +37,19 @@ class Cacher {
   void SortCache();
   std::deque<sp_cRaysunFrame> GetSampleTimeOrderedFrames();
   sp_cRaysunFrame GetNearestFrame(const OCLong timestamp, const OCLong devid);
-  std::map<OCLong, std::map<size_t, sp_cRaysunFrame>> named_buff() {
-    return named_buff_;
-  }
-  std::map<size_t, sp_cRaysunFrame> buffer() { return buffer_; }
+  // fn(devid, frame) with the last frame <= timestamp of every device, in
+  // devid order, the frames are not copied
+  template <typename Fn>
+  void ForEachNearestFrame(const OCLong timestamp, Fn fn) const;
+  // the frames of every device in time order
+  const std::map<OCLong, FrameRing> &named_buff() const { return named_buff_; }
 
  public:
-  std::map<OCLong, std::map<size_t, sp_cRaysunFrame>>
-      named_buff_;  // 缓存duration_s_的所有数据
-  std::map<size_t, sp_cRaysunFrame> buffer_;
+  std::map<OCLong, FrameRing> named_buff_;  // 缓存duration_s_的所有数据
   std::mutex mtx_named_buff_;
   double duration_s_ = 1.5;
   double max_delay_ms_ = 1000;
+  size_t frames_per_device_ = 64;
   double last_recieve_time_s_ = -1;
   double current_recieve_time_s_ = -1;
   // OCLong main_devid_;
@@ -54,36 +58,27 @@ class Cacher {
 
 template <typename T>
 std::deque<sp_cRaysunFrame> Cacher::push_back(sp(T) msg) {
-  // que_.push_back(msg);
-  double dt_ms_single_buff = 0;
-  double dt_ms_buffer = 0;
-  {
-    current_recieve_time_s_ = msg->head().timestamp;
-
-    std::map<size_t, sp_cRaysunFrame> &single_buff =
-        named_buff_[msg->head().devid];
-    single_buff[msg->head().timestamp] = msg;
-    dt_ms_single_buff = single_buff.rbegin()->second->head().timestamp -
-                        single_buff.begin()->second->head().timestamp;
-    // named_buff_[msg->head().devid][msg->head().timestamp]=msg;
-    if (dt_ms_single_buff >= s2ms(duration_s_)) {
-      size_t remove_ms = single_buff.rbegin()->second->head().timestamp -
-                              s2ms(duration_s_);
-      single_buff.erase(single_buff.begin(),
-                        single_buff.lower_bound(remove_ms));
-    }
-
-    buffer_[msg->head().timestamp] = msg;
-    dt_ms_buffer = buffer_.rbegin()->second->head().timestamp -
-                   buffer_.begin()->second->head().timestamp;
+  current_recieve_time_s_ = msg->head().timestamp;
+  const OCLong devid = msg->head().devid;
+  auto it = named_buff_.find(devid);
+  if (it == named_buff_.end()) {
+    it = named_buff_.emplace(devid, FrameRing(frames_per_device_)).first;
+  }
+  FrameRing &single_buff = it->second;
+  single_buff.Insert(msg->head().timestamp, msg);
+  // keep duration_s_ before the newest frame of the device
+  single_buff.EvictBefore(single_buff.back_time() -
+                          static_cast<OCLong>(s2ms(duration_s_)));
+  return std::deque<sp_cRaysunFrame>();
+}
 
-    if (dt_ms_buffer >= s2ms(duration_s_)) {
-      size_t remove_ms =
-          buffer_.rbegin()->second->head().timestamp - s2ms(duration_s_);
-      buffer_.erase(buffer_.begin(), buffer_.lower_bound(remove_ms));
+template <typename Fn>
+void Cacher::ForEachNearestFrame(const OCLong timestamp, Fn fn) const {
+  for (const auto &dev : named_buff_) {
+    const sp_cRaysunFrame *frame = dev.second.Nearest(timestamp);
+    if (frame) {
+      fn(dev.first, *frame);
     }
-
-    return std::deque<sp_cRaysunFrame>();
   }
 }
 
@@ -0,0 +1,150 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "modules/common/util/inner_types.hpp"
+
+namespace coop {
+namespace v2x {
+
+/**
+ * @brief fixed capacity ring of values ordered by timestamp
+ *
+ * Frames of one sensor arrive in time order, so Insert() is an append in the
+ * common case. A late frame is moved into place, a timestamp already in the
+ * ring is replaced. When the ring is full the oldest value is dropped.
+ * Lookups by time are binary searches, nothing is allocated after the
+ * construction.
+ */
+template <typename T>
+class TimeIndexedRing {
+ public:
+  explicit TimeIndexedRing(size_t capacity = 64) {
+    size_t slots = 1;
+    while (slots < capacity) slots <<= 1;
+    times_.resize(slots);
+    values_.resize(slots);
+    mask_ = slots - 1;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return times_.size(); }
+
+  // i-th value in time order, 0 is the oldest
+  OCLong time(size_t i) const { return times_[slot(i)]; }
+  const T &value(size_t i) const { return values_[slot(i)]; }
+  OCLong front_time() const { return time(0); }
+  OCLong back_time() const { return time(size_ - 1); }
+
+  /**
+   * @brief insert a value keeping the time order
+   * @return false if the ring is full and the value is older than all of
+   * the kept ones
+   */
+  bool Insert(OCLong timestamp, const T &value) {
+    // in order arrival
+    if (size_ == 0 || timestamp > back_time()) {
+      if (size_ == capacity()) PopFront();
+      times_[slot(size_)] = timestamp;
+      values_[slot(size_)] = value;
+      size_++;
+      return true;
+    }
+    size_t pos = LowerBound(timestamp);
+    if (pos < size_ && time(pos) == timestamp) {
+      values_[slot(pos)] = value;
+      return true;
+    }
+    if (size_ == capacity()) {
+      if (pos == 0) return false;
+      PopFront();
+      pos--;
+    }
+    // late arrival, shift the newer values by one
+    for (size_t i = size_; i > pos; --i) {
+      times_[slot(i)] = times_[slot(i - 1)];
+      values_[slot(i)] = std::move(values_[slot(i - 1)]);
+    }
+    times_[slot(pos)] = timestamp;
+    values_[slot(pos)] = value;
+    size_++;
+    return true;
+  }
+
+  // drop the values older than timestamp
+  void EvictBefore(OCLong timestamp) {
+    while (size_ > 0 && front_time() < timestamp) PopFront();
+  }
+
+  // the last value with a time <= timestamp, nullptr if there is none
+  const T *Nearest(OCLong timestamp) const {
+    const size_t pos = UpperBound(timestamp);
+    return pos == 0 ? nullptr : &values_[slot(pos - 1)];
+  }
+
+  void Clear() {
+    while (size_ > 0) PopFront();
+  }
+
+ private:
+  size_t slot(size_t i) const { return (head_ + i) & mask_; }
+
+  void PopFront() {
+    values_[head_] = T();
+    head_ = (head_ + 1) & mask_;
+    size_--;
+  }
+
+  // first index with time >= timestamp
+  size_t LowerBound(OCLong timestamp) const {
+    size_t lo = 0, hi = size_;
+    while (lo < hi) {
+      const size_t mid = (lo + hi) / 2;
+      if (time(mid) < timestamp) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  // first index with time > timestamp
+  size_t UpperBound(OCLong timestamp) const {
+    size_t lo = 0, hi = size_;
+    while (lo < hi) {
+      const size_t mid = (lo + hi) / 2;
+      if (time(mid) <= timestamp) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  std::vector<OCLong> times_;
+  std::vector<T> values_;
+  size_t mask_ = 0;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace v2x
+}  // namespace coop
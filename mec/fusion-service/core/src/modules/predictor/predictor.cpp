@@ -63,7 +63,7 @@ spRaysunFrame Predictor::PropagateFrame(sp_cRaysunFrame ori_frame,
   return syncSubFrame;
 }
 
-void Predictor::PropagateVehicles(std::map<int, spVehicleState> &vehicle_states,std::map<int, spVehicleState> &removed_vehicle_states,
+void Predictor::PropagateVehicles(VehicleStateTable &vehicle_states,std::map<int, spVehicleState> &removed_vehicle_states,
                                   OCLong current_time) {
   // remove the vehicle state if time to live is <0
   // otherwise, use the speed to propagate to current time
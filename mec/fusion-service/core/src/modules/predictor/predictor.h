@@ -29,7 +29,7 @@ class Predictor {
    * position
    * @param current_time the given time until when the system is propagated
    */
-  void PropagateVehicles(std::map<int, spVehicleState> &vehicle_states,std::map<int, spVehicleState> &removed_vehicle_states,
+  void PropagateVehicles(VehicleStateTable &vehicle_states,std::map<int, spVehicleState> &removed_vehicle_states,
                          OCLong current_time);
   /**
    * @brief use the speed and orientation to predict the observation frame in
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Tracks per second of the fusion track filter, the previous
+// ExtendedKalmanFilter against the fixed size one.
+//
+// ekf_bench [tracks] [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "modules/filter/kalman_filter.h"
+
+using coop::v2x::ExtendedKalmanFilter;
+
+namespace {
+
+double ElapsedS(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// the previous ExtendedKalmanFilter
+struct DynamicEKF {
+  Eigen::Vector4d state_;
+  Eigen::Matrix4d variance_, process_noise_, measure_noise_, measure_matrix_,
+      transition_, kalman_gain_;
+  void Predict(float delta_t) {
+    float sin_theta = static_cast<float>(std::sin(state_(3)));
+    float cos_theta = static_cast<float>(std::cos(state_(3)));
+    transition_(0, 2) = delta_t * cos_theta;
+    transition_(0, 3) = -delta_t * state_(2) * sin_theta;
+    transition_(1, 2) = delta_t * sin_theta;
+    transition_(1, 3) = delta_t * state_(2) * cos_theta;
+    state_(0) += state_(2) * cos_theta * delta_t;
+    state_(1) += state_(2) * sin_theta * delta_t;
+    variance_ =
+        transition_ * variance_ * transition_.transpose() + process_noise_;
+  }
+  void Correct(const Eigen::VectorXd &z) {
+    Eigen::Vector4d measure;
+    measure << z[0], z[1], z[2], z[3];
+    Eigen::Matrix4d cov =
+        measure_matrix_ * variance_ * measure_matrix_.transpose() +
+        measure_noise_;
+    kalman_gain_ = variance_ * measure_matrix_.transpose() * cov.inverse();
+    variance_ = variance_ - kalman_gain_ * measure_matrix_ * variance_;
+    Eigen::Vector4d diff = measure - measure_matrix_ * state_;
+    diff(3) = coop::v2x::normalizeRad(diff(3));
+    state_ = state_ + kalman_gain_ * diff;
+  }
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int num_tracks = argc > 1 ? atoi(argv[1]) : 300;
+  const int frames = argc > 2 ? atoi(argv[2]) : 2000;
+  const double dt = 0.1;
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> pos(-200., 200.), speed(0., 20.),
+      heading(-M_PI, M_PI);
+  std::vector<std::shared_ptr<ExtendedKalmanFilter>> filters;
+  std::vector<std::shared_ptr<DynamicEKF>> dynamic;
+  std::vector<Eigen::Vector4d> measures;
+  for (int i = 0; i < num_tracks; ++i) {
+    const Eigen::Vector4d x(pos(gen), pos(gen), speed(gen), heading(gen));
+    filters.push_back(std::make_shared<ExtendedKalmanFilter>());
+    filters.back()->Init(x);
+    // the filters live in the heap like the ones of VehicleState
+    dynamic.push_back(std::make_shared<DynamicEKF>());
+    dynamic[i]->state_ = x;
+    dynamic[i]->variance_ = filters.back()->variance_;
+    dynamic[i]->process_noise_ = filters.back()->process_noise_;
+    dynamic[i]->measure_noise_ = filters.back()->measure_noise_;
+    dynamic[i]->measure_matrix_.setIdentity();
+    dynamic[i]->transition_.setIdentity();
+    measures.push_back(x);
+  }
+
+  // predict only, as PropagateVehicles does every frame
+  auto t0 = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (auto &ekf : dynamic) ekf->Predict(dt);
+  }
+  const double dynamic_predict = ElapsedS(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (auto &ekf : filters) ekf->Predict(dt);
+  }
+  const double scalar_predict = ElapsedS(t0);
+
+  // predict and correct
+  t0 = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (int i = 0; i < num_tracks; ++i) {
+      dynamic[i]->Predict(dt);
+      dynamic[i]->Correct(Eigen::VectorXd(measures[i]));
+    }
+  }
+  const double dynamic_cycle = ElapsedS(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (int i = 0; i < num_tracks; ++i) {
+      filters[i]->Predict(dt);
+      filters[i]->Correct(measures[i]);
+    }
+  }
+  const double scalar_cycle = ElapsedS(t0);
+
+  double diff = 0;
+  for (int i = 0; i < num_tracks; ++i) {
+    diff = std::max(diff, (filters[i]->get_state() - dynamic[i]->state_)
+                              .cwiseAbs()
+                              .maxCoeff());
+  }
+
+  const double n = static_cast<double>(num_tracks) * frames;
+  printf("%d tracks, %d frames\n", num_tracks, frames);
+  printf("predict, dynamic interface : %8.2f M tracks/s\n",
+         n / dynamic_predict / 1e6);
+  printf("predict, fixed size        : %8.2f M tracks/s\n",
+         n / scalar_predict / 1e6);
+  printf("predict+correct, dynamic   : %8.2f M tracks/s\n",
+         n / dynamic_cycle / 1e6);
+  printf("predict+correct, fixed size: %8.2f M tracks/s\n",
+         n / scalar_cycle / 1e6);
+  printf("max state difference       : %g\n", diff);
+  return 0;
+}
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "modules/filter/kalman_filter.h"
+
+namespace coop {
+namespace v2x {
+namespace {
+
+// the previous ExtendedKalmanFilter: dynamic vectors in the interface and
+// the prediction in float
+class ReferenceEKF {
+ public:
+  void Init(const Eigen::VectorXd &x, const ExtendedKalmanFilter &params) {
+    variance_ = params.variance_;
+    measure_noise_ = params.measure_noise_;
+    process_noise_ = params.process_noise_;
+    transition_.setIdentity();
+    state_ << x(0), x(1), x(2), x(3);
+  }
+  void Predict(float delta_t) {
+    float sin_theta = static_cast<float>(std::sin(state_(3)));
+    float cos_theta = static_cast<float>(std::cos(state_(3)));
+    transition_(0, 2) = delta_t * cos_theta;
+    transition_(0, 3) = -delta_t * state_(2) * sin_theta;
+    transition_(1, 2) = delta_t * sin_theta;
+    transition_(1, 3) = delta_t * state_(2) * cos_theta;
+    state_(0) += state_(2) * cos_theta * delta_t;
+    state_(1) += state_(2) * sin_theta * delta_t;
+    variance_ =
+        transition_ * variance_ * transition_.transpose() + process_noise_;
+  }
+  void Correct(const Eigen::VectorXd &z) {
+    Eigen::Vector4d measure;
+    measure << z[0], z[1], z[2], z[3];
+    Eigen::Matrix4d cov = variance_ + measure_noise_;
+    Eigen::Matrix4d gain = variance_ * cov.inverse();
+    variance_ = variance_ - gain * variance_;
+    Eigen::Vector4d diff = measure - state_;
+    diff(3) = normalizeRad(diff(3));
+    state_ = state_ + gain * diff;
+  }
+  Eigen::Vector4d state_;
+  Eigen::Matrix4d variance_;
+  Eigen::Matrix4d measure_noise_;
+  Eigen::Matrix4d process_noise_;
+  Eigen::Matrix4d transition_;
+};
+
+Eigen::Vector4d RandomState(std::mt19937 *gen) {
+  std::uniform_real_distribution<double> pos(-200., 200.);
+  std::uniform_real_distribution<double> speed(0., 20.);
+  std::uniform_real_distribution<double> heading(-M_PI, M_PI);
+  return Eigen::Vector4d(pos(*gen), pos(*gen), speed(*gen), heading(*gen));
+}
+
+// a track driving at constant speed, observed with noise every 100 ms
+TEST(ExtendedKalmanFilterTest, MatchesReference) {
+  std::mt19937 gen(5);
+  std::normal_distribution<double> noise(0., 0.5);
+  for (int track = 0; track < 100; ++track) {
+    Eigen::Vector4d truth = RandomState(&gen);
+    ExtendedKalmanFilter ekf;
+    ekf.Init(truth);
+    ReferenceEKF reference;
+    reference.Init(Eigen::VectorXd(truth), ekf);
+
+    for (int step = 0; step < 100; ++step) {
+      const double dt = 0.1;
+      truth(0) += truth(2) * std::cos(truth(3)) * dt;
+      truth(1) += truth(2) * std::sin(truth(3)) * dt;
+      ekf.Predict(dt);
+      reference.Predict(dt);
+      Eigen::Vector4d z = truth;
+      z(0) += noise(gen);
+      z(1) += noise(gen);
+      z(3) = normalizeRad(z(3) + noise(gen) * 0.05);
+      ekf.Correct(z);
+      reference.Correct(Eigen::VectorXd(z));
+
+      // the reference rounds the prediction to float
+      for (int k = 0; k < 4; ++k) {
+        ASSERT_NEAR(ekf.get_state()(k), reference.state_(k), 1e-4)
+            << "track " << track << " step " << step;
+      }
+      ASSERT_LT((ekf.variance_ - reference.variance_).cwiseAbs().maxCoeff(),
+                1e-5);
+    }
+  }
+}
+
+TEST(ExtendedKalmanFilterTest, FirstCorrectInitializes) {
+  ExtendedKalmanFilter ekf;
+  ekf.Init();
+  EXPECT_FALSE(ekf.inited());
+  ekf.Predict(0.1);
+  const Eigen::Vector4d z(1., 2., 3., 0.5);
+  ekf.Correct(z);
+  EXPECT_TRUE(ekf.inited());
+  EXPECT_EQ(ekf.get_state(), z);
+}
+
+// the closed form of TrackMotionModel::Predict against F * P * F'
+TEST(TrackMotionModelTest, PredictIsJacobianProduct) {
+  std::mt19937 gen(9);
+  std::uniform_real_distribution<double> dt(0., 0.5);
+  std::uniform_real_distribution<double> cov(-0.5, 0.5);
+  for (int n = 0; n < 1000; ++n) {
+    Eigen::Vector4d x = RandomState(&gen);
+    Eigen::Matrix4d a;
+    for (int k = 0; k < 16; ++k) a(k) = cov(gen);
+    Eigen::Matrix4d p = a * a.transpose() + Eigen::Matrix4d::Identity();
+    const double delta_t = dt(gen);
+
+    Eigen::Matrix4d jacobian = Eigen::Matrix4d::Identity();
+    jacobian(0, 2) = delta_t * std::cos(x(3));
+    jacobian(0, 3) = -delta_t * x(2) * std::sin(x(3));
+    jacobian(1, 2) = delta_t * std::sin(x(3));
+    jacobian(1, 3) = delta_t * x(2) * std::cos(x(3));
+    const Eigen::Vector4d expected_x(
+        x(0) + x(2) * std::cos(x(3)) * delta_t,
+        x(1) + x(2) * std::sin(x(3)) * delta_t, x(2), x(3));
+    const Eigen::Matrix4d expected_p = jacobian * p * jacobian.transpose();
+
+    TrackMotionModel::Predict(delta_t, &x, &p);
+    EXPECT_LT((x - expected_x).cwiseAbs().maxCoeff(), 1e-12);
+    EXPECT_LT((p - expected_p).cwiseAbs().maxCoeff(), 1e-12);
+    EXPECT_EQ(p, p.transpose());
+  }
+}
+
+}  // namespace
+}  // namespace v2x
+}  // namespace coop
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <map>
+#include <random>
+
+#include "modules/message_cache/frame_ring.hpp"
+
+namespace coop {
+namespace v2x {
+namespace {
+
+typedef TimeIndexedRing<int> Ring;
+
+void ExpectSameAs(const Ring &ring, const std::map<OCLong, int> &reference) {
+  ASSERT_EQ(ring.size(), reference.size());
+  size_t i = 0;
+  for (const auto &kv : reference) {
+    EXPECT_EQ(ring.time(i), kv.first);
+    EXPECT_EQ(ring.value(i), kv.second);
+    i++;
+  }
+}
+
+TEST(TimeIndexedRingTest, InOrder) {
+  Ring ring(4);
+  EXPECT_EQ(ring.capacity(), 4u);
+  EXPECT_EQ(ring.Nearest(100), nullptr);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_TRUE(ring.Insert(100 + i * 50, i));
+  }
+  // the two oldest are dropped
+  EXPECT_EQ(ring.size(), 4u);
+  EXPECT_EQ(ring.front_time(), 200);
+  EXPECT_EQ(ring.back_time(), 350);
+  EXPECT_EQ(ring.Nearest(199), nullptr);
+  EXPECT_EQ(*ring.Nearest(200), 2);
+  EXPECT_EQ(*ring.Nearest(249), 2);
+  EXPECT_EQ(*ring.Nearest(1000), 5);
+}
+
+TEST(TimeIndexedRingTest, OutOfOrder) {
+  Ring ring(8);
+  ring.Insert(100, 1);
+  ring.Insert(300, 3);
+  ring.Insert(200, 2);
+  ring.Insert(50, 0);
+  std::map<OCLong, int> reference = {{50, 0}, {100, 1}, {200, 2}, {300, 3}};
+  ExpectSameAs(ring, reference);
+  EXPECT_EQ(*ring.Nearest(250), 2);
+
+  // the same timestamp replaces the frame
+  ring.Insert(200, 20);
+  EXPECT_EQ(ring.size(), 4u);
+  EXPECT_EQ(*ring.Nearest(200), 20);
+}
+
+TEST(TimeIndexedRingTest, LateFrameInFullRing) {
+  Ring ring(4);
+  for (int i = 0; i < 4; ++i) ring.Insert(100 * (i + 1), i);
+  // older than everything kept
+  EXPECT_FALSE(ring.Insert(50, -1));
+  // in between, the oldest is dropped
+  EXPECT_TRUE(ring.Insert(250, 9));
+  std::map<OCLong, int> reference = {{200, 1}, {250, 9}, {300, 2}, {400, 3}};
+  ExpectSameAs(ring, reference);
+}
+
+TEST(TimeIndexedRingTest, EvictBefore) {
+  Ring ring(8);
+  for (int i = 0; i < 8; ++i) ring.Insert(i * 10, i);
+  ring.EvictBefore(35);
+  EXPECT_EQ(ring.size(), 4u);
+  EXPECT_EQ(ring.front_time(), 40);
+  ring.EvictBefore(1000);
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.Nearest(1000), nullptr);
+}
+
+// a 20 Hz sensor with jitter and reordering, against a map that keeps the
+// same window as Cacher did before
+TEST(TimeIndexedRingTest, MatchesMapWindow) {
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> jitter(-120, 120);
+  std::uniform_int_distribution<int> probe(-200, 200);
+  const OCLong window = 1500;
+  Ring ring(64);
+  std::map<OCLong, int> reference;
+  for (int n = 0; n < 5000; ++n) {
+    const OCLong t = 1000000 + n * 50 + jitter(gen);
+    ring.Insert(t, n);
+    reference[t] = n;
+    ring.EvictBefore(ring.back_time() - window);
+    reference.erase(reference.begin(),
+                    reference.lower_bound(reference.rbegin()->first - window));
+    ASSERT_NO_FATAL_FAILURE(ExpectSameAs(ring, reference));
+
+    const OCLong q = t + probe(gen);
+    auto it = reference.upper_bound(q);
+    const int *nearest = ring.Nearest(q);
+    if (it == reference.begin()) {
+      EXPECT_EQ(nearest, nullptr);
+    } else {
+      ASSERT_NE(nearest, nullptr);
+      EXPECT_EQ(*nearest, std::prev(it)->second);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace v2x
+}  // namespace coop
@@ -0,0 +1,362 @@
+#include "fusion-shards.h"
+#include "interface/fuser.h"
+#include "proto/fusion_service_pkg.pb.h"
+#include "proto/junction_fusion_package.pb.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace zas {
+namespace fusion_service {
+
+using namespace coop::v2x;
+using namespace jos;
+
+void latency_histogram::add(uint64_t us)
+{
+	// bucket = 4 * log2(us) + the 2 bits below the msb
+	size_t idx = us;
+	if (us >= sub_buckets) {
+		int msb = 63 - __builtin_clzll(us);
+		idx = (msb - 1) * sub_buckets + ((us >> (msb - 2)) & (sub_buckets - 1))
+			+ sub_buckets;
+	}
+	if (idx >= buckets) idx = buckets - 1;
+	_buckets[idx].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t prev = _max_us.load(std::memory_order_relaxed);
+	while (us > prev && !_max_us.compare_exchange_weak(prev, us,
+		std::memory_order_relaxed)) {}
+}
+
+uint64_t latency_histogram::percentile_us(double p) const
+{
+	uint64_t total = _count.load(std::memory_order_relaxed);
+	if (!total) return 0;
+	uint64_t target = (uint64_t)(p * total), sum = 0;
+	for (size_t idx = 0; idx < buckets; ++idx) {
+		sum += _buckets[idx].load(std::memory_order_relaxed);
+		if (sum <= target) continue;
+		if (idx < sub_buckets) return idx;
+		// upper bound of the bucket
+		size_t msb = (idx - sub_buckets) / sub_buckets + 1;
+		size_t sub = (idx - sub_buckets) % sub_buckets;
+		return std::min((uint64_t)(((sub_buckets + sub + 1) << (msb - 2)) - 1),
+			_max_us.load(std::memory_order_relaxed));
+	}
+	return _max_us.load(std::memory_order_relaxed);
+}
+
+struct fusion_shards::junction
+{
+	junction(const std::string& id, shard* s, size_t queue_size)
+	: junc_id(id), owner(s), queue(queue_size), posted(0)
+	, done(0), delivered(0) {}
+
+	std::string junc_id;
+	shard* owner;
+	// only accessed by the worker of the shard
+	spFuser fuser;
+	// producers of a junction are serialized by pmut,
+	// the worker of the shard is the only consumer
+	std::mutex pmut;
+	spsc_queue<frame*> queue;
+	uint64_t posted;
+
+	// the latest result
+	std::mutex rmut;
+	std::condition_variable rcond;
+	uint64_t done;
+	// the seq of the result last returned by take_result()
+	uint64_t delivered;
+	std::string result;
+};
+
+struct fusion_shards::shard
+{
+	shard(int i)
+	: id(i), queued(0), sleeping(false), stop(false), changed(false)
+	, frames(0), fused(0), dropped(0), skipped(0), max_depth(0) {}
+
+	int id;
+	std::thread thread;
+	std::mutex mut;
+	std::condition_variable cond;
+	// frames pending in all junctions of the shard
+	std::atomic<size_t> queued;
+	std::atomic<bool> sleeping;
+	bool stop;
+	// junctions added to the shard, the worker keeps a copy
+	std::vector<junction*> junctions;
+	bool changed;
+
+	std::atomic<uint64_t> frames;
+	std::atomic<uint64_t> fused;
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint64_t> skipped;
+	std::atomic<size_t> max_depth;
+	latency_histogram latency;
+};
+
+fusion_shards::fusion_shards(const fusion_shards_config& cfg)
+: _cfg(cfg)
+{
+	if (_cfg.workers < 1) _cfg.workers = 1;
+	if (_cfg.queue_size < 2) _cfg.queue_size = 2;
+	if (_cfg.max_lag < 1) _cfg.max_lag = 1;
+	for (int i = 0; i < _cfg.workers; ++i) {
+		auto* s = new shard(i);
+		s->thread = std::thread(&fusion_shards::run, this, s);
+		_shards.push_back(s);
+	}
+}
+
+fusion_shards::~fusion_shards()
+{
+	shutdown();
+	for (auto& jun : _junctions) {
+		frame* f;
+		while (jun.second->queue.pop(f)) delete f;
+		delete jun.second;
+	}
+	_junctions.clear();
+}
+
+void fusion_shards::shutdown(void)
+{
+	std::lock_guard<std::mutex> lk(_mut);
+	for (auto* s : _shards) {
+		std::lock_guard<std::mutex> slk(s->mut);
+		s->stop = true;
+		s->cond.notify_one();
+	}
+	for (auto* s : _shards) {
+		if (s->thread.joinable()) s->thread.join();
+		delete s;
+	}
+	_shards.clear();
+}
+
+uint64_t fusion_shards::now_us(void)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+fusion_shards::junction* fusion_shards::get_junction(const std::string& junc_id)
+{
+	std::lock_guard<std::mutex> lk(_mut);
+	if (_shards.empty()) {
+		return nullptr;
+	}
+	auto it = _junctions.find(junc_id);
+	if (it != _junctions.end()) {
+		return it->second;
+	}
+
+	// pin the junction to the shard with the fewest junctions
+	shard* target = _shards[0];
+	for (auto* s : _shards) {
+		std::lock_guard<std::mutex> slk(s->mut);
+		if (s->junctions.size() < target->junctions.size()) target = s;
+	}
+	auto* j = new junction(junc_id, target, _cfg.queue_size);
+	{
+		std::lock_guard<std::mutex> slk(target->mut);
+		target->junctions.push_back(j);
+		target->changed = true;
+	}
+	_junctions[junc_id] = j;
+	return j;
+}
+
+int fusion_shards::post(const std::string& junc_id, const void* data,
+	size_t sz, uint64_t* seq)
+{
+	if (junc_id.empty() || !data) {
+		return -EBADPARM;
+	}
+	auto* j = get_junction(junc_id);
+	if (!j) {
+		return -ENOTAVAIL;
+	}
+	shard* s = j->owner;
+	auto* f = new frame();
+	f->enqueue_us = now_us();
+	f->data.assign((const char*)data, sz);
+	// the worker may pop and delete the frame as soon as it is
+	// pushed, and counts it off "queued" then
+	uint64_t fseq;
+	size_t depth;
+	{
+		std::lock_guard<std::mutex> lk(j->pmut);
+		fseq = f->seq = j->posted + 1;
+		depth = s->queued.fetch_add(1) + 1;
+		if (!j->queue.push(f)) {
+			s->queued.fetch_sub(1);
+			s->dropped.fetch_add(1, std::memory_order_relaxed);
+			delete f;
+			return -ETOOMANYITEMS;
+		}
+		++j->posted;
+	}
+	if (seq) *seq = fseq;
+	s->frames.fetch_add(1, std::memory_order_relaxed);
+
+	size_t prev = s->max_depth.load(std::memory_order_relaxed);
+	while (depth > prev && !s->max_depth.compare_exchange_weak(prev, depth)) {}
+
+	// the worker sets "sleeping" before it checks "queued"
+	if (s->sleeping.load()) {
+		std::lock_guard<std::mutex> lk(s->mut);
+		s->cond.notify_one();
+	}
+	return 0;
+}
+
+int fusion_shards::get_result(const std::string& junc_id, uint64_t seq,
+	uint32_t wait_ms, std::string& result)
+{
+	junction* j = nullptr;
+	{
+		std::lock_guard<std::mutex> lk(_mut);
+		auto it = _junctions.find(junc_id);
+		if (it == _junctions.end()) {
+			result.clear();
+			return -ENOTFOUND;
+		}
+		j = it->second;
+	}
+	std::unique_lock<std::mutex> lk(j->rmut);
+	if (wait_ms && j->done < seq) {
+		j->rcond.wait_for(lk, std::chrono::milliseconds(wait_ms),
+			[&] { return j->done >= seq; });
+	}
+	result = j->result;
+	return (j->done >= seq) ? 0 : -ETIMEOUT;
+}
+
+int fusion_shards::take_result(const std::string& junc_id,
+	std::string& result)
+{
+	result.clear();
+	junction* j = nullptr;
+	{
+		std::lock_guard<std::mutex> lk(_mut);
+		auto it = _junctions.find(junc_id);
+		if (it == _junctions.end()) {
+			return -ENOTAVAIL;
+		}
+		j = it->second;
+	}
+	std::lock_guard<std::mutex> lk(j->rmut);
+	if (j->done <= j->delivered) {
+		return -ENOTAVAIL;
+	}
+	result = j->result;
+	j->delivered = j->done;
+	return 0;
+}
+
+bool fusion_shards::process_junction(shard* s, junction* j)
+{
+	size_t depth = j->queue.size();
+	if (!depth) {
+		return false;
+	}
+
+	// the shard is behind: drop the stale frames
+	frame* f = nullptr;
+	for (; depth > _cfg.max_lag; --depth) {
+		if (!j->queue.pop(f)) break;
+		s->queued.fetch_sub(1);
+		s->skipped.fetch_add(1, std::memory_order_relaxed);
+		delete f;
+	}
+	if (!j->queue.pop(f)) {
+		return false;
+	}
+	s->queued.fetch_sub(1);
+
+	// the fuser is created on the worker thread so that
+	// the socket thread is never blocked by it
+	if (!j->fuser) {
+		j->fuser = std::make_shared<Fuser>();
+	}
+	junction_fusion_package junpkg;
+	junpkg.ParseFromArray(f->data.c_str(), f->data.length());
+	fusion_service_pkg fpkg;
+	j->fuser->fuse_frame(junpkg, fpkg);
+	fpkg.mutable_fus_pkg()->set_junc_id(j->junc_id);
+
+	std::string out;
+	fpkg.SerializeToString(&out);
+	{
+		std::lock_guard<std::mutex> lk(j->rmut);
+		j->result.swap(out);
+		j->done = f->seq;
+	}
+	j->rcond.notify_all();
+
+	s->latency.add(now_us() - f->enqueue_us);
+	s->fused.fetch_add(1, std::memory_order_relaxed);
+	delete f;
+	return true;
+}
+
+void fusion_shards::run(shard* s)
+{
+	std::vector<junction*> junctions;
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> lk(s->mut);
+			if (s->stop) break;
+			if (s->changed) {
+				junctions = s->junctions;
+				s->changed = false;
+			}
+		}
+
+		// one frame per junction and round, so that a busy
+		// junction can not starve the others of the shard
+		bool worked = false;
+		for (auto* j : junctions) {
+			worked |= process_junction(s, j);
+		}
+		if (worked) continue;
+
+		std::unique_lock<std::mutex> lk(s->mut);
+		s->sleeping.store(true);
+		s->cond.wait(lk, [s] {
+			return s->stop || s->changed || s->queued.load() > 0;
+		});
+		s->sleeping.store(false);
+	}
+}
+
+void fusion_shards::get_stats(std::vector<fusion_shard_stats>& stats)
+{
+	stats.clear();
+	std::lock_guard<std::mutex> lk(_mut);
+	for (auto* s : _shards) {
+		fusion_shard_stats st;
+		st.shard = s->id;
+		{
+			std::lock_guard<std::mutex> slk(s->mut);
+			st.junctions = s->junctions.size();
+		}
+		st.frames = s->frames.load();
+		st.fused = s->fused.load();
+		st.dropped = s->dropped.load();
+		st.skipped = s->skipped.load();
+		st.queue_depth = s->queued.load();
+		st.max_queue_depth = s->max_depth.load();
+		st.latency_p50_us = s->latency.percentile_us(.5);
+		st.latency_p99_us = s->latency.percentile_us(.99);
+		st.latency_max_us = s->latency.max_us();
+		stats.push_back(st);
+	}
+}
+
+}}	//zas::fusion_service
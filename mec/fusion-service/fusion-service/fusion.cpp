@@ -21,19 +21,105 @@ using namespace zas::mapcore;
 using namespace coop::v2x;
 using namespace jos;
 
+#define FUSION_STATS_INTERVAL_US	(10 * 1000000ULL)
+
+static uint64_t gettick_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, nullptr);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 device_fusion::device_fusion()
+: _shards(nullptr)
+, _last_stats_us(0)
 {
+	fusion_shards_config cfg;
+	if (!load_config(cfg)) {
+		_shards = new fusion_shards(cfg);
+	}
 }
 
 device_fusion::~device_fusion()
 {
+	if (_shards) {
+		delete _shards;
+		_shards = nullptr;
+	}
+}
 
+int device_fusion::load_config(fusion_shards_config& cfg)
+{
+	int iret = 0;
+	cfg.workers = get_sysconfig("fusion-service.shards.workers",
+		(ssize_t)cfg.workers, &iret);
+	if (cfg.workers <= 0) {
+		log.i(FUSION_SNAPSHOT_TAG, "fusion on the socket thread\n");
+		return -ENOTAVAIL;
+	}
+	cfg.queue_size = get_sysconfig("fusion-service.shards.queue-size",
+		(ssize_t)cfg.queue_size, &iret);
+	cfg.max_lag = get_sysconfig("fusion-service.shards.max-lag",
+		(ssize_t)cfg.max_lag, &iret);
+	log.i(FUSION_SNAPSHOT_TAG, "fusion on %d workers, queue %lu, "
+		"max lag %lu\n", cfg.workers, cfg.queue_size, cfg.max_lag);
+	return 0;
+}
+
+void device_fusion::log_stats(void)
+{
+	uint64_t now = gettick_us();
+	if (now - _last_stats_us < FUSION_STATS_INTERVAL_US) {
+		return;
+	}
+	_last_stats_us = now;
+
+	std::vector<fusion_shard_stats> stats;
+	_shards->get_stats(stats);
+	for (auto& st : stats) {
+		log.i(FUSION_SNAPSHOT_TAG, "shard %d: %lu junctions, "
+			"frames %lu, fused %lu, dropped %lu, skipped %lu, "
+			"queue %lu (max %lu), latency p50 %lu us, p99 %lu us, "
+			"max %lu us\n", st.shard, st.junctions, st.frames,
+			st.fused, st.dropped, st.skipped, st.queue_depth,
+			st.max_queue_depth, st.latency_p50_us, st.latency_p99_us,
+			st.latency_max_us);
+	}
 }
 
 int device_fusion::on_recv(wa_response *wa_rep, std::string &vid,
 	void* data, size_t sz)
 {
 	assert(nullptr != data);
+	if (!_shards) {
+		return fuse_inline(wa_rep, vid, data, sz);
+	}
+
+	// the reply has to be sent from the socket thread, which
+	// serves all the junctions: reply with the result fused
+	// since the last reply (usually a frame behind) without
+	// waiting. Each result is sent once, when nothing new is
+	// fused the reply only holds the junc_id and a zero
+	// timestamp, which the snapshot service skips
+	int ret = _shards->post(vid, data, sz);
+	if (ret && ret != -ETOOMANYITEMS) {
+		log.e(FUSION_SNAPSHOT_TAG, "fail to post the frame of %s: %d\n",
+			vid.c_str(), ret);
+	}
+	std::string senddata;
+	if (_shards->take_result(vid, senddata)) {
+		fusion_service_pkg fpkg;
+		fpkg.mutable_fus_pkg()->set_junc_id(vid);
+		fpkg.SerializeToString(&senddata);
+	}
+	wa_rep->response((void*)senddata.c_str(), senddata.length());
+	log_stats();
+	return 0;
+}
+
+int device_fusion::fuse_inline(wa_response *wa_rep, std::string &vid,
+	void* data, size_t sz)
+{
 	junction_fusion_package junpkg;
 	junpkg.ParseFromArray(data, sz);
 	fusion_service_pkg fpkg;
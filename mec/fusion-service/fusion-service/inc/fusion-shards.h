@@ -0,0 +1,147 @@
+#ifndef __CXX_FUSION_SERVICE_FUSION_SHARDS_H__
+#define __CXX_FUSION_SERVICE_FUSION_SHARDS_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "fusion-service-def.h"
+#include "spsc-queue.h"
+
+namespace zas {
+namespace fusion_service {
+
+struct fusion_shards_config
+{
+	fusion_shards_config()
+	: workers(4), queue_size(16), max_lag(4) {}
+
+	// number of worker threads, each junction is pinned
+	// to one of them
+	int workers;
+	// frames queued per junction, new frames are
+	// dropped when the queue is full
+	size_t queue_size;
+	// when more than max_lag frames of a junction are pending
+	// the worker skips the older ones and fuses the newest
+	size_t max_lag;
+};
+
+// latency histogram: 4 linear sub-buckets per power of 2
+// of microseconds, about 20% resolution
+class latency_histogram
+{
+public:
+	latency_histogram() {
+		for (auto& b : _buckets) b = 0;
+		_count = 0, _max_us = 0;
+	}
+
+	void add(uint64_t us);
+	uint64_t count(void) const { return _count; }
+	uint64_t max_us(void) const { return _max_us; }
+	// the upper bound of the bucket holding the percentile
+	uint64_t percentile_us(double p) const;
+
+private:
+	enum { sub_buckets = 4, buckets = 64 * sub_buckets };
+	std::atomic<uint64_t> _buckets[buckets];
+	std::atomic<uint64_t> _count;
+	std::atomic<uint64_t> _max_us;
+};
+
+struct fusion_shard_stats
+{
+	int shard;
+	size_t junctions;
+	// frames accepted, fused, dropped (queue full)
+	// and skipped (shard behind)
+	uint64_t frames;
+	uint64_t fused;
+	uint64_t dropped;
+	uint64_t skipped;
+	// pending frames of all junctions of the shard
+	size_t queue_depth;
+	size_t max_queue_depth;
+	// from post() to the result being available
+	uint64_t latency_p50_us;
+	uint64_t latency_p99_us;
+	uint64_t latency_max_us;
+};
+
+// runs the Fuser of every junction on a fixed pool of
+// worker threads, a busy junction only delays the other
+// junctions of its own shard
+class fusion_shards
+{
+public:
+	fusion_shards(const fusion_shards_config& cfg);
+	~fusion_shards();
+
+	/**
+	 * queue a junction_fusion_package of a junction
+	 * @param junc_id the junction id
+	 * @param data, sz the serialized package
+	 * @param seq the sequence number of the frame in the junction
+	 * @return 0 for success, -ETOOMANYITEMS if the frame is dropped
+	 */
+	int post(const std::string& junc_id, const void* data, size_t sz,
+		uint64_t* seq = nullptr);
+
+	/**
+	 * get the latest fusion_service_pkg of a junction
+	 * @param junc_id the junction id
+	 * @param seq wait for the result of this frame (or a newer one)
+	 * @param wait_ms max wait time, 0 returns immediately
+	 * @param result the serialized fusion_service_pkg, empty if
+	 * 		no frame of the junction is fused yet
+	 * @return 0 if the result of frame "seq" is available,
+	 * 		-ETIMEOUT if an older result is returned
+	 */
+	int get_result(const std::string& junc_id, uint64_t seq,
+		uint32_t wait_ms, std::string& result);
+
+	/**
+	 * take the latest fusion_service_pkg of a junction once: a
+	 * result is only returned by the first call after it is fused
+	 * @param junc_id the junction id
+	 * @param result the serialized fusion_service_pkg, empty if
+	 * 		nothing new is fused since the last call
+	 * @return 0 for a new result, -ENOTAVAIL if there is none
+	 */
+	int take_result(const std::string& junc_id, std::string& result);
+
+	void get_stats(std::vector<fusion_shard_stats>& stats);
+	void shutdown(void);
+
+private:
+	struct frame
+	{
+		uint64_t seq;
+		uint64_t enqueue_us;
+		std::string data;
+	};
+
+	struct junction;
+	struct shard;
+
+	junction* get_junction(const std::string& junc_id);
+	void run(shard* s);
+	bool process_junction(shard* s, junction* j);
+	static uint64_t now_us(void);
+
+private:
+	fusion_shards_config _cfg;
+	std::vector<shard*> _shards;
+	std::mutex _mut;
+	std::map<std::string, junction*> _junctions;
+};
+
+}}	//zas::fusion_service
+
+#endif /* __CXX_FUSION_SERVICE_FUSION_SHARDS_H__*/
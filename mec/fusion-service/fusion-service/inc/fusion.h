@@ -3,6 +3,7 @@
 
 #include <string>
 #include "fusion-service-def.h"
+#include "fusion-shards.h"
 #include "interface/fuser.h"
 #include "map"
 #include "std/list.h"
@@ -33,8 +34,18 @@ class device_fusion {
   int on_recv(zas::webcore::wa_response *wa_rep, std::string &vincode,
               void *data, size_t sz);
 
+ private:
+  int load_config(fusion_shards_config &cfg);
+  int fuse_inline(zas::webcore::wa_response *wa_rep, std::string &vid,
+                  void *data, size_t sz);
+  void log_stats(void);
+
  private:
   std::map<std::string, spFuser> _fusers;
+  // null if "fusion-service.shards.workers" is 0, the
+  // junctions are fused on the socket thread then
+  fusion_shards *_shards;
+  uint64_t _last_stats_us;
 };
 
 }  // namespace fusion_service
@@ -0,0 +1,74 @@
+#ifndef __CXX_FUSION_SERVICE_SPSC_QUEUE_H__
+#define __CXX_FUSION_SERVICE_SPSC_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+namespace zas {
+namespace fusion_service {
+
+// bounded lock-free queue for exactly one producer thread
+// and one consumer thread
+template <typename T>
+class spsc_queue
+{
+public:
+	// the capacity is rounded up to a power of 2
+	explicit spsc_queue(size_t capacity)
+	: _head(0), _tail(0)
+	{
+		size_t sz = 2;
+		while (sz < capacity) sz <<= 1;
+		_items.resize(sz);
+		_mask = sz - 1;
+	}
+
+	size_t capacity(void) const {
+		return _mask + 1;
+	}
+
+	// producer side, returns false if the queue is full
+	bool push(const T& item)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) > _mask) {
+			return false;
+		}
+		_items[tail & _mask] = item;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false if the queue is empty
+	bool pop(T& item)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = _items[head & _mask];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// may be called from both sides, the value
+	// is only a snapshot
+	size_t size(void) const {
+		size_t head = _head.load(std::memory_order_acquire);
+		return _tail.load(std::memory_order_acquire) - head;
+	}
+
+private:
+	std::vector<T> _items;
+	size_t _mask;
+	// head and tail are kept 64 bytes apart so that they never
+	// share a cache line (alignas is not honored by "new" in c++11)
+	std::atomic<size_t> _head;
+	char _padding[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> _tail;
+};
+
+}}	//zas::fusion_service
+
+#endif /* __CXX_FUSION_SERVICE_SPSC_QUEUE_H__*/
@@ -0,0 +1,201 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Replays synthetic radar frames of many junctions through fusion_shards the
+// way the fusion service does: one producer thread stands for the socket
+// thread, posts the frame of every junction in turn and replies with the
+// result fused since its last reply, or with "no new result", without
+// waiting. Reports the intake rate and
+// reply latency of the producer and the per shard statistics.
+//
+// fusion_load_test [junctions] [workers] [frames] [rate_hz]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fusion-shards.h"
+#include "proto/junction_fusion_package.pb.h"
+
+using namespace zas::fusion_service;
+
+namespace {
+
+const double kOriginLat = 31.284156453;
+const double kOriginLon = 121.170937985;
+const int kRadarsPerJunction = 2;
+const int kTargetsPerRadar = 20;
+
+uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// targets drive through the junction on straight lines, each radar sees all
+// of them with a little noise
+void make_frame(int junction, int frame, uint64_t timestamp_ms,
+                std::string *data) {
+  jos::junction_fusion_package pkg;
+  pkg.set_fusion_endtime(timestamp_ms);
+  const double jlat = kOriginLat + (junction / 8) * 0.005;
+  const double jlon = kOriginLon + (junction % 8) * 0.005;
+  const double m2lat = 1. / 111000., m2lon = m2lat / cos(jlat * M_PI / 180.);
+
+  for (int r = 0; r < kRadarsPerJunction; r++) {
+    auto *radar = pkg.mutable_jun_pkg()->add_radar_info();
+    radar->set_type(jos::radar_vision_type_radar);
+    radar->set_id(junction * kRadarsPerJunction + r + 1);
+    // the radars of a junction are a few ms apart
+    radar->set_timestamp(timestamp_ms + r * 5);
+    radar->set_lat(jlat);
+    radar->set_lon(jlon);
+    radar->set_rdir(r * 180.f);
+    auto *timeinfo = radar->mutable_timeinfo();
+    timeinfo->set_timestamp_sec(timestamp_ms / 1000);
+    timeinfo->set_timestamp_usec((timestamp_ms % 1000) * 1000);
+    timeinfo->set_collection_timestamp_sec(timestamp_ms / 1000);
+    timeinfo->set_collection_timestamp_usec((timestamp_ms % 1000) * 1000);
+    timeinfo->set_erecv_timestamp_sec(timestamp_ms / 1000);
+    timeinfo->set_erecv_timestamp_usec((timestamp_ms % 1000) * 1000);
+
+    for (int t = 0; t < kTargetsPerRadar; t++) {
+      // 10 m/s, 4 lanes 3.5 m apart, heading north or east
+      const bool north = (t % 2) == 0;
+      const double along = -100. + fmod(t * 13. + frame * 1.0, 200.);
+      const double across = ((t / 2) % 4 - 1.5) * 3.5;
+      const double noise = ((t * 7 + frame * 3 + r * 5) % 11 - 5) * 0.02;
+      auto *target = radar->add_targets();
+      target->set_id(t + 1);
+      target->set_type(jos::radar_target_type_car);
+      target->set_lat(jlat + (north ? along : across + noise) * m2lat);
+      target->set_lon(jlon + (north ? across + noise : along) * m2lon);
+      target->set_heading(north ? 0.f : 90.f);
+      target->set_length(4.8f);
+      target->set_width(1.9f);
+      target->set_height(1.5f);
+      target->set_speed(36.f);
+      target->set_origin_time(timestamp_ms);
+    }
+  }
+  pkg.SerializeToString(data);
+}
+
+struct producer_stats {
+  producer_stats() : posted(0), dropped(0), fresh(0), older(0), none(0) {}
+  uint64_t posted;
+  uint64_t dropped;
+  // replied with the result of the frame itself, with a result of an older
+  // frame not replied yet, or with "no new result"
+  uint64_t fresh;
+  uint64_t older;
+  uint64_t none;
+};
+
+void run_producer(fusion_shards *shards, int junctions, int frames,
+                  int rate_hz, latency_histogram *latency,
+                  producer_stats *stats) {
+  std::vector<std::string> junc_ids;
+  for (int j = 0; j < junctions; j++) {
+    junc_ids.push_back("junction-" + std::to_string(j));
+  }
+  const uint64_t period_us = rate_hz > 0 ? 1000000 / rate_hz : 0;
+  const uint64_t start_us = now_us();
+  std::string data, result;
+
+  for (int f = 0; f < frames; f++) {
+    if (period_us) {
+      const uint64_t due = start_us + f * period_us;
+      const uint64_t now = now_us();
+      if (due > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+      }
+    }
+    for (int j = 0; j < junctions; j++) {
+      make_frame(j, f, 1600000000000ULL + f * 100ULL, &data);
+      // device_fusion::on_recv
+      const uint64_t t0 = now_us();
+      uint64_t seq = 0;
+      stats->posted++;
+      const bool dropped =
+          shards->post(junc_ids[j], data.c_str(), data.length(), &seq) != 0;
+      if (dropped) {
+        stats->dropped++;
+      }
+      const bool taken = shards->take_result(junc_ids[j], result) == 0;
+      latency->add(now_us() - t0);
+      if (!taken) {
+        stats->none++;
+      } else if (dropped || shards->get_result(junc_ids[j], seq, 0, data)) {
+        stats->older++;
+      } else {
+        stats->fresh++;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int junctions = argc > 1 ? atoi(argv[1]) : 48;
+  fusion_shards_config cfg;
+  cfg.workers = argc > 2 ? atoi(argv[2]) : 4;
+  const int frames = argc > 3 ? atoi(argv[3]) : 200;
+  const int rate_hz = argc > 4 ? atoi(argv[4]) : 10;
+
+  printf("%d junctions, %d workers, %d frames at %d Hz, one producer\n",
+         junctions, cfg.workers, frames, rate_hz);
+
+  fusion_shards shards(cfg);
+  latency_histogram latency;
+  producer_stats total;
+
+  const uint64_t t0 = now_us();
+  std::thread producer(run_producer, &shards, junctions, frames, rate_hz,
+                       &latency, &total);
+  producer.join();
+  const double elapsed_s = (now_us() - t0) / 1e6;
+
+  printf(
+      "%lu frames in %.2f s (%.0f frames/s), %lu dropped, %lu fresh "
+      "replies, %lu older results, %lu \"no new result\" replies\n",
+      total.posted, elapsed_s, total.posted / elapsed_s, total.dropped,
+      total.fresh, total.older, total.none);
+  printf("reply latency: p50 %lu us, p90 %lu us, p99 %lu us, max %lu us\n",
+         latency.percentile_us(.5), latency.percentile_us(.9),
+         latency.percentile_us(.99), latency.max_us());
+
+  std::vector<fusion_shard_stats> shard_stats;
+  shards.get_stats(shard_stats);
+  for (auto &st : shard_stats) {
+    printf(
+        "shard %d: %lu junctions, frames %lu, fused %lu, dropped %lu, "
+        "skipped %lu, max queue %lu, latency p50 %lu us, p99 %lu us, "
+        "max %lu us\n",
+        st.shard, st.junctions, st.frames, st.fused, st.dropped, st.skipped,
+        st.max_queue_depth, st.latency_p50_us, st.latency_p99_us,
+        st.latency_max_us);
+  }
+  shards.shutdown();
+  return 0;
+}
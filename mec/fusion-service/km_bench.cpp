@@ -0,0 +1,231 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Compares KMkernal with the previous new/delete and std::set based
+// implementation on dense and on gated association matrices.
+//
+// km_bench [size] [rounds]
+
+#include <string.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "modules/fusion/km.h"
+
+namespace {
+
+// the previous implementation of KMkernal
+class LegacyKMkernal {
+ public:
+  LegacyKMkernal() = default;
+  ~LegacyKMkernal() = default;
+  template <typename T>
+  bool GetKMResult(const T &association_mat,
+                   std::vector<std::pair<int, int>> *match_cps,
+                   bool need_reverse = false);
+
+ private:
+  int u_size_;
+  int v_size_;
+  double *ex_u_;
+  double *ex_v_;
+  int *v_matched_;
+  double *v_slack_;
+  std::set<int> used_u_;
+  std::set<int> used_v_;
+  template <typename T>
+  bool FindCP(const T &mat, int i);
+};
+template <typename T>
+bool LegacyKMkernal::GetKMResult(const T &association_mat,
+                                 std::vector<std::pair<int, int>> *match_cps,
+                                 bool need_reverse) {
+  match_cps->clear();
+  u_size_ = association_mat.rows();
+  v_size_ = association_mat.cols();
+  if (u_size_ > v_size_) return false;
+  ex_u_ = new double[u_size_];
+  ex_v_ = new double[v_size_];
+  v_matched_ = new int[v_size_];
+  std::fill(v_matched_, v_matched_ + v_size_, -1);
+  memset(ex_v_, 0, v_size_ * sizeof(double));
+  for (int i = 0; i < u_size_; ++i) {
+    ex_u_[i] = association_mat(i, 0);
+    for (int j = 1; j < v_size_; ++j) {
+      ex_u_[i] = std::max(static_cast<float>(ex_u_[i]), association_mat(i, j));
+    }
+  }
+  for (int i = 0; i < u_size_; ++i) {
+    if (ex_u_[i] <= 0) {
+      if (need_reverse)
+        match_cps->push_back(std::make_pair(-1, i));
+      else
+        match_cps->push_back(std::make_pair(i, -1));
+      continue;
+    }
+    v_slack_ = new double[v_size_];
+    std::fill(v_slack_, v_slack_ + v_size_, 999999999999);
+    while (1) {
+      used_u_.clear();
+      used_v_.clear();
+      if (FindCP(association_mat, i)) break;
+      double d = 999999999999;
+      for (int j = 0; j < v_size_; ++j)
+        if (used_v_.find(j) == used_v_.end()) d = std::min(d, v_slack_[j]);
+      for (auto it = used_u_.begin(); it != used_u_.end(); it++) {
+        ex_u_[*it] -= d;
+      }
+      for (int j = 0; j < v_size_; ++j) {
+        if (used_v_.find(j) != used_v_.end())
+          ex_v_[j] += d;
+        else
+          v_slack_[j] -= d;
+      }
+    }
+    delete[] v_slack_;
+  }
+  if (need_reverse) {
+    for (int j = 0; j < v_size_; ++j) {
+      if (v_matched_[j] == -1) {
+        match_cps->push_back(std::make_pair(j, -1));
+      } else if (association_mat(v_matched_[j], j) > 0) {
+        match_cps->push_back(std::make_pair(j, v_matched_[j]));
+      } else {
+        match_cps->push_back(std::make_pair(-1, v_matched_[j]));
+        match_cps->push_back(std::make_pair(j, -1));
+      }
+    }
+  } else {
+    for (int j = 0; j < v_size_; ++j) {
+      if (v_matched_[j] == -1) {
+        match_cps->push_back(std::make_pair(-1, j));
+      } else if (association_mat(v_matched_[j], j) > 0) {
+        match_cps->push_back(std::make_pair(v_matched_[j], j));
+      } else {
+        match_cps->push_back(std::make_pair(v_matched_[j], -1));
+        match_cps->push_back(std::make_pair(-1, j));
+      }
+    }
+  }
+  delete[] ex_u_;
+  delete[] ex_v_;
+  delete[] v_matched_;
+  return true;
+}
+
+template <typename T>
+bool LegacyKMkernal::FindCP(const T &mat, int i) {
+  used_u_.insert(i);
+  for (int j = 0; j < v_size_; ++j) {
+    if (used_v_.find(j) != used_v_.end()) {
+      continue;
+    }
+    double gap = ex_u_[i] + ex_v_[j] - mat(i, j);
+    if (gap <= 0) {
+      // res = 0;
+      used_v_.insert(j);
+      bool match_success = v_matched_[j] == -1 || FindCP(mat, v_matched_[j]);
+      if (match_success) {
+        v_matched_[j] = i;
+        return true;
+      }
+    } else {
+      v_slack_[j] = std::min(v_slack_[j], gap);
+    }
+  }
+  return false;
+}
+
+
+Eigen::MatrixXf RandomMatrix(int rows, int cols, double gated,
+                             std::mt19937 *gen) {
+  std::uniform_real_distribution<float> score(0.f, 1.f);
+  std::uniform_real_distribution<double> gate(0., 1.);
+  Eigen::MatrixXf mat(rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      mat(i, j) = gate(*gen) < gated ? 0.f : score(*gen);
+    }
+  }
+  return mat;
+}
+
+double MatchedSum(const Eigen::MatrixXf &mat,
+                  const std::vector<std::pair<int, int>> &match_cps) {
+  double sum = 0;
+  for (const auto &cp : match_cps) {
+    if (cp.first != -1 && cp.second != -1) sum += mat(cp.first, cp.second);
+  }
+  return sum;
+}
+
+template <typename F>
+double TimeUs(const std::vector<Eigen::MatrixXf> &mats,
+              std::vector<double> *sums, F solve) {
+  std::vector<std::pair<int, int>> match_cps;
+  sums->clear();
+  const auto t0 = std::chrono::steady_clock::now();
+  for (const auto &mat : mats) {
+    solve(mat, &match_cps);
+    sums->push_back(MatchedSum(mat, match_cps));
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() /
+         mats.size();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int size = argc > 1 ? atoi(argv[1]) : 200;
+  const int rounds = argc > 2 ? atoi(argv[2]) : 20;
+  std::mt19937 gen(1);
+  int mismatches = 0;
+
+  // dense scores, and the association case where a fused object only
+  // passes the distance gate of a few new objects
+  for (double gated : {0., 0.97}) {
+    std::vector<Eigen::MatrixXf> mats;
+    for (int i = 0; i < rounds; ++i) {
+      mats.push_back(RandomMatrix(size, size, gated, &gen));
+    }
+    LegacyKMkernal legacy;
+    coop::v2x::KMkernal km;
+    std::vector<double> legacy_sums, km_sums;
+    const double legacy_us =
+        TimeUs(mats, &legacy_sums, [&](const Eigen::MatrixXf &mat,
+                                       std::vector<std::pair<int, int>> *cps) {
+          legacy.GetKMResult(mat, cps);
+        });
+    const double km_us =
+        TimeUs(mats, &km_sums, [&](const Eigen::MatrixXf &mat,
+                                   std::vector<std::pair<int, int>> *cps) {
+          km.GetKMResult(mat, cps);
+        });
+    for (int i = 0; i < rounds; ++i) {
+      if (std::abs(legacy_sums[i] - km_sums[i]) > 1e-3) mismatches++;
+    }
+    printf("%dx%d, %2.0f%% gated: legacy %10.1f us, KMkernal %8.1f us, "
+           "%.1fx\n",
+           size, size, gated * 100, legacy_us, km_us, legacy_us / km_us);
+  }
+  printf("score mismatches: %d\n", mismatches);
+  return mismatches ? 1 : 0;
+}
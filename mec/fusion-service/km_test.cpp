@@ -0,0 +1,150 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "modules/fusion/km.h"
+
+namespace coop {
+namespace v2x {
+namespace {
+
+// the best sum of scores over all matchings using pairs with a score > 0
+double BruteForce(const Eigen::MatrixXf &mat, int row, std::vector<char> *used) {
+  if (row == mat.rows()) {
+    return 0;
+  }
+  // the row stays unmatched
+  double best = BruteForce(mat, row + 1, used);
+  for (int j = 0; j < mat.cols(); ++j) {
+    if ((*used)[j] || mat(row, j) <= 0) continue;
+    (*used)[j] = 1;
+    best = std::max(best, mat(row, j) + BruteForce(mat, row + 1, used));
+    (*used)[j] = 0;
+  }
+  return best;
+}
+
+// checks that every row and column is reported once and only gated-in pairs
+// are matched, returns the sum of the matched scores
+double CheckResult(const Eigen::MatrixXf &mat,
+                   const std::vector<std::pair<int, int>> &match_cps) {
+  std::vector<int> rows(mat.rows(), 0), cols(mat.cols(), 0);
+  double sum = 0;
+  for (const auto &cp : match_cps) {
+    EXPECT_FALSE(cp.first == -1 && cp.second == -1);
+    if (cp.first != -1) rows[cp.first]++;
+    if (cp.second != -1) cols[cp.second]++;
+    if (cp.first != -1 && cp.second != -1) {
+      EXPECT_GT(mat(cp.first, cp.second), 0);
+      sum += mat(cp.first, cp.second);
+    }
+  }
+  for (int c : rows) EXPECT_EQ(c, 1);
+  for (int c : cols) EXPECT_EQ(c, 1);
+  return sum;
+}
+
+Eigen::MatrixXf RandomMatrix(int rows, int cols, double gated,
+                             std::mt19937 *gen) {
+  std::uniform_real_distribution<float> score(0.f, 1.f);
+  std::uniform_real_distribution<double> gate(0., 1.);
+  Eigen::MatrixXf mat(rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      mat(i, j) = gate(*gen) < gated ? 0.f : score(*gen);
+    }
+  }
+  return mat;
+}
+
+TEST(KMkernalTest, MatchesBruteForce) {
+  std::mt19937 gen(7);
+  KMkernal km;
+  std::vector<std::pair<int, int>> match_cps;
+  for (int rows = 0; rows <= 6; ++rows) {
+    for (int cols = 0; cols <= 6; ++cols) {
+      for (double gated : {0., 0.3, 0.7, 1.}) {
+        for (int round = 0; round < 20; ++round) {
+          const Eigen::MatrixXf mat = RandomMatrix(rows, cols, gated, &gen);
+          std::vector<char> used(cols, 0);
+          const double best = BruteForce(mat, 0, &used);
+          ASSERT_TRUE(km.GetKMResult(mat, &match_cps));
+          EXPECT_NEAR(CheckResult(mat, match_cps), best, 1e-4)
+              << rows << "x" << cols << ", gated " << gated << "\n"
+              << mat;
+        }
+      }
+    }
+  }
+}
+
+TEST(KMkernalTest, NeedReverse) {
+  std::mt19937 gen(11);
+  KMkernal km;
+  std::vector<std::pair<int, int>> match_cps, reversed;
+  for (int round = 0; round < 50; ++round) {
+    const Eigen::MatrixXf mat = RandomMatrix(5, 3, 0.4, &gen);
+    km.GetKMResult(mat, &match_cps);
+    km.GetKMResult(mat.transpose(), &reversed, true);
+    // (j, i) pairs of the transposed matrix read as (i, j) pairs of mat
+    const double sum = CheckResult(mat, reversed);
+    EXPECT_NEAR(sum, CheckResult(mat, match_cps), 1e-4);
+  }
+}
+
+TEST(KMkernalTest, ReusesWorkspace) {
+  std::mt19937 gen(3);
+  KMkernal km;
+  std::vector<std::pair<int, int>> match_cps;
+  // shrinking and growing problems on the same matcher
+  for (int n : {40, 3, 25, 1, 0, 60, 7}) {
+    const Eigen::MatrixXf mat = RandomMatrix(n, n + 2, 0.8, &gen);
+    std::vector<char> used(mat.cols(), 0);
+    km.GetKMResult(mat, &match_cps);
+    const double sum = CheckResult(mat, match_cps);
+    if (n <= 7) {
+      EXPECT_NEAR(sum, BruteForce(mat, 0, &used), 1e-4);
+    }
+  }
+}
+
+TEST(KMkernalTest, GatedPairsNeverMatch) {
+  Eigen::MatrixXf mat(3, 3);
+  mat << 0.9f, 0.f, 0.f,
+         0.8f, 0.f, 0.f,
+         0.f, 0.f, -1.f;
+  KMkernal km;
+  std::vector<std::pair<int, int>> match_cps;
+  km.GetKMResult(mat, &match_cps);
+  EXPECT_NEAR(CheckResult(mat, match_cps), 0.9, 1e-6);
+  int matched = 0;
+  for (const auto &cp : match_cps) {
+    if (cp.first != -1 && cp.second != -1) {
+      EXPECT_EQ(cp, std::make_pair(0, 0));
+      matched++;
+    }
+  }
+  EXPECT_EQ(matched, 1);
+}
+
+}  // namespace
+}  // namespace v2x
+}  // namespace coop
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Cost of caching a frame and selecting the sync frames, as
+// Fuser::ProcessOneFrame does for every frame: the previous Cacher (map of
+// maps, copied by named_buff()) against the TimeIndexedRing of every device.
+//
+// sync_bench [sensors] [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "modules/message_cache/frame_ring.hpp"
+
+using coop::v2x::OCLong;
+using coop::v2x::TimeIndexedRing;
+
+namespace {
+
+struct Frame {
+  OCLong devid;
+  OCLong timestamp;
+};
+typedef std::shared_ptr<const Frame> spFrame;
+
+const OCLong kWindowMs = 1500;
+
+class MapCacher {
+ public:
+  void push_back(const spFrame &frame) {
+    auto &single_buff = named_buff_[frame->devid];
+    single_buff[frame->timestamp] = frame;
+    if (single_buff.rbegin()->first - single_buff.begin()->first >=
+        kWindowMs) {
+      single_buff.erase(
+          single_buff.begin(),
+          single_buff.lower_bound(single_buff.rbegin()->first - kWindowMs));
+    }
+  }
+  std::map<OCLong, std::map<OCLong, spFrame>> named_buff() {
+    return named_buff_;
+  }
+  spFrame GetNearestFrame(OCLong timestamp, OCLong devid) {
+    auto &dev_map = named_buff_[devid];
+    auto it = dev_map.upper_bound(timestamp);
+    return it == dev_map.begin() ? nullptr : (--it)->second;
+  }
+
+ private:
+  std::map<OCLong, std::map<OCLong, spFrame>> named_buff_;
+};
+
+class RingCacher {
+ public:
+  void push_back(const spFrame &frame) {
+    auto it = named_buff_.find(frame->devid);
+    if (it == named_buff_.end()) {
+      it = named_buff_.emplace(frame->devid, TimeIndexedRing<spFrame>(64))
+               .first;
+    }
+    it->second.Insert(frame->timestamp, frame);
+    it->second.EvictBefore(it->second.back_time() - kWindowMs);
+  }
+  template <typename Fn>
+  void ForEachNearestFrame(OCLong timestamp, Fn fn) const {
+    for (const auto &dev : named_buff_) {
+      const spFrame *frame = dev.second.Nearest(timestamp);
+      if (frame) fn(*frame);
+    }
+  }
+
+ private:
+  std::map<OCLong, TimeIndexedRing<spFrame>> named_buff_;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int sensors = argc > 1 ? atoi(argv[1]) : 16;
+  const int seconds = argc > 2 ? atoi(argv[2]) : 60;
+
+  // every sensor at 20 Hz with its own phase and some jitter, a few frames
+  // arrive late
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> phase(0, 49), jitter(-5, 5);
+  std::uniform_real_distribution<double> chance(0., 1.);
+  std::vector<spFrame> frames;
+  std::vector<int> phases(sensors);
+  for (auto &p : phases) p = phase(gen);
+  for (OCLong t = 0; t < seconds * 1000; t += 50) {
+    for (int s = 0; s < sensors; ++s) {
+      frames.push_back(std::make_shared<Frame>(
+          Frame{s, 1700000000000LL + t + phases[s] + jitter(gen)}));
+    }
+  }
+  for (size_t i = 1; i < frames.size(); ++i) {
+    if (chance(gen) < 0.05) std::swap(frames[i - 1], frames[i]);
+  }
+
+  MapCacher map_cacher;
+  size_t map_synced = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (const auto &frame : frames) {
+    map_cacher.push_back(frame);
+    for (auto &&cam : map_cacher.named_buff()) {
+      spFrame matched = map_cacher.GetNearestFrame(frame->timestamp, cam.first);
+      if (matched && frame->timestamp - matched->timestamp < 1000) {
+        map_synced++;
+      }
+    }
+  }
+  const double map_us = std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - t0)
+                            .count();
+
+  RingCacher ring_cacher;
+  size_t ring_synced = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (const auto &frame : frames) {
+    ring_cacher.push_back(frame);
+    ring_cacher.ForEachNearestFrame(frame->timestamp, [&](const spFrame &m) {
+      if (frame->timestamp - m->timestamp < 1000) ring_synced++;
+    });
+  }
+  const double ring_us = std::chrono::duration<double, std::micro>(
+                             std::chrono::steady_clock::now() - t0)
+                             .count();
+
+  printf("%d sensors at 20 Hz, %d s, %lu frames\n", sensors, seconds,
+         frames.size());
+  printf("map of maps : %8.2f us/frame\n", map_us / frames.size());
+  printf("ring        : %8.2f us/frame\n", ring_us / frames.size());
+  printf("speedup %.1fx, sync frames %lu / %lu\n", map_us / ring_us,
+         map_synced, ring_synced);
+  return map_synced == ring_synced ? 0 : 1;
+}
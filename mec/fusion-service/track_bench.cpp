@@ -0,0 +1,323 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+// Track management of Fuser::UpdateVehicleStates with many concurrent tracks:
+// the previous std::map with the linear isTracked / isAssociated scans
+// against the TrackTable with the (devid, target) index and the TrackGrid.
+// Objects are born and die every frame, each one is seen by two devices.
+//
+// track_bench [objects] [frames]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "modules/dataType/track_table.hpp"
+
+using coop::v2x::TrackGrid;
+using coop::v2x::TrackTable;
+
+namespace {
+
+typedef int64_t OCLong;
+typedef unsigned int OCInt;
+
+const int kDevices = 4;
+const double kFrameS = 0.1;
+const double kTtl = 1.0;
+
+struct Obs {
+  OCInt id;
+  double x, y;
+  int obj_class;
+};
+struct Frame {
+  OCLong devid;
+  std::vector<Obs> targets;
+};
+
+struct Track {
+  int id;
+  double x, y, heading;
+  int obj_class;
+  double ttl;
+  std::map<OCLong, OCInt> obs_dev_target_id;
+  void Update(const Obs &obs) {
+    x = obs.x;
+    y = obs.y;
+    ttl = kTtl;
+  }
+};
+typedef std::shared_ptr<Track> spTrack;
+
+struct Counters {
+  size_t tracked = 0, associated = 0, added = 0, removed = 0;
+  bool operator==(const Counters &o) const {
+    return tracked == o.tracked && associated == o.associated &&
+           added == o.added && removed == o.removed;
+  }
+};
+
+// the association box of Fuser::isAssociated
+bool InBox(const Obs &obs, const Track &track, double dx, double dy) {
+  if ((obs.obj_class == 2) != (track.obj_class == 2)) return false;
+  const double h = track.heading;
+  const double lx = std::cos(h) * dx + std::sin(h) * dy;
+  const double ly = -std::sin(h) * dx + std::cos(h) * dy;
+  return std::abs(lx) < 4 && std::abs(ly) < 2.5;
+}
+
+spTrack NewTrack(int id, OCLong devid, const Obs &obs) {
+  spTrack track = std::make_shared<Track>();
+  track->id = id;
+  track->x = obs.x;
+  track->y = obs.y;
+  track->heading = 0.3 * (id % 20);
+  track->obj_class = obs.obj_class;
+  track->ttl = kTtl;
+  track->obs_dev_target_id[devid] = obs.id;
+  return track;
+}
+
+class MapTracks {
+ public:
+  void Frame(const std::vector<::Frame> &frames, int *next_id) {
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+      it->second->ttl -= kFrameS;
+      if (it->second->ttl < 0) {
+        it = tracks_.erase(it);
+        counters.removed++;
+      } else {
+        ++it;
+      }
+    }
+    for (const auto &frame : frames) {
+      for (const auto &obs : frame.targets) {
+        int id;
+        if (isTracked(frame.devid, obs.id, &id)) {
+          tracks_[id]->Update(obs);
+          counters.tracked++;
+          continue;
+        }
+        if (isAssociated(frame.devid, obs, &id)) {
+          tracks_[id]->obs_dev_target_id[frame.devid] = obs.id;
+          tracks_[id]->Update(obs);
+          counters.associated++;
+          continue;
+        }
+        const int new_id = (*next_id)++;
+        tracks_[new_id] = NewTrack(new_id, frame.devid, obs);
+        counters.added++;
+      }
+    }
+  }
+  size_t size() const { return tracks_.size(); }
+  Counters counters;
+
+ private:
+  bool isTracked(OCLong devid, OCInt target_id, int *id) {
+    for (auto &&track : tracks_) {
+      if (track.second->obs_dev_target_id.count(devid)) {
+        if (target_id == track.second->obs_dev_target_id[devid]) {
+          *id = track.second->id;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  bool isAssociated(OCLong devid, const Obs &obs, int *id) {
+    for (const auto &track : tracks_) {
+      if (track.second->obs_dev_target_id.count(devid)) continue;
+      if (InBox(obs, *track.second, obs.x - track.second->x,
+                obs.y - track.second->y)) {
+        *id = track.second->id;
+        return true;
+      }
+    }
+    return false;
+  }
+  std::map<int, spTrack> tracks_;
+};
+
+class TableTracks {
+ public:
+  void Frame(const std::vector<::Frame> &frames, int *next_id) {
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+      it->second->ttl -= kFrameS;
+      if (it->second->ttl >= 0) {
+        ++it;
+        continue;
+      }
+      for (const auto &dev_target : it->second->obs_dev_target_id) {
+        targets_.erase(dev_target);
+      }
+      grid_.Remove(it.slot());
+      it = tracks_.erase(it);
+      counters.removed++;
+    }
+    for (const auto &frame : frames) {
+      for (const auto &obs : frame.targets) {
+        auto target = targets_.find(std::make_pair(frame.devid, obs.id));
+        if (target != targets_.end()) {
+          const uint32_t slot = tracks_.slot(target->second);
+          tracks_.at_slot(slot).second->Update(obs);
+          Index(slot);
+          counters.tracked++;
+          continue;
+        }
+        int id;
+        if (isAssociated(frame.devid, obs, &id)) {
+          const uint32_t slot = tracks_.slot(id);
+          tracks_.at_slot(slot).second->obs_dev_target_id[frame.devid] =
+              obs.id;
+          targets_[std::make_pair(frame.devid, obs.id)] = id;
+          tracks_.at_slot(slot).second->Update(obs);
+          Index(slot);
+          counters.associated++;
+          continue;
+        }
+        const int new_id = (*next_id)++;
+        const uint32_t slot =
+            tracks_.Insert(new_id, NewTrack(new_id, frame.devid, obs));
+        targets_[std::make_pair(frame.devid, obs.id)] = new_id;
+        Index(slot);
+        counters.added++;
+      }
+    }
+  }
+  size_t size() const { return tracks_.size(); }
+  Counters counters;
+
+ private:
+  struct TargetKeyHash {
+    size_t operator()(const std::pair<OCLong, OCInt> &key) const {
+      return std::hash<OCLong>()(key.first) * 31 + key.second;
+    }
+  };
+  void Index(uint32_t slot) {
+    const auto &track = *tracks_.at_slot(slot).second;
+    grid_.Update(slot, track.x, track.y);
+  }
+  bool isAssociated(OCLong devid, const Obs &obs, int *id) {
+    int found = -1;
+    grid_.ForEachNear(obs.x, obs.y, [&](uint32_t slot) {
+      const auto &track = tracks_.at_slot(slot);
+      if (found != -1 && track.first > found) return;
+      if (track.second->obs_dev_target_id.count(devid)) return;
+      if (InBox(obs, *track.second, obs.x - track.second->x,
+                obs.y - track.second->y)) {
+        found = track.first;
+      }
+    });
+    *id = found;
+    return found != -1;
+  }
+  TrackTable<spTrack> tracks_;
+  std::unordered_map<std::pair<OCLong, OCInt>, int, TargetKeyHash> targets_;
+  TrackGrid grid_{6.0};
+};
+
+struct Object {
+  double x, y, vx, vy;
+  int obj_class;
+  OCInt target_id[kDevices];
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const int num_objects = argc > 1 ? atoi(argv[1]) : 1000;
+  const int num_frames = argc > 2 ? atoi(argv[2]) : 300;
+  const double area = 600;
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> pos(0, area), speed(-12, 12);
+  std::uniform_real_distribution<double> chance(0, 1);
+  std::normal_distribution<double> noise(0, 0.3);
+  OCInt next_target = 1;
+  auto spawn = [&]() {
+    Object o;
+    o.x = pos(gen);
+    o.y = pos(gen);
+    o.vx = speed(gen);
+    o.vy = speed(gen);
+    o.obj_class = chance(gen) < 0.1 ? 2 : 1;
+    for (int d = 0; d < kDevices; ++d) o.target_id[d] = next_target++;
+    return o;
+  };
+  std::vector<Object> objects;
+  for (int i = 0; i < num_objects; ++i) objects.push_back(spawn());
+
+  // the frames of the devices, 2% of the objects leave and are replaced
+  // every frame
+  std::vector<std::vector<Frame>> frames(num_frames);
+  for (auto &frame : frames) {
+    for (auto &o : objects) {
+      if (chance(gen) < 0.02) o = spawn();
+      o.x = std::fmod(o.x + o.vx * kFrameS + area, area);
+      o.y = std::fmod(o.y + o.vy * kFrameS + area, area);
+    }
+    for (int d = 0; d < kDevices; ++d) {
+      Frame f;
+      f.devid = 1000 + d;
+      for (size_t i = 0; i < objects.size(); ++i) {
+        if (static_cast<int>(i % kDevices) != d &&
+            static_cast<int>((i + 1) % kDevices) != d) {
+          continue;
+        }
+        const Object &o = objects[i];
+        f.targets.push_back(
+            {o.target_id[d], o.x + noise(gen), o.y + noise(gen), o.obj_class});
+      }
+      frame.push_back(f);
+    }
+  }
+
+  MapTracks map_tracks;
+  int next_id = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (const auto &frame : frames) map_tracks.Frame(frame, &next_id);
+  const double map_ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - t0)
+                            .count();
+
+  TableTracks table_tracks;
+  next_id = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (const auto &frame : frames) table_tracks.Frame(frame, &next_id);
+  const double table_ms = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - t0)
+                              .count();
+
+  const Counters &c = table_tracks.counters;
+  printf("%d objects, %d devices, %d frames, %lu tracks at the end\n",
+         num_objects, kDevices, num_frames, table_tracks.size());
+  printf("tracked %lu, associated %lu, added %lu, removed %lu\n", c.tracked,
+         c.associated, c.added, c.removed);
+  printf("map + scans      : %8.3f ms/frame\n", map_ms / num_frames);
+  printf("table + indexes  : %8.3f ms/frame\n", table_ms / num_frames);
+  const bool same = map_tracks.counters == table_tracks.counters &&
+                    map_tracks.size() == table_tracks.size();
+  printf("speedup %.1fx, same decisions: %s\n", map_ms / table_ms,
+         same ? "yes" : "NO");
+  return same ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Copyright 2022 The CIV Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+
+#include "modules/dataType/track_table.hpp"
+
+namespace coop {
+namespace v2x {
+namespace {
+
+TEST(TrackTableTest, InsertFindErase) {
+  TrackTable<double> table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(table.Insert(7, 0.7), 0u);
+  EXPECT_EQ(table.Insert(3, 0.3), 1u);
+  table[9] = 0.9;
+  EXPECT_EQ(table.size(), 3u);
+  EXPECT_EQ(table.slot(9), 2u);
+  EXPECT_EQ(table.slot(4), TrackTable<double>::npos);
+  EXPECT_EQ(table.find(3)->second, 0.3);
+  EXPECT_TRUE(table.find(4) == table.end());
+
+  // replacing keeps the slot
+  EXPECT_EQ(table.Insert(3, 3.0), 1u);
+  EXPECT_EQ(table.at_slot(1).second, 3.0);
+
+  EXPECT_EQ(table.erase(7), 1u);
+  EXPECT_EQ(table.erase(7), 0u);
+  EXPECT_FALSE(table.live(0));
+  EXPECT_EQ(table.count(7), 0u);
+  // the free slot is reused, the others keep theirs
+  EXPECT_EQ(table.Insert(11, 1.1), 0u);
+  EXPECT_EQ(table.slot(3), 1u);
+  EXPECT_EQ(table.slot(9), 2u);
+  EXPECT_EQ(table.slots(), 3u);
+}
+
+TEST(TrackTableTest, EraseWhileIterating) {
+  TrackTable<int> table;
+  for (int id = 0; id < 10; ++id) table.Insert(id, id * 10);
+  for (auto it = table.begin(); it != table.end();) {
+    if (it->first % 3 == 0) {
+      it = table.erase(it);
+    } else {
+      it++;
+    }
+  }
+  std::vector<int> ids;
+  for (const auto &track : table) ids.push_back(track.first);
+  EXPECT_EQ(ids, std::vector<int>({1, 2, 4, 5, 7, 8}));
+  const std::map<int, int> by_id(table.begin(), table.end());
+  EXPECT_EQ(by_id.size(), 6u);
+  EXPECT_EQ(by_id.at(5), 50);
+}
+
+// random births and deaths against a std::map
+TEST(TrackTableTest, MatchesMap) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> id(0, 300);
+  TrackTable<int> table;
+  std::map<int, int> reference;
+  for (int n = 0; n < 20000; ++n) {
+    const int k = id(gen);
+    if (gen() % 3) {
+      table.Insert(k, n);
+      reference[k] = n;
+    } else {
+      EXPECT_EQ(table.erase(k), reference.erase(k));
+    }
+    ASSERT_EQ(table.size(), reference.size());
+  }
+  EXPECT_LE(table.slots(), 301u);
+  const std::map<int, int> by_id(table.begin(), table.end());
+  EXPECT_EQ(by_id, reference);
+}
+
+TEST(TrackGridTest, ForEachNear) {
+  TrackGrid grid(5.0);
+  grid.Update(0, 1, 1);
+  grid.Update(1, 9, 1);
+  grid.Update(2, 30, 30);
+  grid.Update(3, -1, -1);
+  std::set<uint32_t> near;
+  grid.ForEachNear(0, 0, [&](uint32_t slot) { near.insert(slot); });
+  EXPECT_EQ(near, std::set<uint32_t>({0, 1, 3}));
+
+  // move 1 away and 2 close, remove 3
+  grid.Update(1, 40, 40);
+  grid.Update(2, 2, -2);
+  grid.Remove(3);
+  near.clear();
+  grid.ForEachNear(0, 0, [&](uint32_t slot) { near.insert(slot); });
+  EXPECT_EQ(near, std::set<uint32_t>({0, 2}));
+}
+
+// every slot closer than the cell size is visited
+TEST(TrackGridTest, CoversCellSize) {
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> pos(-50, 50);
+  TrackGrid grid(6.0);
+  std::vector<std::pair<double, double>> points(500);
+  for (uint32_t i = 0; i < points.size(); ++i) {
+    points[i] = std::make_pair(pos(gen), pos(gen));
+    grid.Update(i, points[i].first, points[i].second);
+  }
+  for (int q = 0; q < 200; ++q) {
+    const double x = pos(gen), y = pos(gen);
+    std::set<uint32_t> near;
+    grid.ForEachNear(x, y, [&](uint32_t slot) { near.insert(slot); });
+    for (uint32_t i = 0; i < points.size(); ++i) {
+      if (std::hypot(points[i].first - x, points[i].second - y) < 6.0) {
+        EXPECT_TRUE(near.count(i)) << i;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace v2x
+}  // namespace coop
@@ -28,6 +28,8 @@ struct route_rule_item
 	avl_node_t avlnode;
 	std::string url_name;	// rule
 	std::string name;
+	// query key of the vehicle id for the consistent hash
+	std::string keyword;
 	server_item_node service;
 	static int route_rule_compare(avl_node_t* a, avl_node_t* b);
 };
@@ -52,6 +54,7 @@ private:
 	int load_rule_url_name(std::string &name, int order);
 	int load_service_name(std::string &name, int order);
 	int load_service_type(route_rule_item*, int order);
+	int load_service_keyword(route_rule_item*, int order);
 
 	int init_client_endpoint(std::string &url);
 	int init_server_endpoint(std::string &url);
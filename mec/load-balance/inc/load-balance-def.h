@@ -69,6 +69,8 @@ struct server_header
 struct server_request_info
 {
 	uint32_t veh_cnt;
+	// capacity relative to the other endpoints, 1 by default
+	uint32_t weight;
 	size_t name_len;
 	char buf[0];
 };
@@ -5,6 +5,7 @@
 #include "std/smtptr.h"
 #include "std/list.h"
 #include "utils/avltree.h"
+#include "utils/endpoint-balancer.h"
 
 namespace zas {
 namespace load_balance {
@@ -23,6 +24,7 @@ struct server_item
 	int _refcnt;
 	listnode_t _endpoints_list;
 	avl_node_t* _endpoints_tree;
+	endpoint_balancer _balancer;
 	static int server_item_compare(avl_node_t* a, avl_node_t* b);
 };
 
@@ -35,7 +37,7 @@ struct server_endpoint
 	avl_node_t avlnode;
 	std::string _identity;	//server endpoint unique id
 	server_item* _server;		//server point
-	size_t _count;		//veh count in this server
+	balance_node _balance;	//request count and weight in this server
 	int _refcnt;
 	int _status;	// 0: server disable, 1: server enable
 	static int server_endpoint_compare(avl_node_t* a, avl_node_t* b);
@@ -51,10 +53,11 @@ public:
 	virtual ~server_endpoint_mgr();
 
 	server_endpoint* add_server_endpoint(const char* svr_name,
-		const char* identity);
+		const char* identity, uint32_t weight = 1);
 	server_endpoint* find_server_endpoint(const char* svr_name,
 		const char* identity);
-	server_endpoint_node get_service_endpoint(server_item *item);
+	server_endpoint_node get_service_endpoint(server_item *item,
+		const std::string* key = nullptr);
 	server_item_node get_service_item(std::string &svr_name);
 
 private:
@@ -65,7 +68,7 @@ private:
 
 	//server endpoint
 	server_endpoint* add_endpoint(server_item* item,
-		std::string &identity);
+		std::string &identity, uint32_t weight);
 	server_endpoint* find_endpoint(server_item* item,
 		std::string &identity);
 	int remove_endpoint(server_item* item, std::string &identity);
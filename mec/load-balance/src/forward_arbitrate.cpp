@@ -117,6 +117,16 @@ int forward_arbitrate::load_service_type(route_rule_item* item, int order)
 	return 0;
 }
 
+int forward_arbitrate::load_service_keyword(route_rule_item* item, int order)
+{
+	if (!item) { return -EBADPARM; }
+	std::string keyword_path = "load-balance-service.route-rule.";
+	keyword_path += std::to_string(order);
+	keyword_path += ".service.keyword";
+	item->keyword = get_sysconfig(keyword_path.c_str(), "");
+	return 0;
+}
+
 int forward_arbitrate::init_rule_list(void)
 {
 	size_t cnt = 0;
@@ -141,6 +151,7 @@ int forward_arbitrate::init_rule_list(void)
 		}
 		item->name = svc_name;
 		load_service_type(item, i);
+		load_service_keyword(item, i);
 		auto svc = _server_mgr->get_service_item(svc_name);
 		if (!svc.get()) {
 			log.e(LOAD_BALANCE_FORWRD_TAG,
@@ -271,7 +282,8 @@ int forward_arbitrate::service_request(zmq_backend_socket* wa_sock,
 		assert(nullptr != s_info);
 		assert(nullptr != _server_mgr);
 		s_info->buf[s_info->name_len] = '\0';
-		_server_mgr->add_server_endpoint(s_info->buf, identify.c_str());
+		_server_mgr->add_server_endpoint(s_info->buf, identify.c_str(),
+			s_info->weight);
 		server_header rep_hdr;
 		rep_hdr.svc_type = service_msg_reply;
 		data->set_part(2, (char*)&rep_hdr, sizeof(server_header));
@@ -310,8 +322,12 @@ int forward_arbitrate::forward_to_service(webapp_zeromq_msg* data, uri &url)
 		}
 		rule->service = svc;
 	}
+	std::string vid;
+	if (rule->keyword.length()) {
+		vid = url.query_value(rule->keyword.c_str());
+	}
 	forward_backend::inst()->forward_to_service(data,
-		_server_mgr->get_service_endpoint(rule->service.get()));
+		_server_mgr->get_service_endpoint(rule->service.get(), &vid));
 	return 0;
 }
 
@@ -86,6 +86,16 @@ int server_endpoint_mgr::init_server_info(server_item* item)
 	int max_cnt = LOAD_BALANCE_SERVER_ENDPOINT_MAX_CNT;
 	item->_max_cnt = get_sysconfig(path.c_str(), max_cnt, &ret);
 
+	path = rootpath + "balance.mode";
+	std::string mode = get_sysconfig(path.c_str(), "least-loaded");
+	int bmode = endpoint_balancer::parse_mode(mode.c_str());
+	if (bmode < 0) {
+		log.e(LOAD_BALANCE_FORWRD_TAG,
+			"unknown balance mode %s\n", mode.c_str());
+		bmode = balance_mode_least_loaded;
+	}
+	item->_balancer.set_mode(bmode);
+
 	path = rootpath + "keepalive.internal";
 	size_t interval = HEARTBEAT_INTERVAL_DEFAULT;
 	interval = get_sysconfig(path.c_str(), interval, &ret);
@@ -101,7 +111,7 @@ int server_endpoint_mgr::init_server_info(server_item* item)
 }
 
 server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
-	std::string &identity)
+	std::string &identity, uint32_t weight)
 {
 	if (!item) {
 		return nullptr;
@@ -114,7 +124,7 @@ server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
 	node = new server_endpoint();
 	node->_server = item;
 	node->_identity = identity;
-	node->_count = 0;
+	endpoint_balancer::init_node(&node->_balance, 0, weight);
 	node->_refcnt = 1;
 	node->_status = 1;
 	if (avl_insert(&item->_endpoints_tree, &node->avlnode,
@@ -124,6 +134,7 @@ server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
 		return nullptr;
 	}
 	listnode_add(item->_endpoints_list, node->ownerlist);
+	item->_balancer.add(&node->_balance, identity);
 	return node;
 }
 
@@ -173,6 +184,7 @@ int server_endpoint_mgr::remove_endpoint(server_item* item,
 	if (!node) {
 		return -ENOTFOUND;
 	}
+	item->_balancer.remove(&node->_balance);
 	avl_remove(&item->_endpoints_tree, &node->avlnode);
 	listnode_del(node->ownerlist);
 	node->_server = nullptr;
@@ -202,6 +214,7 @@ int server_endpoint_mgr::remove_server_item(server_item* item)
 		auto* node = LIST_ENTRY(server_endpoint,	\
 			ownerlist, item->_endpoints_list.next);
 		assert(nullptr != node);
+		item->_balancer.remove(&node->_balance);
 		avl_remove(&item->_endpoints_tree, &node->avlnode);
 		listnode_del(node->ownerlist);
 		node->_server = nullptr;
@@ -229,7 +242,7 @@ int server_endpoint_mgr::release_all_nodes(void)
 
 
 server_endpoint* server_endpoint_mgr::add_server_endpoint(const char* svr_name,
-	const char* identity)
+	const char* identity, uint32_t weight)
 {
 	if (!svr_name || !*svr_name || !identity || !*identity) {
 		return nullptr;
@@ -249,7 +262,7 @@ server_endpoint* server_endpoint_mgr::add_server_endpoint(const char* svr_name,
 		return node;
 	}
 	log.i(LOAD_BALANCE_FORWRD_TAG, "add server new %s, %s\n", name.c_str(), idt.c_str());
-	return add_endpoint(item, idt);
+	return add_endpoint(item, idt, weight);
 }
 
 server_endpoint* server_endpoint_mgr::find_server_endpoint(const char* svr_name,
@@ -281,49 +294,23 @@ server_item_node server_endpoint_mgr::get_service_item(std::string &name)
 }
 
 server_endpoint_node server_endpoint_mgr::get_service_endpoint(
-	server_item *item)
+	server_item *item, const std::string* key)
 {
 	if (!item) {
 		return nullptr;
 	}
 
-	if (listnode_isempty(item->_endpoints_list)) {
+	auto* bnode = item->_balancer.acquire(key);
+	if (!bnode) {
 		return nullptr;
 	}
-	
-	listnode_t* nd = item->_endpoints_list.next;
-	server_endpoint* alloc_point = nullptr;
-	int64_t min_count = -1;
-	for (; nd != &item->_endpoints_list; nd = nd->next) {
-		auto* point = list_entry(server_endpoint, ownerlist, nd);
-		assert(nullptr != point);
-		if (point->_status != 1) {
-			continue;
-		}
-		if (min_count < 0) {
-			min_count = point->_count;
-			alloc_point = point;
-		} else {
-			if (point->_count < min_count) {
-				min_count = point->_count;
-				alloc_point = point;
-			}
-		}
-	}
-	if (alloc_point) {
-		alloc_point->_count++;
-		if (alloc_point->_count >= item->_max_cnt) {
-			nd = item->_endpoints_list.next;
-			for (; nd != &item->_endpoints_list; nd = nd->next) {
-				auto* point = list_entry(server_endpoint, ownerlist, nd);
-				assert(nullptr != point);
-				point->_count = 0;
-			}
-		}
+	// the counts start again before they grow over the max count
+	if (bnode->load >= item->_max_cnt * bnode->weight) {
+		item->_balancer.reset_load();
 	}
-	server_endpoint_node alloc_node(alloc_point);
+	server_endpoint_node alloc_node(
+		BALANCE_NODE_ENTRY(server_endpoint, _balance, bnode));
 	return alloc_node;
 }
-	
 
 }}	//zas::vehicle_indexing
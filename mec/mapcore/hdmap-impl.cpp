@@ -43,7 +43,7 @@ using odrview_refline = odr::RefLine;
 using odrview_lane = odr::Lane;
 
 hdmap_impl::hdmap_impl()
-: _refcnt(0), _buffer(nullptr), _buffer_end(0), _flags(0)
+: _refcnt(0), _buffer(nullptr), _buffer_end(0), _buffer_size(0), _flags(0)
 , _roadsegs(nullptr), _lanes(nullptr), _lanesegs(nullptr)
 , _laneseg_kdtree(nullptr), _lanebdy_kdtree(nullptr)
 {
@@ -55,14 +55,23 @@ hdmap_impl::~hdmap_impl() { release_all(); }
 void hdmap_impl::release_all(void)
 {
 	remove_hdmap_date(-1);
-	delete[] _buffer;
+	if (!_f.external_buffer) {
+		delete[] _buffer;
+	}
 	_buffer = nullptr;
+	_buffer_end = 0;
+	_buffer_size = 0;
+	_f.external_buffer = 0;
 
 	_roadsegs = nullptr;
 	_lanes = nullptr;
 	_lanesegs = nullptr;
 	_laneseg_kdtree = nullptr;
 	_lanebdy_kdtree = nullptr;
+	_centerline_kdtree.release();
+	_lsc_transitions.clear();
+	_lsc_adj_offsets.clear();
+	_lsc_adj_lanes.clear();
 
 	_wgs84prj.reset(nullptr, nullptr);
 	_f.valid = 0;
@@ -86,6 +95,30 @@ int hdmap_impl::load_fromfile(const char* filename)
 		reset();
 		return ret;
 	}
+	return setup_buffer();
+}
+
+int hdmap_impl::load_frombuffer(void* buffer, size_t sz)
+{
+	if (nullptr == buffer || sz < sizeof(hdmap_fileheader_v1)) {
+		return -EBADPARM;
+	}
+
+	if (nullptr != _buffer) {
+		return -ENOTALLOWED;
+	}
+
+	// the buffer is owned by the caller, we relocate
+	// it in place and never release it
+	reset();
+	_buffer = reinterpret_cast<uint8_t*>(buffer);
+	_buffer_size = sz;
+	_f.external_buffer = 1;
+	return setup_buffer();
+}
+
+int hdmap_impl::setup_buffer(void)
+{
 	if (check_validity()) {
 		reset();
 		return -EINVALID;
@@ -119,9 +152,42 @@ int hdmap_impl::finalize(void)
 {
 	// init the projection
 	_wgs84prj.reset(GREF_WGS84, get_georef());
+
+	if (build_centerline_index()) {
+		return -EINVALID;
+	}
 	return 0;
 }
 
+int hdmap_impl::build_centerline_index(void)
+{
+	auto* hdr = header();
+	if (nullptr == hdr) {
+		return -ENOTAVAIL;
+	}
+	_centerline_kdtree.release();
+	if (!hdr->a.persistence) {
+		return 0;
+	}
+
+	for (int i = 0; i < hdr->laneseg_count; i++) {
+		auto* ls = &_lanesegs[i];
+		if (nullptr == ls->data.ptr || nullptr == ls->lane.ptr) {
+			continue;
+		}
+		size_t lssz = ls->data.ptr->extinfo.center_pts.size
+			/ sizeof(hdmap_lane_boundary_point_v1);
+		auto* lscenter = ls->data.ptr->extinfo.center_pts.ptr;
+		for (size_t index = 0; index + 1 < lssz; index++) {
+			auto& start = lscenter[index].pt;
+			auto& end = lscenter[index + 1].pt;
+			_centerline_kdtree.add(i, start.xyz.x, start.xyz.y,
+				end.xyz.x, end.xyz.y);
+		}
+	}
+	return _centerline_kdtree.build();
+}
+
 int hdmap_impl::drawmap(void)
 {
 	auto* hdr = header();
@@ -209,6 +275,9 @@ int hdmap_impl::check_validity(void)
 	}
 	if (hdr->a.persistence) {
 		// hdrmap_file_rendermap_v1
+		if (hdr->size > _buffer_size) {
+			return -3;
+		}
 		_buffer_end = ((size_t)hdr) + hdr->size;
 	} else {
 		// todo
@@ -382,6 +451,8 @@ int hdmap_impl::loadfile(const char* filename)
 		return -ENOMEMORY;
 	}
 
+	_buffer_size = sz;
+
 	rewind(fp);
 	if (sz != fread(_buffer, 1, sz, fp)) {
 		fclose(fp);
@@ -422,27 +493,17 @@ int hdmap_impl::find_laneseg(double x, double y, int count,
 		return -ENOTFOUND;
 	}
 
+	std::vector<kdtree2d_neighbor<hdmap_laneseg_point_v1>> nearest(count);
+	count = kdtree2d_knn_search(_laneseg_kdtree, x, y,
+		count, nearest.data());
+
 	for (int i = 0; i < count; ++i) {
 		hdmap_nearest_laneseg item;
-		auto* langseg = kdtree2d_search(_laneseg_kdtree,
-			x, y, item.distance);
+		auto* langseg = nearest[i].node;
+		item.distance = nearest[i].distance;
 		item.laneseg = reinterpret_cast<hdmap_laneseg*>(&(_lanesegs[langseg->laneseg_index]));
 		set.push_back(item);
 	}
-
-	// restore "selected" flags
-	for (auto& item : set) {
-		if (nullptr == item.laneseg) {
-			continue;
-		}
-		auto* langseg = reinterpret_cast<hdmap_laneseg_point_v1*>
-			(item.laneseg);
-		if (nullptr == langseg) {
-			return -ENOTAVAIL;
-		}
-		langseg->attrs.KNN_selected = 0;
-	}
-	
 	return count;
 }
 
@@ -581,9 +642,53 @@ int hdmap_impl::generate_lanesect_transition(const char* filepath) {
 			_lsc_transitions[lanesec_index] = lscts;
 		}
 	}
+	return build_lanesect_adjacency();
+}
+
+int hdmap_impl::build_lanesect_adjacency(void)
+{
+	auto* hdr = header();
+	if (nullptr == hdr) {
+		return -ENOTAVAIL;
+	}
+	_lsc_adj_offsets.assign(hdr->laneseg_count + 1, 0);
+	_lsc_adj_lanes.clear();
+
+	std::set<uint64_t> lanes;
+	for (uint64_t i = 0; i < hdr->laneseg_count; i++) {
+		_lsc_adj_offsets[i] = _lsc_adj_lanes.size();
+		auto it = _lsc_transitions.find(i);
+		if (it == _lsc_transitions.end() || nullptr == it->second) {
+			continue;
+		}
+		// the same rules as CalculateTransitionalProbability()
+		auto& lanesect = it->second;
+		lanes = lanesect->lsc_next_index;
+		auto left = lanesect->lsc_left_index.find(0);
+		if (left != lanesect->lsc_left_index.end()) {
+			lanes.insert(left->second);
+		}
+		auto right = lanesect->lsc_right_index.find(0);
+		if (right != lanesect->lsc_right_index.end()) {
+			lanes.insert(right->second);
+		}
+		lanes.erase(i);
+		_lsc_adj_lanes.insert(_lsc_adj_lanes.end(), lanes.begin(), lanes.end());
+	}
+	_lsc_adj_offsets[hdr->laneseg_count] = _lsc_adj_lanes.size();
 	return 0;
 }
 
+int hdmap_impl::get_lane_transitions(uint64_t lane_id, const uint64_t*& lanes)
+{
+	if (lane_id + 1 >= _lsc_adj_offsets.size()) {
+		lanes = nullptr;
+		return -ENOTFOUND;
+	}
+	lanes = _lsc_adj_lanes.data() + _lsc_adj_offsets[lane_id];
+	return int(_lsc_adj_offsets[lane_id + 1] - _lsc_adj_offsets[lane_id]);
+}
+
 bool hdmap_impl::is_in_lane(const hdmap_laneseg *hdls, double s, point3d &pt)
 {
 	auto* ls = reinterpret_cast<const hdmap_file_laneseg_v1*>(hdls);
@@ -702,44 +807,13 @@ std::vector<uint64_t> hdmap_impl::get_lanes_near_pt_enu(Eigen::Vector3d p3d, dou
 		return tmp;
 	}
 
-	double distance = 0.0;
-	point3d src(p3d[0], p3d[1]);
-	point3d des;
-	hdmap_lane_boundary_point_v1* lane_seg_point = nullptr;
-	std::vector<hdmap_lane_boundary_point_v1*> lanept;
-	for (int i = 0; i < hdr->laneseg_count; i++) {
-		auto* ls = &_lanesegs[i];
-		if (nullptr == ls || nullptr == ls->data.ptr) {
-			continue;
-		}
-
-		if (nullptr == ls->lane.ptr) {
-			continue;
-		}
-
-		size_t lssz = ls->data.ptr->extinfo.center_pts.size / sizeof(hdmap_lane_boundary_point_v1);
-		auto* lscenter = ls->data.ptr->extinfo.center_pts.ptr;
-		int index = 0;
-		for (index = 0; index < lssz; index++) {
-			if (index + 1 == lssz) {
-				break;
-			}
-			hdmap_lane_boundary_point_v1* start = &lscenter[index];
-			hdmap_lane_boundary_point_v1* end  = &lscenter[index+1];
-			get_line_projection_distance(&start->pt, &end->pt, src, des, distance);
-			if(distance < radius) {
-				if (!std::count(tmp.begin(), tmp.end(), i)) {
-					tmp.push_back(i);
-				}
-				break;
-			}
-		}
-	}
-
-	for (auto& item : lanept) {
-		item->attrs.KNN_selected = 0;
-	}
-
+	// the lane ids are returned in ascending order
+	std::set<uint64_t> lanes;
+	_centerline_kdtree.radius_search(p3d[0], p3d[1], radius,
+		[&lanes](segment_kdnode* seg, double) {
+		lanes.insert(seg->index);
+	});
+	tmp.assign(lanes.begin(), lanes.end());
 	return tmp;
 }
 
@@ -762,20 +836,16 @@ std::vector<uint64_t> hdmap_impl::get_lanes_near_pt_enu(std::vector<Eigen::Vecto
 		return tmp;
 	}
 
+	std::set<uint64_t> selected;
 	for (size_t sz = 0; sz < trajectory.size(); sz++) {
 		Eigen::Vector3d p3d = trajectory[sz];
 
 		std::vector<uint64_t> laneids = get_lanes_near_pt_enu(p3d, radius);
-		if (laneids.size() > 0) {
-			for (size_t i = 0; i < laneids.size(); i++) {
-				vector<uint64_t>::iterator it;
-				it=find(tmp.begin(),tmp.end(),laneids[i]);
-				if (it==tmp.end()){
-					tmp.push_back(laneids[i]);
-				}
+		for (auto laneid : laneids) {
+			if (selected.insert(laneid).second) {
+				tmp.push_back(laneid);
 			}
 		}
-		
 	}
 	return tmp;
 }
@@ -1120,47 +1190,32 @@ int hdmap_impl::get_neareast_points(point3d src, double hdg, std::map<uint64_t,
 	}
 	hdg = NormalizeAngle((90 - hdg) * DEG2RAD);
 
-	double calc_distance = 0.0;
-	hdmap_lane_boundary_point_v1* lane_seg_point = nullptr;
-	std::vector<hdmap_lane_boundary_point_v1*> lanept;
+	// keep the nearest boundary point for each laneseg
+	int ret = 0;
 	std::map<uint64_t, double> dismap;
-	for (int i = 0; i < hdr->laneseg_count; i++) {
-		lane_seg_point = kdtree2d_search(_lanebdy_kdtree,
-			src.xyz.x, src.xyz.y, calc_distance);
-		if (nullptr == lane_seg_point) {
-			return -5;
+	kdtree2d_radius_search(_lanebdy_kdtree, src.xyz.x, src.xyz.y, distance,
+		[&](hdmap_lane_boundary_point_v1* lane_seg_point, double calc_distance) {
+		if (ret) {
+			return;
 		}
 		if (lane_seg_point->laneseg_index >= hdr->laneseg_count) {
 			printf("lane seg point data error. point index %lu\n",
 				lane_seg_point->laneseg_index);
-			lanept.push_back(lane_seg_point);
-			for (auto& item : lanept) {
-				item->attrs.KNN_selected = 0;
-			}
-			return -6;
-		}
-
-		if (calc_distance > distance) {
-			continue;
+			ret = -6;
+			return;
 		}
 		uint64_t laneseg_index = lane_seg_point->laneseg_index;
+		auto it = dismap.find(laneseg_index);
+		if (it != dismap.end() && it->second <= calc_distance) {
+			return;
+		}
 		std::shared_ptr<hdmap_segment_point> segpoint = std::make_shared<hdmap_segment_point>();
 		segpoint->pt = lane_seg_point->pt;
 		segpoint->s = lane_seg_point->s;
-		if (points.count(laneseg_index) > 0 && dismap[laneseg_index] > calc_distance) {
-			dismap[laneseg_index] = calc_distance;
-			points[laneseg_index] = segpoint;
-		} 
-		else {
-			dismap[laneseg_index] = calc_distance;
-			points[laneseg_index] = segpoint;
-		}
-		lanept.push_back(lane_seg_point);
-	}
-	for (auto& item : lanept) {
-		item->attrs.KNN_selected = 0;
-	}
-	return 0;
+		dismap[laneseg_index] = calc_distance;
+		points[laneseg_index] = segpoint;
+	});
+	return ret;
 }
 
 int hdmap_impl::get_neareast_laneses(point3d p3d, double hdg, std::map<uint64_t, std::shared_ptr<hdmap_segment_point>> points, std::map<uint64_t, double> &lanesegs)
@@ -1521,20 +1576,16 @@ int hdmap_impl::get_neareast_laneseg(point3d &src,double &hdg, std::set<hdmap_fi
 
 	double distance = 10.0;
 	hdmap_lane_boundary_point_v1* lane_seg_point = nullptr;
-	std::vector<hdmap_lane_boundary_point_v1*> lanept;
+	kdtree2d_nearest_iterator<hdmap_lane_boundary_point_v1>
+		nearest(_lanebdy_kdtree, src.xyz.x, src.xyz.y);
 	for (int i = 0; i < hdr->laneseg_count; i++) {
-		lane_seg_point = kdtree2d_search(_lanebdy_kdtree,
-			src.xyz.x, src.xyz.y, distance);
+		lane_seg_point = nearest.next(distance);
 		if (nullptr == lane_seg_point) {
 			return -1;
 		}
 		if (lane_seg_point->laneseg_index >= hdr->laneseg_count) {
 			printf("lane seg point data error. point index %lu\n",
 				lane_seg_point->laneseg_index);
-			lanept.push_back(lane_seg_point);
-			for (auto& item : lanept) {
-				item->attrs.KNN_selected = 0;
-			}
 			return -1;
 		}
 		auto* ls = &_lanesegs[lane_seg_point->laneseg_index];
@@ -1591,11 +1642,9 @@ int hdmap_impl::get_neareast_laneseg(point3d &src,double &hdg, std::set<hdmap_fi
 			if (adf < M_PI_2 && adf > -M_PI_2) {
 				hdg = NormalizeAngle(M_PI_2 - pthdr) * RAD2DEG;
 				double s = POINT_DISTANCE(lane_seg_point->pt.xyz.x - src.xyz.x, lane_seg_point->pt.xyz.y - src.xyz.y);
-				lanept.push_back(lane_seg_point);
 				break;
 			}
 		}
-		lanept.push_back(lane_seg_point);
 		// todo 查找与hdg相符的lane
 		bpt = lane_seg_point;
 		auto *lls = &_lanesegs[lane_seg_point->laneseg_index];
@@ -1625,9 +1674,6 @@ int hdmap_impl::get_neareast_laneseg(point3d &src,double &hdg, std::set<hdmap_fi
 		}
 		lanesegs.insert(llaneseg);
 	}
-	for (auto& item : lanept) {
-		item->attrs.KNN_selected = 0;
-	}
 	return lanesegs.size();
 }
 
@@ -1762,20 +1808,16 @@ hdmap_file_laneseg_v1* hdmap_impl::find_laneseg_v1(point3d& src, double &hdg,
 
 	double distance = 0.0;
 	hdmap_lane_boundary_point_v1* lane_seg_point = nullptr;
-	std::vector<hdmap_lane_boundary_point_v1*> lanept;
+	kdtree2d_nearest_iterator<hdmap_lane_boundary_point_v1>
+		nearest(_lanebdy_kdtree, src.xyz.x, src.xyz.y);
 	for (int i = 0; i < hdr->laneseg_count; i++) {
-		lane_seg_point = kdtree2d_search(_lanebdy_kdtree,
-			src.xyz.x, src.xyz.y, distance);
+		lane_seg_point = nearest.next(distance);
 		if (nullptr == lane_seg_point) {
 			return nullptr;
 		}
 		if (lane_seg_point->laneseg_index >= hdr->laneseg_count) {
 			printf("lane seg point data error. point index %lu\n",
 				lane_seg_point->laneseg_index);
-			lanept.push_back(lane_seg_point);
-			for (auto& item : lanept) {
-				item->attrs.KNN_selected = 0;
-			}
 			return nullptr;
 		}
 		auto* ls = &_lanesegs[lane_seg_point->laneseg_index];
@@ -1832,14 +1874,9 @@ hdmap_file_laneseg_v1* hdmap_impl::find_laneseg_v1(point3d& src, double &hdg,
 			if (adf < M_PI_2 && adf > -M_PI_2) {
 				hdg = NormalizeAngle(M_PI_2 - pthdr) * RAD2DEG;
 				double s = POINT_DISTANCE(lane_seg_point->pt.xyz.x - src.xyz.x, lane_seg_point->pt.xyz.y - src.xyz.y);
-				lanept.push_back(lane_seg_point);
 				break;
 			}
 		}
-		lanept.push_back(lane_seg_point);
-	}
-	for (auto& item : lanept) {
-		item->attrs.KNN_selected = 0;
 	}
 	// todo 查找与hdg相符的lane
 	*bpt = lane_seg_point;
@@ -2173,6 +2210,15 @@ int hdmap::load_fromfile(const char* filename)
 	return map->load_fromfile(filename);
 }
 
+int hdmap::load_frombuffer(void* buffer, size_t sz)
+{
+	if (nullptr == _data) {
+		return -EINVALID;
+	}
+	auto* map = reinterpret_cast<hdmap_impl*>(_data);
+	return map->load_frombuffer(buffer, sz);
+}
+
 int hdmap::find_laneseg(double x, double y, int count,
 	vector<hdmap_nearest_laneseg>& set) const
 {
@@ -2234,6 +2280,19 @@ int hdmap::generate_lanesect_transition(const char* filepath)
 	return map->generate_lanesect_transition(filepath);
 }
 
+int hdmap::get_lane_transitions(uint64_t lane_id, const uint64_t*& lanes) const
+{
+	lanes = nullptr;
+	if (nullptr == _data) {
+		return -ENOTALLOWED;
+	}
+	auto* map = reinterpret_cast<hdmap_impl*>(_data);
+	if (!map->valid()) {
+		return -ENOTAVAIL;
+	}
+	return map->get_lane_transitions(lane_id, lanes);
+}
+
 const hdmap_road* hdmap::get_road_by_id(uint32_t rid) const
 {
 	if (nullptr == _data) {
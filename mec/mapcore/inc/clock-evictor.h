@@ -0,0 +1,194 @@
+/** @file clock-evictor.h
+ * byte budgeted CLOCK (second chance) eviction policy
+ */
+
+#ifndef __CXX_ZAS_MAPCORE_CLOCK_EVICTOR_H__
+#define __CXX_ZAS_MAPCORE_CLOCK_EVICTOR_H__
+
+#include <stdint.h>
+#include <map>
+
+namespace zas {
+namespace mapcore {
+
+class clock_evictor
+{
+public:
+	clock_evictor()
+	: _budget(0), _resident(0), _peak(0)
+	, _hand(0), _evictions(0), _evicted_bytes(0) {}
+
+	// 0 means unlimited
+	void set_budget(size_t bytes) {
+		_budget = bytes;
+	}
+
+	size_t budget(void) const {
+		return _budget;
+	}
+
+	size_t resident(void) const {
+		return _resident;
+	}
+
+	size_t peak(void) const {
+		return _peak;
+	}
+
+	uint64_t evictions(void) const {
+		return _evictions;
+	}
+
+	uint64_t evicted_bytes(void) const {
+		return _evicted_bytes;
+	}
+
+	size_t size(void) const {
+		return _entries.size();
+	}
+
+	bool over_budget(void) const {
+		return (_budget && _resident > _budget) ? true : false;
+	}
+
+	// add an entry or update its size, the entry is
+	// marked as referenced
+	void set(uint32_t id, size_t bytes)
+	{
+		auto& e = _entries[id];
+		_resident = _resident - e.bytes + bytes;
+		e.bytes = bytes;
+		e.referenced = true;
+		if (_resident > _peak) _peak = _resident;
+	}
+
+	// update the size of an existing entry
+	void resize(uint32_t id, size_t bytes)
+	{
+		auto iter = _entries.find(id);
+		if (iter == _entries.end()) {
+			return;
+		}
+		_resident = _resident - iter->second.bytes + bytes;
+		iter->second.bytes = bytes;
+		if (_resident > _peak) _peak = _resident;
+	}
+
+	// bytes shared by several entries, like the buffer of a
+	// tile holding many blocks: they are not freed by evicting
+	// one entry but when the last entry sharing them goes
+	void charge(size_t bytes)
+	{
+		_resident += bytes;
+		if (_resident > _peak) _peak = _resident;
+	}
+
+	void discharge(size_t bytes)
+	{
+		_resident -= bytes;
+	}
+
+	// shared bytes freed as the result of an eviction
+	void evicted_shared(size_t bytes)
+	{
+		_evicted_bytes += bytes;
+	}
+
+	void remove(uint32_t id)
+	{
+		auto iter = _entries.find(id);
+		if (iter == _entries.end()) {
+			return;
+		}
+		_resident -= iter->second.bytes;
+		_entries.erase(iter);
+	}
+
+	void touch(uint32_t id)
+	{
+		auto iter = _entries.find(id);
+		if (iter != _entries.end()) {
+			iter->second.referenced = true;
+		}
+	}
+
+	// a pinned entry is never selected as a victim
+	void pin(uint32_t id, bool pinned)
+	{
+		auto iter = _entries.find(id);
+		if (iter != _entries.end()) {
+			iter->second.pinned = pinned;
+		}
+	}
+
+	bool pinned(uint32_t id) const
+	{
+		auto iter = _entries.find(id);
+		return (iter != _entries.end() && iter->second.pinned)
+			? true : false;
+	}
+
+	// select the next victim: sweep from the hand, clear the
+	// referenced bit of the visited entries and stop at the
+	// first unreferenced one; returns false if all entries are
+	// pinned. the caller shall evict the entry and call evicted()
+	bool select_victim(uint32_t& id)
+	{
+		if (_entries.empty()) {
+			return false;
+		}
+		// two rounds at most: the first one clears
+		// all referenced bits
+		size_t steps = _entries.size() * 2;
+		auto iter = _entries.lower_bound(_hand);
+		for (size_t i = 0; i < steps; ++i, ++iter) {
+			if (iter == _entries.end()) {
+				iter = _entries.begin();
+			}
+			auto& e = iter->second;
+			if (e.pinned) {
+				continue;
+			}
+			if (e.referenced) {
+				e.referenced = false;
+				continue;
+			}
+			id = iter->first;
+			_hand = id + 1;
+			return true;
+		}
+		return false;
+	}
+
+	void evicted(uint32_t id)
+	{
+		auto iter = _entries.find(id);
+		if (iter == _entries.end()) {
+			return;
+		}
+		++_evictions;
+		_evicted_bytes += iter->second.bytes;
+		remove(id);
+	}
+
+private:
+	struct entry
+	{
+		entry() : bytes(0), referenced(false), pinned(false) {}
+		size_t bytes;
+		bool referenced;
+		bool pinned;
+	};
+
+	size_t _budget;
+	size_t _resident;
+	size_t _peak;
+	uint32_t _hand;
+	uint64_t _evictions;
+	uint64_t _evicted_bytes;
+	std::map<uint32_t, entry> _entries;
+};
+
+}} // end of namespace zas::mapcore
+#endif // __CXX_ZAS_MAPCORE_CLOCK_EVICTOR_H__
+/* EOF */
@@ -8,6 +8,7 @@
 #include <set>
 
 #include "inc/hdmap-format.h"
+#include "inc/segment-kdtree.h"
 #include "mapcore/hdmap.h"
 #include "std/list.h"
 #include "utils/avltree.h"
@@ -59,6 +60,9 @@ public:
 	// load from file
 	int load_fromfile(const char *filename);
 
+	// load from a caller owned buffer (zero-copy)
+	int load_frombuffer(void* buffer, size_t sz);
+
 	int find_laneseg(double x, double y, int count,
 		vector<hdmap_nearest_laneseg>& set);
 	const hdmap_road* get_road_by_id(uint32_t rid);
@@ -86,6 +90,7 @@ public:
 	std::vector<Eigen::Vector3d> get_curve(uint64_t lane_id,CurveType type = CurveType::center_curve);
 	double get_distance_pt_closest_central_line_enu(const Eigen::Vector3d &pt_enu, Eigen::Vector3d &cross_pt_map_enu);
 	int	generate_lanesect_transition(const char* filepath);
+	int get_lane_transitions(uint64_t lane_id, const uint64_t*& lanes);
 	
 	public:
 	bool valid(void) { return (_f.valid) ? true : false; }
@@ -102,12 +107,15 @@ private:
 	void release_all(void);
 	int check_validity(void);
 	int loadfile(const char *filename);
+	int setup_buffer(void);
 	int fix_ref(void);
 	// int optimize_junctions(void);
 	int update_hdmap_info(void);
 	int update_hdmap_data(int blockid);
 	int remove_hdmap_date(int blockid);
 	int finalize(void);
+	int build_centerline_index(void);
+	int build_lanesect_adjacency(void);
 	int drawmap(void);
 	int get_refline_point(hdmap_file_roadseg_v1* rs, double s, point3d& pt);
 	int get_center_point(hdmap_lane_boundary_point_v1* bpt,
@@ -151,10 +159,12 @@ private:
 	int _refcnt;
 	uint8_t *_buffer;
 	size_t _buffer_end;
+	size_t _buffer_size;
 	union {
 		uint32_t _flags;
 		struct {
 			uint32_t valid : 1;
+			uint32_t external_buffer : 1;
 		} _f;
 	};
 
@@ -164,8 +174,14 @@ private:
 	hdmap_file_laneseg_v1* _lanesegs;
 	hdmap_laneseg_point_v1* _laneseg_kdtree;
 	hdmap_lane_boundary_point_v1* _lanebdy_kdtree;
+	// kd-tree of all lane center line segments
+	segment_kdtree _centerline_kdtree;
 	std::map<int, std::map<double, point3d>*> _lanesegs_center;
 	std::map<uint64_t, std::shared_ptr<hdmap_lanesect_transition>> _lsc_transitions;
+	// compact adjacency of _lsc_transitions: the lanes could be transited
+	// from lane i are _lsc_adj_lanes[_lsc_adj_offsets[i] ... _lsc_adj_offsets[i + 1])
+	std::vector<uint64_t> _lsc_adj_offsets;
+	std::vector<uint64_t> _lsc_adj_lanes;
 	
 	proj _wgs84prj;
 	ZAS_DISABLE_EVIL_CONSTRUCTOR(hdmap_impl);
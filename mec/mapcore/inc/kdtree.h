@@ -5,84 +5,201 @@
 #define __CXX_ZAS_MAPCORE_KDTREE_BASE_H__
 
 #include <stack>
+#include <queue>
+#include <utility>
+#include <algorithm>
 #include <math.h>
 #include <float.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace zas {
 namespace mapcore {
 
 using namespace std;
 
+template <typename T> struct kdtree2d_neighbor
+{
+	T* node;
+	double distance;
+};
+
+template <typename T> static bool
+kdtree2d_neighbor_compare(const kdtree2d_neighbor<T>& a,
+	const kdtree2d_neighbor<T>& b)
+{
+	return (a.distance < b.distance);
+}
+
+// search the "k" nearest nodes of <x, y>, the result is stored
+// in "result" (with at least "k" items) in ascending order of the
+// distance; return the count of nodes found
+// the search keeps a bounded max-heap in "result" and all the
+// other states on the stack of the caller, the tree itself is
+// not touched, so it is safe to be called from multiple threads
+template <typename T> static int
+kdtree2d_knn_search(T* kdtree, double x, double y, int k,
+	kdtree2d_neighbor<T>* result)
+{
+	if (nullptr == kdtree || k <= 0 || nullptr == result) {
+		return 0;
+	}
+
+	int count = 0;
+	// <node, lower bound of distance of the sub space>
+	stack<pair<T*, double>> search_path;
+	search_path.push(make_pair(kdtree, 0.));
+
+	while (search_path.size()) {
+		T* s = search_path.top().first;
+		double bound = search_path.top().second;
+		search_path.pop();
+
+		// the sub space is farther than the worst one we have
+		if (count == k && bound >= result[0].distance) {
+			continue;
+		}
+
+		double d = s->distance(x, y);
+		if (count < k) {
+			result[count].node = s;
+			result[count++].distance = d;
+			push_heap(result, result + count, kdtree2d_neighbor_compare<T>);
+		} else if (d < result[0].distance) {
+			pop_heap(result, result + count, kdtree2d_neighbor_compare<T>);
+			result[count - 1].node = s;
+			result[count - 1].distance = d;
+			push_heap(result, result + count, kdtree2d_neighbor_compare<T>);
+		}
+
+		double diff = (!s->get_split()) ? (x - s->x()) : (y - s->y());
+		T* near = (T*)((diff <= 0) ? s->get_left() : s->get_right());
+		T* far = (T*)((diff <= 0) ? s->get_right() : s->get_left());
+
+		// push the far one first so that the near one is searched first
+		if (far) {
+			double fbound = fabs(diff);
+			search_path.push(make_pair(far, (fbound > bound) ? fbound : bound));
+		}
+		if (near) search_path.push(make_pair(near, bound));
+	}
+
+	sort_heap(result, result + count, kdtree2d_neighbor_compare<T>);
+	return count;
+}
+
+// search the nearest node of <x, y>
 template <typename T> static T*
 kdtree2d_search(T* kdtree, double x, double y, double &dist)
 {
-    double d = DBL_MAX;
-    T* nearest;
-	T* s = kdtree;
-	stack<T*> search_path;
-        
-    while(s != nullptr) {
-		search_path.push(s);
-		if (!s->get_split()) {
-			s = (T*)((x <= s->x()) ? s->get_left() : s->get_right());
-		} else {
-			s = (T*)((y <= s->y()) ? s->get_left() : s->get_right());
+	kdtree2d_neighbor<T> nearest;
+	if (!kdtree2d_knn_search(kdtree, x, y, 1, &nearest)) {
+		dist = DBL_MAX;
+		return nullptr;
+	}
+	dist = nearest.distance;
+	return nearest.node;
+}
+
+// enumerate nodes from the nearest one to the farthest one, one by
+// one, for the caller who does not know how many nodes are needed
+// the iterator shall be defined as a local variable of the caller
+template <typename T> class kdtree2d_nearest_iterator
+{
+public:
+	kdtree2d_nearest_iterator(T* kdtree, double x, double y)
+	: _x(x), _y(y) {
+		if (kdtree) _queue.push(entry(0., kdtree, false));
+	}
+
+	// get the next nearest node, nullptr if all nodes are enumerated
+	T* next(double& dist)
+	{
+		while (_queue.size()) {
+			entry e = _queue.top();
+			_queue.pop();
+			if (e.point) {
+				dist = e.distance;
+				return e.node;
+			}
+
+			T* s = e.node;
+			_queue.push(entry(s->distance(_x, _y), s, true));
+
+			double diff = (!s->get_split()) ? (_x - s->x()) : (_y - s->y());
+			T* near = (T*)((diff <= 0) ? s->get_left() : s->get_right());
+			T* far = (T*)((diff <= 0) ? s->get_right() : s->get_left());
+			if (near) _queue.push(entry(e.distance, near, false));
+			if (far) {
+				double fbound = fabs(diff);
+				_queue.push(entry((fbound > e.distance)
+					? fbound : e.distance, far, false));
+			}
 		}
+		dist = DBL_MAX;
+		return nullptr;
 	}
 
-	// get the last node in search path as the "nearest"
-	nearest = search_path.top();
-	search_path.pop();
-	if (!nearest->KNN_selected()) {
-		d = nearest->distance(x, y);     
+private:
+	struct entry
+	{
+		entry(double d, T* n, bool p)
+		: distance(d), node(n), point(p) {}
+
+		// for priority_queue: smallest distance on top
+		bool operator<(const entry& e) const {
+			return (distance > e.distance);
+		}
+
+		// for a point: the distance to the node
+		// for a sub space: the lower bound of the distance
+		double distance;
+		T* node;
+		bool point;
+	};
+	double _x, _y;
+	priority_queue<entry> _queue;
+};
+
+// walk the kd-tree and invoke "cb(node, dist)" for every node
+// whose distance to <x, y> is not larger than "radius"
+// all the search states are kept on the stack of the caller, the
+// tree itself is not touched, so it is safe to be called from
+// multiple threads concurrently
+template <typename T, typename F> static int
+kdtree2d_radius_search(T* kdtree, double x, double y, double radius, F cb)
+{
+	if (nullptr == kdtree || radius < 0.) {
+		return 0;
 	}
 
-    // re-walk the search path
-    T* back;
+	int count = 0;
+	stack<T*> search_path;
+	search_path.push(kdtree);
+
 	while (search_path.size()) {
-		// get the last node in search path for back
-        back = search_path.top();    
-        search_path.pop();
-
-		double tmp = (back->KNN_selected())
-			? DBL_MAX : back->distance(x, y);
-		
-		// if the back is a leaf
-		if (!back->get_left() && !back->get_right()) {	
-			if (d > tmp) {
-				nearest = back; d = tmp;
-			}
-			continue;
+		T* s = search_path.top();
+		search_path.pop();
+
+		double d = s->distance(x, y);
+		if (d <= radius) {
+			cb(s, d); ++count;
 		}
 
-		int split = back->get_split();
-		if (split == 0) {
-			// if the circle with <y, x> as center point and d as radius be intersected
-			// with the other sub space, move to the other sub space for searching
-			if (fabs(back->x() - x) < d) {
-				if (d > tmp) {
-					nearest = back; d = tmp;
-				}
-
-				// if the <y,x> is located at left of <back>, move to right
-				// sub space for searching
-				s = (T*)((x <= back->x()) ? back->get_right() : back->get_left());
-				if (s) search_path.push(s);
-			}
-		} else {
-			if (fabs(back->y() - y) < d) {
-				if (d > tmp) {
-					nearest = back; d = tmp;
-				}  
-				// see comments above
-				s = (T*)((y <= back->y()) ? back->get_right() : back->get_left());
-				if (s) search_path.push(s);
-			}
+		// distance to the split plane
+		double diff = (!s->get_split()) ? (x - s->x()) : (y - s->y());
+		T* near = (T*)((diff <= 0) ? s->get_left() : s->get_right());
+		T* far = (T*)((diff <= 0) ? s->get_right() : s->get_left());
+
+		// only step into the other sub space when the circle
+		// intersects with the split plane
+		if (far && fabs(diff) <= radius) {
+			search_path.push(far);
 		}
+		if (near) search_path.push(near);
 	}
-	dist = d;
-	nearest->KNN_select();
-	return nearest;
+	return count;
 }
 
 template <typename T> static void choose_split(T** exm_set, int size, int &split)
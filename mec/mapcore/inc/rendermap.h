@@ -180,6 +180,16 @@ public:
 
 	const shared_ptr<odr::RoadNetworkMesh> generate_mesh(uint32_t blkid);
 
+	// generate_mesh() in 3 steps so that the expensive tessellation
+	// could be done without holding the tilecache lock:
+	// prepare_mesh() claims the mesh-gen ownership of the objects and
+	// deserializes the block (shall be called with the lock held),
+	// build_mesh() only works on the deserialized OpenDriveMap and
+	// commit_mesh() publishes the mesh (with the lock held)
+	int prepare_mesh(uint32_t blkid, OpenDriveMap& odrm);
+	static shared_ptr<odr::RoadNetworkMesh> build_mesh(OpenDriveMap& odrm);
+	void commit_mesh(uint32_t blkid, const shared_ptr<odr::RoadNetworkMesh>& mesh);
+
 	int extract_roadobjects(int blkid, const set<uint32_t>& categories,
 		set<const rendermap_roadobject*>& objects, bool reset);
 	bool check_classified_type_validty(const set<uint32_t>& categories);
@@ -310,6 +320,9 @@ private:
 	int _active_blkcnt;
 	uint8_t* _buffer;
 	size_t _buffer_end;
+	// the buffer bytes charged to the memory budget of
+	// the tilecache, released with the map
+	size_t _charged_bytes;
 	union {
 		uint32_t _flags;
 		struct {
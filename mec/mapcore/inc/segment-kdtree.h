@@ -0,0 +1,225 @@
+/** @file segment-kdtree.h
+ * kd-tree of line segments, used for range query of lane center lines
+ */
+
+#ifndef __CXX_ZAS_MAPCORE_SEGMENT_KDTREE_H__
+#define __CXX_ZAS_MAPCORE_SEGMENT_KDTREE_H__
+
+#include <stdint.h>
+#include <vector>
+#include "inc/kdtree.h"
+
+namespace zas {
+namespace mapcore {
+
+// the max length of a segment piece in the kd-tree
+#define SEGMENT_KDTREE_MAX_PIECE_LEN	(20.)
+
+struct segment_kdnode
+{
+	// the two end points of the segment
+	double x1, y1, x2, y2;
+
+	// middle point of the segment (kd-tree key)
+	double cx, cy;
+
+	// half length of the segment
+	double halflen;
+
+	// the index of the object this segment belongs to
+	uint64_t index;
+
+	// kd-tree
+	segment_kdnode *left, *right;
+	struct {
+		uint32_t split : 1;
+		uint32_t KNN_selected : 1;
+	} attrs;
+
+	double x(void) {
+		return cx;
+	}
+	double y(void) {
+		return cy;
+	}
+	int get_split(void) {
+		return attrs.split;
+	}
+	void set_split(int s) {
+		attrs.split = (s) ? 1 : 0;
+	}
+	bool KNN_selected(void) {
+		return (attrs.KNN_selected) ? true : false;
+	}
+	void KNN_select(void) {
+		attrs.KNN_selected = 1;
+	}
+	void set_left(segment_kdnode* l) {
+		left = l;
+	}
+	void set_right(segment_kdnode* r) {
+		right = r;
+	}
+	segment_kdnode* get_left(void) {
+		return left;
+	}
+	segment_kdnode* get_right(void) {
+		return right;
+	}
+
+	// distance from <x, y> to the middle point
+	double distance(double x, double y) {
+		auto dx = (cx - x);
+		auto dy = (cy - y);
+		return sqrt(dx * dx + dy * dy);
+	}
+
+	// distance from <x, y> to the segment
+	// same as hdmap_impl::get_line_projection_distance()
+	double segment_distance(double x, double y) {
+		double cross = (x2 - x1) * (x - x1) + (y2 - y1) * (y - y1);
+		if (cross <= 0) {
+			return sqrt((x - x1) * (x - x1) + (y - y1) * (y - y1));
+		}
+		double d2 = (x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1);
+		if (cross >= d2) {
+			return sqrt((x - x2) * (x - x2) + (y - y2) * (y - y2));
+		}
+		double r = cross / d2;
+		double px = x1 + (x2 - x1) * r - x;
+		double py = y1 + (y2 - y1) * r - y;
+		return sqrt(px * px + py * py);
+	}
+
+	static int kdtree_x_compare(const void* a, const void* b) {
+		auto* aa = *((segment_kdnode**)a);
+		auto* bb = *((segment_kdnode**)b);
+		if (aa->cx > bb->cx) {
+			return 1;
+		} else if (aa->cx < bb->cx) {
+			return -1;
+		} else return 0;
+	}
+
+	static int kdtree_y_compare(const void* a, const void* b) {
+		auto* aa = *((segment_kdnode**)a);
+		auto* bb = *((segment_kdnode**)b);
+		if (aa->cy > bb->cy) {
+			return 1;
+		} else if (aa->cy < bb->cy) {
+			return -1;
+		} else return 0;
+	}
+};
+
+class segment_kdtree
+{
+public:
+	segment_kdtree() : _root(nullptr), _max_halflen(0.) {}
+	~segment_kdtree() { release(); }
+
+	// add a segment, only allowed before build()
+	// long segments are split into pieces so that the search
+	// radius enlarged by "_max_halflen" keeps small
+	int add(uint64_t index, double x1, double y1, double x2, double y2)
+	{
+		if (nullptr != _root) {
+			return -1;
+		}
+		double len = sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+		int pieces = (int)ceil(len / SEGMENT_KDTREE_MAX_PIECE_LEN);
+		if (pieces < 1) pieces = 1;
+
+		double px = x1, py = y1;
+		for (int i = 1; i <= pieces; ++i) {
+			double nx = (i == pieces) ? x2 : x1 + (x2 - x1) * i / pieces;
+			double ny = (i == pieces) ? y2 : y1 + (y2 - y1) * i / pieces;
+			add_piece(index, px, py, nx, ny);
+			px = nx, py = ny;
+		}
+		return 0;
+	}
+
+	// build the kd-tree with all added segments
+	int build(void)
+	{
+		if (nullptr != _root) {
+			return -1;
+		}
+		if (_nodes.empty()) {
+			return 0;
+		}
+		std::vector<segment_kdnode*> table;
+		table.reserve(_nodes.size());
+		for (auto& node : _nodes) {
+			table.push_back(&node);
+		}
+		return build_kdtree(_root, table.data(), (int)table.size());
+	}
+
+	void release(void)
+	{
+		_root = nullptr;
+		_max_halflen = 0.;
+		std::vector<segment_kdnode>().swap(_nodes);
+	}
+
+	bool empty(void) const {
+		return (nullptr == _root);
+	}
+
+	size_t size(void) const {
+		return _nodes.size();
+	}
+
+	// invoke "cb(node, dist)" for every segment whose distance
+	// to <x, y> is less than "radius"; one index may be reported
+	// several times, the caller shall do the dedupe by itself
+	template <typename F>
+	int radius_search(double x, double y, double radius, F cb) const
+	{
+		// a segment may reach the circle only if its middle point
+		// is within (radius + halflen) of <x, y>
+		int count = 0;
+		kdtree2d_radius_search(_root, x, y, radius + _max_halflen,
+			[&](segment_kdnode* node, double cdist) {
+			if (cdist - node->halflen >= radius) {
+				return;
+			}
+			double d = node->segment_distance(x, y);
+			if (d < radius) {
+				cb(node, d); ++count;
+			}
+		});
+		return count;
+	}
+
+private:
+	void add_piece(uint64_t index, double x1, double y1, double x2, double y2)
+	{
+		segment_kdnode node;
+		node.x1 = x1, node.y1 = y1;
+		node.x2 = x2, node.y2 = y2;
+		node.cx = (x1 + x2) / 2.;
+		node.cy = (y1 + y2) / 2.;
+		node.halflen = sqrt((x2 - x1) * (x2 - x1)
+			+ (y2 - y1) * (y2 - y1)) / 2.;
+		node.index = index;
+		node.left = node.right = nullptr;
+		node.attrs.split = 0;
+		node.attrs.KNN_selected = 0;
+		if (node.halflen > _max_halflen) {
+			_max_halflen = node.halflen;
+		}
+		_nodes.push_back(node);
+	}
+
+private:
+	std::vector<segment_kdnode> _nodes;
+	segment_kdnode* _root;
+	double _max_halflen;
+};
+
+}} // end of namespace zas::mapcore
+#endif // __CXX_ZAS_MAPCORE_SEGMENT_KDTREE_H__
+/* EOF */
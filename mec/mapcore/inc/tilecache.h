@@ -5,11 +5,14 @@
 #define __CXX_ZAS_MAPCORE_TILECACHE_IMPL_H__
 
 #include <map>
+#include <future>
 #include "std/list.h"
 #include "utils/mutex.h"
 #include "rendermap.h"
 
 #include "inc/maputils.h"
+#include "inc/worker-pool.h"
+#include "inc/clock-evictor.h"
 
 // todo: re-arrange the following header
 #include "inc/gbuf.h"
@@ -24,7 +27,7 @@ using namespace render_hdmap;
 struct blockcache
 {
 	blockcache(rendermap_impl* m, blockinfo_v1* b)
-	: attrs(0), map(m), block(b) {}
+	: attrs(0), map(m), block(b), mesh_bytes(0) {}
 	union {
 		uint32_t attrs;
 		struct {
@@ -34,6 +37,32 @@ struct blockcache
 	rendermap_impl* map;
 	blockinfo_v1* block;
 	weak_ptr<RoadNetworkMesh> mesh;
+
+	// bytes of the generated mesh charged to this block,
+	// the tile buffer is charged to its rendermap
+	size_t mesh_bytes;
+};
+
+typedef shared_ptr<const odr::RoadNetworkMesh> mesh_ptr;
+
+// an in-flight mesh generation of one block, all requesters
+// of the same block share the same job
+struct mesh_job
+{
+	mesh_job(uint32_t id) : blkid(id), attrs(0) {
+		future = result.get_future().share();
+	}
+	uint32_t blkid;
+	union {
+		uint32_t attrs;
+		struct {
+			uint32_t started : 1;
+			uint32_t cancelled : 1;
+		} a;
+	};
+	promise<mesh_ptr> result;
+	shared_future<mesh_ptr> future;
+	vector<tilecache::mesh_callback> callbacks;
 };
 
 struct ref_bitmap
@@ -66,6 +95,11 @@ public:
 	int add_tile(const void* buffer, size_t sz,
 		rendermap_impl** = nullptr);
 	shared_ptr<const odr::RoadNetworkMesh> get_mesh(uint32_t blkid, bool* g);
+	int get_mesh_async(uint32_t blkid, tilecache::mesh_callback cb);
+	shared_future<mesh_ptr> get_mesh_future(uint32_t blkid);
+	int config_mesh_workers(int workers, int max_pending, int prefetch_radius);
+	int set_memory_budget(size_t bytes);
+	int get_stats(tilecache_stats& stats);
 	int release_mesh(uint32_t blkid);
 	int query_loaded_blocks(const vector<point2d>& pts, set<uint32_t>& blkids);
 	int query_unloaded_blocks(const vector<point2d>& pts, set<uint32_t>& blkids);
@@ -113,6 +147,14 @@ private:
 		const vector<point>&, set<uint32_t>&);
 	int block_in_polygon(uint32_t blkid, const vector<point>&);
 	
+	shared_ptr<mesh_job> get_mesh_job_unlocked(uint32_t blkid, bool& created);
+	void detach_mesh_job_unlocked(const shared_ptr<mesh_job>& job);
+	bool cancel_mesh_job_unlocked(uint32_t blkid);
+	int post_mesh_job_unlocked(const shared_ptr<mesh_job>& job, bool prefetch);
+	void run_mesh_job(const shared_ptr<mesh_job>& job, bool cancelled);
+	void prefetch_neighbors_unlocked(uint32_t blkid);
+	void shrink_unlocked(void);
+
 	rendermap_impl* getmap_byaddr_unlocked(void* addr);
 	void release_block_unlocked(uint32_t, blockcache*);
 	int check_release_rendermap_unlocked(rendermap_impl* map);
@@ -126,6 +168,16 @@ private:
 	// indicate the pending mesh re-generation blocks
 	set<uint32_t> _mesh_expired_blocks;
 
+	// in-flight mesh generations and the workers running them
+	map<uint32_t, shared_ptr<mesh_job>> _mesh_jobs;
+	worker_pool _mesh_workers;
+	int _prefetch_radius;
+
+	// memory accounting and eviction of blocks
+	clock_evictor _evictor;
+	uint64_t _mesh_hits;
+	uint64_t _mesh_misses;
+
 	listnode_t _maplist;
 	avl_node_t* _maptree;
 	rendermap_v1 _mapinfo;
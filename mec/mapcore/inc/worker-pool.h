@@ -0,0 +1,140 @@
+/** @file worker-pool.h
+ * a small bounded pool of worker threads
+ */
+
+#ifndef __CXX_ZAS_MAPCORE_WORKER_POOL_H__
+#define __CXX_ZAS_MAPCORE_WORKER_POOL_H__
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include "std/zasbsc.h"
+
+namespace zas {
+namespace mapcore {
+
+class worker_pool
+{
+public:
+	// the task is always invoked exactly once, "cancelled" is true
+	// if the pool is shutting down before the task is executed
+	typedef std::function<void(bool cancelled)> task;
+
+	worker_pool(int workers = 2, int max_pending = 64)
+	: _workers(workers), _max_pending(max_pending), _stop(false) {}
+	~worker_pool() { shutdown(); }
+
+	// change the configuration, only allowed before
+	// the first task is posted
+	int config(int workers, int max_pending)
+	{
+		if (workers < 1 || max_pending < 1) {
+			return -EBADPARM;
+		}
+		std::lock_guard<std::mutex> lk(_mut);
+		if (_threads.size()) {
+			return -ENOTALLOWED;
+		}
+		_workers = workers;
+		_max_pending = max_pending;
+		return 0;
+	}
+
+	// add a task to the pool, the worker threads are created
+	// on the first post. background tasks (like prefetching) are
+	// always scheduled after foreground ones and are refused when
+	// the queue is half full
+	int post(task t, bool background = false)
+	{
+		std::lock_guard<std::mutex> lk(_mut);
+		if (_stop) {
+			return -ENOTALLOWED;
+		}
+		size_t pending = _foreground.size() + _background.size();
+		size_t limit = (background) ? (_max_pending / 2) : _max_pending;
+		if (pending >= limit) {
+			return -ETOOMANYITEMS;
+		}
+		if (_threads.empty()) {
+			for (int i = 0; i < _workers; ++i) {
+				_threads.emplace_back(&worker_pool::run, this);
+			}
+		}
+		if (background) {
+			_background.push_back(std::move(t));
+		} else {
+			_foreground.push_back(std::move(t));
+		}
+		_cond.notify_one();
+		return 0;
+	}
+
+	size_t pending(void)
+	{
+		std::lock_guard<std::mutex> lk(_mut);
+		return _foreground.size() + _background.size();
+	}
+
+	// stop all workers, tasks not started yet are
+	// invoked with "cancelled = true"
+	void shutdown(void)
+	{
+		std::vector<std::thread> threads;
+		std::deque<task> dropped;
+		{
+			std::lock_guard<std::mutex> lk(_mut);
+			_stop = true;
+			threads.swap(_threads);
+			dropped.swap(_foreground);
+			dropped.insert(dropped.end(),
+				_background.begin(), _background.end());
+			_background.clear();
+			_cond.notify_all();
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		for (auto& t : dropped) {
+			t(true);
+		}
+	}
+
+private:
+	void run(void)
+	{
+		for (;;) {
+			task t;
+			{
+				std::unique_lock<std::mutex> lk(_mut);
+				_cond.wait(lk, [this] {
+					return _stop || !_foreground.empty()
+						|| !_background.empty();
+				});
+				if (_stop) {
+					return;
+				}
+				auto& q = (_foreground.empty()) ? _background : _foreground;
+				t = std::move(q.front());
+				q.pop_front();
+			}
+			t(false);
+		}
+	}
+
+private:
+	int _workers;
+	int _max_pending;
+	bool _stop;
+	std::deque<task> _foreground;
+	std::deque<task> _background;
+	std::vector<std::thread> _threads;
+	std::mutex _mut;
+	std::condition_variable _cond;
+};
+
+}} // end of namespace zas::mapcore
+#endif // __CXX_ZAS_MAPCORE_WORKER_POOL_H__
+/* EOF */
@@ -1,4 +1,5 @@
 #include <set>
+#include <vector>
 #include <math.h>
 
 #include "proj.h"
@@ -28,9 +29,11 @@ public:
 		if (nullptr == _prj) {
 			return {0, 0, 0};
 		}
-		PJ_COORD s = proj_coord(src.v[0], src.v[1], src.v[2], 0);
-		PJ_COORD r = proj_trans(_prj, (inv) ? PJ_INV : PJ_FWD, s);
-		return { r.v[0], r.v[1], r.v[2] };
+		point3d ret;
+		if (_local.enabled && _local.transform(src, ret, inv)) {
+			return ret;
+		}
+		return exact_transform(src, inv);
 	}
 
 	void transform_point(point3d& src, bool inv) {
@@ -38,9 +41,128 @@ public:
 			src.set(0., 0.);
 			return;
 		}
-		PJ_COORD s = proj_coord(src.v[0], src.v[1], src.v[2], 0);
-		PJ_COORD r = proj_trans(_prj, (inv) ? PJ_INV : PJ_FWD, s);
-		src.set(r.v[0], r.v[1], r.v[2]);
+		point3d ret;
+		if (_local.enabled && _local.transform(src, ret, inv)) {
+			src = ret; return;
+		}
+		src = exact_transform(src, inv);
+	}
+
+	int transform(double* x, double* y, double* z,
+		size_t stride, size_t count, bool inv)
+	{
+		if (nullptr == _prj) {
+			return -ENOTREADY;
+		}
+		if (!_local.enabled) {
+			return exact_transform(x, y, z, stride, count, inv);
+		}
+
+		// the coordinations out of the local area go to PROJ
+		_remains.clear();
+		point3d src, dst;
+		for (size_t i = 0; i < count; ++i) {
+			size_t off = i * stride;
+			double* px = (double*)((char*)x + off);
+			double* py = (double*)((char*)y + off);
+			double* pz = (z) ? (double*)((char*)z + off) : nullptr;
+			src.set(*px, *py, (pz) ? *pz : 0.);
+			if (!_local.transform(src, dst, inv)) {
+				_remains.push_back(i);
+				continue;
+			}
+			*px = dst.v[0], *py = dst.v[1];
+			if (pz) *pz = dst.v[2];
+		}
+		if (_remains.empty()) {
+			return (int)count;
+		}
+
+		// gathered as x, y, z triples
+		_buffer.resize(_remains.size() * 3);
+		for (size_t i = 0; i < _remains.size(); ++i) {
+			size_t off = _remains[i] * stride;
+			_buffer[i * 3] = *(double*)((char*)x + off);
+			_buffer[i * 3 + 1] = *(double*)((char*)y + off);
+			_buffer[i * 3 + 2] = (z) ? *(double*)((char*)z + off) : 0.;
+		}
+		int ret = exact_transform(&_buffer[0], &_buffer[1], &_buffer[2],
+			sizeof(double) * 3, _remains.size(), inv);
+		if (ret < 0) {
+			return ret;
+		}
+		for (size_t i = 0; i < _remains.size(); ++i) {
+			size_t off = _remains[i] * stride;
+			*(double*)((char*)x + off) = _buffer[i * 3];
+			*(double*)((char*)y + off) = _buffer[i * 3 + 1];
+			if (z) *(double*)((char*)z + off) = _buffer[i * 3 + 2];
+		}
+		return (int)(count - _remains.size()) + ret;
+	}
+
+	int set_local_area(const point3d& origin, double range, double tolerance)
+	{
+		if (nullptr == _prj) {
+			return -ENOTREADY;
+		}
+		if (range <= 0. || tolerance <= 0.) {
+			return -EBADPARM;
+		}
+		_local.enabled = false;
+
+		// derivatives by central differences
+		local_area la;
+		la.origin = origin;
+		la.range = range;
+		la.dst_origin = exact_transform(origin, false);
+		const double h = range * .1;
+		auto f = [&](double dx, double dy, double dz) {
+			return exact_transform(point3d(origin.v[0] + dx,
+				origin.v[1] + dy, origin.v[2] + dz), false);
+		};
+		point3d fx1 = f(h, 0, 0), fx2 = f(-h, 0, 0);
+		point3d fy1 = f(0, h, 0), fy2 = f(0, -h, 0);
+		point3d fz1 = f(0, 0, 1.), fz2 = f(0, 0, -1.);
+		point3d fpp = f(h, h, 0), fpm = f(h, -h, 0);
+		point3d fmp = f(-h, h, 0), fmm = f(-h, -h, 0);
+		for (int r = 0; r < 3; ++r) {
+			double f0 = la.dst_origin.v[r];
+			la.jacob[r][0] = (fx1.v[r] - fx2.v[r]) / (2. * h);
+			la.jacob[r][1] = (fy1.v[r] - fy2.v[r]) / (2. * h);
+			la.jacob[r][2] = (fz1.v[r] - fz2.v[r]) / 2.;
+			la.hess[r][0] = (fx1.v[r] - 2. * f0 + fx2.v[r]) / (h * h);
+			la.hess[r][1] = (fpp.v[r] - fpm.v[r] - fmp.v[r] + fmm.v[r]) / (4. * h * h);
+			la.hess[r][2] = (fy1.v[r] - 2. * f0 + fy2.v[r]) / (h * h);
+		}
+		if (!la.invert()) {
+			return -EINVALID;
+		}
+
+		// sample the area and check the error of both directions
+		const int n = 8;
+		double max_err = 0.;
+		for (int i = 0; i <= n; ++i) {
+			for (int j = 0; j <= n; ++j) {
+				point3d src(origin.v[0] + range * (2. * i / n - 1.),
+					origin.v[1] + range * (2. * j / n - 1.), origin.v[2]);
+				point3d exact = exact_transform(src, false), model, back;
+				la.apply_fwd(src, model);
+				max_err = fmax(max_err, distance3d(model, exact));
+				la.apply_inv(exact, back);
+				max_err = fmax(max_err, distance3d(
+					exact_transform(back, false), exact));
+			}
+		}
+		if (!(max_err <= tolerance)) {
+			return -EOUTOFOSCOPE;
+		}
+		la.enabled = true;
+		_local = la;
+		return 0;
+	}
+
+	void clear_local_area(void) {
+		_local.enabled = false;
 	}
 
 	bool valid(void) {
@@ -48,6 +170,111 @@ public:
 	}
 
 private:
+	// second order model of the projection around an origin:
+	// dst = dst_origin + jacob * d + (d' * hess * d) / 2, with
+	// d = src - origin, only the horizontal terms are quadratic
+	struct local_area
+	{
+		local_area() : enabled(false), range(0.) {}
+
+		// the area is checked in the source CRS, for the inverse
+		// direction the result of the model is checked
+		bool transform(const point3d& src, point3d& dst, bool inv) const
+		{
+			if (inv) apply_inv(src, dst);
+			else apply_fwd(src, dst);
+			const point3d& s = (inv) ? dst : src;
+			return (fabs(s.v[0] - origin.v[0]) <= range
+				&& fabs(s.v[1] - origin.v[1]) <= range) ? true : false;
+		}
+
+		void apply_fwd(const point3d& src, point3d& dst) const
+		{
+			double dx = src.v[0] - origin.v[0];
+			double dy = src.v[1] - origin.v[1];
+			double dz = src.v[2] - origin.v[2];
+			for (int r = 0; r < 3; ++r) {
+				dst.v[r] = dst_origin.v[r]
+					+ jacob[r][0] * dx + jacob[r][1] * dy + jacob[r][2] * dz
+					+ hess[r][0] * dx * dx * .5 + hess[r][1] * dx * dy
+					+ hess[r][2] * dy * dy * .5;
+			}
+		}
+
+		// start from the linear inverse and refine it with
+		// newton steps on the forward model
+		void apply_inv(const point3d& src, point3d& dst) const
+		{
+			point3d d(src);
+			d.sub(dst_origin);
+			dst = origin;
+			for (int iter = 0; iter < 3; ++iter) {
+				for (int r = 0; r < 3; ++r) {
+					dst.v[r] += inv_jacob[r][0] * d.v[0]
+						+ inv_jacob[r][1] * d.v[1] + inv_jacob[r][2] * d.v[2];
+				}
+				point3d f;
+				apply_fwd(dst, f);
+				d = src;
+				d.sub(f);
+			}
+		}
+
+		bool invert(void)
+		{
+			const double (*m)[3] = jacob;
+			double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+				- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+				+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+			if (fabs(det) < 1e-300 || !isfinite(det)) {
+				return false;
+			}
+			for (int r = 0; r < 3; ++r) {
+				for (int c = 0; c < 3; ++c) {
+					// cofactor of (c, r) over the determinant
+					int r1 = (c + 1) % 3, r2 = (c + 2) % 3;
+					int c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+					inv_jacob[r][c] = (m[r1][c1] * m[r2][c2]
+						- m[r1][c2] * m[r2][c1]) / det;
+				}
+			}
+			return true;
+		}
+
+		bool enabled;
+		double range;
+		point3d origin;
+		point3d dst_origin;
+		double jacob[3][3];
+		double inv_jacob[3][3];
+		// d2/dx2, d2/dxdy, d2/dy2 of each target component
+		double hess[3][3];
+	};
+
+	static double distance3d(const point3d& a, const point3d& b)
+	{
+		double dx = a.v[0] - b.v[0], dy = a.v[1] - b.v[1], dz = a.v[2] - b.v[2];
+		double ret = sqrt(dx * dx + dy * dy + dz * dz);
+		return (isfinite(ret)) ? ret : HUGE_VAL;
+	}
+
+	point3d exact_transform(const point3d& src, bool inv)
+	{
+		PJ_COORD s = proj_coord(src.v[0], src.v[1], src.v[2], 0);
+		PJ_COORD r = proj_trans(_prj, (inv) ? PJ_INV : PJ_FWD, s);
+		return { r.v[0], r.v[1], r.v[2] };
+	}
+
+	int exact_transform(double* x, double* y, double* z,
+		size_t stride, size_t count, bool inv)
+	{
+		size_t ret = proj_trans_generic(_prj, (inv) ? PJ_INV : PJ_FWD,
+			x, stride, count, y, stride, count,
+			z, (z) ? stride : 0, (z) ? count : 0,
+			nullptr, 0, 0);
+		return (int)ret;
+	}
+
 	void grant_context(void)
 	{
 		if (nullptr != _thdctx) {
@@ -79,6 +306,10 @@ private:
 
 private:
 	PJ *_prj;
+	local_area _local;
+	// scratch buffers of the batch transform
+	vector<size_t> _remains;
+	vector<double> _buffer;
 	static __thread PJ_CONTEXT* _thdctx;
 };
 
@@ -150,6 +381,51 @@ void proj::transform_point(point3d& src, bool inv) const
 	p->transform_point(src, inv);
 }
 
+int proj::transform(double* x, double* y, double* z, size_t stride,
+	size_t count, bool inv)
+{
+	if (!x || !y || stride < sizeof(double)) {
+		return -EBADPARM;
+	}
+	if (!_data) {
+		return -ENOTREADY;
+	}
+	if (!count) {
+		return 0;
+	}
+	auto* p = reinterpret_cast<proj_impl*>(_data);
+	return p->transform(x, y, z, stride, count, inv);
+}
+
+int proj::transform(point3d* pts, size_t count, bool inv)
+{
+	if (!pts) {
+		return -EBADPARM;
+	}
+	// point3d is a packed array of 3 doubles
+	size_t addr = (size_t)pts;
+	double* v = (double*)addr;
+	return transform(v, v + 1, v + 2, sizeof(point3d), count, inv);
+}
+
+int proj::set_local_area(const point3d& origin, double range, double tolerance)
+{
+	if (!_data) {
+		return -ENOTREADY;
+	}
+	auto* p = reinterpret_cast<proj_impl*>(_data);
+	return p->set_local_area(origin, range, tolerance);
+}
+
+void proj::clear_local_area(void)
+{
+	if (!_data) {
+		return;
+	}
+	auto* p = reinterpret_cast<proj_impl*>(_data);
+	p->clear_local_area();
+}
+
 point3d proj::inv_transform(const point3d& src) const {
 	return transform(src, true);
 }
@@ -313,6 +313,7 @@ rendermap_impl::rendermap_impl()
 , _active_blkcnt(0)
 , _buffer(nullptr)
 , _buffer_end(0)
+, _charged_bytes(0)
 , _flags(0)
 {
 	listnode_init(_ownerlist);
@@ -1125,40 +1126,59 @@ blockinfo_v1* rendermap_impl::getblock(int blkid)
 }
 
 const shared_ptr<odr::RoadNetworkMesh> rendermap_impl::generate_mesh(uint32_t blkid)
+{
+	OpenDriveMap odrm;
+	if (prepare_mesh(blkid, odrm)) {
+		return nullptr;
+	}
+	auto mesh = build_mesh(odrm);
+	commit_mesh(blkid, mesh);
+	return mesh;
+}
+
+int rendermap_impl::prepare_mesh(uint32_t blkid, OpenDriveMap& odrm)
 {
 	// this method only applied for memory rendermap
 	if (getmap()->a.persistence) {
-		return nullptr;
+		return -ENOTSUPPORT;
 	}
 
 	auto* blk = getblock(blkid);
 	if (nullptr == blk) {
-		return nullptr;
+		return -ENOTFOUND;
 	}
 
-	OpenDriveMap odrm;
 	map<uint32_t, shared_ptr<Road>> roads;
 
 	// handle all lane sections
 	int ret = deserialize_block_lanesecs(blk, odrm, roads);
 	if (ret) {
-		return nullptr;
+		return -EINVALID;
 	}
 
 	ret = deserialize_block_roadobjs(blk, odrm, roads);
 	if (ret) {
-		return nullptr;
+		return -EINVALID;
 	}
-	// finally we update the mesh in meshbuf
-	_meshbuf.erase(blkid);
+	return 0;
+}
 
+shared_ptr<odr::RoadNetworkMesh> rendermap_impl::build_mesh(OpenDriveMap& odrm)
+{
 	// generate the 3D mesh for OpenDriveMap
 	auto mesh = make_shared<odr::RoadNetworkMesh>(get_road_network_mesh(odrm, 0.1));
 	mesh->refline = get_refline_segments(odrm, 0.1);
-	_meshbuf.insert({blkid, mesh});
 	return mesh;
 }
 
+void rendermap_impl::commit_mesh(uint32_t blkid,
+	const shared_ptr<odr::RoadNetworkMesh>& mesh)
+{
+	// finally we update the mesh in meshbuf
+	_meshbuf.erase(blkid);
+	_meshbuf.insert({blkid, mesh});
+}
+
 int rendermap_impl::deserialize_block_roadobjs(blockinfo_v1* blk,
 	OpenDriveMap& odrm, map<uint32_t, shared_ptr<Road>>& r)
 {
@@ -1360,23 +1380,16 @@ int rendermap_impl::find_junctions(double x, double y, int count,
 		return -ENOTFOUND;
 	}
 
+	std::vector<kdtree2d_neighbor<hdrmap_file_junction_v1>> nearest(count);
+	count = kdtree2d_knn_search(hdr->junc_kdtree,
+		x, y, count, nearest.data());
+
 	for (int i = 0; i < count; ++i) {
 		rendermap_nearest_junctions item;
-		auto* junc = kdtree2d_search(hdr->junc_kdtree,
-			x, y, item.distance);
-		item.junction = reinterpret_cast<rendermap_junction*>(junc);
+		item.junction = reinterpret_cast<rendermap_junction*>(nearest[i].node);
+		item.distance = nearest[i].distance;
 		set.push_back(item);
 	}
-
-	// restore "selected" flags
-	for (auto& item : set) {
-		if (nullptr == item.junction) {
-			continue;
-		}
-		auto* junc = reinterpret_cast<hdrmap_file_junction_v1*>
-			(item.junction);
-		junc->attrs.KNN_selected = 0;
-	}
 	return count;
 }
 
@@ -578,20 +578,20 @@ int sdmap_impl::search_nearest_nodes(double lat, double lon,
 	}
 	auto* node = &block->node_table[index];
 
-	for (int i = 0; i < count; ++i) {
-		auto& item = set[i];
-		// x = lat, y = lon
-		item.node = kdtree2d_search(node, lat, lon,
-			item.distance);
-	}
+	// x = lat, y = lon
+	auto* nearest = (kdtree2d_neighbor<fullmap_nodeinfo_v1>*)
+		alloca(count * sizeof(kdtree2d_neighbor<fullmap_nodeinfo_v1>));
+	int found = kdtree2d_knn_search(node, lat, lon, count, nearest);
 
-	// restore "selected" flags
 	for (int i = 0; i < count; ++i) {
 		auto& item = set[i];
-		if (nullptr == item.node) {
-			continue;
+		if (i < found) {
+			item.node = nearest[i].node;
+			item.distance = nearest[i].distance;
+		} else {
+			item.node = nullptr;
+			item.distance = DBL_MAX;
 		}
-		item.node->attr.KNN_selected = 0;
 	}
 	return 0;
 }
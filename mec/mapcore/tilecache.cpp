@@ -12,7 +12,9 @@ using namespace std;
 using namespace zas::utils;
 
 tilecache_impl::tilecache_impl()
-: _maptree(nullptr)
+: _prefetch_radius(0)
+, _mesh_hits(0), _mesh_misses(0)
+, _maptree(nullptr)
 {
 	listnode_init(_maplist);
 	memset(&_mapinfo.uuid, 0, sizeof(uint128_t));
@@ -21,6 +23,8 @@ tilecache_impl::tilecache_impl()
 
 tilecache_impl::~tilecache_impl()
 {
+	// stop all mesh workers before releasing the maps
+	_mesh_workers.shutdown();
 	auto_mutex as(_mut);
 	release_all_unlocked();
 }
@@ -87,6 +91,9 @@ int tilecache_impl::add_tile(const void* buffer,
 
 	ret = map->blocks.count;
 	if (rm) *rm = rdmap;
+	// keep the cache within the memory budget, the caller
+	// asking for the map handles the map by itself
+	else shrink_unlocked();
 	MUTEX_EXIT();
 	return ret;
 }
@@ -253,10 +260,20 @@ int tilecache_impl::fix_lanesecid_unlocked(
 int tilecache_impl::update_blockmap_unlocked(rendermap_impl* rmap)
 {
 	auto* map = rmap->getmap();
+	if (!map->blocks.count) {
+		return 0;
+	}
+	// the tile buffer is only freed with the last block of the
+	// tile, so it is charged to the map, not to the blocks
+	rmap->_charged_bytes = map->size;
+	_evictor.charge(map->size);
 	for (int i = 0; i < map->blocks.count; ++i) {
 		auto* blk = map->blocks.indices[i];
 		int blkid = blk->row * map->cols + blk->col;
-		_blocks.insert({blkid, {rmap, blk}});
+		auto ret = _blocks.insert({blkid, {rmap, blk}});
+		if (ret.second) {
+			_evictor.set(blkid, 0);
+		}
 	}
 	return 0;
 }
@@ -267,8 +284,17 @@ int tilecache_impl::remove_blockmap_unlocked(rendermap_impl* rmap)
 	for (int i = 0; i < map->blocks.count; ++i) {
 		auto* blk = map->blocks.indices[i];
 		int blkid = blk->row * map->cols + blk->col;
-		_blocks.erase(blkid);
+
+		// only remove the block owned by this map
+		auto iter = _blocks.find(blkid);
+		if (iter == _blocks.end() || iter->second.map != rmap) {
+			continue;
+		}
+		_blocks.erase(iter);
+		_evictor.remove(blkid);
 	}
+	_evictor.discharge(rmap->_charged_bytes);
+	rmap->_charged_bytes = 0;
 	return 0;
 }
 
@@ -340,6 +366,9 @@ int tilecache_impl::release_mesh(uint32_t blkid)
 		return -ENOTFOUND; // block not found
 	}
 
+	// drop the in-flight generation, if any
+	bool cancelled = cancel_mesh_job_unlocked(blkid);
+
 	auto block = blk->second.block;
 	assert(nullptr != block);	
 	if (entrust_mesh_unlocked(blk->first, block, pending)) {
@@ -348,7 +377,9 @@ int tilecache_impl::release_mesh(uint32_t blkid)
 
 	// detach the mesh
 	mesh = blk->second.map->release_mesh(blk->first);
-	assert(nullptr != mesh);
+	assert(nullptr != mesh || cancelled);
+	blk->second.mesh_bytes = 0;
+	_evictor.resize(blkid, 0);
 
 	// insert all pendings
 	_mesh_expired_blocks.insert(pending.begin(), pending.end());
@@ -487,12 +518,56 @@ template <typename T> int tilecache_impl::merge_block_objects_unlocked(
 	return index;
 }
 
+static size_t mesh3d_bytes(const odr::Mesh3D& mesh)
+{
+	return mesh.vertices.capacity() * sizeof(odr::Vec3D)
+		+ mesh.indices.capacity() * sizeof(uint32_t)
+		+ mesh.normals.capacity() * sizeof(odr::Vec3D)
+		+ mesh.st_coordinates.capacity() * sizeof(odr::Vec2D);
+}
+
+// approximation of a std::map node: the value and
+// 4 words of the red-black tree node
+template <typename K, typename V>
+static size_t index_bytes(const std::map<K, V>& m)
+{
+	return m.size() * (sizeof(std::pair<const K, V>) + 4 * sizeof(void*));
+}
+
+static size_t road_network_mesh_bytes(const odr::RoadNetworkMesh& mesh)
+{
+	size_t ret = sizeof(odr::RoadNetworkMesh);
+	ret += mesh3d_bytes(mesh.refline);
+	ret += mesh3d_bytes(mesh.lanes_mesh)
+		+ index_bytes(mesh.lanes_mesh.road_start_indices)
+		+ index_bytes(mesh.lanes_mesh.lanesec_start_indices)
+		+ index_bytes(mesh.lanes_mesh.lane_start_indices)
+		+ index_bytes(mesh.lanes_mesh.lane_start_type)
+		+ index_bytes(mesh.lanes_mesh.lane_start_lane_type);
+	if (mesh.height_index) {
+		ret += mesh.height_index->get_memory_bytes();
+	}
+	ret += mesh3d_bytes(mesh.roadmarks_mesh)
+		+ index_bytes(mesh.roadmarks_mesh.road_start_indices)
+		+ index_bytes(mesh.roadmarks_mesh.lanesec_start_indices)
+		+ index_bytes(mesh.roadmarks_mesh.lane_start_indices)
+		+ index_bytes(mesh.roadmarks_mesh.lane_start_type)
+		+ index_bytes(mesh.roadmarks_mesh.roadmark_type_start_indices);
+	ret += mesh3d_bytes(mesh.road_objects_mesh)
+		+ index_bytes(mesh.road_objects_mesh.road_start_indices)
+		+ index_bytes(mesh.road_objects_mesh.road_object_start_indices)
+		+ index_bytes(mesh.road_objects_mesh.road_object_type);
+	return ret;
+}
+
 shared_ptr<const odr::RoadNetworkMesh>
 tilecache_impl::get_mesh(uint32_t blkid, bool* g)
 {
-	bool gen = false;
-	// we need lock here
-	auto_mutex am(_mut);
+	bool created;
+	shared_ptr<mesh_job> job;
+
+	// we need lock here, but only for the lookup
+	MUTEX_ENTER(_mut);
 
 	auto blk = _blocks.find(blkid);
 	if (blk == _blocks.end()) {
@@ -500,30 +575,283 @@ tilecache_impl::get_mesh(uint32_t blkid, bool* g)
 	}
 
 	assert(nullptr != blk->second.map);
+	_evictor.touch(blkid);
+	prefetch_neighbors_unlocked(blkid);
 
 	// check if this block is requested to
 	// re-generate the mesh
 	bool expired = (_mesh_expired_blocks.find(blkid)
 		!= _mesh_expired_blocks.end());
 
-	// get the generated mesh (even if it has expired)
+	// get the generated mesh
 	auto ret = blk->second.mesh.lock();
+	if (nullptr != ret && !expired) {
+		++_mesh_hits;
+		if (g) *g = false;
+		return ret;
+	}
+	++_mesh_misses;
 
+	// act mesh regeneration: join the in-flight one
+	// or start a new one
+	job = get_mesh_job_unlocked(blkid, created);
+	MUTEX_EXIT();
+
+	// run the job here if no worker picked it up,
+	// otherwise wait for the worker
+	run_mesh_job(job, false);
+	if (g) *g = true;
+	return job->future.get();
+}
+
+int tilecache_impl::get_mesh_async(uint32_t blkid, tilecache::mesh_callback cb)
+{
+	mesh_ptr ret;
+
+	// we need lock here
+	MUTEX_ENTER(_mut);
+
+	auto blk = _blocks.find(blkid);
+	if (blk == _blocks.end()) {
+		return -ENOTFOUND;
+	}
+	_evictor.touch(blkid);
+	prefetch_neighbors_unlocked(blkid);
+
+	bool expired = (_mesh_expired_blocks.find(blkid)
+		!= _mesh_expired_blocks.end());
+	ret = blk->second.mesh.lock();
 	if (nullptr == ret || expired) {
-		// act mesh regeneration
-		gen = true;
-		ret = blk->second.map->generate_mesh(blkid);
-		if (nullptr == ret) {
-			return nullptr;
+		++_mesh_misses;
+		bool created;
+		auto job = get_mesh_job_unlocked(blkid, created);
+		if (created && post_mesh_job_unlocked(job, false)) {
+			detach_mesh_job_unlocked(job);
+			return -ETOOMANYITEMS;
 		}
-		blk->second.mesh = ret;
+		if (cb) job->callbacks.push_back(cb);
+		return 0;
 	}
+	++_mesh_hits;
+	MUTEX_EXIT();
 
-	if (expired) {
-		_mesh_expired_blocks.erase(blkid);
+	// the mesh is available, notify immediately
+	if (cb) cb(blkid, ret);
+	return 0;
+}
+
+shared_future<mesh_ptr> tilecache_impl::get_mesh_future(uint32_t blkid)
+{
+	// we need lock here
+	auto_mutex am(_mut);
+
+	auto blk = _blocks.find(blkid);
+	if (blk == _blocks.end()) {
+		return shared_future<mesh_ptr>();
+	}
+	_evictor.touch(blkid);
+	prefetch_neighbors_unlocked(blkid);
+
+	bool expired = (_mesh_expired_blocks.find(blkid)
+		!= _mesh_expired_blocks.end());
+	auto ret = blk->second.mesh.lock();
+	if (nullptr != ret && !expired) {
+		++_mesh_hits;
+		promise<mesh_ptr> p;
+		p.set_value(ret);
+		return p.get_future().share();
+	}
+
+	++_mesh_misses;
+	bool created;
+	auto job = get_mesh_job_unlocked(blkid, created);
+	if (created && post_mesh_job_unlocked(job, false)) {
+		detach_mesh_job_unlocked(job);
+		return shared_future<mesh_ptr>();
+	}
+	return job->future;
+}
+
+int tilecache_impl::set_memory_budget(size_t bytes)
+{
+	auto_mutex am(_mut);
+	_evictor.set_budget(bytes);
+	shrink_unlocked();
+	return 0;
+}
+
+int tilecache_impl::get_stats(tilecache_stats& stats)
+{
+	auto_mutex am(_mut);
+	stats.budget = _evictor.budget();
+	stats.resident = _evictor.resident();
+	stats.peak = _evictor.peak();
+	stats.blocks = _blocks.size();
+	stats.hits = _mesh_hits;
+	stats.misses = _mesh_misses;
+	stats.evictions = _evictor.evictions();
+	stats.evicted_bytes = _evictor.evicted_bytes();
+	return 0;
+}
+
+void tilecache_impl::shrink_unlocked(void)
+{
+	uint32_t blkid;
+	while (_evictor.over_budget() && _evictor.select_victim(blkid)) {
+		// account it first, the block is dropped
+		// from the evictor when it is released
+		_evictor.evicted(blkid);
+		if (_blocks.find(blkid) != _blocks.end()) {
+			// the tiles released with their last block
+			size_t resident = _evictor.resident();
+			release_blocks({blkid});
+			_evictor.evicted_shared(resident - _evictor.resident());
+		}
+	}
+}
+
+int tilecache_impl::config_mesh_workers(int workers,
+	int max_pending, int prefetch_radius)
+{
+	if (prefetch_radius < 0) {
+		return -EBADPARM;
+	}
+	int ret = _mesh_workers.config(workers, max_pending);
+	if (ret) return ret;
+
+	auto_mutex am(_mut);
+	_prefetch_radius = prefetch_radius;
+	return 0;
+}
+
+shared_ptr<mesh_job> tilecache_impl::get_mesh_job_unlocked(
+	uint32_t blkid, bool& created)
+{
+	auto iter = _mesh_jobs.find(blkid);
+	if (iter != _mesh_jobs.end()) {
+		created = false;
+		return iter->second;
+	}
+	auto job = make_shared<mesh_job>(blkid);
+	_mesh_jobs.insert({blkid, job});
+	created = true;
+	return job;
+}
+
+void tilecache_impl::detach_mesh_job_unlocked(const shared_ptr<mesh_job>& job)
+{
+	auto iter = _mesh_jobs.find(job->blkid);
+	if (iter != _mesh_jobs.end() && iter->second == job) {
+		_mesh_jobs.erase(iter);
+	}
+}
+
+bool tilecache_impl::cancel_mesh_job_unlocked(uint32_t blkid)
+{
+	auto iter = _mesh_jobs.find(blkid);
+	if (iter == _mesh_jobs.end()) {
+		return false;
+	}
+	// the job will be completed with nullptr by
+	// whoever runs it
+	iter->second->a.cancelled = 1;
+	_mesh_jobs.erase(iter);
+	return true;
+}
+
+int tilecache_impl::post_mesh_job_unlocked(
+	const shared_ptr<mesh_job>& job, bool prefetch)
+{
+	return _mesh_workers.post([this, job](bool cancelled) {
+		run_mesh_job(job, cancelled);
+	}, prefetch);
+}
+
+void tilecache_impl::run_mesh_job(const shared_ptr<mesh_job>& job, bool cancelled)
+{
+	OpenDriveMap odrm;
+	shared_ptr<odr::RoadNetworkMesh> mesh;
+	bool prepared = false;
+
+	MUTEX_ENTER(_mut);
+	// someone else is running this job
+	if (job->a.started) return;
+	job->a.started = 1;
+
+	// claim the objects and deserialize the block, this shall
+	// be done with the lock held since the mesh-gen ownership of
+	// shared objects is updated
+	if (!cancelled && !job->a.cancelled) {
+		auto blk = _blocks.find(job->blkid);
+		if (blk != _blocks.end() && !blk->second.map->prepare_mesh(
+			job->blkid, odrm)) {
+			prepared = true;
+		}
+	}
+	if (!prepared) {
+		detach_mesh_job_unlocked(job);
+	}
+	MUTEX_EXIT();
+
+	if (prepared) {
+		// the tessellation is the expensive part and
+		// is done without holding the lock
+		mesh = rendermap_impl::build_mesh(odrm);
+
+		MUTEX_ENTER(_mut);
+		auto blk = _blocks.find(job->blkid);
+		if (!job->a.cancelled && blk != _blocks.end()) {
+			blk->second.map->commit_mesh(job->blkid, mesh);
+			blk->second.mesh = mesh;
+			blk->second.mesh_bytes = road_network_mesh_bytes(*mesh);
+			_evictor.resize(job->blkid, blk->second.mesh_bytes);
+			_mesh_expired_blocks.erase(job->blkid);
+		}
+		else mesh = nullptr;	// released during the generation
+		detach_mesh_job_unlocked(job);
+
+		// the mesh may exceed the memory budget
+		shrink_unlocked();
+		MUTEX_EXIT();
+	}
+
+	// the job is detached, no more callbacks could be added
+	job->result.set_value(mesh);
+	for (auto& cb : job->callbacks) {
+		cb(job->blkid, mesh);
+	}
+}
+
+void tilecache_impl::prefetch_neighbors_unlocked(uint32_t blkid)
+{
+	int radius = _prefetch_radius;
+	if (!radius || !_mapinfo.cols) {
+		return;
+	}
+	int row = blkid / _mapinfo.cols;
+	int col = blkid % _mapinfo.cols;
+	for (int r = row - radius; r <= row + radius; ++r) {
+		if (r < 0 || r >= (int)_mapinfo.rows) continue;
+		for (int c = col - radius; c <= col + radius; ++c) {
+			if (c < 0 || c >= (int)_mapinfo.cols) continue;
+			uint32_t id = r * _mapinfo.cols + c;
+			if (id == blkid) continue;
+
+			// only loaded blocks without mesh
+			auto blk = _blocks.find(id);
+			if (blk == _blocks.end() || !blk->second.mesh.expired()) {
+				continue;
+			}
+			bool created;
+			auto job = get_mesh_job_unlocked(id, created);
+			if (!created) continue;
+			if (post_mesh_job_unlocked(job, true)) {
+				// the workers are busy, try later
+				detach_mesh_job_unlocked(job);
+				return;
+			}
+		}
 	}
-	if (g) *g = gen;
-	return ret;
 }
 
 void tilecache_impl::get_bounding_blocks(
@@ -590,6 +918,7 @@ int tilecache_impl::extract_roadobjects(int blkid,
 	if (iter == _blocks.end()) {
 		return -ENOTEXISTS;
 	}
+	_evictor.touch(blkid);
 
 	objects.clear();
 	if (iter->second.map->extract_roadobjects(blkid,
@@ -739,6 +1068,7 @@ int tilecache_impl::filter_loaded_blocks(set<uint32_t>& blkids, bool lock)
 		}
 		if (lock) {
 			iter->second.a.locked = 1;
+			_evictor.pin(*id, true);
 		}
 		id++;
 	}
@@ -763,6 +1093,7 @@ int tilecache_impl::lock_blocks(const set<uint32_t>& blkids)
 			continue;
 		}
 		iter->second.a.locked = 1;
+		_evictor.pin(id, true);
 	}
 	return 0;
 }
@@ -794,9 +1125,13 @@ int tilecache_impl::unlock_blocks(const set<uint32_t>& blkids)
 				// "release_block" method, calling "double free"
 				_inactive_blocks.erase(iter);
 				release_block_unlocked(iter->first, &iter->second);
+				_evictor.remove(id);
 			}
 		}
-		else iter->second.a.locked = 0;
+		else {
+			iter->second.a.locked = 0;
+			_evictor.pin(id, false);
+		}
 	}
 	return 0;
 }
@@ -893,8 +1228,9 @@ int tilecache_impl::release_blocks(const set<uint32_t>& blkids)
 			continue;
 		}
 		
-		// check if 3DMesh exists
-		if (!iter->second.mesh.expired()) {
+		// check if 3DMesh exists or is being generated
+		if (!iter->second.mesh.expired()
+			|| _mesh_jobs.find(id) != _mesh_jobs.end()) {
 			int ret = release_mesh(id);
 			assert(ret == 0);
 		}
@@ -912,6 +1248,7 @@ int tilecache_impl::release_blocks(const set<uint32_t>& blkids)
 			// "release_block" method, calling "double free"
 			_blocks.erase(iter);
 			release_block_unlocked(iter->first, &iter->second);
+			_evictor.remove(id);
 		}
 	}
 	return 0;
@@ -927,57 +1264,47 @@ double tilecache_impl::get_road_height(double x, double y)
 		return 0.0;
 	}
 
-	auto_mutex am(_mut);
 	int px = (x - _mapinfo.xmin) / _mapinfo.block_width;
 	int py = (y - _mapinfo.ymin) / _mapinfo.block_height;
 	uint32_t block_id = (py * _mapinfo.cols) + px;
 
-	double height = 0.0;
-	auto iter = _blocks.find(block_id);
-	if (iter == _blocks.end()) {
-		height = 0.0;
-	}
-
-	assert(nullptr != iter->second.map);
-	auto ret = iter->second.mesh.lock();
-	if (nullptr == ret) {
-		height = 0.0;
-	}
-	height = ret->get_road_height(x, y);
-	while (height == 0.0)
-	{
-		uint32_t blockIndex = 1;
-
-		uint32_t startBlockId = block_id - _mapinfo.cols * (blockIndex / 2) - (blockIndex / 2);
-
-		for(uint32_t i = 0; i < blockIndex; i++) {
-			for(uint32_t j = 0; j < blockIndex; j++) {
-				block_id += i * blockIndex + j; 
-
-				auto iter = _blocks.find(block_id);
+	// collect meshes of the block and the rings around it
+	// with the lock held, then query them without the lock
+	// so that we never wait for a running tessellation
+	vector<shared_ptr<RoadNetworkMesh>> meshes;
+	MUTEX_ENTER(_mut);
+	_evictor.touch(block_id);
+	prefetch_neighbors_unlocked(block_id);
+	for (int radius = 0; radius <= 5; ++radius) {
+		for (int r = py - radius; r <= py + radius; ++r) {
+			if (r < 0 || r >= (int)_mapinfo.rows) continue;
+			for (int c = px - radius; c <= px + radius; ++c) {
+				if (c < 0 || c >= (int)_mapinfo.cols) continue;
+				// only the blocks on the ring
+				if (abs(r - py) != radius && abs(c - px) != radius) {
+					continue;
+				}
+				auto iter = _blocks.find(r * _mapinfo.cols + c);
 				if (iter == _blocks.end()) {
 					continue;
 				}
-
 				assert(nullptr != iter->second.map);
 				auto ret = iter->second.mesh.lock();
-				if (nullptr == ret) {
-					continue;
-				}
-				
-				height = ret->get_road_height(x, y);
-				if(height > 0) {
-					break;
+				if (nullptr != ret) {
+					meshes.push_back(ret);
 				}
 			}
 		}
+	}
+	MUTEX_EXIT();
 
-		blockIndex = blockIndex + 2;
-		if(blockIndex > 12) {
-			break;
+	for (auto& mesh : meshes) {
+		double height = mesh->get_road_height(x, y);
+		if (height != 0.0) {
+			return height;
 		}
 	}
-	return height;
+	return 0.0;
 }
 
 int tilecache_impl::find_junction_center_byappro(double& x, double& y, string appro_uuid)
@@ -1042,6 +1369,59 @@ shared_ptr<const odr::RoadNetworkMesh> tilecache::get_mesh(uint32_t blkid, bool*
 	return tc->get_mesh(blkid, g);
 }
 
+int tilecache::get_mesh_async(uint32_t blkid, mesh_callback cb)
+{
+	if (nullptr == _data) {
+		return -EINVALID;
+	}
+	auto* tc = reinterpret_cast<tilecache_impl*>(_data);
+	if (!tc->map_available()) {
+		return -EINVALID;
+	}
+	return tc->get_mesh_async(blkid, cb);
+}
+
+shared_future<shared_ptr<const odr::RoadNetworkMesh>>
+tilecache::get_mesh_future(uint32_t blkid)
+{
+	if (nullptr == _data) {
+		return shared_future<mesh_ptr>();
+	}
+	auto* tc = reinterpret_cast<tilecache_impl*>(_data);
+	if (!tc->map_available()) {
+		return shared_future<mesh_ptr>();
+	}
+	return tc->get_mesh_future(blkid);
+}
+
+int tilecache::config_mesh_workers(int workers,
+	int max_pending, int prefetch_radius)
+{
+	if (nullptr == _data) {
+		return -EINVALID;
+	}
+	auto* tc = reinterpret_cast<tilecache_impl*>(_data);
+	return tc->config_mesh_workers(workers, max_pending, prefetch_radius);
+}
+
+int tilecache::set_memory_budget(size_t bytes)
+{
+	if (nullptr == _data) {
+		return -EINVALID;
+	}
+	auto* tc = reinterpret_cast<tilecache_impl*>(_data);
+	return tc->set_memory_budget(bytes);
+}
+
+int tilecache::get_stats(tilecache_stats& stats) const
+{
+	if (nullptr == _data) {
+		return -EINVALID;
+	}
+	auto* tc = reinterpret_cast<tilecache_impl*>(_data);
+	return tc->get_stats(stats);
+}
+
 int tilecache::release_mesh(uint32_t blkid)
 {
 	if (nullptr == _data) {
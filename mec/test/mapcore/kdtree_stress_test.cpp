@@ -0,0 +1,142 @@
+/** @file kdtree_stress_test.cpp
+ * concurrent k-NN / radius / nearest-iterator queries on one kd-tree
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "inc/kdtree.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+struct test_point
+{
+	double px, py;
+	test_point *left, *right;
+	struct {
+		uint32_t split : 1;
+		uint32_t KNN_selected : 1;
+	} attrs;
+
+	double x(void) { return px; }
+	double y(void) { return py; }
+	int get_split(void) { return attrs.split; }
+	void set_split(int s) { attrs.split = (s) ? 1 : 0; }
+	bool KNN_selected(void) { return (attrs.KNN_selected) ? true : false; }
+	void KNN_select(void) { attrs.KNN_selected = 1; }
+	void set_left(test_point* l) { left = l; }
+	void set_right(test_point* r) { right = r; }
+	test_point* get_left(void) { return left; }
+	test_point* get_right(void) { return right; }
+	double distance(double x, double y) {
+		auto dx = (px - x);
+		auto dy = (py - y);
+		return sqrt(dx * dx + dy * dy);
+	}
+	static int kdtree_x_compare(const void* a, const void* b) {
+		auto* aa = *((test_point**)a);
+		auto* bb = *((test_point**)b);
+		return (aa->px > bb->px) ? 1 : ((aa->px < bb->px) ? -1 : 0);
+	}
+	static int kdtree_y_compare(const void* a, const void* b) {
+		auto* aa = *((test_point**)a);
+		auto* bb = *((test_point**)b);
+		return (aa->py > bb->py) ? 1 : ((aa->py < bb->py) ? -1 : 0);
+	}
+};
+
+static vector<double> brute_force(vector<test_point>& pts, double x, double y)
+{
+	vector<double> dists;
+	for (auto& p : pts) {
+		dists.push_back(p.distance(x, y));
+	}
+	sort(dists.begin(), dists.end());
+	return dists;
+}
+
+static int check_one_query(test_point* root, vector<test_point>& pts,
+	double x, double y, int k, double radius)
+{
+	auto expected = brute_force(pts, x, y);
+
+	// k-NN
+	vector<kdtree2d_neighbor<test_point>> knn(k);
+	int found = kdtree2d_knn_search(root, x, y, k, knn.data());
+	if (found != min(k, (int)pts.size())) {
+		return 1;
+	}
+	for (int i = 0; i < found; ++i) {
+		if (knn[i].distance != expected[i]) return 2;
+	}
+
+	// radius
+	size_t inside = upper_bound(expected.begin(),
+		expected.end(), radius) - expected.begin();
+	size_t cnt = 0;
+	kdtree2d_radius_search(root, x, y, radius,
+		[&cnt](test_point*, double) { ++cnt; });
+	if (cnt != inside) {
+		return 3;
+	}
+
+	// nearest iterator
+	double d;
+	kdtree2d_nearest_iterator<test_point> it(root, x, y);
+	for (int i = 0; i < k; ++i) {
+		if (nullptr == it.next(d) || d != expected[i]) {
+			return 4;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const int point_count = 20000;
+	const int thread_count = (argc > 1) ? atoi(argv[1]) : 16;
+	const int rounds = (argc > 2) ? atoi(argv[2]) : 200;
+
+	mt19937 gen(1);
+	uniform_real_distribution<double> coord(0., 1000.);
+	vector<test_point> pts(point_count);
+	for (auto& p : pts) {
+		p.px = coord(gen), p.py = coord(gen);
+		p.left = p.right = nullptr;
+		p.attrs.split = p.attrs.KNN_selected = 0;
+	}
+	vector<test_point*> table;
+	for (auto& p : pts) table.push_back(&p);
+	test_point* root = nullptr;
+	build_kdtree(root, table.data(), point_count);
+
+	atomic<int> errors(0);
+	vector<thread> workers;
+	for (int t = 0; t < thread_count; ++t) {
+		workers.emplace_back([&, t]() {
+			mt19937 g(100 + t);
+			uniform_real_distribution<double> c(-50., 1050.);
+			for (int i = 0; i < rounds; ++i) {
+				int k = 1 + (int)(g() % 32);
+				double r = (g() % 5000) / 100.;
+				int ret = check_one_query(root, pts, c(g), c(g), k, r);
+				if (ret) {
+					printf("thread %d round %d: error %d\n", t, i, ret);
+					errors++;
+				}
+			}
+		});
+	}
+	for (auto& w : workers) w.join();
+
+	printf("%d threads x %d rounds: %s\n", thread_count, rounds,
+		errors.load() ? "FAILED" : "PASS");
+	return errors.load() ? 1 : 0;
+}
+/* EOF */
@@ -0,0 +1,152 @@
+/** @file lanes_near_bench.cpp
+ * benchmark: linear scan vs segment kd-tree for hdmap_impl::get_lanes_near_pt_enu
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <chrono>
+#include <set>
+#include <vector>
+
+#include "inc/segment-kdtree.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+struct bench_lane
+{
+	vector<double> xs, ys;
+};
+
+// generate a synthetic city map: a grid of roads with parallel lanes,
+// each lane has a center line of several points
+static void generate_lanes(vector<bench_lane>& lanes, int count)
+{
+	const double road_len = 100.;
+	const double lane_width = 3.5;
+	const int lanes_per_road = 4;
+	const int pts_per_lane = 11;
+
+	int roads = count / lanes_per_road;
+	int cols = (int)sqrt((double)roads);
+	srand(1);
+	for (int r = 0; r < roads; ++r) {
+		double ox = (r % cols) * road_len;
+		double oy = (r / cols) * road_len;
+		bool horizontal = (r & 1) ? true : false;
+		for (int l = 0; l < lanes_per_road; ++l) {
+			bench_lane lane;
+			for (int i = 0; i < pts_per_lane; ++i) {
+				double s = road_len * i / (pts_per_lane - 1);
+				double t = lane_width * l + (rand() % 100) / 1000.;
+				lane.xs.push_back(ox + (horizontal ? s : t));
+				lane.ys.push_back(oy + (horizontal ? t : s));
+			}
+			lanes.push_back(lane);
+		}
+	}
+}
+
+// the same logic as the original hdmap_impl::get_lanes_near_pt_enu
+static void linear_scan(const vector<bench_lane>& lanes,
+	double x, double y, double radius, vector<uint64_t>& ret)
+{
+	segment_kdnode seg;
+	for (size_t i = 0; i < lanes.size(); ++i) {
+		auto& lane = lanes[i];
+		for (size_t j = 0; j + 1 < lane.xs.size(); ++j) {
+			seg.x1 = lane.xs[j], seg.y1 = lane.ys[j];
+			seg.x2 = lane.xs[j + 1], seg.y2 = lane.ys[j + 1];
+			if (seg.segment_distance(x, y) < radius) {
+				ret.push_back(i);
+				break;
+			}
+		}
+	}
+}
+
+static void indexed_query(const segment_kdtree& tree,
+	double x, double y, double radius, vector<uint64_t>& ret)
+{
+	set<uint64_t> lanes;
+	tree.radius_search(x, y, radius, [&lanes](segment_kdnode* seg, double) {
+		lanes.insert(seg->index);
+	});
+	ret.assign(lanes.begin(), lanes.end());
+}
+
+int main(int argc, char* argv[])
+{
+	const int lane_count = 50000;
+	const int query_count = (argc > 1) ? atoi(argv[1]) : 200;
+	const double radius = 20.;
+
+	vector<bench_lane> lanes;
+	generate_lanes(lanes, lane_count);
+
+	double xmax = 0., ymax = 0.;
+	for (auto& lane : lanes) {
+		for (auto x : lane.xs) if (x > xmax) xmax = x;
+		for (auto y : lane.ys) if (y > ymax) ymax = y;
+	}
+
+	auto t0 = chrono::steady_clock::now();
+	segment_kdtree tree;
+	for (size_t i = 0; i < lanes.size(); ++i) {
+		auto& lane = lanes[i];
+		for (size_t j = 0; j + 1 < lane.xs.size(); ++j) {
+			tree.add(i, lane.xs[j], lane.ys[j], lane.xs[j + 1], lane.ys[j + 1]);
+		}
+	}
+	tree.build();
+	auto t1 = chrono::steady_clock::now();
+	printf("lanes: %lu, segments: %lu, build: %.2f ms\n", lanes.size(),
+		tree.size(), chrono::duration<double, milli>(t1 - t0).count());
+
+	vector<double> qx, qy;
+	for (int i = 0; i < query_count; ++i) {
+		qx.push_back(xmax * (rand() % 10000) / 10000.);
+		qy.push_back(ymax * (rand() % 10000) / 10000.);
+	}
+
+	size_t found_linear = 0, found_indexed = 0;
+	vector<uint64_t> r1, r2;
+
+	t0 = chrono::steady_clock::now();
+	for (int i = 0; i < query_count; ++i) {
+		r1.clear();
+		linear_scan(lanes, qx[i], qy[i], radius, r1);
+		found_linear += r1.size();
+	}
+	t1 = chrono::steady_clock::now();
+	double linear_us = chrono::duration<double, micro>(t1 - t0).count() / query_count;
+
+	t0 = chrono::steady_clock::now();
+	for (int i = 0; i < query_count; ++i) {
+		indexed_query(tree, qx[i], qy[i], radius, r2);
+		found_indexed += r2.size();
+	}
+	t1 = chrono::steady_clock::now();
+	double indexed_us = chrono::duration<double, micro>(t1 - t0).count() / query_count;
+
+	// check the results are identical
+	for (int i = 0; i < query_count; ++i) {
+		r1.clear();
+		linear_scan(lanes, qx[i], qy[i], radius, r1);
+		indexed_query(tree, qx[i], qy[i], radius, r2);
+		assert(r1 == r2);
+		if (r1 != r2) {
+			printf("result mismatch at query %d\n", i);
+			return 1;
+		}
+	}
+
+	printf("queries: %d, radius: %.1f m, avg lanes found: %.2f\n",
+		query_count, radius, (double)found_indexed / query_count);
+	printf("linear scan: %10.2f us/query\n", linear_us);
+	printf("kd-tree    : %10.2f us/query\n", indexed_us);
+	printf("speedup    : %10.2fx\n", linear_us / indexed_us);
+	return (found_linear == found_indexed) ? 0 : 1;
+}
+/* EOF */
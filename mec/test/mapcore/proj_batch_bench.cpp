@@ -0,0 +1,83 @@
+/** @file proj_batch_bench.cpp
+ * benchmark: throughput of the single point transform, the
+ * batch transform and the local area fast path of proj
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "mapcore/mapcore.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+#define GREF_UTM51N	"+proj=utm +zone=51 +ellps=WGS84 +datum=WGS84 +units=m +no_defs"
+
+static void report(const char* name, size_t count, double ms, double base_ms)
+{
+	printf("  %-28s %9.1f ms, %6.2f Mpts/s, %6.1fx\n", name, ms,
+		count / ms / 1e3, base_ms / ms);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = (argc > 1) ? atol(argv[1]) : 1000000;
+	// the area around the boyuanlu junction, ~1 km
+	const double lon0 = 121.164845, lat0 = 31.28027, range = 0.005;
+
+	proj p(GREF_WGS84, GREF_UTM51N);
+	if (!p.valid()) {
+		printf("fail to create the projection\n");
+		return 1;
+	}
+
+	mt19937 gen(1);
+	uniform_real_distribution<double> d(-range, range);
+	vector<point3d> src;
+	for (size_t i = 0; i < count; ++i) {
+		src.push_back(llh(lon0 + d(gen), lat0 + d(gen)));
+	}
+	printf("%lu points within %.3f deg of <%f, %f>\n", count, range, lon0, lat0);
+
+	vector<point3d> dst(src);
+	auto t0 = chrono::steady_clock::now();
+	for (auto& pt : dst) {
+		p.transform_point(pt);
+	}
+	auto t1 = chrono::steady_clock::now();
+	double single_ms = chrono::duration<double, milli>(t1 - t0).count();
+	report("transform_point", count, single_ms, single_ms);
+
+	dst = src;
+	t0 = chrono::steady_clock::now();
+	p.transform(dst.data(), dst.size());
+	t1 = chrono::steady_clock::now();
+	report("batch (proj_trans_generic)", count,
+		chrono::duration<double, milli>(t1 - t0).count(), single_ms);
+
+	int ret = p.set_local_area(llh(lon0, lat0), range, 0.01);
+	if (ret) {
+		printf("set_local_area failed: %d\n", ret);
+		return 1;
+	}
+	dst = src;
+	t0 = chrono::steady_clock::now();
+	p.transform(dst.data(), dst.size());
+	t1 = chrono::steady_clock::now();
+	report("batch, local area (1 cm)", count,
+		chrono::duration<double, milli>(t1 - t0).count(), single_ms);
+
+	dst = src;
+	t0 = chrono::steady_clock::now();
+	for (auto& pt : dst) {
+		p.transform_point(pt);
+	}
+	t1 = chrono::steady_clock::now();
+	report("transform_point, local area", count,
+		chrono::duration<double, milli>(t1 - t0).count(), single_ms);
+	return 0;
+}
+/* EOF */
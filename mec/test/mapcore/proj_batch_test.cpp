@@ -0,0 +1,152 @@
+/** @file proj_batch_test.cpp
+ * check the batch transform and the local area fast path
+ * of proj against the single point transform
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "mapcore/mapcore.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+#define VERIFY(cond, ...) do {	\
+	if (!(cond)) { printf(__VA_ARGS__); printf("\n"); return 1; }	\
+} while (0)
+
+// the georef of the boyuanlu map
+#define GREF_UTM51N	"+proj=utm +zone=51 +ellps=WGS84 +datum=WGS84 +units=m +no_defs"
+
+static const double lon0 = 121.164845, lat0 = 31.28027;
+
+static double dist(const point3d& a, const point3d& b)
+{
+	return sqrt((a.v[0] - b.v[0]) * (a.v[0] - b.v[0])
+		+ (a.v[1] - b.v[1]) * (a.v[1] - b.v[1])
+		+ (a.v[2] - b.v[2]) * (a.v[2] - b.v[2]));
+}
+
+static void random_points(vector<point3d>& pts, size_t count,
+	double range, unsigned seed)
+{
+	mt19937 gen(seed);
+	uniform_real_distribution<double> d(-range, range);
+	uniform_real_distribution<double> h(0., 50.);
+	pts.clear();
+	for (size_t i = 0; i < count; ++i) {
+		pts.push_back(llh(lon0 + d(gen), lat0 + d(gen), h(gen)));
+	}
+}
+
+// the batch transform gives the same result as proj_trans
+static int test_batch_exact(proj& p)
+{
+	vector<point3d> pts, exact;
+	random_points(pts, 10000, 0.5, 1);
+	for (auto& pt : pts) {
+		exact.push_back(p.transform(pt));
+	}
+	VERIFY(p.transform(pts.data(), pts.size()) == (int)pts.size(),
+		"batch transform failed");
+	for (size_t i = 0; i < pts.size(); ++i) {
+		VERIFY(dist(pts[i], exact[i]) < 1e-9, "point %lu: batch differs"
+			" from the single transform by %g m", i, dist(pts[i], exact[i]));
+	}
+
+	// strided arrays without z
+	vector<double> xy;
+	random_points(pts, 1000, 0.5, 2);
+	for (auto& pt : pts) {
+		xy.push_back(pt.v[0]), xy.push_back(pt.v[1]);
+	}
+	VERIFY(p.transform(&xy[0], &xy[1], nullptr, sizeof(double) * 2,
+		pts.size()) == (int)pts.size(), "strided transform failed");
+	for (size_t i = 0; i < pts.size(); ++i) {
+		pts[i].v[2] = 0.;
+		point3d e = p.transform(pts[i]);
+		VERIFY(fabs(xy[i * 2] - e.v[0]) < 1e-9 && fabs(xy[i * 2 + 1] - e.v[1]) < 1e-9,
+			"point %lu: strided batch differs from the single transform", i);
+	}
+
+	// inverse
+	vector<point3d> back(exact);
+	VERIFY(p.transform(back.data(), back.size(), true) == (int)back.size(),
+		"inverse batch transform failed");
+	random_points(pts, 10000, 0.5, 1);
+	for (size_t i = 0; i < pts.size(); ++i) {
+		VERIFY(fabs(back[i].v[0] - pts[i].v[0]) < 1e-9
+			&& fabs(back[i].v[1] - pts[i].v[1]) < 1e-9,
+			"point %lu: inverse does not round trip", i);
+	}
+	printf("batch transform: PASS\n");
+	return 0;
+}
+
+// the local area model stays within the tolerance, points
+// out of the area are transformed exactly
+static int test_local_area(proj& p, const proj& exact,
+	double range, double tolerance)
+{
+	int ret = p.set_local_area(llh(lon0, lat0), range, tolerance);
+	if (ret == -EOUTOFOSCOPE) {
+		printf("local area %.3f deg, tolerance %.3f m: refused\n", range, tolerance);
+		return 0;
+	}
+	VERIFY(!ret, "set_local_area failed: %d", ret);
+
+	vector<point3d> pts, fast;
+	random_points(pts, 100000, range * 2, 3);
+	fast = pts;
+	VERIFY(p.transform(fast.data(), fast.size()) == (int)fast.size(),
+		"batch transform failed");
+
+	double max_in = 0., max_out = 0.;
+	size_t in_area = 0;
+	for (size_t i = 0; i < pts.size(); ++i) {
+		point3d e = exact.transform(pts[i]);
+		bool inside = fabs(pts[i].v[0] - lon0) <= range
+			&& fabs(pts[i].v[1] - lat0) <= range;
+		double err = dist(fast[i], e);
+		if (inside) ++in_area, max_in = fmax(max_in, err);
+		else max_out = fmax(max_out, err);
+
+		// the single transform takes the same path
+		VERIFY(dist(p.transform(pts[i]), fast[i]) < 1e-9,
+			"point %lu: single and batch transform differ", i);
+	}
+	VERIFY(max_in <= tolerance, "local area error %g m > %g m", max_in, tolerance);
+	VERIFY(max_out < 1e-9, "points out of the area are not exact: %g m", max_out);
+
+	// inverse, from target CRS back to lon/lat
+	vector<point3d> back(fast);
+	VERIFY(p.transform(back.data(), back.size(), true) == (int)back.size(),
+		"inverse batch transform failed");
+	double max_inv = 0.;
+	for (size_t i = 0; i < pts.size(); ++i) {
+		max_inv = fmax(max_inv, dist(exact.transform(back[i]), fast[i]));
+	}
+	VERIFY(max_inv <= tolerance * 2, "inverse error %g m", max_inv);
+
+	printf("local area %.3f deg, tolerance %.3f m: %lu of %lu in area,"
+		" max error %.4f m, inverse %.4f m: PASS\n", range, tolerance,
+		in_area, pts.size(), max_in, max_inv);
+	return 0;
+}
+
+int main(void)
+{
+	proj p(GREF_WGS84, GREF_UTM51N), exact(GREF_WGS84, GREF_UTM51N);
+	VERIFY(p.valid() && exact.valid(), "fail to create the projection");
+	if (test_batch_exact(p)) return 1;
+
+	// ~1 km, ~5 km and ~50 km around the junction
+	if (test_local_area(p, exact, 0.005, 0.01)) return 1;
+	if (test_local_area(p, exact, 0.025, 0.1)) return 1;
+	if (test_local_area(p, exact, 0.25, 0.1)) return 1;
+	p.clear_local_area();
+	return 0;
+}
+/* EOF */
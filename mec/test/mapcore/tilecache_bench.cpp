@@ -0,0 +1,136 @@
+/** @file tilecache_bench.cpp
+ * benchmark: latency of tilecache queries while meshes are
+ * being generated, synchronous get_mesh vs background workers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "mapcore/hdmap.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+struct latency
+{
+	vector<double> samples;
+
+	void report(const char* name)
+	{
+		if (samples.empty()) {
+			printf("  %s: no samples\n", name);
+			return;
+		}
+		sort(samples.begin(), samples.end());
+		auto pct = [this](double p) {
+			return samples[(size_t)(p * (samples.size() - 1))];
+		};
+		printf("  %s: %lu queries, p50 %8.1f us, p99 %10.1f us,"
+			" max %10.1f us\n", name, samples.size(),
+			pct(.5), pct(.99), samples.back());
+	}
+};
+
+// query threads keep hitting the cache with cheap requests
+// while the meshes are being generated
+static void run_queries(tilecache& tc, const vector<uint32_t>& blocks,
+	atomic<bool>& stop, latency& lat)
+{
+	set<const rendermap_roadobject*> objs;
+	size_t i = 0;
+	while (!stop.load()) {
+		uint32_t blkid = blocks[i++ % blocks.size()];
+		auto t0 = chrono::steady_clock::now();
+		tc.extract_roadobjects(blkid, {}, objs);
+		auto t1 = chrono::steady_clock::now();
+		lat.samples.push_back(chrono::duration<double, micro>(t1 - t0).count());
+	}
+}
+
+static double run_phase(tilecache& tc, const vector<uint32_t>& blocks,
+	int query_threads, bool async, latency& total)
+{
+	atomic<bool> stop(false);
+	vector<latency> lats(query_threads);
+	vector<thread> threads;
+	for (int i = 0; i < query_threads; ++i) {
+		threads.emplace_back(run_queries, ref(tc),
+			cref(blocks), ref(stop), ref(lats[i]));
+	}
+
+	auto t0 = chrono::steady_clock::now();
+	if (async) {
+		vector<shared_future<shared_ptr<const odr::RoadNetworkMesh>>> futures;
+		for (auto blkid : blocks) {
+			futures.push_back(tc.get_mesh_future(blkid));
+		}
+		for (auto& f : futures) {
+			if (f.valid()) f.wait();
+		}
+	} else {
+		for (auto blkid : blocks) {
+			tc.get_mesh(blkid);
+		}
+	}
+	auto t1 = chrono::steady_clock::now();
+
+	stop = true;
+	for (auto& t : threads) t.join();
+	for (auto& l : lats) {
+		total.samples.insert(total.samples.end(),
+			l.samples.begin(), l.samples.end());
+	}
+	return chrono::duration<double, milli>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		printf("usage: %s <rendermap file> [workers] [query threads]\n", argv[0]);
+		return 1;
+	}
+	int workers = (argc > 2) ? atoi(argv[2]) : 4;
+	int query_threads = (argc > 3) ? atoi(argv[3]) : 2;
+
+	rendermap rmap;
+	if (rmap.load_fromfile(argv[1])) {
+		printf("fail to load %s\n", argv[1]);
+		return 1;
+	}
+	rendermap_info info;
+	rmap.get_mapinfo(info);
+
+	string buf;
+	tilecache tc;
+	tc.config_mesh_workers(workers, 1024);
+	if (rmap.extract_blocks({}, {}, buf) || tc.bind_map(buf)) {
+		printf("fail to bind the map\n");
+		return 1;
+	}
+
+	// load all blocks as tiles
+	vector<uint32_t> blocks;
+	for (uint32_t i = 0; i < info.rows * info.cols; ++i) {
+		if (rmap.extract_blocks({i}, {}, buf)) continue;
+		if (tc.add_tile(buf) > 0) blocks.push_back(i);
+	}
+	printf("blocks loaded: %lu\n", blocks.size());
+	if (blocks.empty()) return 1;
+
+	latency sync_lat, async_lat;
+	double sync_ms = run_phase(tc, blocks, query_threads, false, sync_lat);
+	for (auto blkid : blocks) tc.release_mesh(blkid);
+	double async_ms = run_phase(tc, blocks, query_threads, true, async_lat);
+
+	printf("synchronous get_mesh: all meshes in %.1f ms\n", sync_ms);
+	sync_lat.report("query latency");
+	printf("%d mesh workers: all meshes in %.1f ms\n", workers, async_ms);
+	async_lat.report("query latency");
+	return 0;
+}
+/* EOF */
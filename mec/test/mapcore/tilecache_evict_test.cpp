@@ -0,0 +1,242 @@
+/** @file tilecache_evict_test.cpp
+ * stream a route across hundreds of blocks and check the
+ * resident size of the cache stays under the budget
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "inc/clock-evictor.h"
+#include "mapcore/hdmap.h"
+
+using namespace std;
+using namespace zas::mapcore;
+
+#define VERIFY(cond, ...) do {	\
+	if (!(cond)) { printf(__VA_ARGS__); printf("\n"); return 1; }	\
+} while (0)
+
+// a serpentine route over a rows x cols grid
+static void make_route(int rows, int cols, vector<uint32_t>& route)
+{
+	for (int r = 0; r < rows; ++r) {
+		for (int c = 0; c < cols; ++c) {
+			int col = (r & 1) ? (cols - 1 - c) : c;
+			route.push_back(r * cols + col);
+		}
+	}
+}
+
+// the window of blocks around the vehicle which is
+// locked like lock_blocks() does in the viewer
+static void window(uint32_t center, int cols, set<uint32_t>& blocks)
+{
+	blocks.clear();
+	int row = center / cols, col = center % cols;
+	for (int r = row - 1; r <= row + 1; ++r) {
+		for (int c = col - 1; c <= col + 1; ++c) {
+			if (r < 0 || c < 0 || c >= cols) continue;
+			blocks.insert(r * cols + c);
+		}
+	}
+}
+
+static int test_synthetic_route(void)
+{
+	const int rows = 20, cols = 30;
+	const size_t budget = 64 << 20;
+	mt19937 gen(7);
+	uniform_int_distribution<size_t> data_sz(200 << 10, 1 << 20);
+	uniform_int_distribution<size_t> mesh_sz(1 << 20, 4 << 20);
+
+	vector<uint32_t> route;
+	make_route(rows, cols, route);
+
+	clock_evictor ev;
+	ev.set_budget(budget);
+	set<uint32_t> resident, pinned, win;
+	size_t loads = 0;
+
+	for (auto blkid : route) {
+		// unpin the old window and pin the new one
+		window(blkid, cols, win);
+		for (auto id : pinned) {
+			if (!win.count(id)) ev.pin(id, false);
+		}
+		pinned.clear();
+
+		// load the window blocks and generate their meshes
+		for (auto id : win) {
+			if (!resident.count(id)) {
+				size_t data = data_sz(gen);
+				ev.set(id, data);
+				ev.resize(id, data + mesh_sz(gen));
+				resident.insert(id);
+				++loads;
+			}
+			ev.touch(id);
+			ev.pin(id, true);
+			pinned.insert(id);
+		}
+
+		// evict as tilecache_impl::shrink_unlocked() does
+		uint32_t victim;
+		while (ev.over_budget() && ev.select_victim(victim)) {
+			VERIFY(!pinned.count(victim), "pinned block %u evicted", victim);
+			VERIFY(resident.count(victim), "unknown block %u evicted", victim);
+			ev.evicted(victim);
+			resident.erase(victim);
+		}
+		VERIFY(ev.resident() <= budget, "block %u: resident %lu > budget %lu",
+			blkid, ev.resident(), budget);
+		VERIFY(ev.size() == resident.size(), "entry count mismatch");
+	}
+
+	printf("synthetic route: %lu blocks, %lu loads, %lu evictions,"
+		" peak %lu kB, budget %lu kB: PASS\n", route.size(), loads,
+		ev.evictions(), ev.peak() >> 10, budget >> 10);
+	return 0;
+}
+
+// all blocks pinned: nothing could be evicted
+static int test_all_pinned(void)
+{
+	clock_evictor ev;
+	ev.set_budget(100);
+	for (uint32_t i = 0; i < 10; ++i) {
+		ev.set(i, 50);
+		ev.pin(i, true);
+	}
+	uint32_t victim;
+	VERIFY(!ev.select_victim(victim), "a pinned block is selected");
+	ev.pin(3, false);
+	VERIFY(ev.select_victim(victim) && victim == 3, "block 3 shall be selected");
+	printf("all pinned: PASS\n");
+	return 0;
+}
+
+// tiles of 2 x 2 blocks: the tile buffer is charged once and only
+// freed with the last block of the tile, as tilecache_impl does
+static int test_shared_tiles(void)
+{
+	const int rows = 20, cols = 30;
+	const size_t budget = 32 << 20, tile_sz = 2 << 20;
+	mt19937 gen(11);
+	uniform_int_distribution<size_t> mesh_sz(256 << 10, 1 << 20);
+
+	vector<uint32_t> route;
+	make_route(rows, cols, route);
+
+	clock_evictor ev;
+	ev.set_budget(budget);
+	map<uint32_t, size_t> meshes;
+	map<uint32_t, int> tiles;	// tile id -> blocks loaded
+	set<uint32_t> pinned, win;
+	auto tile_of = [&](uint32_t id) {
+		return (id / cols / 2) * cols + (id % cols) / 2;
+	};
+
+	for (auto blkid : route) {
+		window(blkid, cols, win);
+		for (auto id : pinned) {
+			if (!win.count(id)) ev.pin(id, false);
+		}
+		pinned.clear();
+
+		for (auto id : win) {
+			if (!meshes.count(id)) {
+				// the whole tile is loaded with the first block
+				uint32_t tile = tile_of(id);
+				if (!tiles[tile]++) ev.charge(tile_sz);
+				size_t sz = mesh_sz(gen);
+				ev.set(id, sz);
+				meshes[id] = sz;
+			}
+			ev.touch(id);
+			ev.pin(id, true);
+			pinned.insert(id);
+		}
+
+		uint32_t victim;
+		while (ev.over_budget() && ev.select_victim(victim)) {
+			VERIFY(!pinned.count(victim), "pinned block %u evicted", victim);
+			ev.evicted(victim);
+			meshes.erase(victim);
+			size_t resident = ev.resident();
+			uint32_t tile = tile_of(victim);
+			if (!--tiles[tile]) {
+				tiles.erase(tile);
+				ev.discharge(tile_sz);
+			}
+			ev.evicted_shared(resident - ev.resident());
+		}
+
+		size_t expected = tiles.size() * tile_sz;
+		for (auto& m : meshes) expected += m.second;
+		VERIFY(ev.resident() == expected, "block %u: resident %lu, "
+			"expected %lu", blkid, ev.resident(), expected);
+		VERIFY(ev.resident() <= budget, "block %u: resident %lu > budget %lu",
+			blkid, ev.resident(), budget);
+	}
+	printf("shared tiles: %lu evictions, %lu kB evicted, peak %lu kB,"
+		" budget %lu kB: PASS\n", ev.evictions(), ev.evicted_bytes() >> 10,
+		ev.peak() >> 10, budget >> 10);
+	return 0;
+}
+
+// stream the blocks of a real rendermap through a tilecache
+static int test_tilecache_route(const char* filename, size_t budget)
+{
+	rendermap rmap;
+	VERIFY(!rmap.load_fromfile(filename), "fail to load %s", filename);
+	rendermap_info info;
+	rmap.get_mapinfo(info);
+
+	string buf;
+	tilecache tc;
+	VERIFY(!rmap.extract_blocks({}, {}, buf), "fail to extract mapinfo");
+	VERIFY(!tc.bind_map(buf), "fail to bind the map");
+	tc.set_memory_budget(budget);
+
+	vector<uint32_t> route;
+	make_route(info.rows, info.cols, route);
+
+	tilecache_stats stats;
+	set<uint32_t> win, locked;
+	for (auto blkid : route) {
+		if (rmap.extract_blocks({blkid}, {}, buf)) continue;
+		if (tc.add_tile(buf) <= 0) continue;
+
+		window(blkid, info.cols, win);
+		tc.unlock_blocks(locked);
+		locked = win;
+		tc.filter_loaded_blocks(locked, true);
+		tc.get_mesh(blkid);
+
+		tc.get_stats(stats);
+		VERIFY(stats.resident <= budget, "block %u: resident %lu > budget %lu",
+			blkid, stats.resident, budget);
+	}
+	tc.get_stats(stats);
+	printf("tilecache route: %lu blocks, hits %lu, misses %lu, evictions %lu,"
+		" peak %lu kB, budget %lu kB: PASS\n", route.size(), stats.hits,
+		stats.misses, stats.evictions, stats.peak >> 10, budget >> 10);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (test_synthetic_route()) return 1;
+	if (test_all_pinned()) return 1;
+	if (test_shared_tiles()) return 1;
+	if (argc > 1) {
+		size_t budget = (argc > 2) ? atol(argv[2]) << 20 : (64 << 20);
+		if (test_tilecache_route(argv[1], budget)) return 1;
+	}
+	return 0;
+}
+/* EOF */
@@ -82,6 +82,39 @@ Lane::Lane(void** buf)
 }
 Lane::Lane(int id, bool level, std::string type) : id(id), level(level), type(type) {}
 
+LaneType get_lane_type(const std::string& type)
+{
+    static const std::map<std::string, LaneType> types = {
+        {"none", LaneType::None},
+        {"driving", LaneType::Driving},
+        {"stop", LaneType::Stop},
+        {"shoulder", LaneType::Shoulder},
+        {"biking", LaneType::Biking},
+        {"sidewalk", LaneType::Sidewalk},
+        {"border", LaneType::Border},
+        {"restricted", LaneType::Restricted},
+        {"parking", LaneType::Parking},
+        {"bidirectional", LaneType::Bidirectional},
+        {"median", LaneType::Median},
+        {"special1", LaneType::Special1},
+        {"special2", LaneType::Special2},
+        {"special3", LaneType::Special3},
+        {"roadWorks", LaneType::RoadWorks},
+        {"tram", LaneType::Tram},
+        {"rail", LaneType::Rail},
+        {"entry", LaneType::Entry},
+        {"exit", LaneType::Exit},
+        {"offRamp", LaneType::OffRamp},
+        {"onRamp", LaneType::OnRamp},
+        {"connectingRamp", LaneType::ConnectingRamp},
+        {"bus", LaneType::Bus},
+        {"taxi", LaneType::Taxi},
+        {"HOV", LaneType::HOV}};
+
+    auto iter = types.find(type);
+    return (iter == types.end()) ? LaneType::Unknown : iter->second;
+}
+
 Vec3D Lane::get_surface_pt(double s, double t, Vec3D* vn) const
 {
     auto road_ptr = this->road.lock();
@@ -18,6 +18,39 @@ namespace odr
 class Road;
 struct LaneSection;
 
+/* lane types of OpenDRIVE 1.6, Unknown for anything else */
+enum class LaneType
+{
+    None,
+    Driving,
+    Stop,
+    Shoulder,
+    Biking,
+    Sidewalk,
+    Border,
+    Restricted,
+    Parking,
+    Bidirectional,
+    Median,
+    Special1,
+    Special2,
+    Special3,
+    RoadWorks,
+    Tram,
+    Rail,
+    Entry,
+    Exit,
+    OffRamp,
+    OnRamp,
+    ConnectingRamp,
+    Bus,
+    Taxi,
+    HOV,
+    Unknown
+};
+
+LaneType get_lane_type(const std::string& type);
+
 struct HeightOffset
 {
     uint64_t getsize(void);
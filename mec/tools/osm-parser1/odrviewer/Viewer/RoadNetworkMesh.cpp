@@ -1,6 +1,8 @@
 #include "RoadNetworkMesh.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
 
 namespace odr
 {
@@ -94,56 +96,213 @@ Mesh3D RoadNetworkMesh::get_mesh() const
     return out_mesh;
 }
 
-double distance_utm(double x1, double y1, double x2, double y2)
+RoadHeightIndex::RoadHeightIndex(const LanesMesh& lanes_mesh)
 {
-    return (x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2);
-}
+    const std::vector<Vec3D>&    vertices = lanes_mesh.vertices;
+    const std::vector<uint32_t>& indices = lanes_mesh.indices;
 
-double RoadNetworkMesh::get_road_height(double x, double y, double distance)
-{
-    double height = 0.0;
-    size_t max_vsz = lanes_mesh.vertices.size();
-	std::map<size_t, int>::iterator it;
-    size_t prev = 0;
-    size_t next = 0;
-    
-	for(it = lanes_mesh.lane_start_indices.begin();
-         it != lanes_mesh.lane_start_indices.end(); ++it) {
-        next = it->first;
-        if (prev == next) {
+    /* keep the triangles of all lanes but the ones of type None */
+    auto lane_type_at = [&lanes_mesh](size_t vert_idx) {
+        auto iter = lanes_mesh.lane_start_lane_type.upper_bound(vert_idx);
+        if (iter == lanes_mesh.lane_start_lane_type.begin())
+            return LaneType::Unknown;
+        return std::prev(iter)->second;
+    };
+
+    double xmax = 0.0, ymax = 0.0, extent_sum = 0.0;
+    for (size_t idx = 0; idx + 2 < indices.size(); idx += 3)
+    {
+        if (lane_type_at(indices[idx]) == LaneType::None)
             continue;
+
+        double tx1 = vertices[indices[idx]][0], tx2 = tx1;
+        double ty1 = vertices[indices[idx]][1], ty2 = ty1;
+        for (size_t k = 1; k < 3; k++)
+        {
+            const Vec3D& v = vertices[indices[idx + k]];
+            tx1 = std::min(tx1, v[0]), tx2 = std::max(tx2, v[0]);
+            ty1 = std::min(ty1, v[1]), ty2 = std::max(ty2, v[1]);
         }
-        if(lanes_mesh.lane_start_type[prev].compare("none")) {
-            for (size_t i = prev + 1; i < next; i += 2) {
-                auto tmp = distance_utm(lanes_mesh.vertices[i][0],
-                    lanes_mesh.vertices[i][1], x, y);
-                if (tmp < distance) {
-                    distance = tmp;
-                    height = lanes_mesh.vertices[i][2];
-                    if (distance < 1.0) {
-                        return height;
-                    }
+        if (this->triangles.empty())
+        {
+            this->xmin = tx1, this->ymin = ty1;
+            xmax = tx2, ymax = ty2;
+        }
+        this->xmin = std::min(this->xmin, tx1), this->ymin = std::min(this->ymin, ty1);
+        xmax = std::max(xmax, tx2), ymax = std::max(ymax, ty2);
+        extent_sum += std::max(tx2 - tx1, ty2 - ty1);
+
+        this->triangles.push_back(indices[idx]);
+        this->triangles.push_back(indices[idx + 1]);
+        this->triangles.push_back(indices[idx + 2]);
+    }
+
+    const size_t num_triangles = this->get_num_triangles();
+    if (num_triangles == 0)
+        return;
+
+    /* a cell about the size of a triangle, but never more cells than 4x the triangles */
+    this->cell_size = std::max(0.5, extent_sum / num_triangles);
+    const double width = xmax - this->xmin, height = ymax - this->ymin;
+    while ((width / this->cell_size + 1) * (height / this->cell_size + 1) > 4.0 * num_triangles + 16)
+        this->cell_size *= 2;
+    this->cols = static_cast<int>(width / this->cell_size) + 1;
+    this->rows = static_cast<int>(height / this->cell_size) + 1;
+
+    /* counting pass, then fill (CSR layout) */
+    std::vector<uint32_t> counts(static_cast<size_t>(this->cols) * this->rows + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t tri = 0; tri < num_triangles; tri++)
+        {
+            double tx1 = DBL_MAX, ty1 = DBL_MAX, tx2 = -DBL_MAX, ty2 = -DBL_MAX;
+            for (size_t k = 0; k < 3; k++)
+            {
+                const Vec3D& v = vertices[this->triangles[tri * 3 + k]];
+                tx1 = std::min(tx1, v[0]), tx2 = std::max(tx2, v[0]);
+                ty1 = std::min(ty1, v[1]), ty2 = std::max(ty2, v[1]);
+            }
+            int cx1, cy1, cx2, cy2;
+            this->get_cell(tx1, ty1, cx1, cy1);
+            this->get_cell(tx2, ty2, cx2, cy2);
+            for (int cy = cy1; cy <= cy2; cy++)
+            {
+                for (int cx = cx1; cx <= cx2; cx++)
+                {
+                    const size_t cell = static_cast<size_t>(cy) * this->cols + cx;
+                    if (pass == 0)
+                        counts[cell + 1]++;
+                    else
+                        this->cell_triangles[counts[cell]++] = static_cast<uint32_t>(tri);
                 }
             }
-        } 
-        prev = next;
+        }
+        if (pass == 0)
+        {
+            for (size_t cell = 1; cell < counts.size(); cell++)
+                counts[cell] += counts[cell - 1];
+            this->cell_offsets = counts;
+            this->cell_triangles.resize(counts.back());
+        }
     }
-    if (next < max_vsz) {
-        if(lanes_mesh.lane_start_type[next].compare("none")) {
-            for (size_t i = prev + 1; i < max_vsz; i += 2) {
-                auto tmp = distance_utm(lanes_mesh.vertices[i][0],
-                    lanes_mesh.vertices[i][1], x, y);
-                if (tmp < distance) {
-                    distance = tmp;
-                    height = lanes_mesh.vertices[i][2];
-                    if (distance < 1.0) {
-                        return height;
+}
+
+bool RoadHeightIndex::get_cell(double x, double y, int& cx, int& cy) const
+{
+    cx = static_cast<int>(std::floor((x - this->xmin) / this->cell_size));
+    cy = static_cast<int>(std::floor((y - this->ymin) / this->cell_size));
+    const bool inside = (cx >= 0 && cy >= 0 && cx < this->cols && cy < this->rows);
+    cx = std::min(std::max(cx, 0), this->cols - 1);
+    cy = std::min(std::max(cy, 0), this->rows - 1);
+    return inside;
+}
+
+bool RoadHeightIndex::get_triangle_height(const std::vector<Vec3D>& vertices, uint32_t tri, double x, double y, double& height) const
+{
+    const Vec3D& a = vertices[this->triangles[tri * 3]];
+    const Vec3D& b = vertices[this->triangles[tri * 3 + 1]];
+    const Vec3D& c = vertices[this->triangles[tri * 3 + 2]];
+
+    /* barycentric coordinates in the xy plane */
+    const double det = (b[1] - c[1]) * (a[0] - c[0]) + (c[0] - b[0]) * (a[1] - c[1]);
+    if (std::abs(det) < 1e-12)
+        return false;
+    const double l1 = ((b[1] - c[1]) * (x - c[0]) + (c[0] - b[0]) * (y - c[1])) / det;
+    const double l2 = ((c[1] - a[1]) * (x - c[0]) + (a[0] - c[0]) * (y - c[1])) / det;
+    const double l3 = 1.0 - l1 - l2;
+    const double eps = -1e-9;
+    if (l1 < eps || l2 < eps || l3 < eps)
+        return false;
+
+    height = l1 * a[2] + l2 * b[2] + l3 * c[2];
+    return true;
+}
+
+bool RoadHeightIndex::get_height(const std::vector<Vec3D>& vertices, double x, double y, double max_dist2, double& height) const
+{
+    if (this->triangles.empty())
+        return false;
+
+    int        cx, cy;
+    const bool inside = this->get_cell(x, y, cx, cy);
+    if (inside)
+    {
+        const size_t cell = static_cast<size_t>(cy) * this->cols + cx;
+        for (uint32_t i = this->cell_offsets[cell]; i < this->cell_offsets[cell + 1]; i++)
+        {
+            if (this->get_triangle_height(vertices, this->cell_triangles[i], x, y, height))
+                return true;
+        }
+    }
+
+    /* not on the road surface: the nearest vertex within the distance */
+    const double radius = std::sqrt(max_dist2);
+    int          cx1, cy1, cx2, cy2;
+    this->get_cell(x - radius, y - radius, cx1, cy1);
+    this->get_cell(x + radius, y + radius, cx2, cy2);
+
+    bool found = false;
+    for (int yy = cy1; yy <= cy2; yy++)
+    {
+        for (int xx = cx1; xx <= cx2; xx++)
+        {
+            const size_t cell = static_cast<size_t>(yy) * this->cols + xx;
+            for (uint32_t i = this->cell_offsets[cell]; i < this->cell_offsets[cell + 1]; i++)
+            {
+                const uint32_t tri = this->cell_triangles[i];
+                for (size_t k = 0; k < 3; k++)
+                {
+                    const Vec3D& v = vertices[this->triangles[tri * 3 + k]];
+                    const double d2 = (v[0] - x) * (v[0] - x) + (v[1] - y) * (v[1] - y);
+                    if (d2 < max_dist2)
+                    {
+                        max_dist2 = d2;
+                        height = v[2];
+                        found = true;
                     }
                 }
             }
         }
     }
+    return found;
+}
+
+size_t RoadHeightIndex::get_memory_bytes() const
+{
+    return sizeof(RoadHeightIndex) + (this->triangles.capacity() + this->cell_offsets.capacity() + this->cell_triangles.capacity()) * sizeof(uint32_t);
+}
+
+void RoadNetworkMesh::build_height_index() { std::atomic_store(&this->height_index, std::shared_ptr<const RoadHeightIndex>(std::make_shared<RoadHeightIndex>(this->lanes_mesh))); }
+
+std::shared_ptr<const RoadHeightIndex> RoadNetworkMesh::get_height_index() const
+{
+    auto index = std::atomic_load(&this->height_index);
+    if (!index)
+    {
+        /* concurrent builders may race, any of the identical results wins */
+        index = std::make_shared<RoadHeightIndex>(this->lanes_mesh);
+        std::atomic_store(&this->height_index, index);
+    }
+    return index;
+}
+
+double RoadNetworkMesh::get_road_height(double x, double y, double distance) const
+{
+    double height = 0.0;
+    if (!this->get_height_index()->get_height(this->lanes_mesh.vertices, x, y, distance, height))
+        return 0.0;
     return height;
 }
 
+void RoadNetworkMesh::get_road_heights(const std::vector<Vec2D>& pts, std::vector<double>& heights, double distance) const
+{
+    auto index = this->get_height_index();
+    heights.resize(pts.size());
+    for (size_t idx = 0; idx < pts.size(); idx++)
+    {
+        if (!index->get_height(this->lanes_mesh.vertices, pts[idx][0], pts[idx][1], distance, heights[idx]))
+            heights[idx] = 0.0;
+    }
+}
+
 } // namespace odr
\ No newline at end of file
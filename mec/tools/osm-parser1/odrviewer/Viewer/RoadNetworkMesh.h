@@ -1,9 +1,11 @@
 #pragma once
 
+#include "Lanes.h"
 #include "Mesh.h"
 #include "Utils.hpp"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,7 @@ struct LanesMesh : public RoadsMesh
     std::map<size_t, double> lanesec_start_indices;
     std::map<size_t, int>    lane_start_indices;
     std::map<size_t, std::string>    lane_start_type;
+    std::map<size_t, LaneType>       lane_start_lane_type;
 };
 
 struct RoadmarksMesh : public LanesMesh
@@ -62,15 +65,53 @@ struct RoadObjectsMesh : public RoadsMesh
     std::map<size_t, std::string> road_object_type;
 };
 
+/* uniform 2D grid over the lane mesh triangles (lanes of type None excluded),
+   triangles refer to the vertices of the lanes mesh it was built from */
+class RoadHeightIndex
+{
+public:
+    explicit RoadHeightIndex(const LanesMesh& lanes_mesh);
+
+    /* height of the triangle containing (x, y) interpolated from its vertices; if no triangle
+       contains the point, the height of the nearest vertex with squared distance < max_dist2 */
+    bool get_height(const std::vector<Vec3D>& vertices, double x, double y, double max_dist2, double& height) const;
+
+    size_t get_num_triangles() const { return triangles.size() / 3; }
+    size_t get_memory_bytes() const;
+
+private:
+    bool get_cell(double x, double y, int& cx, int& cy) const;
+    bool get_triangle_height(const std::vector<Vec3D>& vertices, uint32_t tri, double x, double y, double& height) const;
+
+    double xmin = 0.0;
+    double ymin = 0.0;
+    double cell_size = 1.0;
+    int    cols = 0;
+    int    rows = 0;
+
+    std::vector<uint32_t> triangles;    // 3 vertex indices per triangle
+    std::vector<uint32_t> cell_offsets; // cols * rows + 1, into cell_triangles
+    std::vector<uint32_t> cell_triangles;
+};
+
 struct RoadNetworkMesh
 {
     Mesh3D get_mesh() const;
-    double get_road_height(double x, double y, double distance = 25.0);
+    double get_road_height(double x, double y, double distance = 25.0) const;
+    void   get_road_heights(const std::vector<Vec2D>& pts, std::vector<double>& heights, double distance = 25.0) const;
+
+    /* build the height index, done by get_road_network_mesh(); built lazily otherwise */
+    void build_height_index();
 
     Mesh3D          refline;
     LanesMesh       lanes_mesh;
     RoadmarksMesh   roadmarks_mesh;
     RoadObjectsMesh road_objects_mesh;
+
+    mutable std::shared_ptr<const RoadHeightIndex> height_index;
+
+private:
+    std::shared_ptr<const RoadHeightIndex> get_height_index() const;
 };
 
 } // namespace odr
\ No newline at end of file
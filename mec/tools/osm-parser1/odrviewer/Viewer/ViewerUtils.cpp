@@ -56,6 +56,7 @@ RoadNetworkMesh get_road_network_mesh(const OpenDriveMap& odr_map, double eps)
                 const size_t lanes_idx_offset = lanes_mesh.vertices.size();
                 lanes_mesh.lane_start_indices[lanes_idx_offset] = lane->id;
                 lanes_mesh.lane_start_type[lanes_idx_offset] = lane->type;
+                lanes_mesh.lane_start_lane_type[lanes_idx_offset] = get_lane_type(lane->type);
                 lanes_mesh.add_mesh(lane->get_mesh(lanesec->s0, lanesec->get_end(), eps));
 
                 size_t roadmarks_idx_offset = roadmarks_mesh.vertices.size();
@@ -79,6 +80,7 @@ RoadNetworkMesh get_road_network_mesh(const OpenDriveMap& odr_map, double eps)
             road_objects_mesh.add_mesh(road_object->get_mesh(eps));
         }
     }
+    out_mesh.build_height_index();
     return out_mesh;
 }
 
@@ -0,0 +1,158 @@
+#include "Lanes.h"
+#include "Viewer/RoadNetworkMesh.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/* the road surface of the synthetic map, a gentle slope */
+static double surface_z(double x, double y) { return 10.0 + 0.02 * x - 0.01 * y; }
+
+/* a dense junction: num_roads straight roads crossing the origin at different angles,
+   each with lanes_per_side lanes on both sides, sampled every eps like Lane::get_mesh() */
+static odr::RoadNetworkMesh make_junction(int num_roads, int lanes_per_side, double length, double eps)
+{
+    odr::RoadNetworkMesh mesh;
+    odr::LanesMesh&      lanes_mesh = mesh.lanes_mesh;
+    const double         lane_width = 3.5;
+
+    for (int r = 0; r < num_roads; r++)
+    {
+        const double hdg = M_PI * r / num_roads;
+        const double dx = std::cos(hdg), dy = std::sin(hdg);
+        for (int lane_id = -lanes_per_side; lane_id <= lanes_per_side; lane_id++)
+        {
+            const bool   is_center = (lane_id == 0);
+            const double t_inner = is_center ? 0.0 : (std::abs(lane_id) - 1) * lane_width * (lane_id > 0 ? 1 : -1);
+            const double t_outer = is_center ? 0.0 : std::abs(lane_id) * lane_width * (lane_id > 0 ? 1 : -1);
+            const size_t offset = lanes_mesh.vertices.size();
+            lanes_mesh.lane_start_indices[offset] = lane_id;
+            lanes_mesh.lane_start_type[offset] = is_center ? "none" : "driving";
+            lanes_mesh.lane_start_lane_type[offset] = is_center ? odr::LaneType::None : odr::LaneType::Driving;
+
+            odr::Mesh3D lane;
+            for (double s = -length / 2; s <= length / 2; s += eps)
+            {
+                for (double t : {t_inner, t_outer})
+                {
+                    const double x = s * dx - t * dy, y = s * dy + t * dx;
+                    lane.vertices.push_back({x, y, surface_z(x, y)});
+                }
+            }
+            for (size_t idx = 0; idx + 3 < lane.vertices.size(); idx += 2)
+            {
+                lane.indices.insert(lane.indices.end(), {uint32_t(idx), uint32_t(idx + 1), uint32_t(idx + 2)});
+                lane.indices.insert(lane.indices.end(), {uint32_t(idx + 1), uint32_t(idx + 3), uint32_t(idx + 2)});
+            }
+            lanes_mesh.add_mesh(lane);
+        }
+    }
+    return mesh;
+}
+
+/* the previous implementation of RoadNetworkMesh::get_road_height() */
+static double linear_road_height(odr::LanesMesh& lanes_mesh, double x, double y, double distance)
+{
+    double height = 0.0;
+    size_t max_vsz = lanes_mesh.vertices.size();
+    size_t prev = 0;
+    size_t next = 0;
+    auto   scan = [&](size_t from, size_t to) {
+        for (size_t i = from + 1; i < to; i += 2)
+        {
+            const double tmp = (lanes_mesh.vertices[i][0] - x) * (lanes_mesh.vertices[i][0] - x) +
+                               (lanes_mesh.vertices[i][1] - y) * (lanes_mesh.vertices[i][1] - y);
+            if (tmp < distance)
+            {
+                distance = tmp;
+                height = lanes_mesh.vertices[i][2];
+                if (distance < 1.0)
+                    return true;
+            }
+        }
+        return false;
+    };
+    for (auto it = lanes_mesh.lane_start_indices.begin(); it != lanes_mesh.lane_start_indices.end(); ++it)
+    {
+        next = it->first;
+        if (prev == next)
+            continue;
+        if (lanes_mesh.lane_start_type[prev].compare("none") && scan(prev, next))
+            return height;
+        prev = next;
+    }
+    if (next < max_vsz && lanes_mesh.lane_start_type[next].compare("none") && scan(prev, max_vsz))
+        return height;
+    return height;
+}
+
+int main(int argc, char** argv)
+{
+    const int    num_roads = (argc > 1) ? atoi(argv[1]) : 8;
+    const int    num_queries = (argc > 2) ? atoi(argv[2]) : 2000;
+    const double length = 200.0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto mesh = make_junction(num_roads, 3, length, 0.1);
+    auto t1 = std::chrono::steady_clock::now();
+    mesh.build_height_index();
+    auto t2 = std::chrono::steady_clock::now();
+    printf("junction: %d roads, %lu vertices, %lu triangles indexed, mesh %.1f ms, index %.1f ms (%lu kB)\n",
+           num_roads,
+           mesh.lanes_mesh.vertices.size(),
+           mesh.height_index->get_num_triangles(),
+           std::chrono::duration<double, std::milli>(t1 - t0).count(),
+           std::chrono::duration<double, std::milli>(t2 - t1).count(),
+           mesh.height_index->get_memory_bytes() >> 10);
+
+    /* query points on and around the junction */
+    std::mt19937                           gen(3);
+    std::uniform_real_distribution<double> coord(-length / 3, length / 3);
+    std::vector<odr::Vec2D>                pts;
+    for (int i = 0; i < num_queries; i++)
+        pts.push_back({coord(gen), coord(gen)});
+
+    int linear_queries = std::min(num_queries, 200);
+    t0 = std::chrono::steady_clock::now();
+    double sum_linear = 0.0;
+    for (int i = 0; i < linear_queries; i++)
+        sum_linear += linear_road_height(mesh.lanes_mesh, pts[i][0], pts[i][1], 25.0);
+    t1 = std::chrono::steady_clock::now();
+    const double linear_qps = linear_queries / std::chrono::duration<double>(t1 - t0).count();
+
+    t0 = std::chrono::steady_clock::now();
+    double sum_indexed = 0.0;
+    for (int i = 0; i < num_queries; i++)
+        sum_indexed += mesh.get_road_height(pts[i][0], pts[i][1]);
+    t1 = std::chrono::steady_clock::now();
+    const double indexed_qps = num_queries / std::chrono::duration<double>(t1 - t0).count();
+
+    std::vector<double> heights;
+    t0 = std::chrono::steady_clock::now();
+    mesh.get_road_heights(pts, heights);
+    t1 = std::chrono::steady_clock::now();
+    const double batch_qps = num_queries / std::chrono::duration<double>(t1 - t0).count();
+
+    /* points on the road surface get the exact interpolated height */
+    int on_road = 0, errors = 0;
+    for (int i = 0; i < num_queries; i++)
+    {
+        if (heights[i] == 0.0)
+            continue;
+        const double expected = surface_z(pts[i][0], pts[i][1]);
+        if (std::abs(heights[i] - expected) < 1e-6)
+            on_road++;
+        else if (std::abs(heights[i] - expected) > 0.2)
+            errors++;
+    }
+
+    printf("linear scan : %12.0f queries/s (checksum %.3f over %d queries)\n", linear_qps, sum_linear, linear_queries);
+    printf("grid index  : %12.0f queries/s (checksum %.3f)\n", indexed_qps, sum_indexed);
+    printf("grid batch  : %12.0f queries/s\n", batch_qps);
+    printf("speedup     : %12.1fx\n", indexed_qps / linear_qps);
+    printf("exact on-road heights: %d / %d, off by > 0.2 m: %d\n", on_road, num_queries, errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+/** @file endpoint-balance-bench.cpp
+ * benchmark: simulation of the endpoints of a server with weights,
+ * reconnecting vehicles and endpoints going down and up. The linear
+ * scan of alloc_server_endpoint_to_vehicle against the modes of the
+ * endpoint_balancer: time, load / weight spread and the vehicles that
+ * reconnect to the endpoint they had
+ *
+ * endpoint-balance-bench [endpoints] [vehicles] [reconnects] [churn every]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/endpoint-balancer.h"
+
+using namespace std;
+using namespace zas::utils;
+
+struct sim_endpoint
+{
+	balance_node node;
+	string identity;
+	bool up;
+};
+
+class sim_policy
+{
+public:
+	virtual ~sim_policy() {}
+	virtual int acquire(const string &vid) = 0;
+	virtual void release(int ep) = 0;
+	virtual void down(int ep) = 0;
+	virtual void up(int ep) = 0;
+	virtual double spread(void) = 0;
+};
+
+// alloc_server_endpoint_to_vehicle before the endpoint_balancer
+class linear_policy : public sim_policy
+{
+public:
+	linear_policy(vector<sim_endpoint> &eps, size_t maxcnt)
+	: _eps(eps), _maxcnt(maxcnt) {
+		for (auto& ep : _eps) {
+			ep.node.load = 0;
+			ep.up = true;
+		}
+	}
+
+	// the vehicle does not matter to the scan
+	int acquire(const string &) {
+		int ret = -1;
+		size_t min = _maxcnt;
+		for (size_t i = 0; i < _eps.size(); i++) {
+			if (!_eps[i].up) continue;
+			if (_eps[i].node.load < min) {
+				min = _eps[i].node.load;
+				ret = (int)i;
+			}
+		}
+		if (ret >= 0) _eps[ret].node.load++;
+		return ret;
+	}
+
+	void release(int ep) {
+		if (_eps[ep].node.load) _eps[ep].node.load--;
+	}
+
+	void down(int ep) {
+		_eps[ep].up = false;
+		_eps[ep].node.load = 0;
+	}
+
+	void up(int ep) {
+		_eps[ep].up = true;
+	}
+
+	double spread(void);
+
+private:
+	vector<sim_endpoint> &_eps;
+	size_t _maxcnt;
+};
+
+class balancer_policy : public sim_policy
+{
+public:
+	balancer_policy(vector<sim_endpoint> &eps, size_t capacity, int mode)
+	: _eps(eps) {
+		_balancer.set_mode(mode);
+		_balancer.set_capacity(capacity);
+		for (auto& ep : _eps) {
+			endpoint_balancer::init_node(&ep.node, 0, ep.node.weight);
+			ep.up = true;
+			_balancer.add(&ep.node, ep.identity);
+		}
+	}
+
+	int acquire(const string &vid) {
+		auto* node = _balancer.acquire(&vid);
+		if (!node) return -1;
+		return (int)(BALANCE_NODE_ENTRY(sim_endpoint, node, node) - &_eps[0]);
+	}
+
+	void release(int ep) {
+		_balancer.release(&_eps[ep].node);
+	}
+
+	void down(int ep) {
+		_eps[ep].up = false;
+		_balancer.remove(&_eps[ep].node);
+		_eps[ep].node.load = 0;
+	}
+
+	void up(int ep) {
+		_eps[ep].up = true;
+		_balancer.add(&_eps[ep].node, _eps[ep].identity);
+	}
+
+	double spread(void);
+
+private:
+	vector<sim_endpoint> &_eps;
+	endpoint_balancer _balancer;
+};
+
+// the most loaded endpoint for its weight against the average
+static double load_spread(const vector<sim_endpoint> &eps)
+{
+	double maxrel = 0.;
+	size_t load = 0, weight = 0;
+	for (auto& ep : eps) {
+		if (!ep.up) continue;
+		load += ep.node.load;
+		weight += ep.node.weight;
+		double rel = (double)ep.node.load / ep.node.weight;
+		if (rel > maxrel) maxrel = rel;
+	}
+	return (load && weight) ? maxrel / ((double)load / weight) : 0.;
+}
+
+double linear_policy::spread(void) { return load_spread(_eps); }
+double balancer_policy::spread(void) { return load_spread(_eps); }
+
+struct sim_result
+{
+	double seconds;
+	double spread;
+	size_t reconnects;
+	size_t sticky;
+	size_t moved;
+	size_t failed;
+};
+
+static sim_result simulate(sim_policy &policy, vector<sim_endpoint> &eps,
+	const vector<string> &vids, size_t reconnects, size_t churn)
+{
+	sim_result res = {0., 0., 0, 0, 0, 0};
+	mt19937 gen(7);
+	uniform_int_distribution<size_t> pickv(0, vids.size() - 1);
+	uniform_int_distribution<size_t> picke(0, eps.size() - 1);
+	vector<int> owner(vids.size(), -1);
+	vector<int> downs;
+
+	auto t0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < vids.size(); i++) {
+		owner[i] = policy.acquire(vids[i]);
+	}
+	for (size_t r = 0; r < reconnects; r++) {
+		if (churn && r && !(r % churn)) {
+			// an endpoint goes down, one that was down comes back
+			int ep = (int)picke(gen);
+			if (eps[ep].up) {
+				policy.down(ep);
+				downs.push_back(ep);
+				for (size_t v = 0; v < vids.size(); v++) {
+					if (owner[v] != ep) continue;
+					owner[v] = policy.acquire(vids[v]);
+					res.moved++;
+				}
+			}
+			if (downs.size() > 1) {
+				policy.up(downs.front());
+				downs.erase(downs.begin());
+			}
+		}
+		size_t v = pickv(gen);
+		int prev = owner[v];
+		if (prev >= 0) policy.release(prev);
+		owner[v] = policy.acquire(vids[v]);
+		if (owner[v] < 0) res.failed++;
+		if (owner[v] == prev) res.sticky++;
+		res.reconnects++;
+	}
+	res.seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	res.spread = policy.spread();
+	return res;
+}
+
+static void print(const char* name, const sim_result &res, size_t ops)
+{
+	printf("%-16s: %8.3f us/op, spread %5.2f, sticky %6.2f%%, "
+		"moved %lu, failed %lu\n", name, res.seconds * 1e6 / ops,
+		res.spread, 100. * res.sticky / res.reconnects,
+		res.moved, res.failed);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t endpoints = (argc > 1) ? atol(argv[1]) : 2000;
+	size_t vehicles = (argc > 2) ? atol(argv[2]) : 200000;
+	size_t reconnects = (argc > 3) ? atol(argv[3]) : 1000000;
+	size_t churn = (argc > 4) ? atol(argv[4]) : 10000;
+
+	mt19937 gen(1);
+	uniform_int_distribution<int> pickw(1, 4);
+	vector<sim_endpoint> eps(endpoints);
+	char buf[32];
+	for (size_t i = 0; i < endpoints; i++) {
+		snprintf(buf, sizeof(buf), "snapshot-%05lu", i);
+		eps[i].identity = buf;
+		endpoint_balancer::init_node(&eps[i].node, 0, pickw(gen));
+	}
+	vector<string> vids(vehicles);
+	for (size_t i = 0; i < vehicles; i++) {
+		snprintf(buf, sizeof(buf), "LSVAU2180N%07lu", i);
+		vids[i] = buf;
+	}
+	// every endpoint could take all the vehicles alone
+	size_t capacity = vehicles;
+	size_t ops = vehicles + reconnects;
+	printf("%lu endpoints of weight 1-4, %lu vehicles, %lu reconnects, "
+		"an endpoint down every %lu\n", endpoints, vehicles,
+		reconnects, churn);
+
+	{
+		linear_policy policy(eps, capacity);
+		print("linear scan", simulate(policy, eps, vids,
+			reconnects, churn), ops);
+	}
+	const char* names[] = {"least-loaded", "two-choices", "consistent-hash"};
+	for (int mode = balance_mode_least_loaded;
+		mode <= balance_mode_consistent_hash; mode++) {
+		balancer_policy policy(eps, capacity, mode);
+		print(names[mode], simulate(policy, eps, vids,
+			reconnects, churn), ops);
+	}
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include "std/smtptr.h"
 #include "std/list.h"
 #include "utils/avltree.h"
+#include "utils/endpoint-balancer.h"
 
 namespace zas {
 namespace vehicle_indexing {
@@ -20,6 +21,7 @@ struct server_item
 	int64_t _expiry;	
 	listnode_t _endpoints_list;
 	avl_node_t* _endpoints_tree;
+	endpoint_balancer _balancer;
 	static int server_item_compare(avl_node_t* a, avl_node_t* b);
 };
 
@@ -32,7 +34,7 @@ struct server_endpoint
 	avl_node_t avlnode;
 	std::string _identity;	//server endpoint unique id
 	server_item* _server;		//server point
-	size_t _veh_cnt;		//veh count in this server
+	balance_node _balance;	//veh count and weight in this server
 	int _refcnt;
 	int _status;	// 0: server disable, 1: server enable
 	static int server_endpoint_compare(avl_node_t* a, avl_node_t* b);
@@ -47,11 +49,12 @@ public:
 	virtual ~server_endpoint_mgr();
 
 	server_endpoint* add_server_endpoint(const char* svr_name,
-		const char* identity, size_t veh_cnt);
+		const char* identity, size_t veh_cnt, uint32_t weight = 1);
 	server_endpoint* find_server_endpoint(const char* svr_name,
 		const char* identity);
 	server_endpoint_node alloc_server_endpoint_to_vehicle(std::string &svr_name,
-		server_endpoint_node master);
+		server_endpoint_node master, const std::string* vehicle_id = nullptr);
+	int release_server_endpoint_from_vehicle(server_endpoint_node endpoint);
 
 private:
 	//server item
@@ -61,7 +64,7 @@ private:
 
 	//server endpoint
 	server_endpoint* add_endpoint(server_item* item,
-		std::string &identity, size_t veh_cnt);
+		std::string &identity, size_t veh_cnt, uint32_t weight);
 	server_endpoint* find_endpoint(server_item* item,
 		std::string &identity);
 	int remove_endpoint(server_item* item, std::string &identity);
@@ -3,6 +3,7 @@
 
 #include <string.h>
 #include "indexing-def.h"
+#include "vehicle-registry.h"
 #include "utils/timer.h"
 #include "utils/uri.h"
 
@@ -15,18 +16,6 @@ namespace vehicle_indexing {
 
 using namespace zas::utils;
 
-struct vehicle_item
-{
-	listnode_t ownerlist;
-	avl_node_t avlnode;
-	avl_node_t avlvinnode;
-	std::string uid;
-	std::string vid;
-	std::string acctoken;
-	static int vehicle_uid_compare(avl_node_t*, avl_node_t*);
-	static int vehicle_vin_compare(avl_node_t*, avl_node_t*);
-};
-
 class vehicle_mgr
 {
 public:
@@ -38,18 +27,7 @@ public:
 	int get_vehicle_id(std::string& uid, std::string& vid);
 
 private:
-	vehicle_item* add_vehicle(std::string& vid, std::string& acc_token);
-	vehicle_item* find_vehicle_uid(std::string& uid);
-	vehicle_item* find_vehicle_vid(std::string &vid);
-	int remove_vehicle_by_uid(std::string& uid);
-	int remove_vehicle_by_vid(std::string &vid);
-	int remove_all_vehicle(void);
-	std::string alloc_uid(void);
-
-private:
-	listnode_t _vehicle_list;
-	avl_node_t* _vehicle_vin_tree;
-	avl_node_t* _vehicle_uid_tree;
+	vehicle_registry _registry;
 };
 
 }}	//zas::vehicle_indexing
@@ -0,0 +1,124 @@
+#ifndef __CXX_VEHICLE_REGISTRY_H__
+#define __CXX_VEHICLE_REGISTRY_H__
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include "std/zasbsc.h"
+#include "utils/mutex.h"
+
+namespace zas {
+namespace vehicle_indexing {
+
+// power of 2, the shard is picked by 8 bits of the uid
+#define VEHICLE_REGISTRY_SHARDS			(64)
+
+// length of the hex form of a uid, the access token
+#define VEHICLE_UID_HEX_LENGTH			(36)
+
+struct vehicle_uid_hash
+{
+	size_t operator()(const uint128_t &uid) const {
+		uint64_t a, b;
+		memcpy(&a, &uid, sizeof(a));
+		memcpy(&b, ((const uint8_t*)&uid) + sizeof(a), sizeof(b));
+		return (size_t)((a ^ (b * 0x9E3779B97F4A7C15ULL)) >> 7);
+	}
+};
+
+struct vehicle_uid_equal
+{
+	bool operator()(const uint128_t &a, const uint128_t &b) const {
+		return !memcmp(&a, &b, sizeof(uint128_t));
+	}
+};
+
+struct vehicle_item
+{
+	uint128_t uid;
+	std::string vid;
+	std::string acctoken;
+};
+
+/*
+ * the registered vehicles, keyed by the binary uid and by the vin
+ *
+ * a vehicle lives in one shard for both keys: the last byte of the uid
+ * is the hash of the vin when the uid is allocated, so a register or a
+ * lookup only takes the lock of one shard.
+ *
+ * with a journal, every change is appended to the file and replayed by
+ * open_journal() so that the vehicles keep their uid over a restart.
+ */
+class vehicle_registry
+{
+public:
+	vehicle_registry();
+	~vehicle_registry();
+
+	// replay the journal, then append the changes to it
+	int open_journal(const char* path);
+	void close_journal(void);
+
+	/*
+	 * find the vehicle of the vin or create it. The acctoken is
+	 * updated when it is not null
+	 * @return 1 if created, 0 if found, < 0 for error
+	 */
+	int add(const std::string &vin, const std::string* acctoken,
+		uint128_t &uid);
+
+	int find_uid(const uint128_t &uid, std::string &vin);
+	// the acctoken is copied when it is not null
+	int find_vin(const std::string &vin, uint128_t &uid,
+		std::string* acctoken = nullptr);
+	int remove_uid(const uint128_t &uid);
+	int remove_vin(const std::string &vin);
+	void clear(void);
+	size_t size(void);
+
+	static int parse_uid(const char* str, size_t len, uint128_t &uid);
+	static void uid_to_hex(const uint128_t &uid, std::string &str);
+
+private:
+	struct shard
+	{
+		zas::utils::mutex mut;
+		std::unordered_map<uint128_t, vehicle_item,
+			vehicle_uid_hash, vehicle_uid_equal> uids;
+		std::unordered_map<std::string, vehicle_item*> vins;
+	};
+
+	static uint8_t vin_hash(const std::string &vin);
+
+	shard& uid_shard(const uint128_t &uid) {
+		return _shards[uid.data4[7] & (VEHICLE_REGISTRY_SHARDS - 1)];
+	}
+
+	shard& vin_shard(uint8_t hash) {
+		return _shards[hash & (VEHICLE_REGISTRY_SHARDS - 1)];
+	}
+
+	// with the lock of the shard
+	vehicle_item* insert(shard &s, const uint128_t &uid,
+		const std::string &vin, const std::string &acctoken);
+	void erase(shard &s, vehicle_item* item);
+	int append(int type, const vehicle_item* item);
+
+	int replay(FILE* fp, size_t &records, long &offset);
+	int compact(const char* path);
+
+private:
+	vehicle_registry(const vehicle_registry&);
+	vehicle_registry& operator=(const vehicle_registry&);
+
+private:
+	shard _shards[VEHICLE_REGISTRY_SHARDS];
+	zas::utils::mutex _journal_mut;
+	FILE* _journal;
+};
+
+}}	//zas::vehicle_indexing
+
+#endif /* __CXX_VEHICLE_REGISTRY_H__*/
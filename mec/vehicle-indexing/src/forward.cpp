@@ -441,6 +441,7 @@ int forward::init_client(void)
 	size_t infosz = strlen("indexing-service") + sizeof(server_request_info);
 	server_request_info* info = (server_request_info*)(alloca(infosz));
 	info->veh_cnt = 0;
+	info->weight = get_sysconfig("indexing-service.weight", (ssize_t)1);
 	info->name_len = strlen("indexing-service");
 	strncpy(info->buf, "indexing-service", info->name_len);
 	_client->send((void*)&hdr, sizeof(server_header), false);
@@ -408,9 +408,20 @@ int forward_arbitrate::check_set_service_node(forward_service_node* node)
 		slave_invail = true;
 	}
 
+	// the vehicle leaves a disabled endpoint
+	if (maste_invail && node->master.endpoint.get()) {
+		_server_mgr->release_server_endpoint_from_vehicle(
+			node->master.endpoint);
+	}
+	if (slave_invail && node->slaver.endpoint.get()) {
+		_server_mgr->release_server_endpoint_from_vehicle(
+			node->slaver.endpoint);
+	}
+
 	if (maste_invail && slave_invail){
 		node->master.endpoint = 
-			_server_mgr->alloc_server_endpoint_to_vehicle(node->name, nullptr);
+			_server_mgr->alloc_server_endpoint_to_vehicle(node->name, nullptr,
+				&node->node_id);
 		if (!node->master.endpoint.get()) {
 			return -EINVALID;
 		}
@@ -418,21 +429,21 @@ int forward_arbitrate::check_set_service_node(forward_service_node* node)
 
 		node->slaver.endpoint = 
 			_server_mgr->alloc_server_endpoint_to_vehicle(node->name,
-				node->master.endpoint);
+				node->master.endpoint, &node->node_id);
 		if (node->slaver.endpoint.get()) {
 			node->slaver.identity = node->slaver.endpoint->_identity;
 		}
 	} else if (!maste_invail && slave_invail) {
 		node->slaver.endpoint = 
 			_server_mgr->alloc_server_endpoint_to_vehicle(node->name,
-				node->master.endpoint);
+				node->master.endpoint, &node->node_id);
 		if (node->slaver.endpoint.get()) {
 			node->slaver.identity = node->slaver.endpoint->_identity;
 		}
 	} else if (maste_invail && !slave_invail) {
 		node->master.endpoint = 
 			_server_mgr->alloc_server_endpoint_to_vehicle(node->name,
-				node->slaver.endpoint);
+				node->slaver.endpoint, &node->node_id);
 		if (!node->master.endpoint.get()) {
 			node->master.endpoint = node->slaver.endpoint;
 			node->master.identity = node->master.endpoint->_identity;
@@ -512,6 +523,14 @@ int forward_arbitrate::remove_forward_service_node(
 	}
 	avl_remove(&item->forward_node_tree, &node->avlnode);
 	listnode_del(node->ownerlist);
+	if (node->master.endpoint.get()) {
+		_server_mgr->release_server_endpoint_from_vehicle(
+			node->master.endpoint);
+	}
+	if (node->slaver.endpoint.get()) {
+		_server_mgr->release_server_endpoint_from_vehicle(
+			node->slaver.endpoint);
+	}
 	node->master.endpoint = nullptr;
 	node->slaver.endpoint = nullptr;
 	delete node;
@@ -542,7 +561,8 @@ int forward_arbitrate::service_request(zmq_backend_socket* wa_sock,
 		assert(nullptr != s_info);
 		assert(nullptr != _server_mgr);
 		s_info->buf[s_info->name_len] = '\0';
-		_server_mgr->add_server_endpoint(s_info->buf, identify.c_str(), s_info->veh_cnt);
+		_server_mgr->add_server_endpoint(s_info->buf, identify.c_str(),
+			s_info->veh_cnt, s_info->weight);
 		server_header rep_hdr;
 		rep_hdr.svc_type = service_msg_reply;
 		data->set_part(2, (char*)&rep_hdr, sizeof(server_header));
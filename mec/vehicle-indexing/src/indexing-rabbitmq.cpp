@@ -1,4 +1,6 @@
 #include "indexing-rabbitmq.h"
+#include <unistd.h>
+#include "utils/thread.h"
 #include "webcore/logger.h"
 #include "webcore/sysconfig.h"
 #include "indexing-def.h"
@@ -10,6 +12,8 @@ namespace zas {
 namespace vehicle_indexing {
 
 #define RABBITMQ_INIT_RETRY_INTERVAL (1000)
+#define RABBITMQ_PUBLISH_WAIT_MS (100)
+#define RABBITMQ_STATS_INTERVAL (10)
 
 using namespace zas::utils;
 using namespace zas::webcore;
@@ -34,6 +38,39 @@ private:
 	ZAS_DISABLE_EVIL_CONSTRUCTOR(rabbitmq_init_retry_timer);
 };
 
+class rabbitmq_confirm_reader : public rabbitmq_confirm_peer
+{
+public:
+	rabbitmq_confirm_reader(indexing_rabbitmq* rmq)
+	: _rmq(rmq) {
+	}
+
+	int next_confirm(uint64_t &tag, bool &multiple, bool &nack) {
+		assert(nullptr != _rmq);
+		return _rmq->read_confirm(tag, multiple, nack);
+	}
+
+private:
+	indexing_rabbitmq* _rmq;
+};
+
+class rabbitmq_publisher : public thread
+{
+public:
+	rabbitmq_publisher(indexing_rabbitmq* idx_rmq)
+	: thread("rabbitmq-publisher")
+	, _idx_rmq(idx_rmq) {
+	}
+
+	int run(void) {
+		assert(nullptr != _idx_rmq);
+		return _idx_rmq->run_publisher();
+	}
+
+private:
+	indexing_rabbitmq* _idx_rmq;
+};
+
 indexing_rabbitmq::indexing_rabbitmq(rabbitmq_role erole,
 	const char* name, forward_backend* backend, void* context, timermgr* mgr)
 : _rabbitmq_role(erole)
@@ -45,6 +82,19 @@ indexing_rabbitmq::indexing_rabbitmq(rabbitmq_role erole,
 , _channel_id(1)
 , _sock_fd(0)
 , _port(0)
+, _outbound(nullptr)
+, _publisher(nullptr)
+, _queue_capacity(RABBITMQ_QUEUE_CAPACITY)
+, _drop_policy(rabbitmq_drop_oldest)
+, _block_ms(RABBITMQ_BLOCK_TIMEOUT_MS)
+, _batch_size(RABBITMQ_PUBLISH_BATCH)
+, _confirm_ms(RABBITMQ_CONFIRM_TIMEOUT_MS)
+, _persistent(false)
+, _delivery_tag(0)
+, _stats_time(0)
+, _stats_dropped(0)
+, _prefetch(RABBITMQ_CONSUME_PREFETCH)
+, _ack_batch(RABBITMQ_ACK_BATCH)
 {
 	_host.clear();
 	_username.clear();
@@ -66,6 +116,17 @@ indexing_rabbitmq::~indexing_rabbitmq()
 		delete _retry_timer;
 		_retry_timer = nullptr;
 	}
+	// the publisher sends what is queued and closes its connection
+	if (_publisher) {
+		_outbound->stop();
+		_publisher->join();
+		_publisher->release();
+		_publisher = nullptr;
+	}
+	if (_outbound) {
+		delete _outbound;
+		_outbound = nullptr;
+	}
 	if (nullptr == _conn) {
 		return;
 	}
@@ -103,7 +164,14 @@ int indexing_rabbitmq::init(void)
 	if (rabbitmq_role_producing == _rabbitmq_role) {
 		log.d(INDEXING_SNAPSHOT_TAG, 
 			"init rabbitmq producing");
-		ret = init_producing();
+		if (_publisher) {
+			return -EEXISTS;
+		}
+		// the publisher thread connects and retries by itself
+		_outbound = new rabbitmq_outbound(_queue_capacity,
+			_drop_policy, _block_ms);
+		_publisher = new rabbitmq_publisher(this);
+		return _publisher->start();
 	} else {
 		log.d(INDEXING_SNAPSHOT_TAG, 
 			"init rabbitmq consuming");
@@ -122,14 +190,12 @@ void indexing_rabbitmq::on_timer(void)
 	int ret = 0;
 	log.d(INDEXING_SNAPSHOT_TAG, "retry init ontimer");
 	if (rabbitmq_role_producing == _rabbitmq_role) {
-		log.d(INDEXING_SNAPSHOT_TAG, 
-			"retry init rabbitmq producing");
-		ret = retry_init_producing();
-	} else {
-		log.d(INDEXING_SNAPSHOT_TAG, 
-			"retry init rabbitmq consuming");
-		ret = retry_init_consuming();
+		// reconnected by the publisher thread
+		return;
 	}
+	log.d(INDEXING_SNAPSHOT_TAG, 
+		"retry init rabbitmq consuming");
+	ret = retry_init_consuming();
 	if (ret) {
 		if (_retry_timer) {
 			_retry_timer->start();
@@ -139,39 +205,203 @@ void indexing_rabbitmq::on_timer(void)
 
 int indexing_rabbitmq::publishing(const char* exchange, std::string &routingkey,
 	void* data, size_t sz)
+{
+	if (!_outbound) {
+		return -ENOTAVAIL;
+	}
+	// sent by the publisher thread, the event loop never waits for
+	// the socket
+	return _outbound->push(exchange, routingkey, data, sz);
+}
+
+size_t indexing_rabbitmq::queue_depth(void)
+{
+	if (!_outbound) {
+		return 0;
+	}
+	return _outbound->depth();
+}
+
+int indexing_rabbitmq::get_publish_stats(rabbitmq_outbound_stats &stats)
+{
+	if (!_outbound) {
+		return -ENOTAVAIL;
+	}
+	_outbound->get_stats(stats);
+	return 0;
+}
+
+int indexing_rabbitmq::run_publisher(void)
+{
+	assert(nullptr != _outbound);
+	while (!_outbound->stopped() || _outbound->depth()) {
+		if (nullptr == _conn && init_producing()) {
+			close_connection();
+			if (_outbound->stopped()) {
+				break;
+			}
+			usleep(RABBITMQ_INIT_RETRY_INTERVAL * 1000);
+			continue;
+		}
+		if (_outbound->pop(_batch, _batch_size, RABBITMQ_PUBLISH_WAIT_MS)) {
+			if (publish_batch()) {
+				close_connection();
+				// stopping: a broker that fails the batch would
+				// be reconnected to forever
+				if (_outbound->stopped()) {
+					break;
+				}
+			}
+		}
+		report_stats();
+	}
+	size_t left = _outbound->discard();
+	if (left) {
+		log.e(INDEXING_SNAPSHOT_TAG,
+			"%lu messages dropped on shutdown", left);
+	}
+	close_connection();
+	return 0;
+}
+
+int indexing_rabbitmq::publish_batch(void)
 {
 	amqp_basic_properties_t props;
-	amqp_bytes_t body;
-	body.bytes = data;
-	body.len = sz;
 	props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
 	props.content_type = amqp_cstring_bytes("application/octet-stream");
-	props.delivery_mode = 2; /* persistent delivery mode */
-	std::string rkey = routingkey;
-	// rkey += "." + routingkey;
-	log.w(INDEXING_SNAPSHOT_TAG, "vin %s\n", rkey.c_str());
-	if (nullptr == _conn) {
-		retry_init_producing();
-	}
-	int ret = amqp_basic_publish(_conn, _channel_id, 
-				amqp_cstring_bytes(exchange),
-				amqp_cstring_bytes(rkey.c_str()),
+	// the batch is acknowledged by the publisher confirms
+	props.delivery_mode = _persistent ? 2 : 1;
+
+	// the publishes are written back to back, the confirms of
+	// the batch are waited for once
+	uint64_t first = _delivery_tag + 1;
+	size_t sent = 0;
+	int ret = 0;
+	for (; sent < _batch.size(); sent++) {
+		auto* msg = _batch[sent];
+		amqp_bytes_t body;
+		body.bytes = (void*)msg->body.data();
+		body.len = msg->body.length();
+		ret = amqp_basic_publish(_conn, _channel_id,
+				amqp_cstring_bytes(msg->exchange.c_str()),
+				amqp_cstring_bytes(msg->routingkey.c_str()),
 				0,
 				0,
-				&props, 
+				&props,
 				body);
-	if (ret != AMQP_STATUS_OK){	
-		log.e(INDEXING_SNAPSHOT_TAG, 
-			"producting amqp error %d", ret);
-		if (AMQP_STATUS_SOCKET_CLOSED == ret
-			|| AMQP_STATUS_SOCKET_ERROR == ret) {
-			retry_init_producing();
+		if (ret != AMQP_STATUS_OK) {
+			log.e(INDEXING_SNAPSHOT_TAG,
+				"producting amqp error %d", ret);
+			break;
 		}
-		return ret;
-	}	
+		_delivery_tag++;
+	}
+	_outbound->on_published(sent);
+
+	// after a failed publish the connection is closed, the
+	// confirms of the sent messages would never come
+	_confirms.reset(first, sent);
+	int cret = 0;
+	if (sent && ret == AMQP_STATUS_OK) {
+		rabbitmq_confirm_reader reader(this);
+		cret = _confirms.wait(&reader);
+		if (cret) {
+			log.e(INDEXING_SNAPSHOT_TAG,
+				"wait confirm error %d, %lu pending", cret,
+				_confirms.pending());
+		}
+	}
+	amqp_maybe_release_buffers(_conn);
+
+	// the messages that were not acknowledged are sent again
+	_outbound->settle(_batch, _confirms);
+	if (ret != AMQP_STATUS_OK || cret) {
+		return -ENOTCONN;
+	}
 	return 0;
 }
 
+int indexing_rabbitmq::read_confirm(uint64_t &tag, bool &multiple,
+	bool &nack)
+{
+	for (;;) {
+		amqp_frame_t frame;
+		timeval tv;
+		tv.tv_sec = _confirm_ms / 1000;
+		tv.tv_usec = (_confirm_ms % 1000) * 1000;
+		int ret = amqp_simple_wait_frame_noblock(_conn, &frame, &tv);
+		if (ret != AMQP_STATUS_OK) {
+			return (AMQP_STATUS_TIMEOUT == ret) ? -ETIMEOUT : -ENOTCONN;
+		}
+		if (frame.frame_type != AMQP_FRAME_METHOD) {
+			continue;
+		}
+		switch (frame.payload.method.id) {
+		case AMQP_BASIC_ACK_METHOD: {
+			auto* ack = (amqp_basic_ack_t*)frame.payload.method.decoded;
+			tag = ack->delivery_tag;
+			multiple = ack->multiple;
+			nack = false;
+			return 0;
+		}
+		case AMQP_BASIC_NACK_METHOD: {
+			auto* rej = (amqp_basic_nack_t*)frame.payload.method.decoded;
+			tag = rej->delivery_tag;
+			multiple = rej->multiple;
+			nack = true;
+			return 0;
+		}
+		case AMQP_CHANNEL_CLOSE_METHOD:
+		case AMQP_CONNECTION_CLOSE_METHOD:
+			log.e(INDEXING_SNAPSHOT_TAG, "closed by server");
+			return -ENOTCONN;
+		default:
+			continue;
+		}
+	}
+}
+
+void indexing_rabbitmq::report_stats(void)
+{
+	time_t now = time(nullptr);
+	if (now - _stats_time < RABBITMQ_STATS_INTERVAL) {
+		return;
+	}
+	_stats_time = now;
+	rabbitmq_outbound_stats stats;
+	_outbound->get_stats(stats);
+	if (stats.dropped != _stats_dropped) {
+		log.e(INDEXING_SNAPSHOT_TAG,
+			"rabbitmq %s dropped %lu messages, queue depth %lu",
+			_mq_name.c_str(), stats.dropped - _stats_dropped, stats.depth);
+		_stats_dropped = stats.dropped;
+	}
+	log.d(INDEXING_SNAPSHOT_TAG,
+		"rabbitmq %s depth %lu, published %lu, confirmed %lu, nacked %lu",
+		_mq_name.c_str(), stats.depth, stats.published,
+		stats.confirmed, stats.nacked);
+}
+
+void indexing_rabbitmq::close_connection(void)
+{
+	if (nullptr == _conn) {
+		return;
+	}
+	amqp_rpc_reply_t ret = amqp_channel_close(_conn,
+			_channel_id, AMQP_REPLY_SUCCESS);
+	amqp_return_result(ret, "close channel");
+
+	ret = amqp_connection_close(_conn, AMQP_REPLY_SUCCESS);
+	amqp_return_result(ret, "close connection");
+
+	int retval = amqp_destroy_connection(_conn);
+	if (AMQP_STATUS_OK != retval) {
+		log.e(INDEXING_SNAPSHOT_TAG, 
+			"destroy connection error [%d]", retval);
+	}
+	_conn = nullptr;
+}
+
 int indexing_rabbitmq::set_consuming_callback(rabbitmq_callback* cb)
 {
 	_cb = cb;
@@ -289,9 +519,58 @@ int indexing_rabbitmq::load_config(void)
 		}
 		_exchange_info.push_back(info);
 	}
+
+	if (rabbitmq_role_producing == _rabbitmq_role) {
+		load_publish_config(path);
+	} else {
+		load_consume_config(path);
+	}
 	return 0;
 }
 
+void indexing_rabbitmq::load_consume_config(const std::string &path)
+{
+	// 0 is the automatic acknowledgement without a prefetch limit
+	std::string mqattr = path + "prefetch";
+	ssize_t val = get_sysconfig(mqattr.c_str(),
+		(ssize_t)RABBITMQ_CONSUME_PREFETCH);
+	_prefetch = (val >= 0 && val <= 0xFFFF) ? val : RABBITMQ_CONSUME_PREFETCH;
+
+	mqattr = path + "ack-batch";
+	val = get_sysconfig(mqattr.c_str(), (ssize_t)RABBITMQ_ACK_BATCH);
+	_ack_batch = (val > 0) ? val : RABBITMQ_ACK_BATCH;
+	if (_prefetch && _ack_batch > _prefetch) {
+		_ack_batch = _prefetch;
+	}
+}
+
+void indexing_rabbitmq::load_publish_config(const std::string &path)
+{
+	std::string mqattr = path + "queue-capacity";
+	ssize_t val = get_sysconfig(mqattr.c_str(),
+		(ssize_t)RABBITMQ_QUEUE_CAPACITY);
+	_queue_capacity = (val > 0) ? val : RABBITMQ_QUEUE_CAPACITY;
+
+	mqattr = path + "drop-policy";
+	_drop_policy = rabbitmq_outbound::get_policy(
+		get_sysconfig(mqattr.c_str(), "drop-oldest"));
+
+	mqattr = path + "block-timeout-ms";
+	val = get_sysconfig(mqattr.c_str(), (ssize_t)RABBITMQ_BLOCK_TIMEOUT_MS);
+	_block_ms = (val >= 0) ? val : RABBITMQ_BLOCK_TIMEOUT_MS;
+
+	mqattr = path + "batch-size";
+	val = get_sysconfig(mqattr.c_str(), (ssize_t)RABBITMQ_PUBLISH_BATCH);
+	_batch_size = (val > 0) ? val : RABBITMQ_PUBLISH_BATCH;
+
+	mqattr = path + "confirm-timeout-ms";
+	val = get_sysconfig(mqattr.c_str(), (ssize_t)RABBITMQ_CONFIRM_TIMEOUT_MS);
+	_confirm_ms = (val > 0) ? val : RABBITMQ_CONFIRM_TIMEOUT_MS;
+
+	mqattr = path + "persistent";
+	_persistent = (get_sysconfig(mqattr.c_str(), (ssize_t)0) != 0);
+}
+
 int indexing_rabbitmq::init_producing(void)
 {
 	assert(nullptr != _backend);
@@ -343,6 +622,14 @@ int indexing_rabbitmq::init_producing(void)
 		return -ELOGIC;
 	}
 
+	// the broker acknowledges the published messages
+	amqp_confirm_select(_conn, _channel_id);
+	ret = amqp_get_rpc_reply(_conn);
+	if (amqp_return_result(ret, "producting confirm select")) {
+		return -ELOGIC;
+	}
+	_delivery_tag = 0;
+
 	// for(auto &exc_item:_exchange_info) {
 	// 	amqp_exchange_declare(_conn,
 	// 			_channel_id,
@@ -385,25 +672,6 @@ int indexing_rabbitmq::retry_init_consuming(void)
 }
 
 
-int indexing_rabbitmq::retry_init_producing(void)
-{
-	amqp_rpc_reply_t ret = amqp_channel_close(_conn,
-			_channel_id, AMQP_REPLY_SUCCESS);
-	amqp_return_result(ret, "close channel");
-
-	ret = amqp_connection_close(_conn, AMQP_REPLY_SUCCESS);
-	amqp_return_result(ret, "close connection");
-
-	int retval = amqp_destroy_connection(_conn);
-	if (AMQP_STATUS_OK != retval) {
-		log.e(INDEXING_SNAPSHOT_TAG, 
-			"destroy connection error [%d]", retval);
-	}
-
-	_conn = nullptr;
-	return init_producing();
-}
-
 int indexing_rabbitmq::init_consuming(void)
 {
 	assert(nullptr != _backend);
@@ -456,6 +724,14 @@ int indexing_rabbitmq::init_consuming(void)
 	if (amqp_return_result(ret, "consuming open channel")) {
 		return -ELOGIC;
 	}
+
+	if (_prefetch) {
+		amqp_basic_qos(_conn, _channel_id, 0, _prefetch, 0);
+		ret = amqp_get_rpc_reply(_conn);
+		if (amqp_return_result(ret, "consuming qos")) {
+			return -ELOGIC;
+		}
+	}
 	
 	for(auto &exc_item:_exchange_info) {
 		amqp_exchange_declare(_conn,
@@ -510,7 +786,7 @@ int indexing_rabbitmq::init_consuming(void)
 				queuename,
 				amqp_empty_bytes,
 				0,
-				1,
+				_prefetch ? 0 : 1,	// no_ack
 				0,
 				amqp_empty_table);
 		ret = amqp_get_rpc_reply(_conn);		
@@ -594,57 +870,89 @@ int indexing_rabbitmq::on_consume(int fd, int revents)
 {
 	assert(nullptr != _conn);
 	assert(_sock_fd == fd);
-	amqp_rpc_reply_t res;
-	amqp_envelope_t envelope;
-	amqp_maybe_release_buffers(_conn);
-	res = amqp_consume_message(_conn, &envelope, NULL, 0);
-	int iret = amqp_return_result(res, "consuming");
-	if (iret) {
-		if (_cb) {
-			_cb->on_consuming_error(iret);
+
+	// handle every delivery already read from the socket, the fd
+	// does not wake the loop again for them
+	timeval notime = {0, 0};
+	timeval* timeout = nullptr;
+	uint64_t last_tag = 0;
+	uint32_t unacked = 0;
+	do {
+		amqp_rpc_reply_t res;
+		amqp_envelope_t envelope;
+		amqp_maybe_release_buffers(_conn);
+		res = amqp_consume_message(_conn, &envelope, timeout, 0);
+		timeout = &notime;
+		if (AMQP_RESPONSE_LIBRARY_EXCEPTION == res.reply_type
+			&& AMQP_STATUS_TIMEOUT == res.library_error) {
+			break;
 		}
-		if (-ENOTCONN == iret) {
-			if (retry_init_consuming()) {
-				if (_retry_timer) {
-					_retry_timer->start();
+		int iret = amqp_return_result(res, "consuming");
+		if (iret) {
+			if (_cb) {
+				_cb->on_consuming_error(iret);
+			}
+			printf("consuming error is %d\n", iret);
+			amqp_destroy_envelope(&envelope);
+			if (-ENOTCONN == iret) {
+				// the deliveries not acknowledged are sent again
+				if (retry_init_consuming()) {
+					if (_retry_timer) {
+						_retry_timer->start();
+					}
 				}
+				return -ELOGIC;
+			}
+			break;
+		}
+		on_delivery(envelope);
+		if (_prefetch) {
+			last_tag = envelope.delivery_tag;
+			if (++unacked >= _ack_batch) {
+				ack_deliveries(last_tag);
+				unacked = 0;
 			}
 		}
-		printf("consuming error is %d\n", iret);
 		amqp_destroy_envelope(&envelope);
-		return -ELOGIC;
-	}
-	log.d(INDEXING_SNAPSHOT_TAG,
-		"Delivery %u, exchange %.*s routingkey %.*s\n",
-			(unsigned)envelope.delivery_tag, (int)envelope.exchange.len,
-			(char *)envelope.exchange.bytes, (int)envelope.routing_key.len,
-			(char *)envelope.routing_key.bytes);
+	} while (amqp_data_in_buffer(_conn) || amqp_frames_enqueued(_conn));
 
-	if (envelope.message.properties._flags & AMQP_BASIC_CONTENT_TYPE_FLAG) {
-		log.d(INDEXING_SNAPSHOT_TAG,
-			"Content-type: %.*s\n",
-			(int)envelope.message.properties.content_type.len,
-			(char *)envelope.message.properties.content_type.bytes);
+	if (unacked) {
+		ack_deliveries(last_tag);
 	}
+	return 0;
+}
+
+void indexing_rabbitmq::on_delivery(amqp_envelope_t &envelope)
+{
 	if (envelope.message.body.len == 0) {
-		amqp_destroy_envelope(&envelope);
 		log.e(INDEXING_SNAPSHOT_TAG, "no message data\n");
-		return -EDATANOTAVAIL;
-	}
-	if (_cb) {
-		std::string exchange((char *)envelope.exchange.bytes,
-			(int)envelope.exchange.len);
-		std::string routingkey((char *)envelope.routing_key.bytes,
-			envelope.routing_key.len);
-		exchange += "." + routingkey;
-		_cb->on_consuming((char *)exchange.c_str(),
-			exchange.length(),
-			envelope.message.body.bytes,
-			envelope.message.body.len);
+		return;
+	}
+	if (!_cb) {
+		return;
 	}
+	// <exchange>.<routingkey>, the string keeps its buffer
+	_routingkey.assign((char *)envelope.exchange.bytes,
+		envelope.exchange.len);
+	_routingkey += ".";
+	_routingkey.append((char *)envelope.routing_key.bytes,
+		envelope.routing_key.len);
+	_cb->on_consuming((char *)_routingkey.c_str(),
+		_routingkey.length(),
+		envelope.message.body.bytes,
+		envelope.message.body.len);
 	// amqp_dump(envelope.message.body.bytes, envelope.message.body.len);
+}
 
-	amqp_destroy_envelope(&envelope);
+int indexing_rabbitmq::ack_deliveries(uint64_t tag)
+{
+	// acknowledges every delivery up to tag
+	int ret = amqp_basic_ack(_conn, _channel_id, tag, 1);
+	if (ret != AMQP_STATUS_OK) {
+		log.e(INDEXING_SNAPSHOT_TAG,
+			"consuming ack %lu error %d", tag, ret);
+		return -ELOGIC;
+	}
 	return 0;
 }
 
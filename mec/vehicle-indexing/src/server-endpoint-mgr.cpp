@@ -86,6 +86,17 @@ int server_endpoint_mgr::init_server_info(server_item* item)
 	int max_cnt = INDEXING_SERVER_ENDPOINT_VEH_MAX_CNT;
 	item->_veh_max_cnt = get_sysconfig(path.c_str(), max_cnt, &ret);
 
+	path = rootpath + "balance.mode";
+	std::string mode = get_sysconfig(path.c_str(), "least-loaded");
+	int bmode = endpoint_balancer::parse_mode(mode.c_str());
+	if (bmode < 0) {
+		log.e(INDEXING_FORWRD_TAG,
+			"unknown balance mode %s\n", mode.c_str());
+		bmode = balance_mode_least_loaded;
+	}
+	item->_balancer.set_mode(bmode);
+	item->_balancer.set_capacity(item->_veh_max_cnt);
+
 	path = rootpath + "keepalive.internal";
 	size_t interval = HEARTBEAT_INTERVAL_DEFAULT;
 	interval = get_sysconfig(path.c_str(), interval, &ret);
@@ -100,7 +111,7 @@ int server_endpoint_mgr::init_server_info(server_item* item)
 	return 0;
 }
 server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
-	std::string &identity, size_t veh_cnt)
+	std::string &identity, size_t veh_cnt, uint32_t weight)
 {
 	if (!item) {
 		return nullptr;
@@ -113,7 +124,7 @@ server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
 	node = new server_endpoint();
 	node->_server = item;
 	node->_identity = identity;
-	node->_veh_cnt = veh_cnt;
+	endpoint_balancer::init_node(&node->_balance, veh_cnt, weight);
 	node->_refcnt = 1;
 	node->_status = 1;
 	if (avl_insert(&item->_endpoints_tree, &node->avlnode,
@@ -123,6 +134,7 @@ server_endpoint* server_endpoint_mgr::add_endpoint(server_item* item,
 		return nullptr;
 	}
 	listnode_add(item->_endpoints_list, node->ownerlist);
+	item->_balancer.add(&node->_balance, identity);
 	return node;
 }
 
@@ -158,6 +170,7 @@ int server_endpoint_mgr::remove_endpoint(server_item* item,
 	if (!node) {
 		return -ENOTFOUND;
 	}
+	item->_balancer.remove(&node->_balance);
 	avl_remove(&item->_endpoints_tree, &node->avlnode);
 	listnode_del(node->ownerlist);
 	node->_server = nullptr;
@@ -187,6 +200,7 @@ int server_endpoint_mgr::remove_server_item(server_item* item)
 		auto* node = LIST_ENTRY(server_endpoint,	\
 			ownerlist, item->_endpoints_list.next);
 		assert(nullptr != node);
+		item->_balancer.remove(&node->_balance);
 		avl_remove(&item->_endpoints_tree, &node->avlnode);
 		listnode_del(node->ownerlist);
 		node->_server = nullptr;
@@ -214,7 +228,7 @@ int server_endpoint_mgr::release_all_nodes(void)
 
 
 server_endpoint* server_endpoint_mgr::add_server_endpoint(const char* svr_name,
-	const char* identity, size_t veh_cnt)
+	const char* identity, size_t veh_cnt, uint32_t weight)
 {
 	if (!svr_name || !*svr_name || !identity || !*identity) {
 		return nullptr;
@@ -232,7 +246,7 @@ server_endpoint* server_endpoint_mgr::add_server_endpoint(const char* svr_name,
 	if (node) {
 		return node;
 	}
-	return add_endpoint(item, idt, veh_cnt);
+	return add_endpoint(item, idt, veh_cnt, weight);
 }
 
 server_endpoint* server_endpoint_mgr::find_server_endpoint(const char* svr_name,
@@ -255,40 +269,35 @@ server_endpoint* server_endpoint_mgr::find_server_endpoint(const char* svr_name,
 
 server_endpoint_node server_endpoint_mgr::alloc_server_endpoint_to_vehicle(
 	std::string &svr_name,
-	server_endpoint_node master)
+	server_endpoint_node master, const std::string* vehicle_id)
 {
 	auto *item = find_server_item(svr_name);
 	if (!item) {
 		return nullptr;
 	}
 
-	if (listnode_isempty(item->_endpoints_list)) {
+	auto* node = master.get();
+	auto* bnode = item->_balancer.acquire(vehicle_id,
+		node ? &node->_balance : nullptr);
+	if (!bnode) {
 		return nullptr;
 	}
-	
-	listnode_t* nd = item->_endpoints_list.next;
-	server_endpoint* alloc_point = nullptr;
-	uint32_t min_veh_cnt = item->_veh_max_cnt;
-	auto* node = master.get();
-	for (; nd != &item->_endpoints_list; nd = nd->next) {
-		auto* point = list_entry(server_endpoint, ownerlist, nd);
-		if (point->_status != 1) {
-			continue;
-		}
-		if (point->_veh_cnt < min_veh_cnt) {
-			if (node && node == point) {
-				continue;
-			}
-			min_veh_cnt = point->_veh_cnt;
-			alloc_point = point;
-		}
+	server_endpoint_node alloc_node(
+		BALANCE_NODE_ENTRY(server_endpoint, _balance, bnode));
+	return alloc_node;
+}
+
+int server_endpoint_mgr::release_server_endpoint_from_vehicle(
+	server_endpoint_node endpoint)
+{
+	auto* node = endpoint.get();
+	if (!node) {
+		return -EBADPARM;
 	}
-	if (alloc_point) {
-		alloc_point->_veh_cnt++;
+	if (node->_server) {
+		node->_server->_balancer.release(&node->_balance);
 	}
-	server_endpoint_node alloc_node(alloc_point);
-	return alloc_node;
+	return 0;
 }
-	
 
 }}	//zas::vehicle_indexing
@@ -0,0 +1,398 @@
+#include "vehicle-registry.h"
+#include <assert.h>
+#include <unistd.h>
+#include "utils/uuid.h"
+
+namespace zas {
+namespace vehicle_indexing {
+
+using namespace zas::utils;
+
+#define VEHICLE_JOURNAL_MAGIC			(0x4A524756)
+
+enum vehicle_journal_type
+{
+	vehicle_journal_unknown = 0,
+	vehicle_journal_add,
+	vehicle_journal_remove,
+};
+
+// followed by the vin and the acctoken
+struct vehicle_journal_record
+{
+	uint32_t magic;
+	// fnv-1a of the record from the type to the end
+	uint32_t checksum;
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t vin_len;
+	uint16_t token_len;
+	uint16_t reserved1;
+	uint128_t uid;
+} PACKED;
+
+static uint32_t fnv1a(uint32_t h, const void* data, size_t sz)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < sz; i++) {
+		h = (h ^ p[i]) * 16777619u;
+	}
+	return h;
+}
+
+#define FNV1A_INIT	(2166136261u)
+
+vehicle_registry::vehicle_registry()
+: _journal(nullptr)
+{
+}
+
+vehicle_registry::~vehicle_registry()
+{
+	close_journal();
+	clear();
+}
+
+uint8_t vehicle_registry::vin_hash(const std::string &vin)
+{
+	// stable over the builds, the journal keeps uids made with it
+	uint32_t h = fnv1a(FNV1A_INIT, vin.c_str(), vin.length());
+	return (uint8_t)(h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24));
+}
+
+static int hexval(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+int vehicle_registry::parse_uid(const char* str, size_t len, uint128_t &uid)
+{
+	if (!str || len != VEHICLE_UID_HEX_LENGTH) {
+		return -EBADPARM;
+	}
+	if (str[8] != '-' || str[13] != '-'
+		|| str[18] != '-' || str[23] != '-') {
+		return -EBADPARM;
+	}
+	// the digits of "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X"
+	uint8_t bytes[16];
+	const char* p = str;
+	for (int i = 0; i < 16; i++) {
+		if (*p == '-') p++;
+		int h = hexval(p[0]), l = hexval(p[1]);
+		if (h < 0 || l < 0) {
+			return -EBADPARM;
+		}
+		bytes[i] = (uint8_t)((h << 4) | l);
+		p += 2;
+	}
+	uid.data1 = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+		| ((uint32_t)bytes[2] << 8) | bytes[3];
+	uid.data2 = (uint16_t)((bytes[4] << 8) | bytes[5]);
+	uid.data3 = (uint16_t)((bytes[6] << 8) | bytes[7]);
+	memcpy(uid.data4, bytes + 8, sizeof(uid.data4));
+	return 0;
+}
+
+void vehicle_registry::uid_to_hex(const uint128_t &uid, std::string &str)
+{
+	uuid u;
+	u = uid;
+	u.to_hex(str);
+}
+
+vehicle_item* vehicle_registry::insert(shard &s, const uint128_t &uid,
+	const std::string &vin, const std::string &acctoken)
+{
+	auto ret = s.uids.emplace(uid, vehicle_item());
+	auto* item = &ret.first->second;
+	if (!ret.second) {
+		s.vins.erase(item->vid);
+	}
+	item->uid = uid;
+	item->vid = vin;
+	item->acctoken = acctoken;
+	s.vins[vin] = item;
+	return item;
+}
+
+void vehicle_registry::erase(shard &s, vehicle_item* item)
+{
+	assert(nullptr != item);
+	s.vins.erase(item->vid);
+	s.uids.erase(item->uid);
+}
+
+int vehicle_registry::add(const std::string &vin,
+	const std::string* acctoken, uint128_t &uid)
+{
+	if (vin.length() > UINT16_MAX
+		|| (acctoken && acctoken->length() > UINT16_MAX)) {
+		return -EBADPARM;
+	}
+	uint8_t hash = vin_hash(vin);
+	auto& s = vin_shard(hash);
+	auto_mutex am(s.mut);
+	auto it = s.vins.find(vin);
+	if (it != s.vins.end()) {
+		auto* item = it->second;
+		if (acctoken && item->acctoken != *acctoken) {
+			item->acctoken = *acctoken;
+			append(vehicle_journal_add, item);
+		}
+		uid = item->uid;
+		return 0;
+	}
+
+	// the last byte of the uid selects the shard of the vin
+	uint128_t newuid;
+	do {
+		uuid allocuid;
+		allocuid.generate();
+		newuid = allocuid.getuuid();
+		newuid.data4[7] = hash;
+	} while (s.uids.count(newuid));
+
+	auto* item = insert(s, newuid, vin,
+		acctoken ? *acctoken : std::string());
+	append(vehicle_journal_add, item);
+	uid = newuid;
+	return 1;
+}
+
+int vehicle_registry::find_uid(const uint128_t &uid, std::string &vin)
+{
+	auto& s = uid_shard(uid);
+	auto_mutex am(s.mut);
+	auto it = s.uids.find(uid);
+	if (it == s.uids.end()) {
+		return -ENOTFOUND;
+	}
+	vin = it->second.vid;
+	return 0;
+}
+
+int vehicle_registry::find_vin(const std::string &vin, uint128_t &uid,
+	std::string* acctoken)
+{
+	auto& s = vin_shard(vin_hash(vin));
+	auto_mutex am(s.mut);
+	auto it = s.vins.find(vin);
+	if (it == s.vins.end()) {
+		return -ENOTFOUND;
+	}
+	uid = it->second->uid;
+	if (acctoken) {
+		*acctoken = it->second->acctoken;
+	}
+	return 0;
+}
+
+int vehicle_registry::remove_uid(const uint128_t &uid)
+{
+	auto& s = uid_shard(uid);
+	auto_mutex am(s.mut);
+	auto it = s.uids.find(uid);
+	if (it == s.uids.end()) {
+		return -ENOTFOUND;
+	}
+	append(vehicle_journal_remove, &it->second);
+	erase(s, &it->second);
+	return 0;
+}
+
+int vehicle_registry::remove_vin(const std::string &vin)
+{
+	auto& s = vin_shard(vin_hash(vin));
+	auto_mutex am(s.mut);
+	auto it = s.vins.find(vin);
+	if (it == s.vins.end()) {
+		return -ENOTFOUND;
+	}
+	append(vehicle_journal_remove, it->second);
+	erase(s, it->second);
+	return 0;
+}
+
+void vehicle_registry::clear(void)
+{
+	for (auto& s : _shards) {
+		auto_mutex am(s.mut);
+		s.vins.clear();
+		s.uids.clear();
+	}
+}
+
+size_t vehicle_registry::size(void)
+{
+	size_t cnt = 0;
+	for (auto& s : _shards) {
+		auto_mutex am(s.mut);
+		cnt += s.uids.size();
+	}
+	return cnt;
+}
+
+static bool write_record(FILE* fp, int type, const vehicle_item* item)
+{
+	vehicle_journal_record rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = VEHICLE_JOURNAL_MAGIC;
+	rec.type = (uint8_t)type;
+	rec.vin_len = (uint16_t)item->vid.length();
+	rec.token_len = (uint16_t)item->acctoken.length();
+	rec.uid = item->uid;
+
+	const size_t hdrsz = sizeof(rec.magic) + sizeof(rec.checksum);
+	uint32_t h = fnv1a(FNV1A_INIT, ((const uint8_t*)&rec) + hdrsz,
+		sizeof(rec) - hdrsz);
+	h = fnv1a(h, item->vid.c_str(), rec.vin_len);
+	rec.checksum = fnv1a(h, item->acctoken.c_str(), rec.token_len);
+
+	return fwrite(&rec, sizeof(rec), 1, fp) == 1
+		&& fwrite(item->vid.c_str(), 1, rec.vin_len, fp) == rec.vin_len
+		&& fwrite(item->acctoken.c_str(), 1, rec.token_len, fp)
+		== rec.token_len;
+}
+
+int vehicle_registry::append(int type, const vehicle_item* item)
+{
+	auto_mutex am(_journal_mut);
+	if (!_journal) {
+		return 0;
+	}
+	if (!write_record(_journal, type, item) || fflush(_journal)) {
+		return -ELOGIC;
+	}
+	return 0;
+}
+
+int vehicle_registry::replay(FILE* fp, size_t &records, long &offset)
+{
+	std::string data;
+	vehicle_journal_record rec;
+	const size_t hdrsz = sizeof(rec.magic) + sizeof(rec.checksum);
+	records = 0;
+	offset = 0;
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (rec.magic != VEHICLE_JOURNAL_MAGIC) {
+			break;
+		}
+		data.resize((size_t)rec.vin_len + rec.token_len);
+		if (data.length() && fread(&data[0], 1, data.length(), fp)
+			!= data.length()) {
+			break;
+		}
+		uint32_t h = fnv1a(FNV1A_INIT, ((const uint8_t*)&rec) + hdrsz,
+			sizeof(rec) - hdrsz);
+		if (fnv1a(h, data.c_str(), data.length()) != rec.checksum) {
+			break;
+		}
+		offset = ftell(fp);
+		records++;
+
+		std::string vin(data, 0, rec.vin_len);
+		if (rec.uid.data4[7] != vin_hash(vin)) {
+			continue;
+		}
+		auto& s = uid_shard(rec.uid);
+		auto_mutex am(s.mut);
+		auto it = s.vins.find(vin);
+		if (rec.type == vehicle_journal_add) {
+			if (it != s.vins.end() && !vehicle_uid_equal()(
+				it->second->uid, rec.uid)) {
+				erase(s, it->second);
+			}
+			insert(s, rec.uid, vin, data.substr(rec.vin_len));
+		} else if (rec.type == vehicle_journal_remove) {
+			if (it != s.vins.end()) erase(s, it->second);
+		}
+	}
+	return 0;
+}
+
+int vehicle_registry::compact(const char* path)
+{
+	std::string tmp(path);
+	tmp += ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		return -ENOTAVAIL;
+	}
+	bool ok = true;
+	for (auto& s : _shards) {
+		auto_mutex am(s.mut);
+		for (auto& uid : s.uids) {
+			if (!(ok = write_record(fp, vehicle_journal_add, &uid.second))) {
+				break;
+			}
+		}
+		if (!ok) break;
+	}
+	ok = ok && !fflush(fp) && !fsync(fileno(fp));
+	fclose(fp);
+	if (!ok || rename(tmp.c_str(), path)) {
+		unlink(tmp.c_str());
+		return -ELOGIC;
+	}
+	return 0;
+}
+
+int vehicle_registry::open_journal(const char* path)
+{
+	if (!path || !*path) {
+		return -EBADPARM;
+	}
+	close_journal();
+
+	FILE* fp = fopen(path, "rb");
+	if (fp) {
+		size_t records;
+		long offset, fsize;
+		fseek(fp, 0, SEEK_END);
+		fsize = ftell(fp);
+		rewind(fp);
+
+		// at most one vehicle a record, saves the rehash of the replay
+		size_t cnt = fsize / sizeof(vehicle_journal_record)
+			/ VEHICLE_REGISTRY_SHARDS;
+		for (auto& s : _shards) {
+			auto_mutex am(s.mut);
+			s.uids.reserve(s.uids.size() + cnt);
+			s.vins.reserve(s.vins.size() + cnt);
+		}
+		replay(fp, records, offset);
+		fclose(fp);
+
+		// drop the tail of a record torn by a crash so that
+		// the new records are appended after a valid one
+		if (fsize > offset && truncate(path, offset)) {
+			return -ELOGIC;
+		}
+		// the updates and removes take more than the vehicles
+		if (records > 2 * size() && compact(path)) {
+			return -ELOGIC;
+		}
+	}
+
+	auto_mutex am(_journal_mut);
+	_journal = fopen(path, "ab");
+	if (!_journal) {
+		return -ENOTAVAIL;
+	}
+	return 0;
+}
+
+void vehicle_registry::close_journal(void)
+{
+	auto_mutex am(_journal_mut);
+	if (_journal) {
+		fclose(_journal);
+		_journal = nullptr;
+	}
+}
+
+}}	//zas::vehicle_indexing
@@ -0,0 +1,242 @@
+/** @file vehicle-registry-bench.cpp
+ * benchmark: mixed register / lookup load from worker threads on the
+ * vehicle registry, the string avl trees under one lock against the
+ * sharded vehicle_registry, and the replay of its journal
+ *
+ * vehicle-registry-bench [vehicles] [threads] [ops per thread] [register %]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inc/vehicle-registry.h"
+#include "utils/avltree.h"
+#include "utils/uuid.h"
+
+using namespace std;
+using namespace zas::utils;
+using namespace zas::vehicle_indexing;
+
+// vehicle_mgr before the vehicle_registry
+struct avl_vehicle
+{
+	avl_node_t avlnode;
+	avl_node_t avlvinnode;
+	string uid;
+	string vid;
+	string acctoken;
+
+	static int uid_compare(avl_node_t* a, avl_node_t* b) {
+		auto* aa = AVLNODE_ENTRY(avl_vehicle, avlnode, a);
+		auto* bb = AVLNODE_ENTRY(avl_vehicle, avlnode, b);
+		int ret = aa->uid.compare(bb->uid);
+		return (ret > 0) ? 1 : ((ret < 0) ? -1 : 0);
+	}
+
+	static int vin_compare(avl_node_t* a, avl_node_t* b) {
+		auto* aa = AVLNODE_ENTRY(avl_vehicle, avlvinnode, a);
+		auto* bb = AVLNODE_ENTRY(avl_vehicle, avlvinnode, b);
+		int ret = aa->vid.compare(bb->vid);
+		return (ret > 0) ? 1 : ((ret < 0) ? -1 : 0);
+	}
+};
+
+// the trees shared by the workers need one lock
+struct avl_registry
+{
+	mutex mut;
+	avl_node_t* uidtree = nullptr;
+	avl_node_t* vintree = nullptr;
+	vector<avl_vehicle*> items;
+
+	~avl_registry() {
+		for (auto* item : items) delete item;
+	}
+
+	int add(const string &vin, const string &acctoken, string &uid) {
+		auto_mutex am(mut);
+		auto* nd = avl_find(vintree,
+			MAKE_FIND_OBJECT(vin, avl_vehicle, vid, avlvinnode),
+			avl_vehicle::vin_compare);
+		if (nd) {
+			auto* item = AVLNODE_ENTRY(avl_vehicle, avlvinnode, nd);
+			item->acctoken = acctoken;
+			uid = item->uid;
+			return 0;
+		}
+		auto* item = new avl_vehicle();
+		item->vid = vin;
+		item->acctoken = acctoken;
+		uuid allocuid;
+		allocuid.generate();
+		allocuid.to_hex(item->uid);
+		if (avl_insert(&uidtree, &item->avlnode, avl_vehicle::uid_compare)) {
+			delete item;
+			return -EEXISTS;
+		}
+		avl_insert(&vintree, &item->avlvinnode, avl_vehicle::vin_compare);
+		items.push_back(item);
+		uid = item->uid;
+		return 1;
+	}
+
+	int find(const string &uid, string &vin) {
+		auto_mutex am(mut);
+		auto* nd = avl_find(uidtree,
+			MAKE_FIND_OBJECT(uid, avl_vehicle, uid, avlnode),
+			avl_vehicle::uid_compare);
+		if (!nd) return -ENOTFOUND;
+		vin = AVLNODE_ENTRY(avl_vehicle, avlnode, nd)->vid;
+		return 0;
+	}
+};
+
+// vehicle_mgr::vehicle_register / get_vehicle_id on the registry
+struct shard_registry
+{
+	vehicle_registry reg;
+
+	int add(const string &vin, const string &acctoken, string &uid) {
+		uint128_t key;
+		int ret = reg.add(vin, &acctoken, key);
+		if (ret >= 0) vehicle_registry::uid_to_hex(key, uid);
+		return ret;
+	}
+
+	int find(const string &uid, string &vin) {
+		uint128_t key;
+		if (vehicle_registry::parse_uid(uid.c_str(), uid.length(), key)) {
+			return -EBADPARM;
+		}
+		return reg.find_uid(key, vin);
+	}
+};
+
+static string make_vin(size_t i)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "LSVAU2180N%07lu", i);
+	return buf;
+}
+
+struct load_result
+{
+	double seconds;
+	size_t found;
+	size_t created;
+};
+
+template <typename R>
+static load_result run_load(R &reg, const vector<string> &uids,
+	int threads, size_t ops, int regpct)
+{
+	vector<size_t> found(threads), created(threads);
+	vector<thread> workers;
+	auto t0 = chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			mt19937_64 gen(t + 1);
+			uniform_int_distribution<size_t> pick(0, uids.size() - 1);
+			uniform_int_distribution<int> pct(0, 99);
+			string vin, uid;
+			size_t newvin = uids.size() + t * ops;
+			for (size_t i = 0; i < ops; i++) {
+				int op = pct(gen);
+				if (op >= regpct) {
+					if (!reg.find(uids[pick(gen)], vin)) found[t]++;
+				} else if (op & 1) {
+					// a vehicle registers again with a new token
+					reg.add(make_vin(pick(gen)), "token", uid);
+				} else if (reg.add(make_vin(newvin++), "token", uid) > 0) {
+					created[t]++;
+				}
+			}
+		});
+	}
+	for (auto& w : workers) w.join();
+	load_result res;
+	res.seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	res.found = res.created = 0;
+	for (int t = 0; t < threads; t++) {
+		res.found += found[t];
+		res.created += created[t];
+	}
+	return res;
+}
+
+template <typename R>
+static double fill(R &reg, size_t count, vector<string> &uids)
+{
+	uids.resize(count);
+	auto t0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < count; i++) {
+		reg.add(make_vin(i), "token", uids[i]);
+	}
+	return chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = (argc > 1) ? atol(argv[1]) : 1000000;
+	int threads = (argc > 2) ? atoi(argv[2]) : 8;
+	size_t ops = (argc > 3) ? atol(argv[3]) : 1000000;
+	int regpct = (argc > 4) ? atoi(argv[4]) : 5;
+	size_t total = ops * threads;
+	printf("%lu vehicles, %d threads x %lu ops, %d%% register\n",
+		count, threads, ops, regpct);
+
+	vector<string> avl_uids, shard_uids;
+	auto* avl = new avl_registry();
+	double avl_fill = fill(*avl, count, avl_uids);
+	auto avl_res = run_load(*avl, avl_uids, threads, ops, regpct);
+	delete avl;
+
+	char path[] = "/tmp/vehicle-journal-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		printf("mkstemp error\n");
+		return 1;
+	}
+	close(fd);
+	auto* shard = new shard_registry();
+	if (shard->reg.open_journal(path)) {
+		printf("open journal %s error\n", path);
+		return 1;
+	}
+	double shard_fill = fill(*shard, count, shard_uids);
+	auto shard_res = run_load(*shard, shard_uids, threads, ops, regpct);
+	size_t vehicles = shard->reg.size();
+	delete shard;
+
+	// a restart replays the journal of the run above
+	auto t0 = chrono::steady_clock::now();
+	auto* replayed = new shard_registry();
+	int ret = replayed->reg.open_journal(path);
+	double replay_s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	string vin;
+	bool same = !ret && replayed->reg.size() == vehicles
+		&& !replayed->find(shard_uids[count / 2], vin)
+		&& vin == make_vin(count / 2);
+	delete replayed;
+	unlink(path);
+
+	printf("fill   avl %8.2f s, sharded %8.2f s (with journal)\n",
+		avl_fill, shard_fill);
+	printf("avl    : %10.0f ops/s, %lu found, %lu created\n",
+		total / avl_res.seconds, avl_res.found, avl_res.created);
+	printf("sharded: %10.0f ops/s, %lu found, %lu created\n",
+		total / shard_res.seconds, shard_res.found, shard_res.created);
+	printf("speedup %.1fx, replay of %lu vehicles %.2f s, same: %s\n",
+		avl_res.seconds / shard_res.seconds, vehicles, replay_s,
+		same ? "yes" : "NO");
+	return same ? 0 : 1;
+}
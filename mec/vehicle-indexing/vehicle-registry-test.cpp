@@ -0,0 +1,248 @@
+/** @file vehicle-registry-test.cpp
+ * unit test of the journal of vehicle_registry: replay of adds, token
+ * changes and removes, a torn or corrupted tail and the compaction
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+#include "inc/vehicle-registry.h"
+
+using namespace std;
+using namespace zas::vehicle_indexing;
+
+namespace {
+
+class VehicleRegistryTest : public ::testing::Test
+{
+protected:
+	void SetUp() override {
+		strcpy(_path, "/tmp/vehicle-registry-test-XXXXXX");
+		int fd = mkstemp(_path);
+		ASSERT_GE(fd, 0);
+		close(fd);
+	}
+
+	void TearDown() override {
+		unlink(_path);
+		string tmp(_path);
+		unlink((tmp + ".tmp").c_str());
+	}
+
+	long file_size(void) {
+		struct stat st;
+		return stat(_path, &st) ? -1 : (long)st.st_size;
+	}
+
+	void append_bytes(const void* data, size_t sz) {
+		FILE* fp = fopen(_path, "ab");
+		ASSERT_NE(nullptr, fp);
+		ASSERT_EQ(sz, fwrite(data, 1, sz, fp));
+		fclose(fp);
+	}
+
+	void flip_byte(long offset) {
+		FILE* fp = fopen(_path, "r+b");
+		ASSERT_NE(nullptr, fp);
+		fseek(fp, offset, SEEK_SET);
+		int c = fgetc(fp);
+		fseek(fp, offset, SEEK_SET);
+		fputc(c ^ 0x5A, fp);
+		fclose(fp);
+	}
+
+	char _path[64];
+};
+
+bool same_uid(const uint128_t &a, const uint128_t &b)
+{
+	return vehicle_uid_equal()(a, b);
+}
+
+const string vin_a = "LSVAU2180N0000001";
+const string vin_b = "LSVAU2180N0000002";
+const string vin_c = "LSVAU2180N0000003";
+
+}	// namespace
+
+TEST_F(VehicleRegistryTest, ReplayAddUpdateRemove)
+{
+	uint128_t uid_a, uid_b, uid_c, uid;
+	string token_a = "token-a", token_b = "token-b", token_c = "token-c";
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		EXPECT_EQ(1, reg.add(vin_a, &token_a, uid_a));
+		EXPECT_EQ(1, reg.add(vin_b, &token_b, uid_b));
+		EXPECT_EQ(1, reg.add(vin_c, &token_c, uid_c));
+
+		// found again, the same token writes no record
+		long sz = file_size();
+		EXPECT_EQ(0, reg.add(vin_a, &token_a, uid));
+		EXPECT_TRUE(same_uid(uid_a, uid));
+		EXPECT_EQ(sz, file_size());
+
+		string token = "token-b2";
+		EXPECT_EQ(0, reg.add(vin_b, &token, uid));
+		EXPECT_TRUE(same_uid(uid_b, uid));
+		EXPECT_EQ(0, reg.remove_uid(uid_c));
+		EXPECT_EQ(2u, reg.size());
+	}
+
+	vehicle_registry reg;
+	ASSERT_EQ(0, reg.open_journal(_path));
+	EXPECT_EQ(2u, reg.size());
+	string token, vin;
+	ASSERT_EQ(0, reg.find_vin(vin_a, uid, &token));
+	EXPECT_TRUE(same_uid(uid_a, uid));
+	EXPECT_EQ(token_a, token);
+	ASSERT_EQ(0, reg.find_vin(vin_b, uid, &token));
+	EXPECT_TRUE(same_uid(uid_b, uid));
+	EXPECT_EQ("token-b2", token);
+	ASSERT_EQ(0, reg.find_uid(uid_b, vin));
+	EXPECT_EQ(vin_b, vin);
+	EXPECT_EQ(-ENOTFOUND, reg.find_vin(vin_c, uid));
+	EXPECT_EQ(-ENOTFOUND, reg.find_uid(uid_c, vin));
+}
+
+TEST_F(VehicleRegistryTest, RemoveThenAddGetsNewUid)
+{
+	uint128_t first, second, uid;
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		EXPECT_EQ(1, reg.add(vin_a, nullptr, first));
+		EXPECT_EQ(0, reg.remove_vin(vin_a));
+		EXPECT_EQ(-ENOTFOUND, reg.remove_vin(vin_a));
+		EXPECT_EQ(1, reg.add(vin_a, nullptr, second));
+		EXPECT_FALSE(same_uid(first, second));
+	}
+	vehicle_registry reg;
+	ASSERT_EQ(0, reg.open_journal(_path));
+	EXPECT_EQ(1u, reg.size());
+	ASSERT_EQ(0, reg.find_vin(vin_a, uid));
+	EXPECT_TRUE(same_uid(second, uid));
+	string vin;
+	EXPECT_EQ(-ENOTFOUND, reg.find_uid(first, vin));
+}
+
+TEST_F(VehicleRegistryTest, TornTailIsTruncated)
+{
+	uint128_t uid_a, uid_b, uid;
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		reg.add(vin_a, nullptr, uid_a);
+		reg.add(vin_b, nullptr, uid_b);
+	}
+	long valid = file_size();
+
+	// a crash in the middle of a record: the magic and a few bytes
+	const uint8_t torn[] = {0x56, 0x47, 0x52, 0x4A, 0x01, 0x02, 0x03};
+	append_bytes(torn, sizeof(torn));
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		EXPECT_EQ(2u, reg.size());
+		EXPECT_EQ(valid, file_size());
+		// appended after the last valid record
+		EXPECT_EQ(1, reg.add(vin_c, nullptr, uid));
+	}
+
+	vehicle_registry reg;
+	ASSERT_EQ(0, reg.open_journal(_path));
+	EXPECT_EQ(3u, reg.size());
+	ASSERT_EQ(0, reg.find_vin(vin_b, uid));
+	EXPECT_TRUE(same_uid(uid_b, uid));
+	EXPECT_EQ(0, reg.find_vin(vin_c, uid));
+}
+
+TEST_F(VehicleRegistryTest, ChecksumMismatchDropsTheTail)
+{
+	uint128_t uid_a, uid;
+	long first;
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		reg.add(vin_a, nullptr, uid_a);
+		first = file_size();
+		reg.add(vin_b, nullptr, uid);
+	}
+	// the last byte of the vin of the second record
+	flip_byte(file_size() - 1);
+
+	vehicle_registry reg;
+	ASSERT_EQ(0, reg.open_journal(_path));
+	EXPECT_EQ(1u, reg.size());
+	EXPECT_EQ(first, file_size());
+	ASSERT_EQ(0, reg.find_vin(vin_a, uid));
+	EXPECT_TRUE(same_uid(uid_a, uid));
+	EXPECT_EQ(-ENOTFOUND, reg.find_vin(vin_b, uid));
+}
+
+TEST_F(VehicleRegistryTest, CompactionKeepsTheLatest)
+{
+	const int count = 10;
+	char vin[32];
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		uint128_t uid;
+		for (int round = 0; round < 4; round++) {
+			string token = "token-" + to_string(round);
+			for (int i = 0; i < count; i++) {
+				snprintf(vin, sizeof(vin), "LSVAU2180N%07d", i);
+				reg.add(vin, &token, uid);
+			}
+		}
+	}
+	// 40 records of 10 vehicles are compacted on open
+	long before = file_size();
+	{
+		vehicle_registry reg;
+		ASSERT_EQ(0, reg.open_journal(_path));
+		EXPECT_EQ((size_t)count, reg.size());
+	}
+	long after = file_size();
+	EXPECT_EQ(before / 4, after);
+
+	vehicle_registry reg;
+	ASSERT_EQ(0, reg.open_journal(_path));
+	EXPECT_EQ((size_t)count, reg.size());
+	EXPECT_EQ(after, file_size());
+	for (int i = 0; i < count; i++) {
+		uint128_t uid;
+		string token;
+		snprintf(vin, sizeof(vin), "LSVAU2180N%07d", i);
+		ASSERT_EQ(0, reg.find_vin(vin, uid, &token));
+		EXPECT_EQ("token-3", token);
+	}
+}
+
+TEST_F(VehicleRegistryTest, UidHexRoundTrip)
+{
+	vehicle_registry reg;
+	uint128_t uid, parsed;
+	ASSERT_EQ(1, reg.add(vin_a, nullptr, uid));
+	string hex;
+	vehicle_registry::uid_to_hex(uid, hex);
+	ASSERT_EQ((size_t)VEHICLE_UID_HEX_LENGTH, hex.length());
+	ASSERT_EQ(0, vehicle_registry::parse_uid(hex.c_str(), hex.length(), parsed));
+	EXPECT_TRUE(same_uid(uid, parsed));
+
+	string bad = hex;
+	bad[8] = 'x';
+	EXPECT_EQ(-EBADPARM, vehicle_registry::parse_uid(bad.c_str(),
+		bad.length(), parsed));
+	bad = hex;
+	bad[0] = 'g';
+	EXPECT_EQ(-EBADPARM, vehicle_registry::parse_uid(bad.c_str(),
+		bad.length(), parsed));
+	EXPECT_EQ(-EBADPARM, vehicle_registry::parse_uid(hex.c_str(),
+		hex.length() - 1, parsed));
+}
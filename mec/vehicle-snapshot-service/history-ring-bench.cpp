@@ -0,0 +1,159 @@
+/** @file history-ring-bench.cpp
+ * benchmark: resident memory of the per device radar history,
+ * the fixed 4096 entry arrays against the history_ring
+ *
+ * history-ring-bench [devices] [packages] [targets] [depth]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <vector>
+
+#include "inc/history-ring.h"
+#include "proto/junction_package.pb.h"
+
+using namespace std;
+using namespace zas::vehicle_snapshot_service;
+
+#define ARRAY_CACHER (4096)
+
+// the device_info layout before the history_ring
+struct array_device
+{
+	uint32_t index;
+	jos::radar_vision_info info[ARRAY_CACHER];
+};
+
+struct ring_device
+{
+	history_ring<jos::radar_vision_info> info;
+};
+
+static size_t rss_kb(void)
+{
+	long pages = 0, resident = 0;
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (!fp) return 0;
+	if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(fp);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void fill(jos::radar_vision_info& info, int dev, int pkg, int targets)
+{
+	info.set_type(1);
+	info.set_id(dev);
+	info.set_timestamp(1700000000000ULL + pkg * 50);
+	info.set_lon(121.0 + dev * 1e-4);
+	info.set_lat(31.0 + dev * 1e-4);
+	info.set_rdir(90.0f);
+	for (int i = 0; i < targets; i++) {
+		auto* tgt = info.add_targets();
+		tgt->set_id(i);
+		tgt->set_type(1);
+		tgt->set_lon(121.0 + i * 1e-5);
+		tgt->set_lat(31.0 + i * 1e-5);
+		tgt->set_speed(10.0f);
+	}
+}
+
+static int run_array(int devices, int packages, int targets)
+{
+	vector<array_device*> devs;
+	size_t before = rss_kb();
+	auto t0 = chrono::steady_clock::now();
+	for (int d = 0; d < devices; d++) {
+		auto* dev = new array_device();
+		dev->index = 0;
+		devs.push_back(dev);
+	}
+	uint64_t sum = 0;
+	for (int p = 0; p < packages; p++) {
+		for (int d = 0; d < devices; d++) {
+			auto* dev = devs[d];
+			dev->info[dev->index].Clear();
+			fill(dev->info[dev->index], d, p, targets);
+			dev->index = (dev->index + 1) % ARRAY_CACHER;
+			uint32_t curr = (dev->index + ARRAY_CACHER - 1) % ARRAY_CACHER;
+			sum += dev->info[curr].targets_size();
+		}
+	}
+	double ms = chrono::duration<double, milli>(
+		chrono::steady_clock::now() - t0).count();
+	printf("array[%d]  : %8lu KB rss, %8.1f ms (%lu)\n",
+		ARRAY_CACHER, rss_kb() - before, ms, sum);
+	return 0;
+}
+
+static int run_ring(int devices, int packages, int targets, int depth)
+{
+	vector<ring_device*> devs;
+	size_t before = rss_kb();
+	auto t0 = chrono::steady_clock::now();
+	for (int d = 0; d < devices; d++) {
+		auto* dev = new ring_device();
+		dev->info.set_capacity(depth);
+		devs.push_back(dev);
+	}
+	uint64_t sum = 0;
+	for (int p = 0; p < packages; p++) {
+		for (int d = 0; d < devices; d++) {
+			auto* dev = devs[d];
+			fill(*dev->info.prepare(), d, p, targets);
+			dev->info.commit();
+			sum += dev->info.latest()->targets_size();
+		}
+	}
+	double ms = chrono::duration<double, milli>(
+		chrono::steady_clock::now() - t0).count();
+	printf("ring[%d]     : %8lu KB rss, %8.1f ms (%lu)\n",
+		depth, rss_kb() - before, ms, sum);
+
+	// the package 250 ms before the latest one
+	uint64_t ts = devs[0]->info.latest()->timestamp() - 250;
+	auto* found = devs[0]->info.find(ts);
+	if (!found || found->timestamp() != ts) {
+		printf("find error at %lu\n", ts);
+		return 1;
+	}
+	return 0;
+}
+
+// every layout is measured in its own process
+template <typename F> static int forked(F fn)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) return -1;
+	if (!pid) {
+		int ret = fn();
+		fflush(stdout);
+		_exit(ret);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char* argv[])
+{
+	int devices = (argc > 1) ? atoi(argv[1]) : 500;
+	int packages = (argc > 2) ? atoi(argv[2]) : 4096;
+	int targets = (argc > 3) ? atoi(argv[3]) : 20;
+	int depth = (argc > 4) ? atoi(argv[4]) : HISTORY_RING_DEFAULT_DEPTH;
+
+	printf("%d devices, %d packages of %d targets each\n",
+		devices, packages, targets);
+	int ret = forked([&]() {
+		return run_array(devices, packages, targets);
+	});
+	ret |= forked([&]() {
+		return run_ring(devices, packages, targets, depth);
+	});
+	return ret;
+}
@@ -13,6 +13,8 @@
 #include "mapcore/hdmap.h"
 #include "fusion-improver.h"
 #include "kafka-consumer.h"
+#include "history-ring.h"
+#include "radar-batch.h"
 
 #include "proto/junction_package.pb.h"
 #include "proto/fusion_service_pkg.pb.h"
@@ -22,7 +24,6 @@
 namespace zas {
 namespace vehicle_snapshot_service {
 
-#define DEVICE_SNAPSHOT_CACHER (4096)
 #define JUNCTION_COUNT_CYCLE_TIME (1000)
 
 using namespace zas::utils;
@@ -47,9 +48,8 @@ struct device_info
 	listnode_t ownerlist;
 	avl_node_t avlnode;
 	std::string dev_id;
-	uint32_t index;
 	bool inited;
-	jos::radar_vision_info info[DEVICE_SNAPSHOT_CACHER];
+	history_ring<jos::radar_vision_info> info;
 	static int device_avl_compare(avl_node_t*, avl_node_t*);
 };
 
@@ -68,9 +68,8 @@ struct device_junction_item
 	avl_node_t avlnode;
 	listnode_t device_list;
 	avl_node_t* device_tree;
-	uint32_t index;
 	junction_info jun_info;
-	jos::fusion_package info[DEVICE_SNAPSHOT_CACHER];
+	history_ring<jos::fusion_package> info;
 	spfusion_improver improver;
 	spfusion_juncion_info fjunc;
 	static int device_junction_avl_compare(avl_node_t*, avl_node_t*);
@@ -101,7 +100,7 @@ public:
 	int on_request_reply(device_wa_request* wa_req,
 		void* context, void* data, size_t sz);
 
-	int update_fusion_data(device_junction_item *item, device_info* radar_info);
+	int update_fusion_data(device_junction_item *item, const radar_record &rec);
 
 	// for vehicle snapshot
 	int get_traffice_info(vehicle_snapshot_item* item,
@@ -167,6 +166,11 @@ private:
 	zas::mapcore::rendermap*		_hdmap;
 	zas::mapcore::proj*		_proj;
 	zas::mapcore::point3d 	_projoffset;
+	uint32_t	_history_depth;
+	// reused for every received package
+	radar_batch _radar_batch;
+	junction_fusion_package _fusion_head;
+	std::string _fusion_data;
 	mutex	_mut;
 };
 
@@ -0,0 +1,130 @@
+#ifndef __CXX_SNAPSHOT_SERVICE_HISTORY_RING_H__
+#define __CXX_SNAPSHOT_SERVICE_HISTORY_RING_H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "std/zasbsc.h"
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+#define HISTORY_RING_DEFAULT_DEPTH (16)
+
+/*
+ * history of the packages of a device or a junction
+ *
+ * the entries are allocated on first use, so a ring only holds as many
+ * packages as it has received, up to its capacity. A new entry is built
+ * in place: prepare() returns the cleared pending slot and commit()
+ * appends it as the latest entry, dropping the oldest one when the ring
+ * is full. Entries are expected to be committed in time order, find()
+ * binary searches on T::timestamp().
+ */
+template <typename T>
+class history_ring
+{
+public:
+	history_ring()
+	: _slots(nullptr), _capacity(HISTORY_RING_DEFAULT_DEPTH)
+	, _next(0), _count(0) {}
+
+	~history_ring() {
+		release();
+	}
+
+	// the capacity is fixed once the first entry is prepared
+	int set_capacity(uint32_t capacity) {
+		if (!capacity) return -EBADPARM;
+		if (_slots) return -ELOGIC;
+		_capacity = capacity;
+		return 0;
+	}
+
+	uint32_t capacity(void) const {
+		return _capacity;
+	}
+
+	uint32_t size(void) const {
+		return _count;
+	}
+
+	bool empty(void) const {
+		return (0 == _count);
+	}
+
+	// the cleared pending slot, the oldest entry is dropped when full
+	T* prepare(void) {
+		if (!_slots) {
+			_slots = new T*[_capacity]();
+			assert(nullptr != _slots);
+		}
+		if (!_slots[_next]) {
+			_slots[_next] = new T();
+			assert(nullptr != _slots[_next]);
+		} else _slots[_next]->Clear();
+		if (_count == _capacity) {
+			_count--;
+		}
+		return _slots[_next];
+	}
+
+	// the slot returned by the last prepare(), not yet committed
+	T* pending(void) {
+		assert(nullptr != _slots && nullptr != _slots[_next]);
+		return _slots[_next];
+	}
+
+	void commit(void) {
+		_next = (_next + 1) % _capacity;
+		if (_count < _capacity) {
+			_count++;
+		}
+	}
+
+	// the i-th entry, 0 is the oldest
+	T* at(uint32_t i) const {
+		if (i >= _count) return nullptr;
+		return _slots[(_next + _capacity - _count + i) % _capacity];
+	}
+
+	T* latest(void) const {
+		return (_count) ? at(_count - 1) : nullptr;
+	}
+
+	// the latest entry not newer than timestamp, nullptr if none
+	T* find(uint64_t timestamp) const {
+		uint32_t lo = 0, hi = _count;
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+			if (at(mid)->timestamp() <= timestamp) {
+				lo = mid + 1;
+			} else hi = mid;
+		}
+		return (lo) ? at(lo - 1) : nullptr;
+	}
+
+	void release(void) {
+		if (!_slots) return;
+		for (uint32_t i = 0; i < _capacity; i++) {
+			if (_slots[i]) delete _slots[i];
+		}
+		delete [] _slots;
+		_slots = nullptr;
+		_next = _count = 0;
+	}
+
+private:
+	history_ring(const history_ring&);
+	history_ring& operator=(const history_ring&);
+
+private:
+	T** _slots;
+	uint32_t _capacity;
+	uint32_t _next;
+	uint32_t _count;
+};
+
+}}	//zas::vehicle_snapshot_service
+
+#endif /* __CXX_SNAPSHOT_SERVICE_HISTORY_RING_H__*/
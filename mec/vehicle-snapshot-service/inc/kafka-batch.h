@@ -0,0 +1,58 @@
+#ifndef __CXX_SNAPSHOT_SERVICE_KAFKA_BATCH_H__
+#define __CXX_SNAPSHOT_SERVICE_KAFKA_BATCH_H__
+
+#include <stdint.h>
+#include <vector>
+#include "std/zasbsc.h"
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+struct kafka_record
+{
+	// field number of the record in center_kafka_data
+	int field;
+	// the encoded message in the received data
+	const char* data;
+	size_t sz;
+};
+
+/*
+ * the records of a received center_kafka_data
+ *
+ * every record is an already encoded junction_info, vehicle_snapshot
+ * or cnt_junction, so it is sent to kafka as it is without a parse
+ * and serialize round trip. The received data must outlive the batch
+ * since the records point into it.
+ */
+class kafka_batch
+{
+public:
+	kafka_batch();
+	~kafka_batch();
+
+	int parse(const void* data, size_t sz);
+
+	void reset(void) {
+		_records.clear();
+	}
+
+	size_t size(void) const {
+		return _records.size();
+	}
+
+	const kafka_record& record(size_t i) const {
+		return _records[i];
+	}
+
+private:
+	kafka_batch(const kafka_batch&);
+	kafka_batch& operator=(const kafka_batch&);
+
+private:
+	std::vector<kafka_record> _records;
+};
+
+}}	//zas::vehicle_snapshot_service
+
+#endif /* __CXX_SNAPSHOT_SERVICE_KAFKA_BATCH_H__*/
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "snapshot-service-def.h"
 #include "service-worker.h"
+#include "kafka-batch.h"
 #include "std/list.h"
 #include "utils/avltree.h"
 #include "utils/timer.h"
@@ -14,6 +15,8 @@ namespace vss {
 };
 namespace RdKafka {
 	class Producer;
+	class Topic;
+	class Conf;
 };
 
 namespace zas {
@@ -21,7 +24,20 @@ namespace vehicle_snapshot_service {
 
 using namespace zas::utils;
 
+// producer defaults, overridden by kafka.producer in sysconfig
+#define KAFKA_PRODUCER_LINGER_MS		(5)
+#define KAFKA_PRODUCER_BATCH_MESSAGES	(10000)
+#define KAFKA_PRODUCER_QUEUE_MESSAGES	(100000)
+#define KAFKA_PRODUCER_COMPRESSION		"none"
+
+// the delivery reports are served by the poll thread
+#define KAFKA_POLL_TIMEOUT_MS			(100)
+// a message is dropped when the producer queue is full, the drops
+// are logged on the first one and then once every this many
+#define KAFKA_QUEUE_FULL_LOG_EVERY		(1000)
+
 class kafka_delivery_report;
+class kafka_poll_thread;
 
 class vss_kafka_sender : kafka_data_callback
 {
@@ -36,7 +52,11 @@ public:
 private:
 	int load_kafka_config(void);
 	int init_kafka(void);
-	int send_kafka_to_center(std::string &topic, void* data, size_t sz);
+	int set_kafka_conf(RdKafka::Conf* conf, const char* name,
+		const std::string &val);
+	RdKafka::Topic* create_kafka_topic(const std::string &name);
+	int send_kafka_to_center(RdKafka::Topic* topic, const void* data, size_t sz);
+	void print_count(const kafka_record &rec);
 
 private:
 	bool _inited;
@@ -46,7 +66,14 @@ private:
 	std::string _vehicle_topic;
 	std::string _count_topic;
 	RdKafka::Producer* _producer;
+	RdKafka::Topic* _junction_rktopic;
+	RdKafka::Topic* _vehicle_rktopic;
+	RdKafka::Topic* _count_rktopic;
 	kafka_delivery_report* _delivery_cb;
+	kafka_poll_thread* _poll_thread;
+	kafka_batch _batch;
+	// messages dropped on a full producer queue
+	size_t _queue_full_drops;
 };
 
 }}	//zas::vehicle_snapshot_service
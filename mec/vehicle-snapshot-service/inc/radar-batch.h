@@ -0,0 +1,79 @@
+#ifndef __CXX_SNAPSHOT_SERVICE_RADAR_BATCH_H__
+#define __CXX_SNAPSHOT_SERVICE_RADAR_BATCH_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "std/zasbsc.h"
+
+namespace google {
+namespace protobuf {
+	class Arena;
+}}
+
+namespace jos {
+	class radar_vision_info;
+	class junction_fusion_package;
+};
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+struct radar_record
+{
+	// parsed on the arena of the batch
+	jos::radar_vision_info* info;
+	// the bytes of the record in the received package
+	const uint8_t* raw;
+	size_t rawsz;
+};
+
+/*
+ * the radar records of a received junction_package
+ *
+ * the records are parsed on an arena that lives until the next
+ * parse(). The first block of the arena is kept between the batches
+ * and grows to the largest batch seen, so a batch does not allocate
+ * once the service is warmed up. The received data must outlive the
+ * batch since the records point into it.
+ */
+class radar_batch
+{
+public:
+	radar_batch();
+	~radar_batch();
+
+	int parse(const void* data, size_t sz);
+	void reset(void);
+
+	size_t size(void) const {
+		return _records.size();
+	}
+
+	radar_record& record(size_t i) {
+		return _records[i];
+	}
+
+private:
+	radar_batch(const radar_batch&);
+	radar_batch& operator=(const radar_batch&);
+
+private:
+	google::protobuf::Arena* _arena;
+	std::vector<char> _block;
+	std::vector<radar_record> _records;
+};
+
+/*
+ * serialize a junction_fusion_package of the record into out
+ *
+ * head holds every field but jun_pkg. The record is forwarded as its
+ * received bytes followed by the edge receive time of rec.info, which
+ * the receiver merges into the timeinfo of the record.
+ */
+int encode_fusion_package(const jos::junction_fusion_package &head,
+	const radar_record &rec, std::string &out);
+
+}}	//zas::vehicle_snapshot_service
+
+#endif /* __CXX_SNAPSHOT_SERVICE_RADAR_BATCH_H__*/
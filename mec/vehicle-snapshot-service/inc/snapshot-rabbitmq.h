@@ -1,9 +1,11 @@
 #ifndef __CXX_SNAPSHOT_RABBITMQ_H__
 #define __CXX_SNAPSHOT_RABBITMQ_H__
 #include <string>
+#include <time.h>
 #include <rabbitmq-c/amqp.h>
 #include <rabbitmq-c/tcp_socket.h>
 #include "utils/timer.h"
+#include "utils/rabbitmq-outbound.h"
 
 #include <vector>
 
@@ -14,6 +16,18 @@ using namespace zas::utils;
 
 class service_backend;
 class rabbitmq_init_retry_timer;
+class rabbitmq_publisher;
+class rabbitmq_confirm_reader;
+
+// producing defaults, overridden by rabbitmq.producing.<name>
+#define RABBITMQ_QUEUE_CAPACITY		(4096)
+#define RABBITMQ_BLOCK_TIMEOUT_MS	(10)
+#define RABBITMQ_PUBLISH_BATCH		(256)
+#define RABBITMQ_CONFIRM_TIMEOUT_MS	(5000)
+
+// consuming defaults, overridden by rabbitmq.consuming.<name>
+#define RABBITMQ_CONSUME_PREFETCH	(256)
+#define RABBITMQ_ACK_BATCH			(64)
 
 enum rabbitmq_role {
 	rabbitmq_role_unknown = 0,
@@ -36,6 +50,8 @@ public:
 
 class snapshot_rabbitmq
 {
+	friend class rabbitmq_publisher;
+	friend class rabbitmq_confirm_reader;
 public:
 	snapshot_rabbitmq(rabbitmq_role erole, const char* name,
 		service_backend* backend, void* context, timermgr* mgr);
@@ -48,15 +64,27 @@ public:
 	int set_consuming_callback(ss_rabbitmq_callback* cb);
 	void on_timer(void);
 
+	// messages waiting for the publisher
+	size_t queue_depth(void);
+	int get_publish_stats(rabbitmq_outbound_stats &stats);
+
 private:
 	int load_config(void);
+	void load_publish_config(const std::string &path);
+	void load_consume_config(const std::string &path);
 	int init_producing(void);
 	int init_consuming(void);
 	int retry_init_consuming(void);
-	int retry_init_producing(void);
 	int amqp_return_result(amqp_rpc_reply_t &x, char const *desc);
 	static int consume_cb(int fd, int revents, void* data);
 	int on_consume(int fd, int revents);
+	void on_delivery(amqp_envelope_t &envelope);
+	int ack_deliveries(uint64_t tag);
+	int run_publisher(void);
+	int publish_batch(void);
+	int read_confirm(uint64_t &tag, bool &multiple, bool &nack);
+	void report_stats(void);
+	void close_connection(void);
 
 private:
 	void amqp_dump(void const *buffer, size_t len);
@@ -76,6 +104,26 @@ private:
 	std::string _password;
 	std::string _mq_name;
 	std::vector<rabbitmq_exchange_info> _exchange_info;
+
+	// producing, the connection belongs to the publisher thread
+	rabbitmq_outbound* _outbound;
+	rabbitmq_publisher* _publisher;
+	size_t _queue_capacity;
+	rabbitmq_drop_policy _drop_policy;
+	uint32_t _block_ms;
+	size_t _batch_size;
+	uint32_t _confirm_ms;
+	bool _persistent;
+	uint64_t _delivery_tag;
+	time_t _stats_time;
+	size_t _stats_dropped;
+	std::vector<rabbitmq_message*> _batch;
+	rabbitmq_confirms _confirms;
+
+	// consuming
+	uint16_t _prefetch;
+	uint32_t _ack_batch;
+	std::string _routingkey;
 };
 
 }}	//zas::vehicle_indexing
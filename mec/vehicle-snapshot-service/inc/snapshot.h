@@ -9,9 +9,11 @@
 #include "utils/uri.h"
 #include "proto/vehicle_snapshot.pb.h"
 #include "proto/distribute_package.pb.h"
+#include "vehicle-grid.h"
 
 namespace zas::mapcore {
 	class sdmap;
+	class sdmap_link;
 };
 namespace zas {
 namespace vehicle_snapshot_service {
@@ -23,7 +25,7 @@ using namespace zas::utils;
 struct vehicle_snapshot_item
 {
 	listnode_t ownerlist;
-	listnode_t linkownerlist;
+	vehicle_grid_node gridnode;
 	listnode_t junctionownerlist;
 	listnode_t junprevownerlist;
 	avl_node_t avlnode;
@@ -82,8 +84,8 @@ private:
 	
 	int set_way_and_arround_vehilce(vehicle_snapshot_item* item,
 		jos::distribute_package &dspkg);
-	int set_around_vehicle(jos::distribute_package &dspkg, listnode_t *hd,
-		vss::positioning_system_info& gps);
+	int set_around_vehicle(jos::distribute_package &dspkg,
+		vehicle_snapshot_item* item);
 
 	int send_to_subscribe(vehicle_snapshot_item* item,
 		const char* data, size_t sz);
@@ -97,6 +99,8 @@ private:
 	avl_node_t* _request_vin_tree;
 
 	zas::mapcore::sdmap*		_map;
+	// every vehicle at its last position
+	vehicle_grid	_grid;
 };
 
 }}	//zas::vehicle_snapshot_service
@@ -0,0 +1,112 @@
+#ifndef __CXX_SNAPSHOT_SERVICE_VEHICLE_GRID_H__
+#define __CXX_SNAPSHOT_SERVICE_VEHICLE_GRID_H__
+
+#include <stdint.h>
+#include <math.h>
+#include <unordered_map>
+#include "std/zasbsc.h"
+#include "std/list.h"
+
+namespace zas {
+namespace mapcore {
+	class sdmap_link;
+}}
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+// the cells cover the query radius with this margin for the error
+// of the local projection against mapcore::distance
+#define VEHICLE_GRID_MARGIN (1.05)
+
+// embedded in the vehicle item
+struct vehicle_grid_node
+{
+	listnode_t ownerlist;
+	int64_t cell;
+	double lon, lat;
+	const zas::mapcore::sdmap_link* link;
+};
+
+/*
+ * the vehicles bucketed in square cells of a local projection
+ *
+ * the projection is equirectangular around the first vehicle. A node
+ * is moved between the cells as its vehicle updates, so a query only
+ * walks the cells around the point instead of every vehicle on the
+ * nearby links.
+ */
+class vehicle_grid
+{
+public:
+	vehicle_grid(double cellsize);
+	~vehicle_grid();
+
+	static void init_node(vehicle_grid_node* node);
+
+	// insert the node or move it to the new position
+	int update(vehicle_grid_node* node, double lon, double lat,
+		const zas::mapcore::sdmap_link* link);
+	int remove(vehicle_grid_node* node);
+	void clear(void);
+
+	size_t size(void) const {
+		return _count;
+	}
+
+	/*
+	 * call fn for every node that may be within radius of <lon, lat>,
+	 * the caller checks the exact distance
+	 */
+	template <typename F>
+	void for_each_candidate(double lon, double lat, double radius, F fn) const
+	{
+		if (!_count) return;
+		double x, y;
+		project(lon, lat, x, y);
+		double r = radius * VEHICLE_GRID_MARGIN;
+		int64_t x0 = cell_index(x - r), x1 = cell_index(x + r);
+		int64_t y0 = cell_index(y - r), y1 = cell_index(y + r);
+		for (int64_t cx = x0; cx <= x1; cx++) {
+			for (int64_t cy = y0; cy <= y1; cy++) {
+				auto it = _cells.find(cell_key(cx, cy));
+				if (it == _cells.end()) continue;
+				const listnode_t* hd = &it->second;
+				listnode_t* nd = hd->next;
+				for (; nd != hd; nd = nd->next) {
+					fn(LIST_ENTRY(vehicle_grid_node, ownerlist, nd));
+				}
+			}
+		}
+	}
+
+private:
+	void project(double lon, double lat, double &x, double &y) const {
+		x = (lon - _lon0) * _kx;
+		y = (lat - _lat0) * _ky;
+	}
+
+	int64_t cell_index(double v) const {
+		return (int64_t)floor(v / _cellsize);
+	}
+
+	static int64_t cell_key(int64_t cx, int64_t cy) {
+		return (int64_t)(((uint64_t)cx << 32) ^ (uint32_t)cy);
+	}
+
+private:
+	vehicle_grid(const vehicle_grid&);
+	vehicle_grid& operator=(const vehicle_grid&);
+
+private:
+	double _cellsize;
+	bool _origin;
+	double _lon0, _lat0;
+	double _kx, _ky;
+	size_t _count;
+	std::unordered_map<int64_t, listnode_t> _cells;
+};
+
+}}	//zas::vehicle_snapshot_service
+
+#endif /* __CXX_SNAPSHOT_SERVICE_VEHICLE_GRID_H__*/
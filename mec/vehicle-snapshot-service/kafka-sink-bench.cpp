@@ -0,0 +1,183 @@
+/** @file kafka-sink-bench.cpp
+ * benchmark: the kafka data of the snapshots through the sender into
+ * an in-process sink, parse + serialize of every record against the
+ * kafka_batch forwarding the encoded records
+ *
+ * the sink takes a copy of the payload as librdkafka does for
+ * RK_MSG_COPY and releases it in batches like the delivery reports
+ *
+ * kafka-sink-bench [messages] [vehicles per junction] [targets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "inc/kafka-batch.h"
+#include "proto/center_kafka_data.pb.h"
+
+using namespace std;
+using namespace zas::vehicle_snapshot_service;
+
+#define SINK_BATCH (1000)
+
+struct kafka_sink
+{
+	vector<void*> queue;
+	size_t messages;
+	size_t bytes;
+	string last[4];
+
+	kafka_sink() : messages(0), bytes(0) {}
+	~kafka_sink() { deliver(); }
+
+	void produce(int topic, const void* data, size_t sz) {
+		void* payload = malloc(sz);
+		memcpy(payload, data, sz);
+		queue.push_back(payload);
+		messages++;
+		bytes += sz;
+		if (queue.size() >= SINK_BATCH) {
+			last[topic].assign((const char*)payload, sz);
+			deliver();
+		}
+	}
+
+	void deliver(void) {
+		for (auto* p : queue) free(p);
+		queue.clear();
+	}
+};
+
+// on_kafka_data_send before the kafka_batch
+static void send_parsed(kafka_sink &sink, const string &data)
+{
+	jos::center_kafka_data kafka_data;
+	kafka_data.ParseFromArray(data.c_str(), data.length());
+	for (int i = 0; i < kafka_data.snapshot_size(); i++) {
+		auto vss_snapshot = kafka_data.snapshot(i);
+		std::string veh_data;
+		vss_snapshot.SerializeToString(&veh_data);
+		sink.produce(2, veh_data.c_str(), veh_data.length());
+	}
+	for (int i = 0; i < kafka_data.junction_size(); i++) {
+		auto* jos_item = kafka_data.mutable_junction(i);
+		jos_item->mutable_timeinfo();
+		std::string veh_data;
+		jos_item->SerializeToString(&veh_data);
+		sink.produce(1, veh_data.c_str(), veh_data.length());
+	}
+}
+
+// on_kafka_data_send with the kafka_batch
+static void send_forward(kafka_sink &sink, kafka_batch &batch,
+	const string &data)
+{
+	if (batch.parse(data.c_str(), data.length())) {
+		return;
+	}
+	for (size_t i = 0; i < batch.size(); i++) {
+		auto& rec = batch.record(i);
+		sink.produce(rec.field, rec.data, rec.sz);
+	}
+	batch.reset();
+}
+
+static double cpu_seconds(void)
+{
+	rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+		+ (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+int main(int argc, char* argv[])
+{
+	int messages = (argc > 1) ? atoi(argv[1]) : 200000;
+	int vehicles = (argc > 2) ? atoi(argv[2]) : 10;
+	int targets = (argc > 3) ? atoi(argv[3]) : 30;
+
+	// one record in each message, as the snapshots send them:
+	// the vehicles of a junction and then the junction
+	vector<string> recorded;
+	for (int p = 0; p < 100; p++) {
+		for (int v = 0; v < vehicles; v++) {
+			jos::center_kafka_data kafka_data;
+			auto* ss = kafka_data.add_snapshot();
+			ss->set_vincode("LSVAU2180N218" + to_string(3000 + v));
+			ss->set_road_name("zhangjiang road");
+			ss->set_deviation(0.3f);
+			auto* pkg = ss->mutable_package();
+			pkg->set_timestamp_sec(1700000000 + p);
+			pkg->set_timestamp_usec(v * 1000);
+			pkg->set_update_timestamp_sec(1700000000 + p);
+			pkg->set_vehicle_speed(40.f + v);
+			pkg->set_distance(1200.f);
+			pkg->set_steering_wheel_angle(1.5f);
+			auto* gps = pkg->mutable_gpsinfo();
+			gps->set_latitude(31.2 + v * 1e-5);
+			gps->set_longtitude(121.4 + v * 1e-5);
+			gps->set_heading(90.f);
+			recorded.push_back(kafka_data.SerializeAsString());
+		}
+		jos::center_kafka_data kafka_data;
+		auto* jos_item = kafka_data.add_junction();
+		jos_item->set_junction_id("1001");
+		jos_item->set_timestamp(1700000000000ULL + p * 100);
+		jos_item->set_lat(31.2);
+		jos_item->set_lon(121.4);
+		jos_item->mutable_timeinfo()->set_erecv_timestamp_sec(1700000000);
+		for (int i = 0; i < targets; i++) {
+			auto* tgt = jos_item->add_targets();
+			tgt->set_id(i);
+			tgt->set_lat(31.2 + i * 1e-5);
+			tgt->set_lon(121.4 + i * 1e-5);
+			tgt->set_hdg(45.f);
+			tgt->set_speed(10.f);
+		}
+		recorded.push_back(kafka_data.SerializeAsString());
+	}
+	printf("%d messages, %d vehicles a junction, %d targets\n",
+		messages, vehicles, targets);
+
+	kafka_sink parsed_sink;
+	auto t0 = chrono::steady_clock::now();
+	double c0 = cpu_seconds();
+	for (int i = 0; i < messages; i++) {
+		send_parsed(parsed_sink, recorded[i % recorded.size()]);
+	}
+	double parsed_cpu = cpu_seconds() - c0;
+	double parsed_s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+
+	kafka_sink forward_sink;
+	kafka_batch batch;
+	t0 = chrono::steady_clock::now();
+	c0 = cpu_seconds();
+	for (int i = 0; i < messages; i++) {
+		send_forward(forward_sink, batch, recorded[i % recorded.size()]);
+	}
+	double forward_cpu = cpu_seconds() - c0;
+	double forward_s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+
+	printf("parse   : %10.0f msg/s, %6.3f us cpu/msg, %lu bytes\n",
+		parsed_sink.messages / parsed_s,
+		parsed_cpu * 1e6 / parsed_sink.messages, parsed_sink.bytes);
+	printf("forward : %10.0f msg/s, %6.3f us cpu/msg, %lu bytes\n",
+		forward_sink.messages / forward_s,
+		forward_cpu * 1e6 / forward_sink.messages, forward_sink.bytes);
+	bool same = (parsed_sink.messages == forward_sink.messages)
+		&& (parsed_sink.bytes == forward_sink.bytes);
+	for (int i = 0; i < 4; i++) {
+		same = same && (parsed_sink.last[i] == forward_sink.last[i]);
+	}
+	printf("speedup %.2fx, same payloads: %s\n",
+		parsed_s / forward_s, same ? "yes" : "NO");
+	return same ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/** @file rabbitmq-outbound-bench.cpp
+ * benchmark: the time the event loop spends publishing to a slow
+ * peer, a blocking write of every message against the push into the
+ * rabbitmq_outbound drained by a publisher thread
+ *
+ * the peer is a socketpair read at a limited rate, as a broker that
+ * does not keep up with the snapshots
+ *
+ * rabbitmq-outbound-bench [messages] [message size] [peer KB/s] [capacity]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "utils/rabbitmq-outbound.h"
+
+using namespace std;
+using namespace zas::utils;
+
+#define PEER_CHUNK (4096)
+
+struct slow_peer
+{
+	int fd;
+	size_t rate;
+	atomic<bool> running;
+	atomic<size_t> received;
+	std::thread thd;
+
+	slow_peer(int sock, size_t bps) : fd(sock), rate(bps)
+	, running(true), received(0) {
+		thd = std::thread([this] { run(); });
+	}
+
+	void run(void) {
+		char buf[PEER_CHUNK];
+		auto start = chrono::steady_clock::now();
+		while (running) {
+			ssize_t ret = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+			if (ret > 0) received += ret;
+			// read no faster than the rate
+			double due = (double)received / rate;
+			double now = chrono::duration<double>(
+				chrono::steady_clock::now() - start).count();
+			if (due > now || ret <= 0) usleep(200);
+		}
+	}
+
+	void stop(void) {
+		running = false;
+		thd.join();
+	}
+};
+
+struct loop_stats
+{
+	double total_s;
+	double max_s;
+};
+
+static void timed(loop_stats &st, chrono::steady_clock::time_point t0)
+{
+	double s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	st.total_s += s;
+	if (s > st.max_s) st.max_s = s;
+}
+
+// snapshot_rabbitmq::publishing before the outbound queue
+static loop_stats publish_direct(int fd, const string &msg, int messages)
+{
+	loop_stats st = {0., 0.};
+	for (int i = 0; i < messages; i++) {
+		auto t0 = chrono::steady_clock::now();
+		size_t off = 0;
+		while (off < msg.length()) {
+			ssize_t ret = send(fd, msg.data() + off, msg.length() - off, 0);
+			if (ret <= 0) break;
+			off += ret;
+		}
+		timed(st, t0);
+	}
+	return st;
+}
+
+// push on the event loop, written in batches by the publisher thread
+static loop_stats publish_outbound(int fd, const string &msg, int messages,
+	size_t capacity, rabbitmq_outbound_stats &ostats)
+{
+	rabbitmq_outbound outbound(capacity, rabbitmq_drop_oldest, 0);
+	std::thread publisher([&] {
+		vector<rabbitmq_message*> batch;
+		vector<iovec> iov;
+		rabbitmq_confirms confirms;
+		uint64_t tag = 1;
+		while (!outbound.stopped() || outbound.depth()) {
+			if (!outbound.pop(batch, 256, 100)) continue;
+			iov.clear();
+			for (auto* m : batch) {
+				iovec v = { (void*)m->body.data(), m->body.length() };
+				iov.push_back(v);
+			}
+			// the batch is written with one call when the socket has room
+			size_t i = 0;
+			while (i < iov.size()) {
+				ssize_t ret = writev(fd, &iov[i], iov.size() - i);
+				if (ret <= 0) break;
+				while (i < iov.size() && (size_t)ret >= iov[i].iov_len) {
+					ret -= iov[i++].iov_len;
+				}
+				if (i < iov.size()) {
+					iov[i].iov_base = (char*)iov[i].iov_base + ret;
+					iov[i].iov_len -= ret;
+				}
+			}
+			// the peer acks the whole batch with one multiple confirm
+			outbound.on_published(batch.size());
+			confirms.reset(tag, batch.size());
+			tag += batch.size();
+			confirms.confirm(tag - 1, true, false);
+			outbound.settle(batch, confirms);
+		}
+	});
+	loop_stats st = {0., 0.};
+	string rkey = "vehicle_edge_detail_LSVAU2180N2183294";
+	for (int i = 0; i < messages; i++) {
+		auto t0 = chrono::steady_clock::now();
+		outbound.push("vehicle_edge_information", rkey,
+			msg.data(), msg.length());
+		timed(st, t0);
+	}
+	outbound.get_stats(ostats);
+	outbound.stop();
+	publisher.join();
+	return st;
+}
+
+int main(int argc, char* argv[])
+{
+	int messages = (argc > 1) ? atoi(argv[1]) : 20000;
+	size_t msgsz = (argc > 2) ? atoi(argv[2]) : 512;
+	size_t rate = ((argc > 3) ? atoi(argv[3]) : 4096) * 1024;
+	size_t capacity = (argc > 4) ? atoi(argv[4]) : 4096;
+	string msg(msgsz, 'x');
+	printf("%d messages of %lu bytes, peer %lu KB/s, capacity %lu\n",
+		messages, msgsz, rate / 1024, capacity);
+
+	int sv[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	int sndbuf = 64 * 1024;
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+	slow_peer peer(sv[1], rate);
+	auto direct = publish_direct(sv[0], msg, messages);
+	peer.stop();
+	close(sv[0]); close(sv[1]);
+
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+	slow_peer opeer(sv[1], rate);
+	rabbitmq_outbound_stats ostats;
+	auto queued = publish_outbound(sv[0], msg, messages, capacity, ostats);
+	opeer.stop();
+	close(sv[0]); close(sv[1]);
+
+	printf("direct   : %8.3f us/msg on the loop, max stall %8.3f ms\n",
+		direct.total_s * 1e6 / messages, direct.max_s * 1e3);
+	printf("outbound : %8.3f us/msg on the loop, max stall %8.3f ms, "
+		"dropped %lu, depth %lu\n",
+		queued.total_s * 1e6 / messages, queued.max_s * 1e3,
+		ostats.dropped, ostats.depth);
+	return 0;
+}
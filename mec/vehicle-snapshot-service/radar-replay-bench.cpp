@@ -0,0 +1,213 @@
+/** @file radar-replay-bench.cpp
+ * benchmark: replay of junction packages through the device snapshot
+ * hot path, parse + history + fusion package, the per message copies
+ * against the radar_batch arena and the forwarded record bytes
+ *
+ * radar-replay-bench [packages] [devices] [targets] [vehicles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "inc/history-ring.h"
+#include "inc/radar-batch.h"
+#include "proto/junction_package.pb.h"
+#include "proto/junction_fusion_package.pb.h"
+
+using namespace std;
+using namespace zas::vehicle_snapshot_service;
+
+static size_t alloc_count = 0;
+
+void* operator new(size_t sz)
+{
+	alloc_count++;
+	void* p = malloc(sz ? sz : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+struct replay_ctx
+{
+	vector<history_ring<jos::radar_vision_info>*> devices;
+	int vehicles;
+	size_t bytes;
+	string last;
+
+	replay_ctx(int devcnt, int vehcnt) : vehicles(vehcnt), bytes(0) {
+		for (int i = 0; i < devcnt; i++) {
+			devices.push_back(new history_ring<jos::radar_vision_info>());
+		}
+	}
+};
+
+// generate_veh_frame of device_snapshot
+static void add_vehicles(replay_ctx &ctx, jos::junction_fusion_package &pkg,
+	uint64_t endtime)
+{
+	static const string vincode = "LSVAU2180N2183294";
+	for (int i = 0; i < ctx.vehicles; i++) {
+		auto* vehi = pkg.add_vehicles();
+		vehi->set_id(vincode);
+		vehi->set_timestamp(endtime - i);
+		vehi->set_lat(31.0 + i * 1e-5);
+		vehi->set_lon(121.0 + i * 1e-5);
+		vehi->set_heading(90.0f);
+		vehi->set_speed(10.0f);
+	}
+}
+
+// update_snapshot as it was before the radar_batch
+static void replay_copy(replay_ctx &ctx, const string &data, uint64_t recv)
+{
+	jos::junction_package junpkg;
+	junpkg.ParseFromArray(data.c_str(), data.length());
+	for (int i = 0; i < junpkg.radar_info_size(); i++) {
+		auto* rinfo = junpkg.mutable_radar_info(i);
+		auto* timeinfo = rinfo->mutable_timeinfo();
+		timeinfo->set_erecv_timestamp_sec(recv / 1000);
+		timeinfo->set_erecv_timestamp_usec(recv % 1000 * 1000);
+		auto* dev = ctx.devices[i];
+		*dev->prepare() = *rinfo;
+		dev->commit();
+
+		jos::junction_fusion_package junc_fusion_pkg;
+		auto* junc_pkg = junc_fusion_pkg.mutable_jun_pkg();
+		auto* rainfo = junc_pkg->add_radar_info();
+		*rainfo = *dev->latest();
+		add_vehicles(ctx, junc_fusion_pkg, rinfo->timestamp());
+		junc_fusion_pkg.set_fusion_endtime(rinfo->timestamp());
+		std::string senddata;
+		junc_fusion_pkg.SerializeToString(&senddata);
+		ctx.bytes += senddata.length();
+		ctx.last = senddata;
+	}
+}
+
+struct batch_ctx
+{
+	radar_batch batch;
+	jos::junction_fusion_package head;
+	string data;
+};
+
+// update_snapshot with the radar_batch
+static void replay_batch(replay_ctx &ctx, batch_ctx &bctx,
+	const string &data, uint64_t recv)
+{
+	if (bctx.batch.parse(data.c_str(), data.length())) {
+		return;
+	}
+	for (size_t i = 0; i < bctx.batch.size(); i++) {
+		auto& rec = bctx.batch.record(i);
+		auto* timeinfo = rec.info->mutable_timeinfo();
+		timeinfo->set_erecv_timestamp_sec(recv / 1000);
+		timeinfo->set_erecv_timestamp_usec(recv % 1000 * 1000);
+		auto* dev = ctx.devices[i];
+		*dev->prepare() = *rec.info;
+		dev->commit();
+
+		bctx.head.Clear();
+		add_vehicles(ctx, bctx.head, rec.info->timestamp());
+		bctx.head.set_fusion_endtime(rec.info->timestamp());
+		encode_fusion_package(bctx.head, rec, bctx.data);
+		ctx.bytes += bctx.data.length();
+	}
+	ctx.last = bctx.data;
+}
+
+static bool same_package(const string &a, const string &b)
+{
+	jos::junction_fusion_package pa, pb;
+	if (!pa.ParseFromString(a) || !pb.ParseFromString(b)) {
+		return false;
+	}
+	return pa.SerializeAsString() == pb.SerializeAsString();
+}
+
+int main(int argc, char* argv[])
+{
+	int packages = (argc > 1) ? atoi(argv[1]) : 20000;
+	int devices = (argc > 2) ? atoi(argv[2]) : 4;
+	int targets = (argc > 3) ? atoi(argv[3]) : 30;
+	int vehicles = (argc > 4) ? atoi(argv[4]) : 4;
+
+	// 100 packages of a junction, replayed
+	vector<string> recorded;
+	for (int p = 0; p < 100; p++) {
+		jos::junction_package junpkg;
+		for (int d = 0; d < devices; d++) {
+			auto* info = junpkg.add_radar_info();
+			info->set_type(1);
+			info->set_id(1000 + d);
+			info->set_timestamp(1700000000000ULL + p * 100 + d);
+			info->set_lon(121.0 + d * 1e-4);
+			info->set_lat(31.0 + d * 1e-4);
+			info->set_rdir(90.0f);
+			info->mutable_timeinfo()->set_timestamp_sec(1700000000);
+			info->mutable_timeinfo()->set_erecv_timestamp_sec(7);
+			for (int i = 0; i < targets; i++) {
+				auto* tgt = info->add_targets();
+				tgt->set_id(i);
+				tgt->set_type(1);
+				tgt->set_lon(121.0 + i * 1e-5);
+				tgt->set_lat(31.0 + i * 1e-5);
+				tgt->set_heading(45.0f);
+				tgt->set_length(4.5f);
+				tgt->set_width(1.8f);
+				tgt->set_speed(10.0f);
+			}
+		}
+		recorded.push_back(junpkg.SerializeAsString());
+	}
+	const uint64_t recv = 1700000001234ULL;
+	size_t records = (size_t)packages * devices;
+	printf("%d packages of %d devices, %d targets, %d vehicles\n",
+		packages, devices, targets, vehicles);
+
+	replay_ctx copy_ctx(devices, vehicles);
+	for (auto& data : recorded) replay_copy(copy_ctx, data, recv);
+	size_t allocs = alloc_count;
+	auto t0 = chrono::steady_clock::now();
+	for (int p = 0; p < packages; p++) {
+		replay_copy(copy_ctx, recorded[p % recorded.size()], recv);
+	}
+	double copy_s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	size_t copy_allocs = alloc_count - allocs;
+
+	replay_ctx batch_ctx_(devices, vehicles);
+	batch_ctx bctx;
+	for (auto& data : recorded) replay_batch(batch_ctx_, bctx, data, recv);
+	allocs = alloc_count;
+	t0 = chrono::steady_clock::now();
+	for (int p = 0; p < packages; p++) {
+		replay_batch(batch_ctx_, bctx, recorded[p % recorded.size()], recv);
+	}
+	double batch_s = chrono::duration<double>(
+		chrono::steady_clock::now() - t0).count();
+	size_t batch_allocs = alloc_count - allocs;
+
+	printf("copy   : %10.0f records/s, %6.2f allocs/record, %lu bytes\n",
+		records / copy_s, (double)copy_allocs / records, copy_ctx.bytes);
+	printf("batch  : %10.0f records/s, %6.2f allocs/record, %lu bytes\n",
+		records / batch_s, (double)batch_allocs / records, batch_ctx_.bytes);
+	bool same = same_package(copy_ctx.last, batch_ctx_.last);
+	printf("speedup %.2fx, same fusion package: %s\n",
+		copy_s / batch_s, same ? "yes" : "NO");
+	return same ? 0 : 1;
+}
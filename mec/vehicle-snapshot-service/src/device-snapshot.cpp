@@ -50,6 +50,7 @@ device_snapshot::device_snapshot()
 , _hdmap(nullptr)
 , _proj(nullptr)
 , _kafka_consumer(nullptr)
+, _history_depth(HISTORY_RING_DEFAULT_DEPTH)
 {
 	listnode_init(_device_junction_list);
 }
@@ -103,6 +104,11 @@ int device_snapshot::init(void)
 	}
 	_f.init_device_ss = 1;
 
+	// packages kept for each device and junction
+	ssize_t depth = get_sysconfig("snapshot-service.history-depth",
+		(ssize_t)HISTORY_RING_DEFAULT_DEPTH);
+	_history_depth = (depth > 0) ? depth : HISTORY_RING_DEFAULT_DEPTH;
+
 	if (!_hdmap) {
 		_hdmap = new rendermap();
 		assert(nullptr != _hdmap);
@@ -145,9 +151,15 @@ int device_snapshot::on_request_reply(device_wa_request* wa_req,
 	if (!jitem) {
 		return -ENOTFOUND;
 	}
-	int index = jitem->index;
-	jitem->info[index].Clear();
-	jitem->info[index] = fustgt;
+	// a zero timestamp is the "no new result" reply of the fusion
+	// service, a known timestamp is a result already delivered
+	auto* last = jitem->info.latest();
+	if (!fustgt.timestamp()
+		|| (last && last->timestamp() == fustgt.timestamp())) {
+		return 0;
+	}
+	auto* curr = jitem->info.prepare();
+	*curr = fustgt;
 	//add fusion service data to junciton
 	timeval tv;
 	gettimeofday(&tv, nullptr);
@@ -156,14 +168,14 @@ int device_snapshot::on_request_reply(device_wa_request* wa_req,
 	gettimeofday(&tv, nullptr);
 	uint64_t end_tm = tv.tv_sec * 1000 + tv.tv_usec / 1000;
 	if (end_tm - start_tm > 5) {
-		printf("++++++++[%d]use[%d] time %lu\n", jitem->info[jitem->index].targets_size() , fpkg.fus_pkg().targets_size(), end_tm - start_tm);
+		printf("++++++++[%d]use[%d] time %lu\n", curr->targets_size() , fpkg.fus_pkg().targets_size(), end_tm - start_tm);
 	}
 	if (end_tm - fustgt.timestamp() > 3000) {
 		printf("++++++++recv fusion %lu \n", end_tm - fustgt.timestamp());
 	}
-	jitem->index = (jitem->index + 1) % DEVICE_SNAPSHOT_CACHER;
+	jitem->info.commit();
 	send_junciton_to_vehicle(jitem);
-	send_subscribe_junction_info(jitem, jitem->info[index]);
+	send_subscribe_junction_info(jitem, *curr);
 	send_junction_to_kafka(jitem);
 	return 0;
 }
@@ -172,8 +184,10 @@ int device_snapshot::on_request_reply(device_wa_request* wa_req,
 int device_snapshot::send_junciton_to_vehicle(device_junction_item* jitem)
 {
 	assert(nullptr != jitem);
-	int currindex = (jitem->index + DEVICE_SNAPSHOT_CACHER -1) % DEVICE_SNAPSHOT_CACHER;
-	auto* item = &(jitem->info[currindex]);
+	auto* item = jitem->info.latest();
+	if (!item) {
+		return -ENOTAVAIL;
+	}
 	distribute_package dspkg;
 	dspkg.set_timestamp(item->timestamp());
 	auto* jun_info = dspkg.add_junctions();
@@ -225,10 +239,10 @@ int device_snapshot::send_subscribe_junction_info(device_junction_item* jitem,
 			}
 			auto* dev_info = junpkg.add_devices();
 			dev_info->set_device_id(info->dev_id);
-			int currid = (info->index + DEVICE_SNAPSHOT_CACHER - 1) % DEVICE_SNAPSHOT_CACHER;
-			dev_info->set_lat(info->info[currid].lat());
-			dev_info->set_lon(info->info[currid].lon());
-			dev_info->set_hdg(info->info[currid].rdir());
+			auto* latest = info->info.latest();
+			dev_info->set_lat(latest->lat());
+			dev_info->set_lon(latest->lon());
+			dev_info->set_hdg(latest->rdir());
 		}
 		size_t ftg_sz = fpkg.targets_size();
 		for (int i = 0; i < ftg_sz; i++) {
@@ -252,7 +266,7 @@ device_snapshot::check_create_junction_item(std::string &uid)
 		item = new device_junction_item();
 		assert(nullptr != item);
 		item->jun_info.id = uid;
-		item->index = 0;
+		item->info.set_capacity(_history_depth);
 		item->device_tree = nullptr;
 		item->jun_info.lat = 0.0;
 		item->jun_info.lon = 0.0;
@@ -310,7 +324,7 @@ device_snapshot::check_create_device_item(device_junction_item *item,
 	if (!info) {
 		info = new device_info();
 		info->dev_id = uid;
-		info->index = 0;
+		info->info.set_capacity(_history_depth);
 		info->inited = true;
 		if(avl_insert(&item->device_tree, &info->avlnode,
 			device_info::device_avl_compare)) {
@@ -331,15 +345,12 @@ int device_snapshot::add_device_info(device_info* device,
 	if (device->inited) {
 		device->inited = false;
 	} else {
-		uint32_t currid = (device->index
-			+ DEVICE_SNAPSHOT_CACHER -1) % DEVICE_SNAPSHOT_CACHER;
-		if (info.timestamp() <= device->info[currid].timestamp()) {
+		if (info.timestamp() <= device->info.latest()->timestamp()) {
 			return -EEXISTS;
 		}
 	}
-	device->info[device->index].Clear();
-	device->info[device->index] = info;
-	device->index = (device->index + 1) % DEVICE_SNAPSHOT_CACHER;
+	*device->info.prepare() = info;
+	device->info.commit();
 	return 0;
 }
 
@@ -701,11 +712,16 @@ int device_snapshot::update_snapshot(std::string &vincode, uri &info, void* data
 	if (times - starttime > 2000) {
 		printf("snapshot recv date time is %lu\n", times - starttime);
 	}
-	junction_package junpkg;
-	junpkg.ParseFromArray(data, sz);
-	int count = junpkg.radar_info_size();
+	int ret = _radar_batch.parse(data, sz);
+	if (ret) {
+		log.e(SNAPSHOT_SNAPSHOT_TAG,
+			"snapshot junction package error\n");
+		return ret;
+	}
+	int count = _radar_batch.size();
 	for (int i = 0; i < count; i ++) {
-		auto* rinfo = junpkg.mutable_radar_info(i);
+		auto& rec = _radar_batch.record(i);
+		auto* rinfo = rec.info;
 		auto* timeinfo = rinfo->mutable_timeinfo();
 		timeinfo->set_erecv_timestamp_sec(starttime / 1000);
 		timeinfo->set_erecv_timestamp_usec((starttime % 1000 * 1000));
@@ -721,7 +737,7 @@ int device_snapshot::update_snapshot(std::string &vincode, uri &info, void* data
 		}
 		send_subscribe_device_info(*rinfo);
 
-		update_fusion_data(item, info);
+		update_fusion_data(item, rec);
 	}
 	return 0;
 }
@@ -834,7 +850,7 @@ int device_snapshot::generate_veh_frame(device_junction_item *item,
 		if (vitem->index >= VEHICLE_SNAPSHOT_HISTORY_MAX) {
 			continue;
 		}
-		auto vspkg = vitem->snapshot[vitem->index].package();
+		const auto& vspkg = vitem->snapshot[vitem->index].package();
 		uint64_t timestamp = vspkg.timestamp_sec() * 1000
 			+ vspkg.timestamp_usec() / 1000;
 		if (timestamp < endtime - 100) {
@@ -855,7 +871,7 @@ int device_snapshot::generate_veh_frame(device_junction_item *item,
 		for (; start != vitem->index;
 			start = (start + VEHICLE_SNAPSHOT_HISTORY_MAX - 1)
 			% VEHICLE_SNAPSHOT_HISTORY_MAX) {
-			auto tpkg = vitem->snapshot[start].package();
+			const auto& tpkg = vitem->snapshot[start].package();
 			timestamp = tpkg.timestamp_sec() * 1000
 			+ tpkg.timestamp_usec() / 1000;
 			if (timestamp <= endtime && timestamp > (endtime - 100)) {
@@ -878,7 +894,7 @@ int device_snapshot::generate_veh_frame(device_junction_item *item,
 		if (vitem->index >= VEHICLE_SNAPSHOT_HISTORY_MAX) {
 			continue;
 		}
-		auto vspkg = vitem->snapshot[vitem->index].package();
+		const auto& vspkg = vitem->snapshot[vitem->index].package();
 		uint64_t timestamp = vspkg.timestamp_sec() * 1000
 			+ vspkg.timestamp_usec() / 1000;
 		if (timestamp < endtime - 100) {
@@ -899,7 +915,7 @@ int device_snapshot::generate_veh_frame(device_junction_item *item,
 		for (; start != vitem->index;
 			start = (start + VEHICLE_SNAPSHOT_HISTORY_MAX - 1)
 			% VEHICLE_SNAPSHOT_HISTORY_MAX) {
-			auto tpkg = vitem->snapshot[start].package();
+			const auto& tpkg = vitem->snapshot[start].package();
 			timestamp = tpkg.timestamp_sec() * 1000
 			+ tpkg.timestamp_usec() / 1000;
 			if (timestamp <= endtime && timestamp > (endtime - 100)) {
@@ -920,10 +936,10 @@ static int snapshot_handle_cnt = 0;
 static uint64_t tmptime1 = 0;
 
 int device_snapshot::update_fusion_data(device_junction_item *item,
-	device_info* radar_info)
+	const radar_record &rec)
 {
 	assert (nullptr != item);
-	assert (nullptr != radar_info);
+	assert (nullptr != rec.info);
 
 	if (snapshot_handle_cnt < 10000) {
 		if (0 == snapshot_handle_cnt) {
@@ -951,20 +967,18 @@ int device_snapshot::update_fusion_data(device_junction_item *item,
 	}
 
 
-	uint32_t currid = (radar_info->index
-		+ DEVICE_SNAPSHOT_CACHER - 1) % DEVICE_SNAPSHOT_CACHER;
-	uint64_t endtime = radar_info->info[currid].timestamp();
+	uint64_t endtime = rec.info->timestamp();
 
-	junction_fusion_package junc_fusion_pkg;
-	auto* junc_pkg = junc_fusion_pkg.mutable_jun_pkg();
-	auto* rainfo = junc_pkg->add_radar_info();
-	*rainfo = radar_info->info[currid];
-	generate_veh_frame(item, junc_fusion_pkg, endtime);
-	junc_fusion_pkg.set_fusion_endtime(endtime);
-	std::string senddata;
-	junc_fusion_pkg.SerializeToString(&senddata);
+	// the radar record is forwarded as received
+	_fusion_head.Clear();
+	generate_veh_frame(item, _fusion_head, endtime);
+	_fusion_head.set_fusion_endtime(endtime);
+	int ret = encode_fusion_package(_fusion_head, rec, _fusion_data);
+	if (ret) {
+		return ret;
+	}
 	send_to_fusion_service(item->jun_info.id,
-		(const uint8_t*)senddata.c_str(), senddata.length());
+		(const uint8_t*)_fusion_data.c_str(), _fusion_data.length());
 	return 0;
 }
 
@@ -1031,12 +1045,14 @@ int device_snapshot::get_traffice_info(vehicle_snapshot_item* item,
 		std::string junid = std::to_string(item.junction->getid());
 		auto* jucitem = find_junction(junid);
 		if (!jucitem) { continue;}
+		auto* latest = jucitem->info.latest();
+		if (!latest) { continue;}
 		auto* jpkg = dist_pkg.add_junctions();
 		jpkg->set_junction_id(jucitem->jun_info.id);
-		size_t sz = jucitem->info[jucitem->index - 1].targets_size();
+		size_t sz = latest->targets_size();
 		for (size_t i = 0; i < sz; i++) {
 			auto* tget = jpkg->add_targets();
-			*tget = jucitem->info[jucitem->index - 1].targets(i);
+			*tget = latest->targets(i);
 		}
 	}
 	
@@ -1148,43 +1164,47 @@ int device_snapshot::send_junction_to_kafka(device_junction_item* item)
 	jos_data->set_junction_id(item->jun_info.id);
 	jos_data->set_lat(item->jun_info.lat);
 	jos_data->set_lon(item->jun_info.lon);
-	int index = (item->index + DEVICE_SNAPSHOT_CACHER - 1)
-		% DEVICE_SNAPSHOT_CACHER;
+	auto* fpkg = item->info.latest();
+	if (!fpkg) {
+		return -ENOTAVAIL;
+	}
 
-	jos_data->set_timestamp(item->info[index].timestamp());
+	jos_data->set_timestamp(fpkg->timestamp());
 	auto* timeinfo = jos_data->mutable_timeinfo();
-	*timeinfo = item->info[index].timeinfo();
+	*timeinfo = fpkg->timeinfo();
 	timeval tv;
 	gettimeofday(&tv, nullptr);
 	timeinfo->set_esend_timestamp_sec(tv.tv_sec);
 	timeinfo->set_esend_timestamp_usec(tv.tv_usec);
 	int64_t timestamp = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-	size_t fsz = item->info[index].targets_size();
+	size_t fsz = fpkg->targets_size();
 	for (size_t i = 0; i < fsz; i++) {
 		auto* fusiontgt = jos_data->add_targets();
-		*fusiontgt = item->info[index].targets(i);
+		*fusiontgt = fpkg->targets(i);
 	}
 
 	auto* dnd = item->device_list.next;
 	for (; dnd != &item->device_list; dnd = dnd->next) {
 		auto* info = LIST_ENTRY(device_info, ownerlist, dnd);
 		assert(nullptr != info);
+		auto* radar = info->info.latest();
+		if (!radar) {
+			continue;
+		}
 		auto* dev_info = jos_data->add_devices();
-		int windex = (info->index + DEVICE_SNAPSHOT_CACHER - 1)
-			% DEVICE_SNAPSHOT_CACHER;
-		dev_info->set_type(info->info[windex].type());
-		dev_info->set_id(std::to_string(info->info[windex].id()));
-		dev_info->set_lon(info->info[windex].lon());
-		dev_info->set_lat(info->info[windex].lat());
-		dev_info->set_rdir(info->info[windex].rdir());
+		dev_info->set_type(radar->type());
+		dev_info->set_id(std::to_string(radar->id()));
+		dev_info->set_lon(radar->lon());
+		dev_info->set_lat(radar->lat());
+		dev_info->set_rdir(radar->rdir());
 		auto* tinfo = dev_info->mutable_timeinfo();
 		*tinfo = *timeinfo;
-		dev_info->set_timestamp(item->info[index].timestamp());
+		dev_info->set_timestamp(fpkg->timestamp());
 		
-		size_t tsz = info->info[windex].targets_size();
+		size_t tsz = radar->targets_size();
 		for (size_t i = 0; i < tsz; i++) {
 			auto* tgobj = dev_info->add_targets();
-			*tgobj = info->info[windex].targets(i);
+			*tgobj = radar->targets(i);
 		}
 	}
 
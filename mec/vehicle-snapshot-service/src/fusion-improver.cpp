@@ -126,7 +126,7 @@ int fusion_improver::improve_fusion_target_to_junction(
 {
 	assert(nullptr != item);
 	auto fpkg = pkg.fus_pkg();
-	item->info[item->index].clear_targets();
+	item->info.pending()->clear_targets();
 #ifdef IMAGE_DEBUG
 	std::map<int, spVehicleState> orign_v;
 	std::map<int, spVehicleState> tran_v;
@@ -180,12 +180,12 @@ int fusion_improver::improve_fusion_target_to_junction(
 	junction_process(dtime);
 	missing_process(dtime);
 	check_set_status_result();
-	set_targets(&item->info[item->index]);
+	set_targets(item->info.pending());
 
 #ifdef IMAGE_DEBUG
 	if (_frame_count >0) {
-	for (int i = 0 ; i < item->info[item->index].targets_size(); i++) {
-		auto& tgt = item->info[item->index].targets(i);
+	for (int i = 0 ; i < item->info.pending()->targets_size(); i++) {
+		auto& tgt = item->info.pending()->targets(i);
 		VehicleObs tvf(&tgt);
 		spVehicleState tvsf= std::make_shared<VehicleState>();
 		tvsf->Init(tvf);
@@ -0,0 +1,63 @@
+#include "kafka-batch.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+kafka_batch::kafka_batch()
+{
+}
+
+kafka_batch::~kafka_batch()
+{
+	_records.clear();
+}
+
+int kafka_batch::parse(const void* data, size_t sz)
+{
+	reset();
+	if (!data) {
+		return -EBADPARM;
+	}
+
+	// every field of center_kafka_data is a repeated message
+	const char* buf = (const char*)data;
+	CodedInputStream in((const uint8_t*)buf, sz);
+	for (uint32_t tag = in.ReadTag(); tag; tag = in.ReadTag()) {
+		if (WireFormatLite::GetTagWireType(tag)
+			!= WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+			if (!WireFormatLite::SkipField(&in, tag)) {
+				reset();
+				return -EBADPARM;
+			}
+			continue;
+		}
+		uint32_t len = 0;
+		if (!in.ReadVarint32(&len)) {
+			reset();
+			return -EBADPARM;
+		}
+		size_t pos = in.CurrentPosition();
+		if (len > sz - pos) {
+			reset();
+			return -EBADPARM;
+		}
+		kafka_record rec;
+		rec.field = WireFormatLite::GetTagFieldNumber(tag);
+		rec.data = buf + pos;
+		rec.sz = len;
+		_records.push_back(rec);
+		in.Skip(len);
+	}
+	if ((size_t)in.CurrentPosition() != sz) {
+		reset();
+		return -EBADPARM;
+	}
+	return 0;
+}
+
+}}	//zas::vehicle_snapshot_service
@@ -9,6 +9,7 @@
 #include "utils/uri.h"
 #include <sys/time.h>
 #include "librdkafka/rdkafkacpp.h"
+#include "utils/thread.h"
 
 namespace zas {
 namespace vehicle_snapshot_service {
@@ -38,11 +39,41 @@ class kafka_delivery_report : public RdKafka::DeliveryReportCb {
 	}
 };
 
+class kafka_poll_thread : public thread
+{
+public:
+	kafka_poll_thread(RdKafka::Producer* producer)
+	: thread("kafka-poll")
+	, _producer(producer)
+	, _running(true) {
+	}
+
+	int run(void) {
+		while (_running) {
+			_producer->poll(KAFKA_POLL_TIMEOUT_MS);
+		}
+		return 0;
+	}
+
+	void stop(void) {
+		_running = false;
+	}
+
+private:
+	RdKafka::Producer* _producer;
+	volatile bool _running;
+};
+
 vss_kafka_sender::vss_kafka_sender()
 : _inited(false)
 , _port(0)
 , _producer(nullptr)
+, _junction_rktopic(nullptr)
+, _vehicle_rktopic(nullptr)
+, _count_rktopic(nullptr)
 , _delivery_cb(nullptr)
+, _poll_thread(nullptr)
+, _queue_full_drops(0)
 {
 	_junciton_topic = "junctioninformation";
 	_vehicle_topic = "vehicleinformation";
@@ -53,6 +84,12 @@ vss_kafka_sender::vss_kafka_sender()
 
 vss_kafka_sender::~vss_kafka_sender()
 {
+	if (_poll_thread) {
+		_poll_thread->stop();
+		_poll_thread->join();
+		_poll_thread->release();
+		_poll_thread = nullptr;
+	}
 	if (_producer) {
 		log.d(SNAPSHOT_SNAPSHOT_TAG,
 			"flushing final messages...\n");
@@ -62,140 +99,59 @@ vss_kafka_sender::~vss_kafka_sender()
 			"%d message(s) were not delivered\n",
 			_producer->outq_len());
 		}
+	}
+	if (_junction_rktopic) {
+		delete _junction_rktopic;
+		_junction_rktopic = nullptr;
+	}
+	if (_vehicle_rktopic) {
+		delete _vehicle_rktopic;
+		_vehicle_rktopic = nullptr;
+	}
+	if (_count_rktopic) {
+		delete _count_rktopic;
+		_count_rktopic = nullptr;
+	}
+	if (_producer) {
 		delete _producer;
 		_producer = nullptr;
 	}
+	if (_delivery_cb) {
+		delete _delivery_cb;
+		_delivery_cb = nullptr;
+	}
 }
 
 static int kafka_handle_cnt = 0;
 static uint64_t tmpusetime1 = 0;
 int vss_kafka_sender::on_kafka_data_send(const char* data, size_t sz)
 {
-	center_kafka_data kafka_data;
-	kafka_data.ParseFromArray(data, sz);
-	size_t jos_sz = kafka_data.junction_size();
-	size_t vss_sz = kafka_data.snapshot_size();
-	size_t cnt_sz = kafka_data.count_size();
-	for (size_t i = 0; i < vss_sz; i++) {
-		auto vss_snapshot = kafka_data.snapshot(i);
-		// auto vss_item = vss_snapshot.package();
-		// timeval tv;
-		// tv.tv_sec = vss_item.timestamp_sec();
-		// tv.tv_usec = vss_item.timestamp_usec();
-		// tm t;
-		// localtime_r(&tv.tv_sec, &t);
-		// printf("data time %d/%02d/%02d %02d:%02d:%02d:%06ld\n",
-		// 	t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		// 	t.tm_hour, t.tm_min, t.tm_sec,
-		// 	tv.tv_usec);
-		// printf("snapshot distance %f m, speed %f km/h\n",
-		// 	vss_item.distance(), vss_item.vehicle_speed());
-		// printf("snapshot gps latitude %.8f, longtitude %.8f, heading %f\n",
-		// 	vss_item.gpsinfo().latitude(),
-		// 	vss_item.gpsinfo().longtitude(), 
-		// 	vss_item.gpsinfo().heading());
-		// printf("snapshot acc_pedal_pos  %f, brake_pedal %f, steering_wheel %f\n",
-		// 	vss_item.acc_pedal_pos_percentage(),
-		// 	vss_item.brake_pedal_pos_percentage(),
-		// 	vss_item.steering_wheel_angle()
-		// 	);
-		// printf("snapshot vehicle_state %d, flags %d, shift_lever_position %d\n",
-		// 	vss_item.vehicle_state(),
-		// 	vss_item.flags(),
-		// 	vss_item.shift_lever_position()
-		// 	);
-		std::string veh_data;
-		vss_snapshot.SerializeToString(&veh_data);
-		send_kafka_to_center(_vehicle_topic, 
-			(void*)veh_data.c_str(), veh_data.length());
-	}
-	timeval tv;
-	gettimeofday(&tv, nullptr);
-	uint64_t times = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-
-	for (size_t i = 0; i < jos_sz; i++) {
-		auto* jos_item = kafka_data.mutable_junction(i);
-		// printf("[%ld] junciton id %s, time %lu, target sz %d, lat %lf, lon %lf\n",
-		// 	times - jos_item->timestamp(),
-		// 	jos_item->junction_id().c_str(), jos_item->timestamp(), jos_item->targets_size(),
-		// 	jos_item->lat(),
-		// 	jos_item->lon());
-
-		// for (size_t j = 0; j < jos_item->targets_size(); j++) {
-		// 	auto target_item = jos_item->targets(j);
-		// 	printf("target id [%d], lat %lf, lon %lf, heading %f, speed %f\n",
-		// 		target_item.id(), target_item.lat(), target_item.lon(),
-		// 		target_item.hdg(), target_item.speed());
-		// }
-
-		// for (size_t j = 0; j < jos_item->devices_size(); j++) {
-		// 	auto target_item = jos_item->devices(j);
-		// 	printf("[%ld] junciton target %s, time %lu\n",
-		// 		times -jos_item->timestamp(),
-		// 		target_item.id().c_str(), target_item.timestamp());
-		// }
-		auto* timeinfo = jos_item->mutable_timeinfo();
-
-		// 时间延时设置，移动到snapshot接收到融合后数据位置
-		// timeval tv;
-		// gettimeofday(&tv, nullptr);
-		// timeinfo->set_esend_timestamp_sec(tv.tv_sec);
-		// timeinfo->set_esend_timestamp_usec(tv.tv_usec);
-		// tm t;
-		// localtime_r(&tv.tv_sec, &t);
-		// printf("send data time %d/%02d/%02d %02d:%02d:%02d:%06ld\n",
-		// 	t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		// 	t.tm_hour, t.tm_min, t.tm_sec,
-		// 	tv.tv_usec);
-		// tv.tv_sec = timeinfo->erecv_timestamp_sec();
-		// tv.tv_usec = timeinfo->erecv_timestamp_usec();
-		// localtime_r(&tv.tv_sec, &t);
-		// printf("recv data time %d/%02d/%02d %02d:%02d:%02d:%06ld\n",
-		// 	t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		// 	t.tm_hour, t.tm_min, t.tm_sec,
-		// 	tv.tv_usec);
-		// tv.tv_sec = timeinfo->collection_timestamp_sec();
-		// tv.tv_usec = timeinfo->collection_timestamp_usec();
-		// localtime_r(&tv.tv_sec, &t);
-		// printf("collection data time %d/%02d/%02d %02d:%02d:%02d:%06ld\n",
-		// 	t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		// 	t.tm_hour, t.tm_min, t.tm_sec,
-		// 	tv.tv_usec);
-		// tv.tv_sec = timeinfo->timestamp_sec();
-		// tv.tv_usec = timeinfo->timestamp_usec();
-		// localtime_r(&tv.tv_sec, &t);
-		// printf("transfer data time %d/%02d/%02d %02d:%02d:%02d:%06ld\n",
-		// 	t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		// 	t.tm_hour, t.tm_min, t.tm_sec,
-		// 	tv.tv_usec);
-		std::string veh_data;
-		jos_item->SerializeToString(&veh_data);
-		send_kafka_to_center(_junciton_topic, 
-			(void*)veh_data.c_str(), veh_data.length());
+	// the records are sent as they were encoded by the snapshots
+	int ret = _batch.parse(data, sz);
+	if (ret) {
+		log.e(SNAPSHOT_SNAPSHOT_TAG,
+			"kafka data parse error, sz %lu\n", sz);
+		return ret;
 	}
-
-	for (size_t i = 0; i < cnt_sz; i++) {
-		auto& cnt_item = kafka_data.count(i);
-		if (cnt_item.invs_size() > 0) {
-			for (int in_index = 0; in_index < cnt_item.invs_size(); in_index++) {
-				auto& ininfo = cnt_item.invs(in_index);
-				printf("[%u]incomming name %s, id %s, type %d, id %d, interval %u, vid %u, speed %lf\n", cnt_item.junction_id(), ininfo.name().c_str(), ininfo.approachid().c_str(), (int)ininfo.type(), ininfo.laneid(), ininfo.time_interval(), ininfo.veh().id(), ininfo.veh().speed());
-			}
+	for (size_t i = 0; i < _batch.size(); i++) {
+		auto& rec = _batch.record(i);
+		if (rec.field == center_kafka_data::kSnapshotFieldNumber) {
+			send_kafka_to_center(_vehicle_rktopic, rec.data, rec.sz);
+			continue;
+		}
+		if (rec.field == center_kafka_data::kJunctionFieldNumber) {
+			send_kafka_to_center(_junction_rktopic, rec.data, rec.sz);
+			continue;
 		}
-		if (cnt_item.outvs_size() > 0) {
-			for (int out_index = 0; out_index < cnt_item.outvs_size(); out_index++) {
-				auto& outinfo = cnt_item.outvs(out_index);
-				printf("outgoing name %s, id %s, outid %s, type %d, inlaneid %d, outlaneid %d, vid %u, speed %lf\n", outinfo.name().c_str(), outinfo.outgoingid().c_str(), outinfo.incommingid().c_str(), (int)outinfo.type(), outinfo.incomming_laneid(), outinfo.outgoing_laneid(), outinfo.veh().id(), outinfo.veh().speed());
-			}
+		if (rec.field != center_kafka_data::kCountFieldNumber) {
+			continue;
 		}
-		std::string cnt_data;
-		cnt_item.SerializeToString(&cnt_data);
+		print_count(rec);
 
 		timeval tv;
 		gettimeofday(&tv, nullptr);
 		uint64_t time1 = tv.tv_sec * 1000 * 1000 + tv.tv_usec;
-		send_kafka_to_center(_count_topic, 
-			(void*)cnt_data.c_str(), cnt_data.length());
+		send_kafka_to_center(_count_rktopic, rec.data, rec.sz);
 		gettimeofday(&tv, nullptr);
 		uint64_t time2 = tv.tv_sec * 1000 * 1000 + tv.tv_usec;
 		if (kafka_handle_cnt < 2000) {
@@ -216,9 +172,26 @@ int vss_kafka_sender::on_kafka_data_send(const char* data, size_t sz)
 			kafka_handle_cnt = 0;
 		}
 	}
+	_batch.reset();
 	return 0;
 }
 
+void vss_kafka_sender::print_count(const kafka_record &rec)
+{
+	cnt_junction cnt_item;
+	if (!cnt_item.ParseFromArray(rec.data, rec.sz)) {
+		return;
+	}
+	for (int in_index = 0; in_index < cnt_item.invs_size(); in_index++) {
+		auto& ininfo = cnt_item.invs(in_index);
+		printf("[%u]incomming name %s, id %s, type %d, id %d, interval %u, vid %u, speed %lf\n", cnt_item.junction_id(), ininfo.name().c_str(), ininfo.approachid().c_str(), (int)ininfo.type(), ininfo.laneid(), ininfo.time_interval(), ininfo.veh().id(), ininfo.veh().speed());
+	}
+	for (int out_index = 0; out_index < cnt_item.outvs_size(); out_index++) {
+		auto& outinfo = cnt_item.outvs(out_index);
+		printf("outgoing name %s, id %s, outid %s, type %d, inlaneid %d, outlaneid %d, vid %u, speed %lf\n", outinfo.name().c_str(), outinfo.outgoingid().c_str(), outinfo.incommingid().c_str(), (int)outinfo.type(), outinfo.incomming_laneid(), outinfo.outgoing_laneid(), outinfo.veh().id(), outinfo.veh().speed());
+	}
+}
+
 int vss_kafka_sender::init(void)
 {
 	if (_inited) {
@@ -261,6 +234,30 @@ int vss_kafka_sender::load_kafka_config(void)
 	return 0;
 }
 
+int vss_kafka_sender::set_kafka_conf(RdKafka::Conf* conf,
+	const char* name, const std::string &val)
+{
+	std::string errstr;
+	if (conf->set(name, val, errstr) != RdKafka::Conf::CONF_OK) {
+		log.e(SNAPSHOT_SNAPSHOT_TAG,
+			"set %s erro: %s\n", name, errstr.c_str());
+		return -ELOGIC;
+	}
+	return 0;
+}
+
+RdKafka::Topic* vss_kafka_sender::create_kafka_topic(const std::string &name)
+{
+	std::string errstr;
+	RdKafka::Topic* topic = RdKafka::Topic::create(_producer,
+		name, nullptr, errstr);
+	if (!topic) {
+		log.e(SNAPSHOT_SNAPSHOT_TAG,
+			"create topic %s erro: %s\n", name.c_str(), errstr.c_str());
+	}
+	return topic;
+}
+
 int vss_kafka_sender::init_kafka(void)
 {
 	RdKafka::Conf *conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
@@ -271,68 +268,86 @@ int vss_kafka_sender::init_kafka(void)
 	brokers += std::to_string(_port);
 	log.d(SNAPSHOT_SNAPSHOT_TAG, "kafka brokers %s\n", brokers.c_str());
 	_delivery_cb = new kafka_delivery_report;
-	if (conf->set("bootstrap.servers", brokers, errstr) !=
-		RdKafka::Conf::CONF_OK) {
-		log.e(SNAPSHOT_SNAPSHOT_TAG,
-			"set callback erro: %s\n", errstr.c_str());
+	if (set_kafka_conf(conf, "bootstrap.servers", brokers)) {
+		delete conf;
 		return -ELOGIC;
 	}
 
 	if (conf->set("dr_cb", _delivery_cb, errstr) != RdKafka::Conf::CONF_OK) {
 		log.e(SNAPSHOT_SNAPSHOT_TAG,
 			"set callback erro: %s\n", errstr.c_str());
+		delete conf;
+		return -ELOGIC;
+	}
+
+	// the messages are batched by librdkafka, a batch is sent when it
+	// is full or its first message waited linger.ms
+	ssize_t linger = get_sysconfig("kafka.producer.linger-ms",
+		(ssize_t)KAFKA_PRODUCER_LINGER_MS);
+	ssize_t batch = get_sysconfig("kafka.producer.batch-num-messages",
+		(ssize_t)KAFKA_PRODUCER_BATCH_MESSAGES);
+	ssize_t queue = get_sysconfig("kafka.producer.queue-max-messages",
+		(ssize_t)KAFKA_PRODUCER_QUEUE_MESSAGES);
+	const char* compression = get_sysconfig("kafka.producer.compression",
+		KAFKA_PRODUCER_COMPRESSION);
+	if (set_kafka_conf(conf, "linger.ms", std::to_string(linger))
+		|| set_kafka_conf(conf, "batch.num.messages", std::to_string(batch))
+		|| set_kafka_conf(conf, "queue.buffering.max.messages",
+		std::to_string(queue))
+		|| set_kafka_conf(conf, "compression.type", compression)) {
+		delete conf;
 		return -ELOGIC;
 	}
 
 	_producer = RdKafka::Producer::create(conf, errstr);
+	delete conf;
 	if (!_producer) {
 		log.e(SNAPSHOT_SNAPSHOT_TAG,
 			"create produce erro: %s\n", errstr.c_str());
 		return -ELOGIC;
 	}
-	log.d(SNAPSHOT_SNAPSHOT_TAG, "kafka init finished\n");
-	delete conf;
+	_junction_rktopic = create_kafka_topic(_junciton_topic);
+	_vehicle_rktopic = create_kafka_topic(_vehicle_topic);
+	_count_rktopic = create_kafka_topic(_count_topic);
+
+	_poll_thread = new kafka_poll_thread(_producer);
+	_poll_thread->start();
+	log.d(SNAPSHOT_SNAPSHOT_TAG, "kafka init finished, linger %ld ms, "
+		"batch %ld, compression %s\n", linger, batch, compression);
 	return 0;
 }
 
-int vss_kafka_sender::send_kafka_to_center(std::string &topic,
-	void* data, size_t sz)
+int vss_kafka_sender::send_kafka_to_center(RdKafka::Topic* topic,
+	const void* data, size_t sz)
 {
-	if (!_producer) {
+	if (!_producer || !topic) {
 		return -ENOTAVAIL;
 	}
-	// printf("send to kafka topic %s, data sz %lu\n", topic.c_str(), sz);
 	if (!data || 0 == sz) { return -EBADPARM; }
-	RdKafka::ErrorCode err = _producer->produce(
-		topic,
+
+	// the payload is a part of the received data, it is copied into
+	// the message buffer of librdkafka
+	RdKafka::ErrorCode err = _producer->produce(topic,
 		RdKafka::Topic::PARTITION_UA,
-		RdKafka::Producer::RK_MSG_COPY /* Copy payload */,
-		data, sz,
-		NULL, 0,
-		0,
-		NULL,
-		NULL);
+		RdKafka::Producer::RK_MSG_COPY,
+		(void*)data, sz, nullptr, nullptr);
 
+	// the queue is drained by the poll thread, waiting for room here
+	// would block the event loop: drop the message
+	if (err == RdKafka::ERR__QUEUE_FULL) {
+		if (!(_queue_full_drops++ % KAFKA_QUEUE_FULL_LOG_EVERY)) {
+			log.e(SNAPSHOT_SNAPSHOT_TAG, "producer queue full, "
+				"%lu messages dropped\n", _queue_full_drops);
+		}
+		return -ETOOMANYITEMS;
+	}
 	if (err != RdKafka::ERR_NO_ERROR) {
 		log.e(SNAPSHOT_SNAPSHOT_TAG,
-			"%s failed to produce to topic : %s, %d\n",
-			topic.c_str(), RdKafka::err2str(err), err);
-
-		if (err == RdKafka::ERR__QUEUE_FULL) {
-			//TODO
-		}
-
-    } else {
-		// log.d(SNAPSHOT_SNAPSHOT_TAG,	
-		// 	"enqueued message (%d bytes) for topic %s\n",
-		// 	sz, topic.c_str());
+			"failed to produce, sz %lu: %s, %d\n",
+			sz, RdKafka::err2str(err).c_str(), err);
+		return -ELOGIC;
 	}
-	_producer->poll(0);
 	return 0;
 }
 
 }}	//zas::vehicle_snapshot_service
-
-
-
-
@@ -0,0 +1,172 @@
+#include "radar-batch.h"
+#include <assert.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include "proto/junction_package.pb.h"
+#include "proto/junction_fusion_package.pb.h"
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+using google::protobuf::Arena;
+using google::protobuf::ArenaOptions;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+#define RADAR_BATCH_MIN_BLOCK (64 * 1024)
+
+radar_batch::radar_batch()
+: _arena(nullptr)
+, _block(RADAR_BATCH_MIN_BLOCK)
+{
+}
+
+radar_batch::~radar_batch()
+{
+	_records.clear();
+	if (_arena) {
+		delete _arena;
+		_arena = nullptr;
+	}
+}
+
+void radar_batch::reset(void)
+{
+	_records.clear();
+	if (!_arena) {
+		return;
+	}
+	size_t used = _arena->Reset();
+	if (used <= _block.size()) {
+		return;
+	}
+	// the batch did not fit in the first block, enlarge it
+	size_t sz = _block.size();
+	while (sz < used) sz <<= 1;
+	delete _arena;
+	_arena = nullptr;
+	std::vector<char>(sz).swap(_block);
+}
+
+int radar_batch::parse(const void* data, size_t sz)
+{
+	if (!data || !sz) {
+		return -EBADPARM;
+	}
+	reset();
+	if (!_arena) {
+		ArenaOptions opts;
+		opts.initial_block = _block.data();
+		opts.initial_block_size = _block.size();
+		_arena = new Arena(opts);
+		assert(nullptr != _arena);
+	}
+
+	// split the junction_package into its radar_info records
+	const uint32_t radar_tag = WireFormatLite::MakeTag(
+		jos::junction_package::kRadarInfoFieldNumber,
+		WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+	const uint8_t* buf = (const uint8_t*)data;
+	CodedInputStream in(buf, sz);
+	for (uint32_t tag = in.ReadTag(); tag; tag = in.ReadTag()) {
+		if (tag != radar_tag) {
+			if (!WireFormatLite::SkipField(&in, tag)) {
+				return -EBADPARM;
+			}
+			continue;
+		}
+		uint32_t len = 0;
+		if (!in.ReadVarint32(&len)) {
+			return -EBADPARM;
+		}
+		size_t pos = in.CurrentPosition();
+		if (len > sz - pos) {
+			return -EBADPARM;
+		}
+		radar_record rec;
+		rec.raw = buf + pos;
+		rec.rawsz = len;
+		rec.info = Arena::CreateMessage<jos::radar_vision_info>(_arena);
+		if (!rec.info->ParseFromArray(rec.raw, len)) {
+			return -EBADPARM;
+		}
+		_records.push_back(rec);
+		in.Skip(len);
+	}
+	if ((size_t)in.CurrentPosition() != sz) {
+		return -EBADPARM;
+	}
+	return 0;
+}
+
+static size_t varint_size(uint64_t val)
+{
+	size_t sz = 1;
+	for (; val >= 0x80; val >>= 7) sz++;
+	return sz;
+}
+
+static void append_varint(std::string &out, uint64_t val)
+{
+	for (; val >= 0x80; val >>= 7) {
+		out.push_back((char)(val | 0x80));
+	}
+	out.push_back((char)val);
+}
+
+static void append_tag(std::string &out, int field,
+	WireFormatLite::WireType type)
+{
+	append_varint(out, WireFormatLite::MakeTag(field, type));
+}
+
+int encode_fusion_package(const jos::junction_fusion_package &head,
+	const radar_record &rec, std::string &out)
+{
+	if (!rec.info || !rec.raw) {
+		return -EBADPARM;
+	}
+	out.clear();
+	if (!head.AppendToString(&out)) {
+		return -ELOGIC;
+	}
+
+	// the receive time is written even when it is 0 so that it
+	// replaces the one in the received bytes
+	const auto& tminfo = rec.info->timeinfo();
+	uint64_t sec = tminfo.erecv_timestamp_sec();
+	uint64_t usec = tminfo.erecv_timestamp_usec();
+	const int sec_field = jos::update_timeinfo::kErecvTimestampSecFieldNumber;
+	const int usec_field = jos::update_timeinfo::kErecvTimestampUsecFieldNumber;
+	const int time_field = jos::radar_vision_info::kTimeinfoFieldNumber;
+	const int radar_field = jos::junction_package::kRadarInfoFieldNumber;
+	const int pkg_field = jos::junction_fusion_package::kJunPkgFieldNumber;
+
+	size_t timesz = WireFormatLite::TagSize(sec_field,
+		WireFormatLite::TYPE_UINT64) + varint_size(sec)
+		+ WireFormatLite::TagSize(usec_field,
+		WireFormatLite::TYPE_UINT64) + varint_size(usec);
+	size_t recsz = rec.rawsz + WireFormatLite::TagSize(time_field,
+		WireFormatLite::TYPE_MESSAGE) + varint_size(timesz) + timesz;
+	size_t pkgsz = WireFormatLite::TagSize(radar_field,
+		WireFormatLite::TYPE_MESSAGE) + varint_size(recsz) + recsz;
+
+	out.reserve(out.length() + WireFormatLite::TagSize(pkg_field,
+		WireFormatLite::TYPE_MESSAGE) + varint_size(pkgsz) + pkgsz);
+	append_tag(out, pkg_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+	append_varint(out, pkgsz);
+	append_tag(out, radar_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+	append_varint(out, recsz);
+	out.append((const char*)rec.raw, rec.rawsz);
+	append_tag(out, time_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+	append_varint(out, timesz);
+	append_tag(out, sec_field, WireFormatLite::WIRETYPE_VARINT);
+	append_varint(out, sec);
+	append_tag(out, usec_field, WireFormatLite::WIRETYPE_VARINT);
+	append_varint(out, usec);
+	return 0;
+}
+
+}}	//zas::vehicle_snapshot_service
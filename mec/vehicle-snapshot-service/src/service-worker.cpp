@@ -263,6 +263,7 @@ int service_worker::init_worker(void)
 	size_t infosz = strlen("snapshot") + sizeof(server_request_info);
 	server_request_info* info = (server_request_info*)(alloca(infosz));
 	info->veh_cnt = 0;
+	info->weight = get_sysconfig("snapshot-service.weight", (ssize_t)1);
 	info->name_len = strlen("snapshot");
 	strncpy(info->buf, "snapshot", info->name_len);
 	_worker->send((void*)&hdr, sizeof(server_header), false);
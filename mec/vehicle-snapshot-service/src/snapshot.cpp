@@ -43,6 +43,7 @@ vss_snapshot::vss_snapshot()
 : _vss_snapshot_tree(nullptr)
 , _map(nullptr)
 , _request_vin_tree(nullptr)
+, _grid(VEHICLE_MAXDISTANCE)
 {
 	listnode_init(_vss_snapshot_list);
 	listnode_init(_request_vin_list);
@@ -119,7 +120,7 @@ int vss_snapshot::update_snapshot(std::string &vincode, uri &info,
 			delete item;
 			return -ELOGIC;
 		}
-		listnode_init(item->linkownerlist);
+		vehicle_grid::init_node(&item->gridnode);
 		listnode_init(item->junctionownerlist);
 		listnode_init(item->junprevownerlist);
 		listnode_add(_vss_snapshot_list, item->ownerlist);
@@ -181,8 +182,7 @@ int vss_snapshot::set_way_and_arround_vehilce(vehicle_snapshot_item* item,
 	assert(nullptr != item);
 	assert(nullptr != _map);
 	sdmap_nearest_link nearest_link;
-	auto vsspkg = item->snapshot[item->index].package();
-	auto gps = vsspkg.gpsinfo();
+	const auto& gps = item->snapshot[item->index].package().gpsinfo();
 	int ret = _map->search_nearest_links(gps.latitude(),
 		gps.longtitude(), &nearest_link);
 		// timeval tv;
@@ -222,35 +222,9 @@ int vss_snapshot::set_way_and_arround_vehilce(vehicle_snapshot_item* item,
 		item->snapshot[item->index].set_deviation(nearest_link.distance);
 		auto* vsssnap = dspkg.mutable_vsspkg();
 		*vsssnap = item->snapshot[item->index];
-		auto* data = curr_link->get_userdata();
-		if (!data) {
-			// create userdata
-			auto* list_root = new listnode_t;
-			listnode_init(*list_root);
-			data = (void*)list_root;
-			curr_link->set_userdata(data);
-		} 
-		auto* listhd = reinterpret_cast<listnode_t*>(data);
-		listnode_del(item->linkownerlist);
-		set_around_vehicle(dspkg, listhd, gps);
-		listnode_add(*listhd, item->linkownerlist);	
-
-		auto* prevlink = curr_link->prev();
-		if (prevlink) { 
-			auto* nddata = prevlink->get_userdata();
-			if (nddata) {
-				auto* hdr = reinterpret_cast<listnode_t*>(nddata);
-				set_around_vehicle(dspkg, hdr, gps);
-			}
-		}
-		auto* nextlink = curr_link->next();
-		if (nextlink) { 
-			auto* nddata = nextlink->get_userdata();
-			if (nddata) {
-				auto* hdr = reinterpret_cast<listnode_t*>(nddata);
-				set_around_vehicle(dspkg, hdr, gps);
-			}
-		}
+		_grid.update(&item->gridnode, gps.longtitude(),
+			gps.latitude(), curr_link);
+		set_around_vehicle(dspkg, item);
 
 	} else {
 		printf("map error\n");
@@ -259,31 +233,35 @@ int vss_snapshot::set_way_and_arround_vehilce(vehicle_snapshot_item* item,
 	return 0;
 }
 
-int vss_snapshot::set_around_vehicle(distribute_package &dspkg, listnode_t *hd,
-	vss::positioning_system_info& curr_gps)
+// the vehicles on the link of the item or the ones before and after it
+int vss_snapshot::set_around_vehicle(distribute_package &dspkg,
+	vehicle_snapshot_item* item)
 {
-	if (listnode_isempty(*hd)) {
-		return 0;
+	auto* curr = &item->gridnode;
+	const sdmap_link* links[3] = {curr->link, nullptr, nullptr};
+	if (curr->link) {
+		links[1] = curr->link->prev();
+		links[2] = curr->link->next();
 	}
-	auto* nd = hd->next;
-	for (; nd != hd; nd = nd->next) {
-		auto* item = LIST_ENTRY(vehicle_snapshot_item,	\
-			linkownerlist, nd);
-		assert(nullptr != item);
-		auto vsspkg = item->snapshot[item->index].package();
-		auto gps = vsspkg.gpsinfo();
-
+	_grid.for_each_candidate(curr->lon, curr->lat, VEHICLE_MAXDISTANCE,
+		[&](vehicle_grid_node* node) {
+		if (node == curr || !node->link) {
+			return;
+		}
+		if (node->link != links[0] && node->link != links[1]
+			&& node->link != links[2]) {
+			return;
+		}
 		auto dist = zas::mapcore::distance(
-			curr_gps.longtitude(), 
-			curr_gps.latitude(), 
-			gps.longtitude(), 
-			gps.latitude());
+			curr->lon, curr->lat, node->lon, node->lat);
 		if (dist > VEHICLE_MAXDISTANCE) {
-			continue;
+			return;
 		}
-
+		auto* vitem = LIST_ENTRY(vehicle_snapshot_item, gridnode, node);
+		const auto& vsspkg = vitem->snapshot[vitem->index].package();
+		const auto& gps = vsspkg.gpsinfo();
 		auto* vehi = dspkg.add_vehicles();
-		vehi->set_id(item->vid);
+		vehi->set_id(vitem->vid);
 		vehi->set_lat(gps.latitude());
 		vehi->set_lon(gps.longtitude());
 		vehi->set_speed(vsspkg.vehicle_speed());
@@ -291,7 +269,7 @@ int vss_snapshot::set_around_vehicle(distribute_package &dspkg, listnode_t *hd,
 		uint64_t vehtime = vsspkg.timestamp_sec() * 1000;
 		vehtime += vsspkg.timestamp_usec();
 		vehi->set_timestamp(vehtime);
-	}
+	});
 	return 0;
 }
 
@@ -386,7 +364,7 @@ int vss_snapshot::remove_snapshot(std::string &vid)
 
 	avl_remove(&_vss_snapshot_tree, &item->avlnode);
 	listnode_del(item->ownerlist);
-	listnode_del(item->linkownerlist);
+	_grid.remove(&item->gridnode);
 	delete item;
 	return 0;
 }
@@ -400,7 +378,7 @@ int vss_snapshot::remove_all_snapshot(void)
 			return -ELOGIC;
 		}
 		listnode_del(item->ownerlist);
-		listnode_del(item->linkownerlist);
+		_grid.remove(&item->gridnode);
 		listnode_del(item->junctionownerlist);
 		listnode_del(item->junprevownerlist);
 		delete item;
@@ -0,0 +1,101 @@
+#include "vehicle-grid.h"
+#include <assert.h>
+
+namespace zas {
+namespace vehicle_snapshot_service {
+
+// meters of a degree of latitude, the radius is the one of mapcore
+#define VEHICLE_GRID_DEG2M (6378137.0 * M_PI / 180.0)
+
+vehicle_grid::vehicle_grid(double cellsize)
+: _cellsize(cellsize)
+, _origin(false)
+, _lon0(0.), _lat0(0.)
+, _kx(VEHICLE_GRID_DEG2M), _ky(VEHICLE_GRID_DEG2M)
+, _count(0)
+{
+	assert(cellsize > 0.);
+}
+
+vehicle_grid::~vehicle_grid()
+{
+	clear();
+}
+
+void vehicle_grid::init_node(vehicle_grid_node* node)
+{
+	assert(nullptr != node);
+	listnode_init(node->ownerlist);
+	node->cell = 0;
+	node->lon = node->lat = 0.;
+	node->link = nullptr;
+}
+
+int vehicle_grid::update(vehicle_grid_node* node, double lon, double lat,
+	const zas::mapcore::sdmap_link* link)
+{
+	if (!node) {
+		return -EBADPARM;
+	}
+	if (!_origin) {
+		_origin = true;
+		_lon0 = lon;
+		_lat0 = lat;
+		_kx = VEHICLE_GRID_DEG2M * cos(lat * M_PI / 180.0);
+	}
+	node->lon = lon;
+	node->lat = lat;
+	node->link = link;
+
+	double x, y;
+	project(lon, lat, x, y);
+	int64_t key = cell_key(cell_index(x), cell_index(y));
+	bool ingrid = !listnode_isempty(node->ownerlist);
+	if (ingrid && key == node->cell) {
+		return 0;
+	}
+	if (ingrid) {
+		remove(node);
+	}
+	auto ret = _cells.emplace(key, listnode_t());
+	if (ret.second) {
+		listnode_init(ret.first->second);
+	}
+	listnode_add(ret.first->second, node->ownerlist);
+	node->cell = key;
+	_count++;
+	return 0;
+}
+
+int vehicle_grid::remove(vehicle_grid_node* node)
+{
+	if (!node) {
+		return -EBADPARM;
+	}
+	if (listnode_isempty(node->ownerlist)) {
+		return -ENOTFOUND;
+	}
+	listnode_del(node->ownerlist);
+	_count--;
+	auto it = _cells.find(node->cell);
+	assert(it != _cells.end());
+	if (listnode_isempty(it->second)) {
+		_cells.erase(it);
+	}
+	return 0;
+}
+
+void vehicle_grid::clear(void)
+{
+	for (auto& cell : _cells) {
+		listnode_t* hd = &cell.second;
+		while (!listnode_isempty(*hd)) {
+			auto* nd = hd->next;
+			listnode_del(*nd);
+		}
+	}
+	_cells.clear();
+	_count = 0;
+}
+
+}}	//zas::vehicle_snapshot_service
@@ -0,0 +1,189 @@
+/** @file vehicle-grid-bench.cpp
+ * benchmark: surrounding vehicles of every vehicle update, the
+ * vehicle lists of the links against the vehicle_grid
+ *
+ * vehicle-grid-bench [vehicles] [roads] [link length] [ticks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "inc/vehicle-grid.h"
+#include "inc/snapshot-service-def.h"
+#include "mapcore/mapcore.h"
+
+using namespace std;
+using namespace zas::vehicle_snapshot_service;
+using zas::mapcore::sdmap_link;
+
+#define LON0 (121.4)
+#define LAT0 (31.2)
+#define DEG2M (6378137.0 * M_PI / 180.0)
+
+// a link of the synthetic sdmap, roads on a square grid
+struct road_link
+{
+	listnode_t vehicles;
+	road_link* prev;
+	road_link* next;
+	double x0, y0;
+	double dx, dy;
+	const sdmap_link* id(void) const {
+		return reinterpret_cast<const sdmap_link*>(this);
+	}
+};
+
+struct sim_vehicle
+{
+	road_link* link;
+	double offset;
+	double speed;
+	double lon, lat;
+};
+
+// a vehicle as the link lists saw it at its last update
+struct list_vehicle
+{
+	listnode_t linkownerlist;
+	road_link* link;
+	double lon, lat;
+};
+
+static double link_length = 1000.;
+
+static void move(sim_vehicle &v, double dt)
+{
+	v.offset += v.speed * dt;
+	while (v.offset > link_length) {
+		v.offset -= link_length;
+		v.link = v.link->next;
+	}
+	double x = v.link->x0 + v.link->dx * v.offset;
+	double y = v.link->y0 + v.link->dy * v.offset;
+	v.lat = LAT0 + y / DEG2M;
+	v.lon = LON0 + x / (DEG2M * cos(LAT0 * M_PI / 180.0));
+}
+
+static size_t scan_link(list_vehicle &v, road_link* link)
+{
+	if (!link) return 0;
+	size_t cnt = 0;
+	listnode_t* hd = &link->vehicles;
+	for (listnode_t* nd = hd->next; nd != hd; nd = nd->next) {
+		auto* o = LIST_ENTRY(list_vehicle, linkownerlist, nd);
+		if (zas::mapcore::distance(v.lon, v.lat, o->lon, o->lat)
+			<= VEHICLE_MAXDISTANCE) cnt++;
+	}
+	return cnt;
+}
+
+// set_way_and_arround_vehilce before the grid
+static size_t around_lists(list_vehicle &v, const sim_vehicle &pos)
+{
+	v.link = pos.link;
+	v.lon = pos.lon;
+	v.lat = pos.lat;
+	listnode_del(v.linkownerlist);
+	size_t cnt = scan_link(v, v.link);
+	listnode_add(v.link->vehicles, v.linkownerlist);
+	cnt += scan_link(v, v.link->prev);
+	cnt += scan_link(v, v.link->next);
+	return cnt;
+}
+
+static size_t around_grid(vehicle_grid &grid, vehicle_grid_node* curr,
+	const sim_vehicle &v)
+{
+	grid.update(curr, v.lon, v.lat, v.link->id());
+	const sdmap_link* links[3] = {
+		v.link->id(), v.link->prev->id(), v.link->next->id() };
+	size_t cnt = 0;
+	grid.for_each_candidate(curr->lon, curr->lat, VEHICLE_MAXDISTANCE,
+		[&](vehicle_grid_node* node) {
+		if (node == curr) return;
+		if (node->link != links[0] && node->link != links[1]
+			&& node->link != links[2]) return;
+		if (zas::mapcore::distance(curr->lon, curr->lat,
+			node->lon, node->lat) <= VEHICLE_MAXDISTANCE) cnt++;
+	});
+	return cnt;
+}
+
+int main(int argc, char* argv[])
+{
+	int count = (argc > 1) ? atoi(argv[1]) : 10000;
+	int roads = (argc > 2) ? atoi(argv[2]) : 10;
+	link_length = (argc > 3) ? atof(argv[3]) : 1000.;
+	int ticks = (argc > 4) ? atoi(argv[4]) : 10;
+
+	// every road is a ring of links, west->east or south->north
+	vector<road_link> links(2 * roads * roads);
+	for (int r = 0; r < roads; r++) {
+		for (int i = 0; i < roads; i++) {
+			auto& h = links[r * roads + i];
+			h.x0 = i * link_length; h.y0 = r * link_length;
+			h.dx = 1.; h.dy = 0.;
+			h.next = &links[r * roads + (i + 1) % roads];
+			h.prev = &links[r * roads + (i + roads - 1) % roads];
+			auto& v = links[roads * roads + r * roads + i];
+			v.x0 = r * link_length; v.y0 = i * link_length;
+			v.dx = 0.; v.dy = 1.;
+			v.next = &links[roads * roads + r * roads + (i + 1) % roads];
+			v.prev = &links[roads * roads + r * roads + (i + roads - 1) % roads];
+		}
+	}
+	for (auto& l : links) listnode_init(l.vehicles);
+
+	mt19937 gen(1);
+	uniform_int_distribution<int> pick(0, links.size() - 1);
+	uniform_real_distribution<double> offset(0., link_length), speed(0., 20.);
+	vector<sim_vehicle> vehicles(count);
+	vector<list_vehicle> list_vehicles(count);
+	vector<vehicle_grid_node> grid_nodes(count);
+	for (int i = 0; i < count; i++) {
+		listnode_init(list_vehicles[i].linkownerlist);
+		vehicle_grid::init_node(&grid_nodes[i]);
+		auto& v = vehicles[i];
+		v.link = &links[pick(gen)];
+		v.offset = offset(gen);
+		v.speed = speed(gen);
+		move(v, 0.);
+	}
+
+	vehicle_grid grid(VEHICLE_MAXDISTANCE);
+	size_t list_found = 0, grid_found = 0;
+	double list_s = 0., grid_s = 0.;
+	for (int t = 0; t < ticks; t++) {
+		for (auto& v : vehicles) move(v, 0.1);
+		auto t0 = chrono::steady_clock::now();
+		for (int i = 0; i < count; i++) {
+			list_found += around_lists(list_vehicles[i], vehicles[i]);
+		}
+		auto t1 = chrono::steady_clock::now();
+		for (int i = 0; i < count; i++) {
+			grid_found += around_grid(grid, &grid_nodes[i], vehicles[i]);
+		}
+		auto t2 = chrono::steady_clock::now();
+		// the first tick fills the lists and the grid
+		if (!t) {
+			list_found = grid_found = 0;
+			continue;
+		}
+		list_s += chrono::duration<double>(t1 - t0).count();
+		grid_s += chrono::duration<double>(t2 - t1).count();
+	}
+
+	size_t updates = (size_t)count * (ticks - 1);
+	printf("%d vehicles, %lu links of %.0f m, %d ticks\n",
+		count, links.size(), link_length, ticks);
+	printf("link lists : %8.2f us/update\n", list_s * 1e6 / updates);
+	printf("grid       : %8.2f us/update\n", grid_s * 1e6 / updates);
+	printf("speedup %.1fx, %.2f vehicles around, same: %s\n",
+		list_s / grid_s, (double)grid_found / updates,
+		(list_found == grid_found) ? "yes" : "NO");
+	return (list_found == grid_found) ? 0 : 1;
+}
@@ -8,6 +8,8 @@
 #include <set>
 #include <vector>
 #include <string>
+#include <future>
+#include <functional>
 #include <Eigen/Dense>
 #include "mapcore/mapcore.h"
 #include "Viewer/RoadNetworkMesh.h"
@@ -318,12 +320,45 @@ private:
 	ZAS_DISABLE_EVIL_CONSTRUCTOR(rendermap);
 };
 
+struct tilecache_stats
+{
+	// the memory budget, 0 means unlimited
+	size_t budget;
+
+	// bytes of the loaded tile buffers and of the
+	// generated meshes, and the peak value
+	size_t resident;
+	size_t peak;
+
+	// count of loaded blocks
+	size_t blocks;
+
+	// mesh requests served from the cache or
+	// requiring a generation
+	uint64_t hits;
+	uint64_t misses;
+
+	// blocks evicted to keep within the budget, the bytes
+	// of their meshes and of the tiles freed with them
+	uint64_t evictions;
+	uint64_t evicted_bytes;
+};
+
 class MAPCORE_EXPORT tilecache
 {
 public:
 	tilecache();
 	~tilecache();
 
+	/*
+	 * callback of an asynchronous mesh request, invoked in
+	 * a worker thread (or in the requesting thread if the
+	 * mesh is already available). mesh is nullptr if the
+	 * generation failed or the block has been released
+	 */
+	typedef std::function<void(uint32_t blkid,
+		shared_ptr<const odr::RoadNetworkMesh> mesh)> mesh_callback;
+
 	/*
 	 * bind map using the mapinfo
 	 * @param mapinfo the buffer of mapinfo downloaded
@@ -371,6 +406,55 @@ public:
 	 */
 	shared_ptr<const odr::RoadNetworkMesh> get_mesh(uint32_t blkid, bool* gen = nullptr);
 
+	/*
+	 * get the mesh of a block asynchronously, the mesh is
+	 * generated by the background workers if not available
+	 * @param blkid the id of the block
+	 * @param cb the callback invoked when the mesh is ready
+	 * @return 0 for success, -ETOOMANYITEMS if the workers
+	 * 		are too busy to accept the request
+	 */
+	int get_mesh_async(uint32_t blkid, mesh_callback cb);
+
+	/*
+	 * same as get_mesh_async() but returns a future
+	 * @param blkid the id of the block
+	 * @return the future of the mesh, which is invalid (valid()
+	 * 		returns false) if the request is not accepted
+	 */
+	std::shared_future<shared_ptr<const odr::RoadNetworkMesh>>
+	get_mesh_future(uint32_t blkid);
+
+	/*
+	 * configure the background mesh generation
+	 * @param workers the count of worker threads
+	 * @param max_pending the max count of queued requests
+	 * @param prefetch_radius generate meshes of loaded blocks
+	 * 		within this radius (in blocks) around the queried
+	 * 		blocks in the background, 0 disables prefetching
+	 * @return 0 for success, the worker count could only be
+	 * 		changed before the first asynchronous request
+	 */
+	int config_mesh_workers(int workers, int max_pending = 64,
+		int prefetch_radius = 0);
+
+	/*
+	 * set the memory budget of the tilecache, the least
+	 * recently used blocks (CLOCK) are released when the
+	 * budget is exceeded. blocks locked by lock_blocks() or
+	 * filter_loaded_blocks() are never evicted
+	 * @param bytes the budget, 0 means unlimited (default)
+	 * @return 0 for success
+	 */
+	int set_memory_budget(size_t bytes);
+
+	/*
+	 * get the memory and hit/miss/eviction counters
+	 * @param stats the returned counters
+	 * @return 0 for success
+	 */
+	int get_stats(tilecache_stats& stats) const;
+
 	/*
 	 * release the generated mesh of a block
 	 * this is used to release memory when the block is
@@ -701,12 +785,15 @@ public:
 	 */
 	int load_fromfile(const char* filename);
 
-	// /*
-	//  * load the hdmap from the buffer
-	//  * @param buffer the memory buffer
-	//  * @return 0 for success
-	//  */
-	// int load_frombuffer(const void* buffer, size_t sz);
+	/*
+	 * load the hdmap from the buffer without copying it
+	 * the buffer is relocated in place, so it shall be writable
+	 * and kept valid by the caller until the hdmap is destroyed
+	 * @param buffer the memory buffer
+	 * @param sz the size of the buffer
+	 * @return 0 for success
+	 */
+	int load_frombuffer(void* buffer, size_t sz);
 
 	// /*
 	//  * load the hdmap from the string buffer
@@ -750,6 +837,16 @@ public:
 	int get_neareast_laneses(point3d p3d, double hdg, std::map<uint64_t, std::shared_ptr<hdmap_segment_point>> points, std::map<uint64_t, double> &lanesegs) const;
 
 	int generate_lanesect_transition(const char* filepath);
+
+	/*
+	 * get the lanes could be transited from a lane (the
+	 * lane itself is not included), available after
+	 * generate_lanesect_transition()
+	 * @param lane_id the lane (laneseg index)
+	 * @param lanes the array of lanes, sorted, owned by the map
+	 * @return count of lanes, < 0 for error
+	 */
+	int get_lane_transitions(uint64_t lane_id, const uint64_t*& lanes) const;
 	// /*
 	//  * get junction by ID
 	//  * @param juncid
@@ -235,6 +235,35 @@ public:
 	point3d inv_transform(const point3d& src) const;
 	void inv_transform_point(point3d& src) const;
 
+	/*
+	 * transform a batch of coordinations in place, the coordinations
+	 * are kept in strided arrays (like proj_trans_generic)
+	 * @param x, y, z the coordination arrays, z could be nullptr
+	 * @param stride the distance in bytes between two coordinations
+	 * @param count the number of coordinations
+	 * @param inv inverse transformation from target CRS to source CRS
+	 * @return the number of transformed coordinations, < 0 for error
+	 * not const: the scratch buffers of the proj are reused, a proj
+	 * shall not run batch transforms in two threads at the same time
+	 */
+	int transform(double* x, double* y, double* z, size_t stride,
+		size_t count, bool inv = false);
+	int transform(point3d* pts, size_t count, bool inv = false);
+
+	/*
+	 * enable the fast path of a small area: coordinations within
+	 * "range" of "origin" are transformed by a second order model of
+	 * the projection at the origin instead of calling PROJ (linear in
+	 * z, quadratic in x and y, the inverse refined by newton steps)
+	 * @param origin the center of the area in the source CRS
+	 * @param range the half size of the area in source CRS units
+	 * @param tolerance the max error allowed in target CRS units
+	 * @return 0 for success, -EOUTOFOSCOPE if the model exceeds
+	 * 		the tolerance somewhere in the area
+	 */
+	int set_local_area(const point3d& origin, double range, double tolerance);
+	void clear_local_area(void);
+
 private:
 	void* _data;
 	ZAS_DISABLE_EVIL_CONSTRUCTOR(proj);
@@ -0,0 +1,158 @@
+/** @file endpoint-balancer.h
+ * Definition of the selection of the endpoint of a server, shared by
+ * the indexing service and the load balance service
+ */
+
+#include "utils/utils.h"
+#ifdef UTILS_ENABLE_FBLOCK_BALANCER
+
+#ifndef __CXX_ZAS_UTILS_ENDPOINT_BALANCER_H__
+#define __CXX_ZAS_UTILS_ENDPOINT_BALANCER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace zas {
+namespace utils {
+
+// points on the hash ring of an endpoint of weight 1
+#define BALANCE_RING_POINTS				(40)
+#define BALANCE_MAX_WEIGHT				(64)
+// a hashed vehicle skips the endpoints loaded above the average by this
+#define BALANCE_HASH_LOAD_FACTOR		(1.25)
+
+enum balance_mode
+{
+	// the endpoint with the least load for its weight
+	balance_mode_least_loaded = 0,
+	// the less loaded of two random endpoints
+	balance_mode_two_choices,
+	// the endpoint of the vehicle id on the hash ring
+	balance_mode_consistent_hash,
+};
+
+// embedded in the endpoint
+struct balance_node
+{
+	size_t load;
+	uint32_t weight;
+	// position in the heap, -1 if not in the balancer
+	int heapidx;
+	// seed of the points on the hash ring
+	uint64_t ringkey;
+};
+
+#define BALANCE_NODE_ENTRY(type, member, ptr)	\
+	((type*)(((size_t)(ptr)) - ((size_t)(&((type*)0)->member))))
+
+/*
+ * select the endpoint of a server for a vehicle or a request
+ *
+ * the endpoints are kept in a min-heap ordered by load / weight, so
+ * the least loaded one is the top and a load change costs O(log n).
+ * The hash ring has weight * BALANCE_RING_POINTS points an endpoint
+ * and is sorted on the first hashed selection, then endpoints going
+ * up or down merge or drop their points.
+ */
+class UTILS_EXPORT endpoint_balancer
+{
+public:
+	endpoint_balancer();
+	~endpoint_balancer();
+
+	static void init_node(balance_node* node, size_t load, uint32_t weight);
+	static int parse_mode(const char* mode);
+
+	int set_mode(int mode);
+	int get_mode(void) const {
+		return _mode;
+	}
+
+	// capacity of an endpoint of weight 1, 0 for unlimited
+	void set_capacity(size_t capacity) {
+		_capacity = capacity;
+	}
+
+	// key is the identity of the endpoint for the hash ring
+	int add(balance_node* node, const std::string &key);
+	int remove(balance_node* node);
+
+	/*
+	 * pick an endpoint other than exclude and count the vehicle on it
+	 * @return nullptr if every endpoint is full
+	 */
+	balance_node* acquire(const std::string* vehicle_id,
+		balance_node* exclude = nullptr);
+	void release(balance_node* node);
+	int set_load(balance_node* node, size_t load);
+	void reset_load(void);
+
+	size_t size(void) const {
+		return _heap.size();
+	}
+
+	/*
+	 * check the heap order, the heap index of the endpoints and the
+	 * totals, and that the hash ring is the one build_ring() makes
+	 * @return 0 or -ELOGIC
+	 */
+	int verify(void) const;
+
+private:
+	bool full(const balance_node* node) const {
+		return _capacity && node->load >= _capacity * node->weight;
+	}
+
+	// a is less loaded than b for their weight
+	static bool lighter(const balance_node* a, const balance_node* b) {
+		return (uint64_t)a->load * b->weight < (uint64_t)b->load * a->weight;
+	}
+
+	void sift_up(int idx);
+	void sift_down(int idx);
+	void update(balance_node* node);
+
+	balance_node* least_loaded(balance_node* exclude);
+	balance_node* two_choices(balance_node* exclude);
+	balance_node* consistent_hash(const std::string &vehicle_id,
+		balance_node* exclude);
+	struct ring_point;
+	void build_ring(void);
+	static void ring_points(balance_node* node,
+		std::vector<ring_point> &ring);
+	void ring_add(balance_node* node);
+	void ring_remove(balance_node* node);
+	uint64_t next_random(void);
+
+	static uint64_t hash(const void* data, size_t sz, uint64_t seed = 0);
+
+private:
+	endpoint_balancer(const endpoint_balancer&);
+	endpoint_balancer& operator=(const endpoint_balancer&);
+
+private:
+	struct ring_point
+	{
+		uint64_t hash;
+		balance_node* node;
+		bool operator<(const ring_point &b) const {
+			return hash < b.hash;
+		}
+	};
+
+	int _mode;
+	size_t _capacity;
+	uint64_t _seed;
+	size_t _total_load;
+	size_t _total_weight;
+	std::vector<balance_node*> _heap;
+	std::vector<ring_point> _ring;
+	bool _ring_dirty;
+};
+
+}} // end of namespace zas::utils
+
+#endif // __CXX_ZAS_UTILS_ENDPOINT_BALANCER_H__
+#endif // UTILS_ENABLE_FBLOCK_BALANCER
+/* EOF */
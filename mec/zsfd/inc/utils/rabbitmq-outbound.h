@@ -0,0 +1,162 @@
+/** @file rabbitmq-outbound.h
+ * Definition of the outbound queue of a rabbitmq publisher thread
+ * and of the bookkeeping of its publisher confirms
+ */
+
+#include "utils/utils.h"
+#if (defined(UTILS_ENABLE_FBLOCK_MQOUTBOUND) && defined(UTILS_ENABLE_FBLOCK_WAIT))
+
+#ifndef __CXX_ZAS_UTILS_RABBITMQ_OUTBOUND_H__
+#define __CXX_ZAS_UTILS_RABBITMQ_OUTBOUND_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "std/list.h"
+#include "utils/wait.h"
+
+namespace zas {
+namespace utils {
+
+// what push() does when the queue is full
+enum rabbitmq_drop_policy {
+	rabbitmq_drop_oldest = 0,
+	rabbitmq_drop_newest,
+	// wait for room up to the block timeout, then drop the newest
+	rabbitmq_drop_block,
+};
+
+// confirm state of a published message
+enum rabbitmq_confirm_state {
+	rabbitmq_confirm_pending = 0,
+	rabbitmq_confirm_ack,
+	rabbitmq_confirm_nack,
+};
+
+struct rabbitmq_message
+{
+	listnode_t ownerlist;
+	std::string exchange;
+	std::string routingkey;
+	std::string body;
+};
+
+struct rabbitmq_outbound_stats
+{
+	size_t depth;
+	size_t enqueued;
+	size_t dropped;
+	size_t published;
+	size_t confirmed;
+	size_t nacked;
+};
+
+// the channel the publisher confirms are read from
+class UTILS_EXPORT rabbitmq_confirm_peer
+{
+public:
+	virtual ~rabbitmq_confirm_peer() {}
+
+	/**
+	 * wait for the next basic.ack or basic.nack of the channel
+	 * @return 0 with tag, multiple and nack set, -ETIMEOUT, or
+	 * 		-ENOTCONN if the channel or the connection is closed
+	 */
+	virtual int next_confirm(uint64_t &tag, bool &multiple,
+		bool &nack) = 0;
+};
+
+/*
+ * the publisher confirms of a batch published back to back, that is
+ * of the delivery tags first to first + count - 1. A multiple confirm
+ * covers every pending tag up to its own, the tags of other batches
+ * are ignored.
+ */
+class UTILS_EXPORT rabbitmq_confirms
+{
+public:
+	rabbitmq_confirms();
+
+	void reset(uint64_t first, size_t count);
+	// returns the number of messages still pending
+	size_t confirm(uint64_t tag, bool multiple, bool nack);
+	// read the confirms from the peer until none is pending,
+	// the error of the peer is returned with the rest pending
+	int wait(rabbitmq_confirm_peer* peer);
+
+	size_t count(void) const;
+	size_t pending(void) const;
+	// messages past count() were not published: pending
+	rabbitmq_confirm_state state(size_t i) const;
+
+private:
+	uint64_t _first;
+	size_t _pending;
+	std::vector<uint8_t> _states;
+};
+
+/*
+ * the messages waiting for the publisher thread
+ *
+ * push() is called from the event loop and only copies the message
+ * into a recycled node, the publisher takes the messages in batches.
+ * The messages of a batch that were not confirmed are put back at
+ * the head, so they are published again in order.
+ */
+class UTILS_EXPORT rabbitmq_outbound
+{
+public:
+	rabbitmq_outbound(size_t capacity, rabbitmq_drop_policy policy,
+		uint32_t block_ms);
+	~rabbitmq_outbound();
+
+	int push(const char* exchange, const std::string &routingkey,
+		const void* data, size_t sz);
+
+	// take up to max messages, wait up to msec for the first one
+	size_t pop(std::vector<rabbitmq_message*> &batch, size_t max,
+		uint32_t msec);
+	void requeue(std::vector<rabbitmq_message*> &batch);
+	void release(std::vector<rabbitmq_message*> &batch);
+	// release the acknowledged messages of a popped batch and
+	// requeue the nacked and pending ones, returns how many acked
+	size_t settle(std::vector<rabbitmq_message*> &batch,
+		const rabbitmq_confirms &confirms);
+	// drop the queued messages, returns how many
+	size_t discard(void);
+
+	void stop(void);
+	bool stopped(void);
+	size_t depth(void);
+
+	void on_published(size_t cnt);
+	void get_stats(rabbitmq_outbound_stats &stats);
+
+	static rabbitmq_drop_policy get_policy(const char* name);
+
+private:
+	rabbitmq_message* alloc_message(void);
+	void free_message(rabbitmq_message* msg);
+	void drop_message(bool oldest);
+
+private:
+	rabbitmq_outbound(const rabbitmq_outbound&);
+	rabbitmq_outbound& operator=(const rabbitmq_outbound&);
+
+private:
+	waitobject _wait;
+	listnode_t _queue;
+	listnode_t _freelist;
+	size_t _count;
+	size_t _capacity;
+	rabbitmq_drop_policy _policy;
+	uint32_t _block_ms;
+	bool _stopped;
+	rabbitmq_outbound_stats _stats;
+};
+
+}} // end of namespace zas::utils
+
+#endif // __CXX_ZAS_UTILS_RABBITMQ_OUTBOUND_H__
+#endif // UTILS_ENABLE_FBLOCK_MQOUTBOUND && UTILS_ENABLE_FBLOCK_WAIT
+/* EOF */
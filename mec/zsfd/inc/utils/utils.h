@@ -16,6 +16,7 @@
 // enable all function blocks
 
 #define UTILS_ENABLE_FBLOCK_ABSFILE
+#define UTILS_ENABLE_FBLOCK_BALANCER
 #define UTILS_ENABLE_FBLOCK_BUFFER
 #define UTILS_ENABLE_FBLOCK_CERT
 #define UTILS_ENABLE_FBLOCK_CMDLINE
@@ -27,6 +28,7 @@
 #define UTILS_ENABLE_FBLOCK_EVLOOP
 #define UTILS_ENABLE_FBLOCK_LOG
 #define UTILS_ENABLE_FBLOCK_MEMCACHE
+#define UTILS_ENABLE_FBLOCK_MQOUTBOUND
 #define UTILS_ENABLE_FBLOCK_SHRMEM
 #define UTILS_ENABLE_FBLOCK_SYSCFG
 #define UTILS_ENABLE_FBLOCK_THREAD
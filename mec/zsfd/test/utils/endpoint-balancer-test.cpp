@@ -0,0 +1,180 @@
+/** @file endpoint-balancer-test.cpp
+ * unit test of endpoint_balancer: the heap order and the heap index of
+ * the endpoints after add, remove, acquire and release, and the hash
+ * ring kept by ring_add / ring_remove against a ring built afresh
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/endpoint-balancer.h"
+
+using namespace std;
+using namespace zas::utils;
+
+namespace {
+
+struct endpoint
+{
+	balance_node node;
+	string identity;
+};
+
+class EndpointBalancerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override {
+		mt19937 gen(3);
+		uniform_int_distribution<int> pickw(1, 4);
+		uniform_int_distribution<int> pickl(0, 20);
+		_eps.resize(64);
+		for (size_t i = 0; i < _eps.size(); i++) {
+			_eps[i].identity = "endpoint-" + to_string(i);
+			endpoint_balancer::init_node(&_eps[i].node, pickl(gen), pickw(gen));
+		}
+	}
+
+	void add_all(endpoint_balancer &bal) {
+		for (auto& ep : _eps) {
+			ASSERT_EQ(0, bal.add(&ep.node, ep.identity));
+		}
+		ASSERT_EQ(_eps.size(), bal.size());
+		ASSERT_EQ(0, bal.verify());
+	}
+
+	// no endpoint in the balancer other than exclude is lighter than node
+	bool least_loaded(const balance_node* node, const balance_node* exclude) {
+		for (auto& ep : _eps) {
+			if (&ep.node == exclude || ep.node.heapidx < 0) continue;
+			if ((uint64_t)ep.node.load * node->weight
+				< (uint64_t)node->load * ep.node.weight) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	vector<endpoint> _eps;
+};
+
+}	// namespace
+
+TEST_F(EndpointBalancerTest, HeapAfterAddRemove)
+{
+	endpoint_balancer bal;
+	add_all(bal);
+	EXPECT_EQ(-EEXISTS, bal.add(&_eps[0].node, _eps[0].identity));
+
+	// the top, a leaf and endpoints in the middle of the heap
+	for (size_t i = 0; i < _eps.size(); i += 3) {
+		ASSERT_EQ(0, bal.remove(&_eps[i].node));
+		EXPECT_EQ(-1, _eps[i].node.heapidx);
+		ASSERT_EQ(0, bal.verify());
+	}
+	EXPECT_EQ(-ENOTFOUND, bal.remove(&_eps[0].node));
+	for (size_t i = 0; i < _eps.size(); i += 3) {
+		ASSERT_EQ(0, bal.add(&_eps[i].node, _eps[i].identity));
+		ASSERT_EQ(0, bal.verify());
+	}
+	EXPECT_EQ(_eps.size(), bal.size());
+}
+
+TEST_F(EndpointBalancerTest, HeapAfterAcquireRelease)
+{
+	for (int mode = balance_mode_least_loaded;
+		mode <= balance_mode_consistent_hash; mode++) {
+		SetUp();
+		endpoint_balancer bal;
+		ASSERT_EQ(0, bal.set_mode(mode));
+		add_all(bal);
+
+		mt19937 gen(5);
+		uniform_int_distribution<size_t> pick(0, _eps.size() - 1);
+		vector<balance_node*> owned;
+		for (int i = 0; i < 600; i++) {
+			string vid = "vehicle-" + to_string(i);
+			balance_node* exclude = (i % 7) ? nullptr : &_eps[pick(gen)].node;
+			auto* node = bal.acquire(&vid, exclude);
+			ASSERT_NE(nullptr, node);
+			EXPECT_NE(exclude, node);
+			owned.push_back(node);
+			ASSERT_EQ(0, bal.verify());
+			if (i % 3 == 2) {
+				size_t j = pick(gen) % owned.size();
+				bal.release(owned[j]);
+				owned.erase(owned.begin() + j);
+				ASSERT_EQ(0, bal.verify());
+			}
+		}
+		for (auto* node : owned) {
+			bal.release(node);
+		}
+		ASSERT_EQ(0, bal.verify());
+	}
+}
+
+TEST_F(EndpointBalancerTest, LeastLoadedIsTheTop)
+{
+	endpoint_balancer bal;
+	add_all(bal);
+	for (int i = 0; i < 500; i++) {
+		balance_node* exclude = (i % 2) ? &_eps[i % _eps.size()].node : nullptr;
+		// the load before the acquire is the one compared
+		auto* node = bal.acquire(nullptr, exclude);
+		ASSERT_NE(nullptr, node);
+		node->load--;
+		EXPECT_TRUE(least_loaded(node, exclude));
+		node->load++;
+	}
+	ASSERT_EQ(0, bal.verify());
+
+	ASSERT_EQ(0, bal.set_load(&_eps[10].node, 0));
+	ASSERT_EQ(0, bal.verify());
+	bal.reset_load();
+	ASSERT_EQ(0, bal.verify());
+}
+
+TEST_F(EndpointBalancerTest, RingAfterAddRemove)
+{
+	endpoint_balancer bal;
+	ASSERT_EQ(0, bal.set_mode(balance_mode_consistent_hash));
+	add_all(bal);
+	// the first hashed selection builds the ring
+	string vid = "vehicle-0";
+	ASSERT_NE(nullptr, bal.acquire(&vid));
+	ASSERT_EQ(0, bal.verify());
+
+	for (size_t i = 0; i < _eps.size(); i += 2) {
+		ASSERT_EQ(0, bal.remove(&_eps[i].node));
+		ASSERT_EQ(0, bal.verify());
+	}
+	for (size_t i = 0; i < _eps.size(); i += 4) {
+		ASSERT_EQ(0, bal.add(&_eps[i].node, _eps[i].identity));
+		ASSERT_EQ(0, bal.verify());
+	}
+	for (int i = 1; i < 200; i++) {
+		vid = "vehicle-" + to_string(i);
+		ASSERT_NE(nullptr, bal.acquire(&vid));
+	}
+	ASSERT_EQ(0, bal.verify());
+}
+
+TEST_F(EndpointBalancerTest, FullEndpoints)
+{
+	endpoint_balancer bal;
+	bal.set_capacity(1);
+	for (auto& ep : _eps) {
+		endpoint_balancer::init_node(&ep.node, 0, 1);
+	}
+	add_all(bal);
+	for (size_t i = 0; i < _eps.size(); i++) {
+		ASSERT_NE(nullptr, bal.acquire(nullptr));
+	}
+	EXPECT_EQ(nullptr, bal.acquire(nullptr));
+	bal.release(&_eps[5].node);
+	EXPECT_EQ(&_eps[5].node, bal.acquire(nullptr));
+	ASSERT_EQ(0, bal.verify());
+}
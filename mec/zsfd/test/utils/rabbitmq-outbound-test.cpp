@@ -0,0 +1,427 @@
+/** @file rabbitmq-outbound-test.cpp
+ * unit test of rabbitmq_outbound: the drop policies of a full queue,
+ * the order of the requeued messages, the trimming of requeue() and
+ * the publisher confirms read from a scripted peer
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/rabbitmq-outbound.h"
+
+using namespace std;
+using namespace zas::utils;
+
+namespace {
+
+int push(rabbitmq_outbound &ob, const string &body)
+{
+	return ob.push("exchange", "key", body.c_str(), body.length());
+}
+
+void push_range(rabbitmq_outbound &ob, int first, int last)
+{
+	for (int i = first; i <= last; i++) {
+		ASSERT_EQ(0, push(ob, to_string(i)));
+	}
+}
+
+vector<string> bodies(const vector<rabbitmq_message*> &batch)
+{
+	vector<string> ret;
+	for (auto* msg : batch) {
+		ret.push_back(msg->body);
+	}
+	return ret;
+}
+
+// pops and releases every queued message
+vector<string> drain(rabbitmq_outbound &ob)
+{
+	vector<rabbitmq_message*> batch;
+	ob.pop(batch, ob.depth(), 0);
+	auto ret = bodies(batch);
+	ob.release(batch);
+	return ret;
+}
+
+vector<string> range(int first, int last)
+{
+	vector<string> ret;
+	for (int i = first; i <= last; i++) {
+		ret.push_back(to_string(i));
+	}
+	return ret;
+}
+
+// a channel replaying a script of confirms, then failing with
+// "error" (a closed channel by default) once the script is over
+class fake_peer : public rabbitmq_confirm_peer
+{
+public:
+	fake_peer() : error(-ENOTCONN), reads(0) {}
+
+	void ack(uint64_t tag, bool multiple = false) {
+		_script.push_back({tag, multiple, false});
+	}
+
+	void nack(uint64_t tag, bool multiple = false) {
+		_script.push_back({tag, multiple, true});
+	}
+
+	int next_confirm(uint64_t &tag, bool &multiple, bool &nack) {
+		reads++;
+		if (_script.empty()) return error;
+		tag = _script.front().tag;
+		multiple = _script.front().multiple;
+		nack = _script.front().nack;
+		_script.pop_front();
+		return 0;
+	}
+
+	int error;
+	int reads;
+
+private:
+	struct confirm {
+		uint64_t tag;
+		bool multiple;
+		bool nack;
+	};
+	deque<confirm> _script;
+};
+
+// pops "count" messages published as the delivery tags from first on
+void publish(rabbitmq_outbound &ob, vector<rabbitmq_message*> &batch,
+	rabbitmq_confirms &confirms, size_t count, uint64_t first)
+{
+	ASSERT_EQ(count, ob.pop(batch, count, 0));
+	ob.on_published(count);
+	confirms.reset(first, count);
+}
+
+}	// namespace
+
+TEST(RabbitmqOutboundTest, PopInOrder)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	EXPECT_EQ(5u, ob.depth());
+
+	vector<rabbitmq_message*> batch;
+	EXPECT_EQ(3u, ob.pop(batch, 3, 0));
+	EXPECT_EQ(range(0, 2), bodies(batch));
+	EXPECT_EQ("exchange", batch[0]->exchange);
+	EXPECT_EQ("key", batch[0]->routingkey);
+	ob.release(batch);
+	EXPECT_TRUE(batch.empty());
+	EXPECT_EQ(range(3, 4), drain(ob));
+	EXPECT_EQ(0u, ob.pop(batch, 3, 0));
+}
+
+TEST(RabbitmqOutboundTest, BadParameters)
+{
+	rabbitmq_outbound ob(4, rabbitmq_drop_oldest, 0);
+	EXPECT_EQ(-EBADPARM, ob.push(nullptr, "key", "a", 1));
+	EXPECT_EQ(-EBADPARM, ob.push("exchange", "key", nullptr, 1));
+	EXPECT_EQ(-EBADPARM, ob.push("exchange", "key", "a", 0));
+	EXPECT_EQ(0u, ob.depth());
+}
+
+TEST(RabbitmqOutboundTest, DropOldest)
+{
+	rabbitmq_outbound ob(3, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	EXPECT_EQ(3u, ob.depth());
+
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(5u, stats.enqueued);
+	EXPECT_EQ(2u, stats.dropped);
+	EXPECT_EQ(3u, stats.depth);
+	EXPECT_EQ(range(2, 4), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, DropNewest)
+{
+	rabbitmq_outbound ob(3, rabbitmq_drop_newest, 0);
+	push_range(ob, 0, 2);
+	EXPECT_EQ(-ETOOMANYITEMS, push(ob, "3"));
+	EXPECT_EQ(-ETOOMANYITEMS, push(ob, "4"));
+
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(3u, stats.enqueued);
+	EXPECT_EQ(2u, stats.dropped);
+	EXPECT_EQ(range(0, 2), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, BlockTimesOut)
+{
+	rabbitmq_outbound ob(2, rabbitmq_drop_block, 50);
+	push_range(ob, 0, 1);
+	auto t0 = chrono::steady_clock::now();
+	EXPECT_EQ(-ETOOMANYITEMS, push(ob, "2"));
+	auto ms = chrono::duration_cast<chrono::milliseconds>(
+		chrono::steady_clock::now() - t0).count();
+	EXPECT_GE(ms, 40);
+
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(1u, stats.dropped);
+	EXPECT_EQ(range(0, 1), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, BlockUntilPopped)
+{
+	rabbitmq_outbound ob(2, rabbitmq_drop_block, 5000);
+	push_range(ob, 0, 1);
+	vector<rabbitmq_message*> batch;
+	thread consumer([&]() {
+		this_thread::sleep_for(chrono::milliseconds(20));
+		ob.pop(batch, 1, 0);
+	});
+	// waits for the consumer to make room instead of dropping
+	EXPECT_EQ(0, push(ob, "2"));
+	consumer.join();
+	EXPECT_EQ(range(0, 0), bodies(batch));
+	ob.release(batch);
+
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(0u, stats.dropped);
+	EXPECT_EQ(range(1, 2), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, RequeueKeepsOrder)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	vector<rabbitmq_message*> batch;
+	EXPECT_EQ(3u, ob.pop(batch, 3, 0));
+	push_range(ob, 5, 5);
+
+	// an unconfirmed batch goes back to the head
+	ob.requeue(batch);
+	EXPECT_TRUE(batch.empty());
+	EXPECT_EQ(6u, ob.depth());
+	EXPECT_EQ(range(0, 5), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, RequeueTrimsOldest)
+{
+	rabbitmq_outbound ob(4, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 3);
+	vector<rabbitmq_message*> batch;
+	EXPECT_EQ(2u, ob.pop(batch, 2, 0));
+	push_range(ob, 4, 5);
+
+	// 6 messages for 4 places, the requeued ones are the oldest
+	ob.requeue(batch);
+	EXPECT_EQ(4u, ob.depth());
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(2u, stats.dropped);
+	EXPECT_EQ(range(2, 5), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, RequeueTrimsNewest)
+{
+	rabbitmq_outbound ob(4, rabbitmq_drop_newest, 0);
+	push_range(ob, 0, 3);
+	vector<rabbitmq_message*> batch;
+	EXPECT_EQ(2u, ob.pop(batch, 2, 0));
+	push_range(ob, 4, 5);
+
+	ob.requeue(batch);
+	EXPECT_EQ(4u, ob.depth());
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(2u, stats.dropped);
+	EXPECT_EQ(range(0, 3), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, RecycledNodes)
+{
+	rabbitmq_outbound ob(4, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 1);
+	vector<rabbitmq_message*> batch;
+	ob.pop(batch, 2, 0);
+	auto* first = batch[0];
+	ob.release(batch);
+
+	// a released node is reused and holds the new message only
+	ASSERT_EQ(0, ob.push("other", "key2", "x", 1));
+	ob.pop(batch, 1, 0);
+	ASSERT_EQ(1u, batch.size());
+	EXPECT_EQ(first, batch[0]);
+	EXPECT_EQ("other", batch[0]->exchange);
+	EXPECT_EQ("key2", batch[0]->routingkey);
+	EXPECT_EQ("x", batch[0]->body);
+	ob.release(batch);
+}
+
+TEST(RabbitmqOutboundTest, DiscardAndStop)
+{
+	rabbitmq_outbound ob(8, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	EXPECT_EQ(5u, ob.discard());
+	EXPECT_EQ(0u, ob.depth());
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(5u, stats.dropped);
+
+	EXPECT_FALSE(ob.stopped());
+	ob.stop();
+	EXPECT_TRUE(ob.stopped());
+	EXPECT_EQ(-ENOTAVAIL, push(ob, "5"));
+
+	// a stopped queue does not wait for messages
+	vector<rabbitmq_message*> batch;
+	auto t0 = chrono::steady_clock::now();
+	EXPECT_EQ(0u, ob.pop(batch, 4, 5000));
+	EXPECT_LT(chrono::steady_clock::now() - t0, chrono::seconds(1));
+}
+
+TEST(RabbitmqOutboundTest, PolicyNames)
+{
+	EXPECT_EQ(rabbitmq_drop_oldest, rabbitmq_outbound::get_policy("drop-oldest"));
+	EXPECT_EQ(rabbitmq_drop_newest, rabbitmq_outbound::get_policy("drop-newest"));
+	EXPECT_EQ(rabbitmq_drop_block, rabbitmq_outbound::get_policy("block"));
+	EXPECT_EQ(rabbitmq_drop_oldest, rabbitmq_outbound::get_policy("unknown"));
+	EXPECT_EQ(rabbitmq_drop_oldest, rabbitmq_outbound::get_policy(nullptr));
+}
+
+TEST(RabbitmqOutboundTest, ConfirmsAck)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 3);
+	vector<rabbitmq_message*> batch;
+	rabbitmq_confirms confirms;
+	publish(ob, batch, confirms, 4, 11);
+
+	// out of order single acks, the tag of another batch is ignored
+	fake_peer peer;
+	peer.ack(12);
+	peer.ack(10);
+	peer.ack(11);
+	peer.ack(15);
+	peer.ack(14);
+	peer.ack(13);
+	EXPECT_EQ(0, confirms.wait(&peer));
+	EXPECT_EQ(0u, confirms.pending());
+	EXPECT_EQ(6, peer.reads);
+
+	EXPECT_EQ(4u, ob.settle(batch, confirms));
+	EXPECT_TRUE(batch.empty());
+	EXPECT_EQ(0u, ob.depth());
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(4u, stats.published);
+	EXPECT_EQ(4u, stats.confirmed);
+	EXPECT_EQ(0u, stats.nacked);
+}
+
+TEST(RabbitmqOutboundTest, ConfirmsNackIsRequeued)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	vector<rabbitmq_message*> batch;
+	rabbitmq_confirms confirms;
+	publish(ob, batch, confirms, 4, 1);
+
+	fake_peer peer;
+	peer.ack(1);
+	peer.nack(2);
+	peer.ack(3);
+	peer.nack(4);
+	// a second confirm of a settled tag changes nothing
+	EXPECT_EQ(0, confirms.wait(&peer));
+	EXPECT_EQ(0u, confirms.confirm(2, false, false));
+	EXPECT_EQ(rabbitmq_confirm_nack, confirms.state(1));
+
+	EXPECT_EQ(2u, ob.settle(batch, confirms));
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(2u, stats.confirmed);
+	EXPECT_EQ(2u, stats.nacked);
+	// the nacked ones go back before the message not yet published
+	EXPECT_EQ((vector<string>{"1", "3", "4"}), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, ConfirmsMultiple)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 5);
+	vector<rabbitmq_message*> batch;
+	rabbitmq_confirms confirms;
+	publish(ob, batch, confirms, 6, 101);
+
+	// a multiple nack up to 103 does not touch the acked 102, a
+	// multiple ack past the end of the batch covers the rest of it
+	fake_peer peer;
+	peer.ack(102);
+	peer.nack(103, true);
+	peer.ack(200, true);
+	EXPECT_EQ(0, confirms.wait(&peer));
+	EXPECT_EQ(3, peer.reads);
+	EXPECT_EQ(rabbitmq_confirm_nack, confirms.state(0));
+	EXPECT_EQ(rabbitmq_confirm_ack, confirms.state(1));
+	EXPECT_EQ(rabbitmq_confirm_nack, confirms.state(2));
+	EXPECT_EQ(rabbitmq_confirm_ack, confirms.state(5));
+
+	EXPECT_EQ(4u, ob.settle(batch, confirms));
+	EXPECT_EQ((vector<string>{"0", "2"}), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, ConfirmsChannelDies)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 4);
+	vector<rabbitmq_message*> batch;
+	rabbitmq_confirms confirms;
+	publish(ob, batch, confirms, 5, 21);
+
+	// the channel is closed after two of the five confirms
+	fake_peer peer;
+	peer.ack(21);
+	peer.ack(23);
+	EXPECT_EQ(-ENOTCONN, confirms.wait(&peer));
+	EXPECT_EQ(3u, confirms.pending());
+
+	// the producer went on while the publisher waited
+	push_range(ob, 5, 6);
+	EXPECT_EQ(2u, ob.settle(batch, confirms));
+	rabbitmq_outbound_stats stats;
+	ob.get_stats(stats);
+	EXPECT_EQ(2u, stats.confirmed);
+	EXPECT_EQ(0u, stats.nacked);
+	EXPECT_EQ((vector<string>{"1", "3", "4", "5", "6"}), drain(ob));
+}
+
+TEST(RabbitmqOutboundTest, ConfirmsTimeoutAndUnsent)
+{
+	rabbitmq_outbound ob(16, rabbitmq_drop_oldest, 0);
+	push_range(ob, 0, 3);
+	vector<rabbitmq_message*> batch;
+	ASSERT_EQ(4u, ob.pop(batch, 4, 0));
+
+	// only two of the batch were published before the publish failed
+	rabbitmq_confirms confirms;
+	confirms.reset(7, 2);
+	fake_peer peer;
+	peer.error = -ETIMEOUT;
+	peer.ack(8);
+	EXPECT_EQ(-ETIMEOUT, confirms.wait(&peer));
+	EXPECT_EQ(1u, confirms.pending());
+	EXPECT_EQ(rabbitmq_confirm_pending, confirms.state(3));
+
+	EXPECT_EQ(1u, ob.settle(batch, confirms));
+	EXPECT_EQ((vector<string>{"0", "2", "3"}), drain(ob));
+	EXPECT_EQ(-EBADPARM, confirms.wait(nullptr));
+}
@@ -0,0 +1,401 @@
+/** @file endpoint-balancer.cpp
+ * implementation of the selection of the endpoint of a server
+ */
+
+#include "utils/utils.h"
+#ifdef UTILS_ENABLE_FBLOCK_BALANCER
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "utils/endpoint-balancer.h"
+
+namespace zas {
+namespace utils {
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return x;
+}
+
+endpoint_balancer::endpoint_balancer()
+: _mode(balance_mode_least_loaded)
+, _capacity(0)
+, _seed(mix64((uint64_t)time(nullptr) ^ (uint64_t)(size_t)this))
+, _total_load(0)
+, _total_weight(0)
+, _ring_dirty(true)
+{
+}
+
+endpoint_balancer::~endpoint_balancer()
+{
+	for (auto* node : _heap) {
+		node->heapidx = -1;
+	}
+	_heap.clear();
+	_ring.clear();
+}
+
+void endpoint_balancer::init_node(balance_node* node,
+	size_t load, uint32_t weight)
+{
+	assert(nullptr != node);
+	node->load = load;
+	if (!weight) weight = 1;
+	else if (weight > BALANCE_MAX_WEIGHT) weight = BALANCE_MAX_WEIGHT;
+	node->weight = weight;
+	node->heapidx = -1;
+	node->ringkey = 0;
+}
+
+int endpoint_balancer::parse_mode(const char* mode)
+{
+	if (!mode || !*mode || !strcmp(mode, "least-loaded")) {
+		return balance_mode_least_loaded;
+	}
+	if (!strcmp(mode, "two-choices")) {
+		return balance_mode_two_choices;
+	}
+	if (!strcmp(mode, "consistent-hash")) {
+		return balance_mode_consistent_hash;
+	}
+	return -EBADPARM;
+}
+
+int endpoint_balancer::set_mode(int mode)
+{
+	if (mode < balance_mode_least_loaded
+		|| mode > balance_mode_consistent_hash) {
+		return -EBADPARM;
+	}
+	_mode = mode;
+	_ring_dirty = true;
+	return 0;
+}
+
+uint64_t endpoint_balancer::hash(const void* data, size_t sz, uint64_t seed)
+{
+	uint64_t h = 14695981039346656037ULL ^ seed;
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < sz; i++) {
+		h = (h ^ p[i]) * 1099511628211ULL;
+	}
+	return mix64(h);
+}
+
+uint64_t endpoint_balancer::next_random(void)
+{
+	_seed += 0x9E3779B97F4A7C15ULL;
+	return mix64(_seed);
+}
+
+void endpoint_balancer::sift_up(int idx)
+{
+	auto* node = _heap[idx];
+	while (idx > 0) {
+		int parent = (idx - 1) / 2;
+		if (!lighter(node, _heap[parent])) {
+			break;
+		}
+		_heap[idx] = _heap[parent];
+		_heap[idx]->heapidx = idx;
+		idx = parent;
+	}
+	_heap[idx] = node;
+	node->heapidx = idx;
+}
+
+void endpoint_balancer::sift_down(int idx)
+{
+	int cnt = (int)_heap.size();
+	auto* node = _heap[idx];
+	for (;;) {
+		int child = idx * 2 + 1;
+		if (child >= cnt) {
+			break;
+		}
+		if (child + 1 < cnt && lighter(_heap[child + 1], _heap[child])) {
+			child++;
+		}
+		if (!lighter(_heap[child], node)) {
+			break;
+		}
+		_heap[idx] = _heap[child];
+		_heap[idx]->heapidx = idx;
+		idx = child;
+	}
+	_heap[idx] = node;
+	node->heapidx = idx;
+}
+
+void endpoint_balancer::update(balance_node* node)
+{
+	if (node->heapidx < 0) {
+		return;
+	}
+	sift_up(node->heapidx);
+	sift_down(node->heapidx);
+}
+
+int endpoint_balancer::add(balance_node* node, const std::string &key)
+{
+	if (!node) {
+		return -EBADPARM;
+	}
+	if (node->heapidx >= 0) {
+		return -EEXISTS;
+	}
+	node->ringkey = hash(key.c_str(), key.length());
+	_heap.push_back(node);
+	sift_up((int)_heap.size() - 1);
+	_total_load += node->load;
+	_total_weight += node->weight;
+	if (!_ring_dirty && _mode == balance_mode_consistent_hash) {
+		ring_add(node);
+	}
+	return 0;
+}
+
+int endpoint_balancer::remove(balance_node* node)
+{
+	if (!node || node->heapidx < 0) {
+		return -ENOTFOUND;
+	}
+	int idx = node->heapidx;
+	assert(idx < (int)_heap.size() && _heap[idx] == node);
+	auto* last = _heap.back();
+	_heap.pop_back();
+	if (last != node) {
+		_heap[idx] = last;
+		last->heapidx = idx;
+		update(last);
+	}
+	node->heapidx = -1;
+	_total_load -= std::min(_total_load, node->load);
+	_total_weight -= node->weight;
+	if (!_ring_dirty && _mode == balance_mode_consistent_hash) {
+		ring_remove(node);
+	}
+	return 0;
+}
+
+int endpoint_balancer::set_load(balance_node* node, size_t load)
+{
+	if (!node) {
+		return -EBADPARM;
+	}
+	if (node->heapidx >= 0) {
+		_total_load = _total_load - std::min(_total_load, node->load) + load;
+	}
+	node->load = load;
+	update(node);
+	return 0;
+}
+
+void endpoint_balancer::reset_load(void)
+{
+	// every key is 0, the heap stays ordered
+	for (auto* node : _heap) {
+		node->load = 0;
+	}
+	_total_load = 0;
+}
+
+balance_node* endpoint_balancer::acquire(const std::string* vehicle_id,
+	balance_node* exclude)
+{
+	if (_heap.empty()) {
+		return nullptr;
+	}
+	balance_node* node = nullptr;
+	if (_mode == balance_mode_consistent_hash
+		&& vehicle_id && vehicle_id->length()) {
+		node = consistent_hash(*vehicle_id, exclude);
+	} else if (_mode == balance_mode_two_choices) {
+		node = two_choices(exclude);
+	}
+	if (!node) {
+		node = least_loaded(exclude);
+	}
+	if (!node) {
+		return nullptr;
+	}
+	node->load++;
+	_total_load++;
+	sift_down(node->heapidx);
+	return node;
+}
+
+void endpoint_balancer::release(balance_node* node)
+{
+	if (!node || !node->load) {
+		return;
+	}
+	node->load--;
+	if (node->heapidx >= 0) {
+		if (_total_load) _total_load--;
+		sift_up(node->heapidx);
+	}
+}
+
+balance_node* endpoint_balancer::least_loaded(balance_node* exclude)
+{
+	auto* node = _heap[0];
+	if (node == exclude) {
+		// the next least loaded is one of the children of the top
+		size_t cnt = _heap.size();
+		if (cnt < 2) {
+			return nullptr;
+		}
+		node = _heap[1];
+		if (cnt > 2 && lighter(_heap[2], node)) {
+			node = _heap[2];
+		}
+	}
+	// no other one has less load for its weight
+	return full(node) ? nullptr : node;
+}
+
+balance_node* endpoint_balancer::two_choices(balance_node* exclude)
+{
+	size_t cnt = _heap.size();
+	if (cnt < 3) {
+		return nullptr;
+	}
+	uint64_t r = next_random();
+	size_t a = (size_t)(r % cnt);
+	size_t b = (size_t)((r >> 32) % (cnt - 1));
+	if (b >= a) b++;
+	auto* na = _heap[a];
+	auto* nb = _heap[b];
+	if (na == exclude || full(na)) na = nullptr;
+	if (nb == exclude || full(nb)) nb = nullptr;
+	if (!na) return nb;
+	if (!nb) return na;
+	return lighter(nb, na) ? nb : na;
+}
+
+void endpoint_balancer::ring_points(balance_node* node,
+	std::vector<ring_point> &ring)
+{
+	size_t points = (size_t)node->weight * BALANCE_RING_POINTS;
+	for (size_t i = 0; i < points; i++) {
+		ring_point pt;
+		pt.hash = mix64(node->ringkey + i * 0x9E3779B97F4A7C15ULL);
+		pt.node = node;
+		ring.push_back(pt);
+	}
+}
+
+void endpoint_balancer::build_ring(void)
+{
+	_ring.clear();
+	for (auto* node : _heap) {
+		ring_points(node, _ring);
+	}
+	std::sort(_ring.begin(), _ring.end());
+	_ring_dirty = false;
+}
+
+void endpoint_balancer::ring_add(balance_node* node)
+{
+	// merge the sorted points of the endpoint, no sort of the ring
+	size_t cnt = _ring.size();
+	ring_points(node, _ring);
+	std::sort(_ring.begin() + cnt, _ring.end());
+	std::inplace_merge(_ring.begin(), _ring.begin() + cnt, _ring.end());
+}
+
+void endpoint_balancer::ring_remove(balance_node* node)
+{
+	_ring.erase(std::remove_if(_ring.begin(), _ring.end(),
+		[node](const ring_point &pt) { return pt.node == node; }),
+		_ring.end());
+}
+
+balance_node* endpoint_balancer::consistent_hash(
+	const std::string &vehicle_id, balance_node* exclude)
+{
+	if (_ring_dirty) {
+		build_ring();
+	}
+	if (_ring.empty()) {
+		return nullptr;
+	}
+	ring_point pt;
+	pt.hash = hash(vehicle_id.c_str(), vehicle_id.length());
+	pt.node = nullptr;
+	size_t idx = std::lower_bound(_ring.begin(), _ring.end(), pt)
+		- _ring.begin();
+
+	// bounded load: go on clockwise when the endpoint of the vehicle
+	// holds more than its share of the load
+	double share = BALANCE_HASH_LOAD_FACTOR * (_total_load + 1)
+		/ _total_weight;
+	size_t cnt = _ring.size();
+	for (size_t i = 0; i < cnt; i++) {
+		auto* node = _ring[(idx + i) % cnt].node;
+		if (node == exclude || full(node)) {
+			continue;
+		}
+		if (node->load + 1 <= ceil(share * node->weight)) {
+			return node;
+		}
+	}
+	return nullptr;
+}
+
+int endpoint_balancer::verify(void) const
+{
+	size_t load = 0, weight = 0;
+	for (size_t i = 0; i < _heap.size(); i++) {
+		auto* node = _heap[i];
+		if (node->heapidx != (int)i) {
+			return -ELOGIC;
+		}
+		if (i && lighter(node, _heap[(i - 1) / 2])) {
+			return -ELOGIC;
+		}
+		load += node->load;
+		weight += node->weight;
+	}
+	if (load != _total_load || weight != _total_weight) {
+		return -ELOGIC;
+	}
+	if (_ring_dirty) {
+		return 0;
+	}
+
+	std::vector<ring_point> ring;
+	for (auto* node : _heap) {
+		ring_points(node, ring);
+	}
+	std::sort(ring.begin(), ring.end());
+	if (ring.size() != _ring.size()) {
+		return -ELOGIC;
+	}
+	for (size_t i = 0; i < ring.size(); i++) {
+		if (ring[i].hash != _ring[i].hash) {
+			return -ELOGIC;
+		}
+		// points of the same hash may be in any order
+		if (ring[i].node != _ring[i].node
+			&& (!i || ring[i].hash != ring[i - 1].hash)
+			&& (i + 1 == ring.size() || ring[i].hash != ring[i + 1].hash)) {
+			return -ELOGIC;
+		}
+	}
+	return 0;
+}
+
+}} // end of namespace zas::utils
+#endif // UTILS_ENABLE_FBLOCK_BALANCER
+/* EOF */
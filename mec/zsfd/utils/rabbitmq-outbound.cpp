@@ -0,0 +1,314 @@
+/** @file rabbitmq-outbound.cpp
+ * implementation of the outbound queue of a rabbitmq publisher thread
+ */
+
+#include "utils/utils.h"
+#if (defined(UTILS_ENABLE_FBLOCK_MQOUTBOUND) && defined(UTILS_ENABLE_FBLOCK_WAIT))
+
+#include <assert.h>
+#include <string.h>
+#include "utils/rabbitmq-outbound.h"
+
+namespace zas {
+namespace utils {
+
+rabbitmq_confirms::rabbitmq_confirms()
+: _first(0), _pending(0)
+{
+}
+
+void rabbitmq_confirms::reset(uint64_t first, size_t count)
+{
+	_first = first;
+	_pending = count;
+	_states.assign(count, rabbitmq_confirm_pending);
+}
+
+size_t rabbitmq_confirms::confirm(uint64_t tag, bool multiple, bool nack)
+{
+	if (!_pending || tag < _first) {
+		return _pending;
+	}
+	size_t last = tag - _first;
+	if (last >= _states.size()) {
+		// a single confirm of another batch
+		if (!multiple) return _pending;
+		last = _states.size() - 1;
+	}
+	uint8_t state = nack ? rabbitmq_confirm_nack : rabbitmq_confirm_ack;
+	size_t i = multiple ? 0 : last;
+	for (; i <= last; i++) {
+		if (rabbitmq_confirm_pending == _states[i]) {
+			_states[i] = state;
+			_pending--;
+		}
+	}
+	return _pending;
+}
+
+int rabbitmq_confirms::wait(rabbitmq_confirm_peer* peer)
+{
+	if (!peer) {
+		return -EBADPARM;
+	}
+	while (_pending) {
+		uint64_t tag = 0;
+		bool multiple = false, nack = false;
+		int ret = peer->next_confirm(tag, multiple, nack);
+		if (ret) return ret;
+		confirm(tag, multiple, nack);
+	}
+	return 0;
+}
+
+size_t rabbitmq_confirms::count(void) const
+{
+	return _states.size();
+}
+
+size_t rabbitmq_confirms::pending(void) const
+{
+	return _pending;
+}
+
+rabbitmq_confirm_state rabbitmq_confirms::state(size_t i) const
+{
+	if (i >= _states.size()) {
+		return rabbitmq_confirm_pending;
+	}
+	return (rabbitmq_confirm_state)_states[i];
+}
+
+rabbitmq_outbound::rabbitmq_outbound(size_t capacity,
+	rabbitmq_drop_policy policy, uint32_t block_ms)
+: _count(0)
+, _capacity(capacity ? capacity : 1)
+, _policy(policy)
+, _block_ms(block_ms)
+, _stopped(false)
+{
+	listnode_init(_queue);
+	listnode_init(_freelist);
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+rabbitmq_outbound::~rabbitmq_outbound()
+{
+	while (!listnode_isempty(_queue)) {
+		auto* msg = LIST_ENTRY(rabbitmq_message, ownerlist, _queue.next);
+		listnode_del(msg->ownerlist);
+		delete msg;
+	}
+	while (!listnode_isempty(_freelist)) {
+		auto* msg = LIST_ENTRY(rabbitmq_message, ownerlist, _freelist.next);
+		listnode_del(msg->ownerlist);
+		delete msg;
+	}
+	_count = 0;
+}
+
+rabbitmq_drop_policy rabbitmq_outbound::get_policy(const char* name)
+{
+	if (name && !strcmp(name, "drop-newest")) {
+		return rabbitmq_drop_newest;
+	}
+	if (name && !strcmp(name, "block")) {
+		return rabbitmq_drop_block;
+	}
+	return rabbitmq_drop_oldest;
+}
+
+rabbitmq_message* rabbitmq_outbound::alloc_message(void)
+{
+	// the nodes are recycled to keep the capacity of their strings
+	if (listnode_isempty(_freelist)) {
+		auto* msg = new rabbitmq_message;
+		listnode_init(msg->ownerlist);
+		return msg;
+	}
+	auto* msg = LIST_ENTRY(rabbitmq_message, ownerlist, _freelist.next);
+	listnode_del(msg->ownerlist);
+	return msg;
+}
+
+void rabbitmq_outbound::free_message(rabbitmq_message* msg)
+{
+	assert(nullptr != msg);
+	listnode_add(_freelist, msg->ownerlist);
+}
+
+void rabbitmq_outbound::drop_message(bool oldest)
+{
+	assert(!listnode_isempty(_queue));
+	listnode_t* nd = oldest ? _queue.next : _queue.prev;
+	auto* msg = LIST_ENTRY(rabbitmq_message, ownerlist, nd);
+	listnode_del(msg->ownerlist);
+	free_message(msg);
+	_count--;
+	_stats.dropped++;
+}
+
+int rabbitmq_outbound::push(const char* exchange,
+	const std::string &routingkey, const void* data, size_t sz)
+{
+	if (!exchange || !data || !sz) {
+		return -EBADPARM;
+	}
+	_wait.lock();
+	if (_stopped) {
+		_wait.unlock();
+		return -ENOTAVAIL;
+	}
+	if (_count >= _capacity && rabbitmq_drop_block == _policy) {
+		_wait.wait(_block_ms);
+	}
+	if (_count >= _capacity) {
+		if (rabbitmq_drop_oldest != _policy) {
+			_stats.dropped++;
+			_wait.unlock();
+			return -ETOOMANYITEMS;
+		}
+		drop_message(true);
+	}
+	auto* msg = alloc_message();
+	msg->exchange.assign(exchange);
+	msg->routingkey.assign(routingkey);
+	msg->body.assign((const char*)data, sz);
+	listnode_add(_queue, msg->ownerlist);
+	_count++;
+	_stats.enqueued++;
+	_wait.broadcast();
+	_wait.unlock();
+	return 0;
+}
+
+size_t rabbitmq_outbound::pop(std::vector<rabbitmq_message*> &batch,
+	size_t max, uint32_t msec)
+{
+	batch.clear();
+	_wait.lock();
+	if (!_count && !_stopped) {
+		_wait.wait(msec);
+	}
+	while (_count && batch.size() < max) {
+		auto* msg = LIST_ENTRY(rabbitmq_message, ownerlist, _queue.next);
+		listnode_del(msg->ownerlist);
+		_count--;
+		batch.push_back(msg);
+	}
+	// room for the blocked producers
+	if (batch.size()) {
+		_wait.broadcast();
+	}
+	_wait.unlock();
+	return batch.size();
+}
+
+void rabbitmq_outbound::requeue(std::vector<rabbitmq_message*> &batch)
+{
+	_wait.lock();
+	for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+		auto* msg = *it;
+		listnode_insertfirst(_queue, msg->ownerlist);
+		_count++;
+	}
+	batch.clear();
+	// the requeued messages are the oldest ones
+	while (_count > _capacity) {
+		drop_message(rabbitmq_drop_oldest == _policy);
+	}
+	_wait.unlock();
+}
+
+void rabbitmq_outbound::release(std::vector<rabbitmq_message*> &batch)
+{
+	_wait.lock();
+	for (auto* msg : batch) {
+		free_message(msg);
+	}
+	_wait.unlock();
+	batch.clear();
+}
+
+size_t rabbitmq_outbound::settle(std::vector<rabbitmq_message*> &batch,
+	const rabbitmq_confirms &confirms)
+{
+	// the unconfirmed messages are kept at the front, in order
+	size_t acked = 0, nacked = 0, kept = 0;
+	_wait.lock();
+	for (size_t i = 0; i < batch.size(); i++) {
+		auto state = confirms.state(i);
+		if (rabbitmq_confirm_ack == state) {
+			free_message(batch[i]);
+			acked++;
+			continue;
+		}
+		if (rabbitmq_confirm_nack == state) {
+			nacked++;
+		}
+		batch[kept++] = batch[i];
+	}
+	_stats.confirmed += acked;
+	_stats.nacked += nacked;
+	_wait.unlock();
+	batch.resize(kept);
+	if (kept) {
+		requeue(batch);
+	}
+	return acked;
+}
+
+size_t rabbitmq_outbound::discard(void)
+{
+	_wait.lock();
+	size_t ret = _count;
+	while (_count) {
+		drop_message(true);
+	}
+	_wait.broadcast();
+	_wait.unlock();
+	return ret;
+}
+
+void rabbitmq_outbound::stop(void)
+{
+	_wait.lock();
+	_stopped = true;
+	_wait.broadcast();
+	_wait.unlock();
+}
+
+bool rabbitmq_outbound::stopped(void)
+{
+	_wait.lock();
+	bool ret = _stopped;
+	_wait.unlock();
+	return ret;
+}
+
+size_t rabbitmq_outbound::depth(void)
+{
+	_wait.lock();
+	size_t ret = _count;
+	_wait.unlock();
+	return ret;
+}
+
+void rabbitmq_outbound::on_published(size_t cnt)
+{
+	_wait.lock();
+	_stats.published += cnt;
+	_wait.unlock();
+}
+
+void rabbitmq_outbound::get_stats(rabbitmq_outbound_stats &stats)
+{
+	_wait.lock();
+	stats = _stats;
+	stats.depth = _count;
+	_wait.unlock();
+}
+
+}} // end of namespace zas::utils
+#endif // UTILS_ENABLE_FBLOCK_MQOUTBOUND && UTILS_ENABLE_FBLOCK_WAIT
+/* EOF */
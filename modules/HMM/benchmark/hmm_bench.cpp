@@ -0,0 +1,140 @@
+// benchmark of the lane-level viterbi on a synthetic trajectory
+// usage: hmm_bench <hdmap file> <lanesec json> [points]
+#include <Eigen/Dense>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "HMM/hmm_loc.h"
+#include "common/math/tools.h"
+
+using namespace civ::V2I;
+using namespace civ::V2I::modules;
+
+// the dense viterbi of viterbiAlgorithmHDMap2 before the sparse lattice, for comparison
+static std::vector<uint64_t> DenseViterbi(sp_cZTrajectory observations, zas::mapcore::hdmap &hdmap, double range)
+{
+    auto emission = [&hdmap](uint64_t lane, const Eigen::Vector3d &pt) {
+        Eigen::Vector3d cross_pt_curve_enu;
+        double w = 3.5;
+        double d = hdmap.get_distance_pt_curve_enu(pt, lane, cross_pt_curve_enu);
+        return (d < 0) ? 0. : civ::common::math::CDF_normal(-w / 2, w / 2, 4, d) / w;
+    };
+
+    int T = observations->points_.size();
+    std::vector<uint64_t> lanes = hdmap.get_lanes_near_pt_enu(observations->points_, range);
+    int num_states = lanes.size();
+    std::vector<std::vector<uint64_t>> time_nodes;
+    Eigen::MatrixXd delta = Eigen::MatrixXd::Zero(T, num_states);
+    Eigen::MatrixXi psi = Eigen::MatrixXi::Zero(T, num_states);
+    time_nodes.push_back(lanes);
+    for (int s = 0; s < num_states; ++s)
+    {
+        delta(0, s) = 1. / num_states * emission(lanes[s], observations->points_[0]);
+    }
+    for (int t = 1; t < T; ++t)
+    {
+        std::vector<uint64_t> lanes_neighbour = hdmap.get_lanes_near_pt_enu(observations->points_[t], range);
+        time_nodes.push_back(lanes_neighbour);
+        Eigen::MatrixXd transition = hdmap.CalculateTransitionalProbability(time_nodes[t - 1], lanes_neighbour);
+        for (int s = 0; s < (int)lanes_neighbour.size(); s++)
+        {
+            double max_prob = 0.0;
+            int max_state = 0;
+            for (int s_prev = 0; s_prev < (int)time_nodes[t - 1].size(); ++s_prev)
+            {
+                double prob = delta(t - 1, s_prev) * transition(s_prev, s) * emission(lanes_neighbour[s], observations->points_[t]);
+                if (prob > max_prob)
+                {
+                    max_prob = prob;
+                    max_state = s_prev;
+                }
+            }
+            delta(t, s) = max_prob;
+            psi(t, s) = max_state;
+        }
+    }
+    int best = 0;
+    for (int s = 0; s < (int)time_nodes[T - 1].size(); ++s)
+    {
+        if (delta(T - 1, s) > delta(T - 1, best))
+        {
+            best = s;
+        }
+    }
+    std::vector<uint64_t> best_states(T);
+    for (int t = T - 1; t >= 0; --t)
+    {
+        best_states[t] = (best < (int)time_nodes[t].size()) ? time_nodes[t][best] : HMM_NO_LANE;
+        if (t > 0)
+        {
+            best = psi(t, best);
+        }
+    }
+    return best_states;
+}
+
+// drive along the lane center lines, following the lane transitions
+static spZTrajectory GenerateTrajectory(zas::mapcore::hdmap &hdmap, int count)
+{
+    spZTrajectory trajectory = std::make_shared<ZTrajectory>();
+    std::mt19937 gen(1);
+    std::normal_distribution<double> noise(0., 1.5);
+    std::vector<zas::mapcore::Curve> curves = hdmap.get_central_curves_enu();
+    if (curves.empty())
+    {
+        return trajectory;
+    }
+    uint64_t lane = curves[0].id;
+    while ((int)trajectory->points_.size() < count)
+    {
+        for (const auto &pt : hdmap.get_curve(lane))
+        {
+            trajectory->points_.push_back(pt + Eigen::Vector3d(noise(gen), noise(gen), 0.));
+        }
+        const uint64_t *next_lanes = nullptr;
+        int next_count = hdmap.get_lane_transitions(lane, next_lanes);
+        lane = (next_count > 0) ? next_lanes[gen() % next_count] : curves[gen() % curves.size()].id;
+    }
+    trajectory->points_.resize(count);
+    return trajectory;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: " << argv[0] << " <hdmap file> <lanesec json> [points]" << std::endl;
+        return 1;
+    }
+    int count = (argc > 3) ? atoi(argv[3]) : 10000;
+    std::shared_ptr<zas::mapcore::hdmap> sp_hdmap = std::make_shared<zas::mapcore::hdmap>();
+    if (sp_hdmap->load_fromfile(argv[1]) || sp_hdmap->generate_lanesect_transition(argv[2]))
+    {
+        std::cout << "fail to load the map" << std::endl;
+        return 2;
+    }
+    std::shared_ptr<HMMLoc> sp_model = std::make_shared<HMMLoc>();
+    sp_model->SetHDMap(sp_hdmap);
+    spZTrajectory trajectory = GenerateTrajectory(*sp_hdmap, count);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint64_t> dense = DenseViterbi(trajectory, *sp_hdmap, 5.0);
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<uint64_t> sparse = sp_model->viterbiAlgorithmHDMap2(trajectory);
+    auto t2 = std::chrono::steady_clock::now();
+
+    double dense_s = std::chrono::duration<double>(t1 - t0).count();
+    double sparse_s = std::chrono::duration<double>(t2 - t1).count();
+    int same = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        same += (dense[i] == sparse[i]) ? 1 : 0;
+    }
+    std::cout << "points: " << count << std::endl;
+    std::cout << "dense  viterbi: " << count / dense_s << " points/s" << std::endl;
+    std::cout << "sparse viterbi: " << count / sparse_s << " points/s" << std::endl;
+    std::cout << "same lanes: " << same << "/" << count << std::endl;
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "modules/HMM/hmm_loc.h"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <math.h>
 #include "common/math/tools.h"
@@ -19,6 +21,7 @@ namespace civ
 
                 sp_map_ = std::make_shared<civ::V2I::map::CivMap>();
                 sp_hdmap_ = std::make_shared<zas::mapcore::hdmap>();
+                sp_lane_map_ = std::make_shared<HDMapLanes>(sp_hdmap_);
 
                 initial_range_ = 5.0;
             }
@@ -31,6 +34,7 @@ namespace civ
             {
                 sp_hdmap_->load_fromfile(map_path.c_str());
                 sp_hdmap_->generate_lanesect_transition(json_path.c_str());
+                sp_lane_map_ = std::make_shared<HDMapLanes>(sp_hdmap_);
             }
             void HMMLoc::ReadMap(std::string map_path)
             {
@@ -40,6 +44,28 @@ namespace civ
             void HMMLoc::SetHDMap(std::shared_ptr<zas::mapcore::hdmap> sp_hdmap)
             {
                 sp_hdmap_ = sp_hdmap;
+                sp_lane_map_ = std::make_shared<HDMapLanes>(sp_hdmap_);
+            }
+
+            void HMMLoc::SetLaneMap(std::shared_ptr<LaneMap> sp_lane_map)
+            {
+                sp_lane_map_ = sp_lane_map;
+            }
+
+            std::vector<uint64_t> HDMapLanes::get_lanes_near_pt_enu(const Eigen::Vector3d &pt_enu, double range)
+            {
+                return sp_hdmap_->get_lanes_near_pt_enu(pt_enu, range);
+            }
+
+            int HDMapLanes::get_lane_transitions(uint64_t lane, const uint64_t *&lanes)
+            {
+                return sp_hdmap_->get_lane_transitions(lane, lanes);
+            }
+
+            double HDMapLanes::get_distance_pt_lane_enu(const Eigen::Vector3d &pt_enu, uint64_t lane)
+            {
+                Eigen::Vector3d cross_pt_curve_enu;
+                return sp_hdmap_->get_distance_pt_curve_enu(pt_enu, lane, cross_pt_curve_enu);
             }
             std::vector<int> HMMLoc::viterbiAlgorithm(const std::vector<int> &observations)
             {
@@ -334,134 +360,262 @@ namespace civ
 
             std::vector<uint64_t> HMMLoc::viterbiAlgorithmHDMap2(sp_cZTrajectory observations, std::shared_ptr<zas::mapcore::hdmap> sp_hdmap)
             {
-
                 int T = observations->points_.size();
                 std::vector<uint64_t> best_states;
                 if (T < 1)
                 {
                     return best_states;
                 }
-                // generate states which contain the curves near the observation points
-                // the range is given by initial_range_, ex. 5 meters
-                std::vector<uint64_t> lanes = sp_hdmap->get_lanes_near_pt_enu(observations->points_, initial_range_);
-                // Initialization step
-                // Calculate the transitional probability
-                int num_states = lanes.size();
-                // the candidate states for each time epoch
-                std::vector<std::vector<uint64_t>> time_nodes;
 
-                Eigen::MatrixXd transition_matrix = sp_hdmap->CalculateTransitionalProbability(lanes, lanes);
-                std::cout << "lanes" << std::endl;
-                print_vec(lanes);
-                std::cout << "transition matrix" << std::endl;
-                std::cout << transition_matrix << std::endl;
+                // the sparse lattice: candidates and back pointers of time t are stored in
+                // lattice_lanes[offsets[t] ... offsets[t + 1]) and lattice_psi, only the
+                // log probabilities of the previous time are kept
+                std::vector<uint64_t> lattice_lanes;
+                std::vector<int> lattice_psi;
+                std::vector<size_t> offsets(T + 1, 0);
+                // the best candidate of each time, used to continue backtracking when the path is broken
+                std::vector<int> column_best(T, -1);
+
+                HDMapLanes lane_map(sp_hdmap);
+                LatticeColumn prev, column;
+                bool has_prev = false;
+                for (int t = 0; t < T; ++t)
+                {
+                    // process only the cadidate states near to observation
+                    // the range is given by initial_range_, ex. 5 meters
+                    column.frame_ = t;
+                    column.lanes_ = lane_map.get_lanes_near_pt_enu(observations->points_[t], initial_range_);
+                    bool connected = false;
+                    int best = ViterbiStep(lane_map, has_prev ? &prev : nullptr, column, observations->points_[t], connected);
+
+                    offsets[t] = lattice_lanes.size();
+                    lattice_lanes.insert(lattice_lanes.end(), column.lanes_.begin(), column.lanes_.end());
+                    lattice_psi.insert(lattice_psi.end(), column.psi_.begin(), column.psi_.end());
+                    offsets[t + 1] = lattice_lanes.size();
+                    column_best[t] = best;
+
+                    has_prev = (best >= 0);
+                    if (has_prev)
+                    {
+                        std::swap(prev, column);
+                    }
+                }
 
-                // The maximum probability of a given node
-                Eigen::MatrixXd delta = Eigen::MatrixXd::Zero(T, num_states);
-                // the path of a given node
-                Eigen::MatrixXi psi = Eigen::MatrixXi::Zero(T, num_states);
-                // the best state for the observation
-                std::vector<int> best_path(T);
+                // termination step, select the maximum probability, and backtrack to find the best path
+                best_states.resize(T);
+                int idx = column_best[T - 1];
+                for (int t = T - 1; t >= 0; --t)
+                {
+                    best_states[t] = (idx < 0) ? HMM_NO_LANE : lattice_lanes[offsets[t] + idx];
+                    if (t == 0)
+                    {
+                        break;
+                    }
+                    int prev_idx = (idx < 0) ? -1 : lattice_psi[offsets[t] + idx];
+                    idx = (prev_idx < 0) ? column_best[t - 1] : prev_idx;
+                }
+                return best_states;
+            }
 
-                Eigen::MatrixXi mask = Eigen::MatrixXi::Zero(T, num_states);
+            int HMMLoc::ViterbiStep(LaneMap &lane_map, const LatticeColumn *prev,
+                                    LatticeColumn &column, const Eigen::Vector3d &pt_enu, bool &connected)
+            {
+                const double neg_inf = -std::numeric_limits<double>::infinity();
+                int num_states = column.lanes_.size();
+                connected = false;
+                column.log_delta_.assign(num_states, neg_inf);
+                column.psi_.assign(num_states, -1);
+                if (num_states == 0)
+                {
+                    return -1;
+                }
 
-                // calculate the initial probability
-                // only the lane state candidate within the range of first observation will be calculated
-                Eigen::VectorXd initial_probs = Eigen::VectorXd::Zero(num_states);
-                std::vector<uint64_t> initial_states;
+                // the emission only depends on the candidate, calculate it once
+                std::vector<double> log_emission(num_states);
                 for (int s = 0; s < num_states; ++s)
                 {
-                    initial_probs(s) = 1;
-                    initial_states.push_back(lanes[s]);
+                    log_emission[s] = std::log(EmissionProbability(lane_map, column.lanes_[s], pt_enu));
                 }
 
-                time_nodes.push_back(initial_states);
-                // normalize
-                initial_probs = initial_probs / initial_probs.sum();
-                std::cout << "-------------------------" << std::endl;
-                std::cout << "initial_probs:" << initial_probs.transpose() << std::endl;
+                if (prev != nullptr && !prev->lanes_.empty())
+                {
+                    // <lane, index> sorted by lane, to look up the candidates reachable
+                    std::vector<std::pair<uint64_t, int>> index(num_states);
+                    for (int s = 0; s < num_states; ++s)
+                    {
+                        index[s] = std::make_pair(column.lanes_[s], s);
+                    }
+                    std::sort(index.begin(), index.end());
+                    auto find_state = [&index](uint64_t lane) -> int {
+                        auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(lane, -1));
+                        return (it != index.end() && it->first == lane) ? it->second : -1;
+                    };
+
+                    // same as hdmap::CalculateTransitionalProbability(): staying in the lane
+                    // weights 1, moving to a next, left or right lane weights 0.7, and
+                    // the weights are normalized over the current candidates
+                    std::vector<std::pair<int, double>> targets;
+                    for (int s_prev = 0; s_prev < (int)prev->lanes_.size(); ++s_prev)
+                    {
+                        if (prev->log_delta_[s_prev] == neg_inf)
+                        {
+                            continue;
+                        }
+                        uint64_t prev_lane = prev->lanes_[s_prev];
+                        targets.clear();
+                        double sum = 0.;
+                        int s = find_state(prev_lane);
+                        if (s >= 0)
+                        {
+                            targets.push_back(std::make_pair(s, 1.));
+                            sum += 1.;
+                        }
+                        const uint64_t *next_lanes = nullptr;
+                        int count = lane_map.get_lane_transitions(prev_lane, next_lanes);
+                        for (int i = 0; i < count; ++i)
+                        {
+                            s = find_state(next_lanes[i]);
+                            if (s >= 0)
+                            {
+                                targets.push_back(std::make_pair(s, 0.7));
+                                sum += 0.7;
+                            }
+                        }
+                        // v(t+1)=max(v(t)+log(P(Xt+1|Xt)))+log(P(Zt|Xt))
+                        for (const auto &target : targets)
+                        {
+                            double prob = prev->log_delta_[s_prev] + std::log(target.second / sum);
+                            if (prob > column.log_delta_[target.first])
+                            {
+                                column.log_delta_[target.first] = prob;
+                                column.psi_[target.first] = s_prev;
+                            }
+                        }
+                    }
+                    for (int s = 0; s < num_states; ++s)
+                    {
+                        if (column.psi_[s] >= 0)
+                        {
+                            column.log_delta_[s] += log_emission[s];
+                            connected = true;
+                        }
+                    }
+                }
 
-                // use the first observed result to calculate the probabilities of first node
-                std::cout << "initial delta:" << std::endl;
-                std::cout.precision(3);
-                for (int s = 0; s < num_states; ++s)
+                if (!connected)
                 {
-                    // use the distance from position to lane center to calculate intitial prob
-                    // viterbi[s,1]<-P(X0Z0)=P(X0)*P(Z0|X0)
-                    std::cout << "EmissionProbability(" << lanes[s] << "):" << EmissionProbability(lanes[s], observations->points_[0]);
-                    delta(0, s) = initial_probs(s) * EmissionProbability(lanes[s], observations->points_[0]);
-                    std::cout << " delta " << delta(0, s) << std::endl;
-                    // backpointer[s,1]<-0
-                    psi(0, s) = 0;
+                    // the first observation, or no candidate is reachable from the
+                    // previous ones: start a new path with the uniform initial probability
+                    for (int s = 0; s < num_states; ++s)
+                    {
+                        column.log_delta_[s] = log_emission[s] - std::log(num_states);
+                        column.psi_[s] = -1;
+                    }
                 }
 
-                // Recursion step
-                // for the steps after initialization
-                for (int t = 1; t < T; ++t)
+                int best_state = 0;
+                for (int s = 1; s < num_states; ++s)
                 {
-                    // process only the cadidate states near to observation
-                    std::vector<uint64_t> lanes_neighbour = sp_hdmap->get_lanes_near_pt_enu(observations->points_[t], initial_range_);
-                    time_nodes.push_back(lanes_neighbour);
+                    if (column.log_delta_[s] > column.log_delta_[best_state])
+                    {
+                        best_state = s;
+                    }
+                }
+                double max_log_delta = column.log_delta_[best_state];
+                if (max_log_delta == neg_inf)
+                {
+                    // all the candidates are impossible
+                    return -1;
+                }
+                // keep the values bounded on long trajectories
+                for (auto &log_delta : column.log_delta_)
+                {
+                    log_delta -= max_log_delta;
+                }
+                return best_state;
+            }
 
-                    std::cout << "time_nodes[t - 1]" << std::endl;
-                    print_vec(time_nodes[t - 1]);
-                    std::cout << "lanes_neighbour" << std::endl;
-                    print_vec(lanes_neighbour);
-                    // std::cout<<lanes_neighbour<<std::endl;
+            void HMMLoc::ResetOnline(int lag)
+            {
+                online_lag_ = (lag < 0) ? 0 : lag;
+                online_frame_ = 0;
+                online_window_.clear();
+            }
 
-                    Eigen::MatrixXd transition_matrix_tmp = sp_hdmap->CalculateTransitionalProbability(time_nodes[t - 1], lanes_neighbour);
+            OnlineLaneResult HMMLoc::PushObservation(const Eigen::Vector3d &pt_enu)
+            {
+                OnlineLaneResult result;
+
+                LatticeColumn column;
+                column.frame_ = online_frame_++;
+                column.lanes_ = sp_lane_map_->get_lanes_near_pt_enu(pt_enu, initial_range_);
+                bool connected = false;
+                int best_state = ViterbiStep(*sp_lane_map_, online_window_.empty() ? nullptr : &online_window_.back(),
+                                             column, pt_enu, connected);
+                if (!connected || best_state < 0)
+                {
+                    // no candidate is reachable from the previous ones (or this
+                    // is the first one): decide the pending frames and start over
+                    FlushOnline(result.decided_);
+                }
+                if (best_state < 0)
+                {
+                    // no candidate is possible, the frame has no lane and the
+                    // next observation starts a new path
+                    result.decided_.push_back({column.frame_, HMM_NO_LANE});
+                    return result;
+                }
 
-                    std::cout << "matrix_tmp" << std::endl;
-                    std::cout << transition_matrix_tmp << std::endl;
+                result.valid_ = true;
+                result.lane_ = column.lanes_[best_state];
+                online_window_.push_back(column);
 
-                    // current node
-                    for (int s = 0; s < lanes_neighbour.size(); s++)
+                if (online_window_.size() > (size_t)online_lag_)
+                {
+                    // backtrack to the oldest column, its lane becomes final
+                    int idx = best_state;
+                    for (size_t i = online_window_.size() - 1; i > 0; --i)
                     {
-                        uint64_t lane_neighbour = lanes_neighbour[s];
-                        double max_prob = 0.0;
-                        int max_state = 0;
-                        for (int s_prev = 0; s_prev < time_nodes[t - 1].size(); ++s_prev)
-                        {
-                            double transitional_prob = transition_matrix_tmp(s_prev, s);
-                            // // v(t+1)=max(v(t)*P(Xt+1|Xt)*P(Zt|Xt))
-                            // // x(t+1)=argmax(v(t)*P(Xt+1|Xt)*P(Zt|Xt))
-                            double prob = delta(t - 1, s_prev) * transitional_prob * EmissionProbability(lanes_neighbour[s], observations->points_[t]);
-                            if (prob > max_prob)
-                            {
-                                max_prob = prob;
-                                max_state = s_prev;
-                            }
-                        }
-                        delta(t, s) = max_prob;
-                        psi(t, s) = max_state;
+                        idx = online_window_[i].psi_[idx];
                     }
+                    const LatticeColumn &oldest = online_window_.front();
+                    result.decided_.push_back({oldest.frame_, oldest.lanes_[idx]});
+                    online_window_.pop_front();
                 }
-                // termination step, select the maximum probability
-                double max_prob = 0.0;
-                int best_final_state = 0;
-                for (int s = 0; s < num_states; ++s)
+                return result;
+            }
+
+            void HMMLoc::FlushOnline(std::vector<LaneDecision> &decided)
+            {
+                if (online_window_.empty())
                 {
-                    if (delta(T - 1, s) > max_prob)
+                    return;
+                }
+                const LatticeColumn &newest = online_window_.back();
+                int idx = 0;
+                for (int s = 1; s < newest.log_delta_.size(); ++s)
+                {
+                    if (newest.log_delta_[s] > newest.log_delta_[idx])
                     {
-                        max_prob = delta(T - 1, s);
-                        best_final_state = s;
+                        idx = s;
                     }
                 }
 
-                std::cout << "delta:" << std::endl;
-                std::cout << delta << std::endl;
-                // Backtrack to find the best path
-                best_path[T - 1] = best_final_state;
-                for (int t = T - 2; t >= 0; --t)
+                std::vector<int> best_path(online_window_.size());
+                for (size_t i = online_window_.size() - 1; ; --i)
                 {
-                    best_path[t] = psi(t + 1, best_path[t + 1]);
+                    best_path[i] = idx;
+                    if (i == 0)
+                    {
+                        break;
+                    }
+                    idx = online_window_[i].psi_[idx];
                 }
-
-                for (const auto &idx_path : best_path)
+                for (size_t i = 0; i < online_window_.size(); ++i)
                 {
-                    best_states.push_back(lanes[idx_path]);
+                    decided.push_back({online_window_[i].frame_, online_window_[i].lanes_[best_path[i]]});
                 }
-                return best_states;
+                online_window_.clear();
             }
 
             std::vector<uint64_t> HMMLoc::viterbiAlgorithmHDMap2(sp_cZTrajectory observations)
@@ -648,8 +802,12 @@ namespace civ
 
             double HMMLoc::EmissionProbability(uint64_t state, Eigen::Vector3d obs_pt_enu)
             {
-                Eigen::Vector3d cross_pt_curve_enu;
-                double distance = sp_hdmap_->get_distance_pt_curve_enu(obs_pt_enu, state, cross_pt_curve_enu);
+                return EmissionProbability(*sp_lane_map_, state, obs_pt_enu);
+            }
+
+            double HMMLoc::EmissionProbability(LaneMap &lane_map, uint64_t state, const Eigen::Vector3d &obs_pt_enu)
+            {
+                double distance = lane_map.get_distance_pt_lane_enu(obs_pt_enu, state);
                 double prob = CDF(lane_width_, gps_sigma_, distance);
                 return prob;
             }
@@ -1,5 +1,6 @@
 #pragma once
 #include <Eigen/Dense>
+#include <deque>
 #include <vector>
 #include "common/inner_types.hpp"
 #include "civmap/map.h"
@@ -16,6 +17,72 @@ namespace civ
             using namespace civ::common;
             using namespace civ::V2I::map;
             // using namespace zas::mapcore;
+
+            // the lane returned for an observation without any candidate lane
+            const uint64_t HMM_NO_LANE = UINT64_MAX;
+
+            /// @brief the lane decided for one observation
+            struct LaneDecision
+            {
+                uint64_t frame_; // index of the observation pushed
+                uint64_t lane_;  // the lane matched
+            };
+
+            /// @brief result of pushing one observation to the online map matching
+            struct OnlineLaneResult
+            {
+                // the most probable lane of the observation just pushed (filtering result),
+                // HMM_NO_LANE and not valid if no candidate lane is possible
+                bool valid_ = false;
+                uint64_t lane_ = HMM_NO_LANE;
+                // the fixed-lag smoothed decisions which become final after this push,
+                // in the order of frame. normally there is at most one, all the pending
+                // frames are decided at once when the path is broken. a frame without
+                // any possible candidate is decided at once as HMM_NO_LANE
+                std::vector<LaneDecision> decided_;
+            };
+
+            /// @brief the lane queries of the map matching. HDMapLanes answers them from the
+            /// HD map, another map (ex. a synthetic one in a test) can be given with SetLaneMap()
+            class LaneMap
+            {
+            public:
+                virtual ~LaneMap() {}
+                /// @brief the candidate lanes near a point
+                virtual std::vector<uint64_t> get_lanes_near_pt_enu(const Eigen::Vector3d &pt_enu, double range) = 0;
+                /// @brief the next, left and right lanes of a lane
+                /// @return the count of lanes, 0 if none
+                virtual int get_lane_transitions(uint64_t lane, const uint64_t *&lanes) = 0;
+                /// @brief perpendicular distance between the point and the lane centerline, negative
+                /// if it can not be calculated
+                virtual double get_distance_pt_lane_enu(const Eigen::Vector3d &pt_enu, uint64_t lane) = 0;
+            };
+
+            class HDMapLanes : public LaneMap
+            {
+            public:
+                explicit HDMapLanes(std::shared_ptr<zas::mapcore::hdmap> sp_hdmap)
+                    : sp_hdmap_(sp_hdmap) {}
+                std::vector<uint64_t> get_lanes_near_pt_enu(const Eigen::Vector3d &pt_enu, double range) override;
+                int get_lane_transitions(uint64_t lane, const uint64_t *&lanes) override;
+                double get_distance_pt_lane_enu(const Eigen::Vector3d &pt_enu, uint64_t lane) override;
+
+            private:
+                std::shared_ptr<zas::mapcore::hdmap> sp_hdmap_;
+                std::shared_ptr<LaneMap> sp_lane_map_;
+            };
+
+            /// @brief one column of the viterbi lattice, containing the candidates of one observation
+            struct LatticeColumn
+            {
+                uint64_t frame_;
+                std::vector<uint64_t> lanes_;
+                // log probability of the best path ending at each candidate
+                std::vector<double> log_delta_;
+                // the best previous candidate (index in previous column), -1 for start of a path
+                std::vector<int> psi_;
+            };
+
             class HMMLoc
             {
             public:
@@ -23,6 +90,9 @@ namespace civ
                 ~HMMLoc();
                 void ReadHDMap(std::string map_path, std::string json_path);
                 void SetHDMap(std::shared_ptr<zas::mapcore::hdmap> sp_hdmap);
+                /// @brief set the map used by the online map matching, SetHDMap() and ReadHDMap()
+                /// set it to the HD map
+                void SetLaneMap(std::shared_ptr<LaneMap> sp_lane_map);
                 void ReadMap(std::string map_path);
                 /// @brief the viterbiAlgorithm
                 /// @param observations
@@ -41,11 +111,29 @@ namespace civ
                 std::vector<uint64_t> viterbiAlgorithmHDMap(sp_cZTrajectory observations);
 
                 /// @brief use viterbi algorithm to extract the most probable states, which are the lanes
-                /// from observation trajectory, using HD map
+                /// from observation trajectory, using HD map. the lattice is sparse: only the lanes near
+                /// each observation are candidates of that time
                 /// @param observations 
-                /// @return 
+                /// @return one lane for each observation, HMM_NO_LANE if no lane is near the observation
                 std::vector<uint64_t> viterbiAlgorithmHDMap2(sp_cZTrajectory observations);
                 std::vector<uint64_t> viterbiAlgorithmHDMap2(sp_cZTrajectory observations,std::shared_ptr<zas::mapcore::hdmap> sp_hdmap);
+
+                /// @brief reset the online (streaming) map matching, all pending observations are dropped
+                /// @param lag the fixed lag in frames, the lane of frame t is decided when frame t+lag is pushed
+                void ResetOnline(int lag = 5);
+
+                /// @brief push one GNSS observation to the online map matching
+                /// only a sliding window of lag+1 lattice columns is kept, the probabilities are in log space.
+                /// if no candidate of the observation is possible, the pending frames are decided, the
+                /// frame is decided as HMM_NO_LANE and the next observation starts a new path
+                /// @param pt_enu the observation
+                /// @return the current best lane and the smoothed decisions
+                OnlineLaneResult PushObservation(const Eigen::Vector3d &pt_enu);
+
+                /// @brief decide all the pending frames in the window, used at the end of a trajectory
+                /// @param decided the decisions appended, in the order of frame
+                void FlushOnline(std::vector<LaneDecision> &decided);
+
             private:
                 /// @brief
                 /// @param observations
@@ -59,6 +147,21 @@ namespace civ
 
                 double EmissionProbability(uint64_t state, Eigen::Vector3d obs_pt_enu);
 
+                double EmissionProbability(LaneMap &lane_map, uint64_t state, const Eigen::Vector3d &obs_pt_enu);
+
+                /// @brief one viterbi recursion on the sparse lattice, in log space. the emissions are
+                /// calculated once for each candidate, the transitions are looked up from the lane
+                /// adjacency of the map
+                /// @param lane_map the map
+                /// @param prev the previous column, nullptr for the first observation
+                /// @param column the lanes_ shall be filled, log_delta_ and psi_ are calculated
+                /// @param pt_enu the observation
+                /// @param connected output: if any candidate is reachable from the previous column,
+                /// otherwise a new path is started
+                /// @return index of the best candidate, -1 if there is no possible candidate
+                int ViterbiStep(LaneMap &lane_map, const LatticeColumn *prev,
+                                LatticeColumn &column, const Eigen::Vector3d &pt_enu, bool &connected);
+
                 /// @brief Calculate the CDF integrating from -0.5w to 0.5w, with sigma and mean
                 /// @param w lane width
                 /// @param sigma sigma standard deviation of the GPS error
@@ -89,8 +192,14 @@ namespace civ
 
                 spCivMap sp_map_;
                 std::shared_ptr<zas::mapcore::hdmap> sp_hdmap_;
+                std::shared_ptr<LaneMap> sp_lane_map_;
                 // the initial range to search lane candidates
                 double initial_range_;
+
+                // online map matching
+                int online_lag_ = 5;
+                uint64_t online_frame_ = 0;
+                std::deque<LatticeColumn> online_window_;
             };
         }
     } // namespace V2I
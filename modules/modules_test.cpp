@@ -1,4 +1,5 @@
 #include <Eigen/Dense>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -103,6 +104,128 @@ void test_hmm_loc()
     std::vector<sp_cState> states = sp_model->viterbiAlgorithm(sp_trajectory_processor->get_trajectory_enu());
 }
 
+// parallel straight lanes along the x axis, from x = 0 to x = length_,
+// each lane may change to its left and right neighbours
+class StraightLanes : public civ::V2I::modules::LaneMap
+{
+public:
+    StraightLanes(int count, double width, double length)
+        : width_(width), length_(length), transitions_(count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (i > 0)
+            {
+                transitions_[i].push_back(i - 1);
+            }
+            if (i + 1 < count)
+            {
+                transitions_[i].push_back(i + 1);
+            }
+        }
+    }
+
+    std::vector<uint64_t> get_lanes_near_pt_enu(const Eigen::Vector3d &pt_enu, double range) override
+    {
+        std::vector<uint64_t> lanes;
+        for (uint64_t i = 0; i < transitions_.size(); ++i)
+        {
+            if (std::fabs(pt_enu[1] - i * width_) <= range)
+            {
+                lanes.push_back(i);
+            }
+        }
+        return lanes;
+    }
+
+    int get_lane_transitions(uint64_t lane, const uint64_t *&lanes) override
+    {
+        lanes = transitions_[lane].data();
+        return transitions_[lane].size();
+    }
+
+    // a point beyond the ends of the lanes can not be projected
+    double get_distance_pt_lane_enu(const Eigen::Vector3d &pt_enu, uint64_t lane) override
+    {
+        if (pt_enu[0] < 0 || pt_enu[0] > length_)
+        {
+            return -1;
+        }
+        return std::fabs(pt_enu[1] - lane * width_);
+    }
+
+private:
+    double width_;
+    double length_;
+    std::vector<std::vector<uint64_t>> transitions_;
+};
+
+int test_hmm_loc_online()
+{
+    using namespace civ::V2I::modules;
+    std::cout << "test hmm loc online" << std::endl;
+    std::shared_ptr<HMMLoc> sp_model = std::make_shared<HMMLoc>();
+    sp_model->SetLaneMap(std::make_shared<StraightLanes>(5, 3.5, 200.));
+
+    // 10 frames in lane 1, a lane change to lane 2, a frame beyond the end of
+    // the lanes where no candidate is possible, then 5 frames in lane 2
+    std::vector<Eigen::Vector3d> trajectory;
+    std::vector<uint64_t> expected;
+    for (int i = 0; i < 20; ++i)
+    {
+        trajectory.push_back(Eigen::Vector3d(i * 2., (i < 10) ? 3.6 : 7.1, 0.));
+        expected.push_back((i < 10) ? 1 : 2);
+    }
+    size_t outlier = trajectory.size();
+    trajectory.push_back(Eigen::Vector3d(500., 7., 0.));
+    expected.push_back(civ::V2I::modules::HMM_NO_LANE);
+    for (int i = 0; i < 5; ++i)
+    {
+        trajectory.push_back(Eigen::Vector3d(42. + i * 2., 7., 0.));
+        expected.push_back(2);
+    }
+
+    int errors = 0;
+    sp_model->ResetOnline(3);
+    std::vector<LaneDecision> decided;
+    for (size_t t = 0; t < trajectory.size(); ++t)
+    {
+        OnlineLaneResult result = sp_model->PushObservation(trajectory[t]);
+        decided.insert(decided.end(), result.decided_.begin(), result.decided_.end());
+        if (t == outlier)
+        {
+            // reported as no lane, and all the frames up to it are decided
+            if (result.valid_ || result.lane_ != HMM_NO_LANE || decided.size() != t + 1)
+            {
+                std::cout << "frame " << t << ": no candidate not reported" << std::endl;
+                ++errors;
+            }
+        }
+        else if (!result.valid_)
+        {
+            std::cout << "frame " << t << ": no lane" << std::endl;
+            ++errors;
+        }
+    }
+    sp_model->FlushOnline(decided);
+
+    if (decided.size() != trajectory.size())
+    {
+        std::cout << decided.size() << " frames decided of " << trajectory.size() << std::endl;
+        return ++errors;
+    }
+    for (size_t t = 0; t < decided.size(); ++t)
+    {
+        if (decided[t].frame_ != t || decided[t].lane_ != expected[t])
+        {
+            std::cout << "frame " << decided[t].frame_ << ": lane " << decided[t].lane_
+                      << ", expected frame " << t << ": lane " << expected[t] << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
 int main()
 {
     // test_gap();
@@ -110,5 +233,5 @@ int main()
     test_hmm_loc();
     // test_ttc();
 
-    return 0;
+    return test_hmm_loc_online() ? 1 : 0;
 }